@@ -0,0 +1,166 @@
+/*
+ * The C interface to turtls
+ *
+ * A connection never blocks and never touches a socket. Move bytes between it and the network as
+ * turtls_want() asks:
+ *
+ *     unsigned want = turtls_want(conn);
+ *     if (want & TURTLS_WANT_READ) {
+ *         size_t len;
+ *         uint8_t *buf = turtls_receive_buffer(conn, &len);
+ *         ssize_t n = recv(fd, buf, len, 0);
+ *         if (turtls_commit_received(conn, n > 0 ? n : 0) < 0) { ... }
+ *     }
+ *     if (want & TURTLS_WANT_WRITE) {
+ *         size_t len;
+ *         const uint8_t *out = turtls_pending_output(conn, &len);
+ *         ssize_t n = send(fd, out, len, 0);
+ *         if (n > 0) turtls_consume_output(conn, n);
+ *     }
+ *
+ * Call turtls_commit_received() after every turtls_receive_buffer(), even if nothing was received,
+ * so that an unused buffer is given back to the pool.
+ *
+ * Functions that can fail return a negative status. After TURTLS_ERR_FATAL, turtls_alert() returns
+ * the alert that was sent or received.
+ *
+ * WARNING: This code has not been audited. Use at your own risk.
+ */
+#ifndef TURTLS_H
+#define TURTLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TURTLS_WANT_READ 1u
+#define TURTLS_WANT_WRITE 2u
+
+#define TURTLS_ERR_CLOSED (-1)
+#define TURTLS_ERR_FATAL (-2)
+#define TURTLS_ERR_INVALID (-3)
+#define TURTLS_ERR_KTLS (-4)
+
+#define TURTLS_AES_128_GCM_SHA256 0x1301
+#define TURTLS_AES_256_GCM_SHA384 0x1302
+#define TURTLS_CHACHA20_POLY1305_SHA256 0x1303
+
+struct turtls_connection;
+
+/* Creates a connection from the traffic keys of a completed handshake, or returns NULL if the
+ * cipher suite is unknown or key_len is wrong for it. Each IV is 12 bytes. */
+struct turtls_connection *turtls_connection_new(uint16_t cipher_suite, const uint8_t *read_key,
+                                                const uint8_t *read_iv, const uint8_t *write_key,
+                                                const uint8_t *write_iv, size_t key_len);
+
+/* Frees a connection. NULL is ignored. */
+void turtls_connection_free(struct turtls_connection *conn);
+
+/* Returns what the connection is waiting on: TURTLS_WANT_READ, TURTLS_WANT_WRITE, both, or 0. */
+uint32_t turtls_want(const struct turtls_connection *conn);
+
+/* Returns the alert sent or received when the connection failed, or -1 if it hasn't. */
+int turtls_alert(const struct turtls_connection *conn);
+
+/* Processes received bytes, returning how many were used, or a negative status. */
+ssize_t turtls_feed(struct turtls_connection *conn, const uint8_t *data, size_t len);
+
+/* Returns space to receive into, valid until the next call on conn, and writes its length.
+ * Always follow it with turtls_commit_received(), even if 0 bytes were received. */
+uint8_t *turtls_receive_buffer(struct turtls_connection *conn, size_t *len);
+
+/* Processes n bytes received into turtls_receive_buffer(), returning 0 or a negative status. */
+int turtls_commit_received(struct turtls_connection *conn, size_t n);
+
+/* Reads decrypted application data, returning how many bytes were read. */
+ssize_t turtls_read(struct turtls_connection *conn, uint8_t *buf, size_t len);
+
+/* Seals application data, returning how many bytes were sealed, or a negative status. */
+ssize_t turtls_write(struct turtls_connection *conn, const uint8_t *data, size_t len);
+
+/* Returns the records waiting to be sent, valid until the next call on conn, and writes their
+ * length. */
+const uint8_t *turtls_pending_output(const struct turtls_connection *conn, size_t *len);
+
+/* Marks n bytes of the pending output as sent, returning 0 or a negative status. */
+int turtls_consume_output(struct turtls_connection *conn, size_t n);
+
+#ifdef __linux__
+/* Hands the connection over to kernel TLS on the TCP socket fd, returning 0 or a negative status.
+ * There must be no output left to send and no data left to read. On TURTLS_ERR_KTLS, errno is
+ * set. Afterwards, the socket seals and opens records itself, and conn can only be freed. */
+int turtls_ktls_offload(struct turtls_connection *conn, int fd);
+#endif
+
+/* Closes this side of the connection, by queueing a close_notify alert. */
+void turtls_close(struct turtls_connection *conn);
+
+/* The hardware the cryptographic primitives use. Without TURTLS_HW_AES, AES is running in
+ * software. The TURTLS_DISABLE environment variable, such as "aes,clmul", turns hardware off the
+ * first time a connection is created. */
+#define TURTLS_HW_AES 1u
+#define TURTLS_HW_CLMUL 2u
+#define TURTLS_HW_SHA256 4u
+#define TURTLS_HW_AVX2 8u
+#define TURTLS_HW_AVX512F 16u
+
+/* Returns the hardware in use, as a combination of TURTLS_HW_*. */
+uint32_t turtls_hardware(void);
+
+/* Uses only the hardware in allowed that the CPU supports, returning the hardware now in use.
+ * 0 forces software. Existing connections keep what they were created with. */
+uint32_t turtls_restrict_hardware(uint32_t allowed);
+
+/* Writes the names of the implementations in use, such as "aes=aes-ni ghash=pclmulqdq ...", to buf
+ * as a null-terminated string, and returns their length. If that isn't less than len, the names
+ * were cut short. */
+size_t turtls_backends(char *buf, size_t len);
+
+/* Counters, only available when turtls is built with the "stats" feature. Define TURTLS_STATS to
+ * declare them. */
+#ifdef TURTLS_STATS
+#define TURTLS_STAGE_KEY_EXCHANGE 0u
+#define TURTLS_STAGE_SIGN 1u
+
+struct turtls_counters {
+    uint64_t records_sealed;
+    uint64_t bytes_sealed;
+    uint64_t records_opened;
+    uint64_t bytes_opened;
+};
+
+struct turtls_stage_times {
+    uint64_t count;
+    uint64_t nanos;
+};
+
+struct turtls_stats {
+    struct turtls_counters records;
+    /* Indexed by TURTLS_STAGE_*. */
+    struct turtls_stage_times stages[2];
+    /* A combination of TURTLS_HW_*. Without TURTLS_HW_AES, AES is running in software. */
+    uint32_t hardware;
+};
+
+/* Writes the counters for the whole process, returning 0 or a negative status. */
+int turtls_stats(struct turtls_stats *stats);
+
+/* Writes the counts of the records conn has sealed and opened, returning 0 or a negative status. */
+int turtls_connection_counters(const struct turtls_connection *conn,
+                               struct turtls_counters *counters);
+
+/* Sets the hook called with each handshake stage, its duration, and context, as it completes, or
+ * removes it if hook is NULL. The hook is called on whichever thread ran the stage. */
+void turtls_set_trace_hook(void (*hook)(uint32_t stage, uint64_t nanos, void *context),
+                           void *context);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
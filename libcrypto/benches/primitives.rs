@@ -0,0 +1,260 @@
+//! Benchmarks for the symmetric primitives and field arithmetic
+//!
+//! Run with `cargo bench`, optionally followed by `--` and a filter, such as
+//! `cargo bench -- gcm`, which only runs the benchmarks whose names contain it.
+//!
+//! To compare implementations, set `LIBCRYPTO_DISABLE` to the CPU features to turn off, as taken
+//! by [`Features::without`], such as `LIBCRYPTO_DISABLE=aes,clmul cargo bench -- gcm`.
+//! The implementations in use are printed first.
+//!
+//! Each benchmark reports the time per call and, for those that process data, the throughput.
+//! On x86_64, it also reports cycles per byte (or per call), counted with the time stamp counter.
+//! The time stamp counter ticks at a constant rate, so under frequency scaling or turbo these
+//! are reference cycles rather than core cycles.
+use std::hint::black_box;
+use std::time::{Duration, Instant};
+
+use libcrypto::aes::gcm::{BatchMessage, Gcm};
+use libcrypto::aes::{Aes128, Aes256};
+use libcrypto::chacha::chacha20;
+use libcrypto::cpu::{self, Features};
+use libcrypto::elliptic_curve::secp256r1::FieldElement;
+use libcrypto::sha2::{sha256, sha512};
+
+/// The message sizes each throughput benchmark is run at
+const SIZES: [usize; 5] = [16, 64, 1024, 16 * 1024, 1024 * 1024];
+
+/// How long each benchmark is measured for, after warming up
+const MEASURE_TIME: Duration = Duration::from_millis(500);
+
+/// How long each benchmark is run before measuring
+const WARM_UP_TIME: Duration = Duration::from_millis(100);
+
+/// Reads the cycle counter, if the CPU has one we can read
+#[inline(always)]
+fn cycles() -> Option<u64> {
+    #[cfg(target_arch = "x86_64")]
+    // SAFETY: every x86_64 CPU has the time stamp counter
+    return Some(unsafe { core::arch::x86_64::_rdtsc() });
+    #[cfg(not(target_arch = "x86_64"))]
+    None
+}
+
+/// Runs and reports benchmarks, skipping those that don't match the filter
+struct Runner {
+    filter: Option<String>,
+}
+
+impl Runner {
+    fn new() -> Self {
+        // cargo passes `--bench`, and would pass other flags, which aren't filters
+        let filter = std::env::args().skip(1).find(|arg| !arg.starts_with("--"));
+        println!(
+            "{:<32} {:>12} {:>12} {:>12}",
+            "benchmark",
+            "time",
+            "throughput",
+            if cycles().is_some() { "cycles" } else { "" },
+        );
+        Self { filter }
+    }
+
+    /// Measures `f`, which processes `bytes` bytes per call, or none if `bytes` is `None`
+    fn run(&self, name: &str, bytes: Option<usize>, mut f: impl FnMut()) {
+        if self
+            .filter
+            .as_ref()
+            .is_some_and(|filter| !name.contains(filter.as_str()))
+        {
+            return;
+        }
+        let start = Instant::now();
+        while start.elapsed() < WARM_UP_TIME {
+            f();
+        }
+
+        // time batches, so that reading the clock doesn't dominate short calls
+        let mut batch = 1u64;
+        let mut calls = 0u64;
+        let mut elapsed = Duration::ZERO;
+        let mut elapsed_cycles = 0;
+        while elapsed < MEASURE_TIME {
+            let start_cycles = cycles();
+            let start = Instant::now();
+            for _ in 0..batch {
+                f();
+            }
+            elapsed += start.elapsed();
+            if let (Some(start), Some(end)) = (start_cycles, cycles()) {
+                elapsed_cycles += end - start;
+            }
+            calls += batch;
+            batch = batch.saturating_mul(2).min(1 << 20);
+        }
+
+        let per_call = elapsed.as_secs_f64() / calls as f64;
+        let time = format_time(per_call);
+        let (throughput, cycle_count) = match bytes {
+            Some(bytes) => (
+                format!("{:.1} MiB/s", bytes as f64 / per_call / (1024.0 * 1024.0)),
+                elapsed_cycles as f64 / (calls * bytes as u64) as f64,
+            ),
+            None => (String::new(), elapsed_cycles as f64 / calls as f64),
+        };
+        let cycle_count = match (cycles(), bytes) {
+            (None, _) => String::new(),
+            (Some(_), Some(_)) => format!("{cycle_count:.2} /B"),
+            (Some(_), None) => format!("{cycle_count:.0}"),
+        };
+        println!("{name:<32} {time:>12} {throughput:>12} {cycle_count:>12}");
+    }
+}
+
+fn format_time(seconds: f64) -> String {
+    match seconds {
+        s if s < 1e-6 => format!("{:.1} ns", s * 1e9),
+        s if s < 1e-3 => format!("{:.2} µs", s * 1e6),
+        s => format!("{:.2} ms", s * 1e3),
+    }
+}
+
+/// Names a benchmark that runs at one of [`SIZES`]
+fn sized(name: &str, size: usize) -> String {
+    match size {
+        size if size >= 1024 * 1024 => format!("{name}/{}MiB", size / (1024 * 1024)),
+        size if size >= 1024 => format!("{name}/{}KiB", size / 1024),
+        size => format!("{name}/{size}B"),
+    }
+}
+
+fn bench_gcm(runner: &Runner) {
+    let init_vector = [0x5a; 12];
+    let add_data = [0xad; 13];
+    let aes128 = Gcm::<Aes128>::new([0x42; 16]);
+    let aes256 = Gcm::<Aes256>::new([0x42; 32]);
+    for size in SIZES {
+        let msg = vec![0x17; size];
+        let mut buf = vec![0; size];
+
+        runner.run(&sized("gcm-aes128/seal", size), Some(size), || {
+            black_box(aes128.encrypt(black_box(&msg), &add_data, &init_vector, &mut buf));
+        });
+        let tag = aes128.encrypt(&msg, &add_data, &init_vector, &mut buf);
+        let cipher_text = buf.clone();
+        runner.run(&sized("gcm-aes128/open", size), Some(size), || {
+            let result = aes128.decrypt(
+                black_box(&cipher_text),
+                &add_data,
+                &init_vector,
+                &tag,
+                &mut buf,
+            );
+            assert!(result.is_ok());
+        });
+
+        runner.run(&sized("gcm-aes256/seal", size), Some(size), || {
+            black_box(aes256.encrypt(black_box(&msg), &add_data, &init_vector, &mut buf));
+        });
+        let tag = aes256.encrypt(&msg, &add_data, &init_vector, &mut buf);
+        let cipher_text = buf.clone();
+        runner.run(&sized("gcm-aes256/open", size), Some(size), || {
+            let result = aes256.decrypt(
+                black_box(&cipher_text),
+                &add_data,
+                &init_vector,
+                &tag,
+                &mut buf,
+            );
+            assert!(result.is_ok());
+        });
+
+        // a batch of 8 messages of `size`, against that batch sealed one message at a time
+        let mut batch = vec![0x17; size * 8];
+        runner.run(&sized("gcm-aes128/seal-8", size), Some(size * 8), || {
+            for message in black_box(&mut batch).chunks_exact_mut(size) {
+                black_box(aes128.encrypt_inline(message, &add_data, &init_vector));
+            }
+        });
+        runner.run(
+            &sized("gcm-aes128/seal-batch-8", size),
+            Some(size * 8),
+            || {
+                let mut messages: [BatchMessage; 8] = Default::default();
+                for (message, data) in messages
+                    .iter_mut()
+                    .zip(black_box(&mut batch).chunks_exact_mut(size))
+                {
+                    *message = BatchMessage {
+                        data,
+                        add_data: &add_data,
+                        init_vector,
+                        ..Default::default()
+                    };
+                }
+                aes128.encrypt_batch_inline(&mut messages);
+                black_box(messages);
+            },
+        );
+
+        // with no message, only the additional data is hashed, which isolates GHASH
+        runner.run(&sized("ghash", size), Some(size), || {
+            black_box(aes128.encrypt_inline(&mut [], black_box(&msg), &init_vector));
+        });
+    }
+}
+
+fn bench_chacha20(runner: &Runner) {
+    for size in SIZES {
+        let mut msg = vec![0x17; size];
+        runner.run(&sized("chacha20", size), Some(size), || {
+            chacha20::encrypt_inline(black_box(&mut msg), [0x42; 32], [0x5a; 12], 1);
+        });
+    }
+}
+
+fn bench_sha2(runner: &Runner) {
+    for size in SIZES {
+        let msg = vec![0x17; size];
+        runner.run(&sized("sha256", size), Some(size), || {
+            black_box(sha256(black_box(&msg)));
+        });
+        runner.run(&sized("sha512", size), Some(size), || {
+            black_box(sha512(black_box(&msg)));
+        });
+    }
+}
+
+fn bench_field_element(runner: &Runner) {
+    let x = FieldElement::from_be_bytes(&[0x17; 32]).unwrap();
+    let y = FieldElement::from_be_bytes(&[0x5a; 32]).unwrap();
+    runner.run("p256-field/add", None, || {
+        black_box(black_box(x).add(black_box(y)));
+    });
+    runner.run("p256-field/sub", None, || {
+        black_box(black_box(x).sub(black_box(y)));
+    });
+    runner.run("p256-field/mul", None, || {
+        black_box(black_box(x).mul(black_box(y)));
+    });
+    runner.run("p256-field/square", None, || {
+        black_box(black_box(x).square());
+    });
+    runner.run("p256-field/invert", None, || {
+        black_box(black_box(x).invert());
+    });
+}
+
+fn main() {
+    if let Ok(names) = std::env::var("LIBCRYPTO_DISABLE") {
+        let allowed = Features::ALL
+            .without(&names)
+            .expect("LIBCRYPTO_DISABLE has an unknown feature");
+        cpu::restrict(allowed);
+    }
+    println!("{}", cpu::backends());
+    let runner = Runner::new();
+    bench_gcm(&runner);
+    bench_chacha20(&runner);
+    bench_sha2(&runner);
+    bench_field_element(&runner);
+}
@@ -6,4 +6,14 @@
 //! GCM (Galois/Counter Mode).
 pub mod aes_core;
 pub use aes_core::*;
+#[cfg(target_arch = "aarch64")]
+mod aes_armv8;
+mod aes_bitsliced;
+#[cfg(target_arch = "x86_64")]
+mod aes_ni;
 pub mod gcm;
+pub(crate) mod ghash;
+#[cfg(target_arch = "x86_64")]
+mod ghash_clmul;
+#[cfg(target_arch = "aarch64")]
+mod ghash_pmull;
@@ -0,0 +1,84 @@
+//! An implementation of AES using the aarch64 cryptography extensions
+//!
+//! These functions take the same round keys as the software implementation.
+use super::aes_core::{RoundKeys, BLOCK_SIZE, PARALLEL_BLOCKS};
+use core::arch::aarch64::{uint8x16_t, vaeseq_u8, vaesmcq_u8, veorq_u8, vld1q_u8, vst1q_u8};
+
+/// Encrypts `block` inline using `round_keys`
+///
+/// `N` is the number of round keys, which is one more than the number of rounds.
+///
+/// Note that `AESE` performs AddRoundKey *before* SubBytes and ShiftRows,
+/// so the final round key is applied with a plain XOR.
+///
+/// # Safety
+///
+/// The CPU must support the `aes` target feature.
+#[target_feature(enable = "aes")]
+pub(super) unsafe fn encrypt_inline<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    block: &mut [u8; BLOCK_SIZE],
+) {
+    let mut state = load(block);
+    for round_key in round_keys[..N - 2].iter() {
+        state = vaesmcq_u8(vaeseq_u8(state, load(round_key)));
+    }
+    state = vaeseq_u8(state, load(&round_keys[N - 2]));
+    state = veorq_u8(state, load(&round_keys[N - 1]));
+    vst1q_u8(block.as_mut_ptr(), state);
+}
+
+/// Encrypts `blocks` inline using `round_keys`
+///
+/// Blocks are encrypted [`PARALLEL_BLOCKS`] at a time,
+/// so that the latency of each `AESE`/`AESMC` pair is hidden behind the others.
+///
+/// # Safety
+///
+/// The CPU must support the `aes` target feature.
+#[target_feature(enable = "aes")]
+pub(super) unsafe fn encrypt_blocks_inline<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    blocks: &mut [[u8; BLOCK_SIZE]],
+) {
+    let mut chunks = blocks.chunks_exact_mut(PARALLEL_BLOCKS);
+    for chunk in &mut chunks {
+        // we can safely unwrap because `chunk` is guaranteed to have a length of
+        // `PARALLEL_BLOCKS`
+        encrypt_parallel(round_keys, chunk.try_into().unwrap());
+    }
+    for block in chunks.into_remainder() {
+        encrypt_inline(round_keys, block);
+    }
+}
+
+#[inline]
+#[target_feature(enable = "aes")]
+unsafe fn encrypt_parallel<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    blocks: &mut [[u8; BLOCK_SIZE]; PARALLEL_BLOCKS],
+) {
+    let mut state = [load(&blocks[0]); PARALLEL_BLOCKS];
+    for (state, block) in state.iter_mut().zip(blocks.iter()) {
+        *state = load(block);
+    }
+    for round_key in round_keys[..N - 2].iter() {
+        let round_key = load(round_key);
+        for state in state.iter_mut() {
+            *state = vaesmcq_u8(vaeseq_u8(*state, round_key));
+        }
+    }
+    let second_last = load(&round_keys[N - 2]);
+    let last = load(&round_keys[N - 1]);
+    for (state, block) in state.iter().zip(blocks.iter_mut()) {
+        vst1q_u8(
+            block.as_mut_ptr(),
+            veorq_u8(vaeseq_u8(*state, second_last), last),
+        );
+    }
+}
+
+#[inline(always)]
+unsafe fn load(block: &[u8; BLOCK_SIZE]) -> uint8x16_t {
+    vld1q_u8(block.as_ptr())
+}
@@ -0,0 +1,414 @@
+//! A constant-time implementation of AES in software, using bitslicing
+//!
+//! Instead of looking bytes up in tables, whose timing depends on the cache,
+//! [`PARALLEL_BLOCKS`] blocks are transposed into eight 128-bit words, one for each bit of a byte.
+//! Every operation then works on the same bit of all 128 bytes at once: the S-box becomes a
+//! circuit of logic gates (Boyar and Peralta), and the other steps become shifts and rotations.
+//!
+//! Bit `8 * i + j` of each word belongs to byte `i` of block `j`, so each byte of the state
+//! occupies the same byte of every word, and bytes of the state can be moved with byte shifts.
+//!
+//! These functions take the same round keys as the hardware implementations.
+use super::aes_core::{RoundKeys, BLOCK_SIZE, PARALLEL_BLOCKS};
+
+/// [`PARALLEL_BLOCKS`] blocks, with word `b` holding bit `b` of every byte
+type State = [u128; 8];
+
+/// The lowest bit of each byte
+const LOW_BITS: u128 = u128::MAX / 0xff;
+
+/// The bytes in the first row of the state, which are the first byte of each column
+const ROW_0: u128 = u128::MAX / 0xffff_ffff * 0xff;
+
+/// Encrypts `block` inline using `round_keys`
+///
+/// The other blocks of the state are left empty, so this takes as long as encrypting
+/// [`PARALLEL_BLOCKS`] blocks.
+///
+/// `N` is the number of round keys, which is one more than the number of rounds.
+pub(super) fn encrypt_inline<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    block: &mut [u8; BLOCK_SIZE],
+) {
+    encrypt_blocks_inline(round_keys, core::slice::from_mut(block));
+}
+
+/// Encrypts `blocks` inline using `round_keys`
+///
+/// Blocks are encrypted [`PARALLEL_BLOCKS`] at a time. The last few blocks are padded,
+/// so passing a multiple of [`PARALLEL_BLOCKS`] blocks wastes the least time.
+pub(super) fn encrypt_blocks_inline<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    blocks: &mut [[u8; BLOCK_SIZE]],
+) {
+    let mut chunks = blocks.chunks_exact_mut(PARALLEL_BLOCKS);
+    for chunk in &mut chunks {
+        // we can safely unwrap because `chunk` is guaranteed to have a length of
+        // `PARALLEL_BLOCKS`
+        encrypt_parallel(round_keys, chunk.try_into().unwrap());
+    }
+    let remainder = chunks.into_remainder();
+    if !remainder.is_empty() {
+        let mut padded = [[0; BLOCK_SIZE]; PARALLEL_BLOCKS];
+        padded[..remainder.len()].copy_from_slice(remainder);
+        encrypt_parallel(round_keys, &mut padded);
+        remainder.copy_from_slice(&padded[..remainder.len()]);
+        crate::zeroize::zeroize(&mut padded, [0; BLOCK_SIZE]);
+    }
+}
+
+fn encrypt_parallel<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    blocks: &mut [[u8; BLOCK_SIZE]; PARALLEL_BLOCKS],
+) {
+    let mut state = pack(blocks);
+    add_round_key(&mut state, &round_keys[0]);
+    for round_key in round_keys[1..N - 1].iter() {
+        sub_bytes(&mut state);
+        shift_rows(&mut state);
+        mix_columns(&mut state);
+        add_round_key(&mut state, round_key);
+    }
+    sub_bytes(&mut state);
+    shift_rows(&mut state);
+    add_round_key(&mut state, &round_keys[N - 1]);
+    *blocks = unpack(&state);
+    crate::zeroize::zeroize(&mut state, 0);
+}
+
+/// Applies the S-box to each byte of `word`, for key expansion
+pub(super) fn sub_word(word: u32) -> u32 {
+    // endianness doesn't matter so long as byte order is maintained
+    let mut state = [0; 8];
+    for (i, byte) in word.to_ne_bytes().into_iter().enumerate() {
+        for (b, word) in state.iter_mut().enumerate() {
+            *word |= ((byte >> b & 1) as u128) << (8 * i);
+        }
+    }
+    sub_bytes(&mut state);
+    let mut bytes = [0u8; 4];
+    for (i, byte) in bytes.iter_mut().enumerate() {
+        for (b, word) in state.iter().enumerate() {
+            *byte |= ((word >> (8 * i)) as u8 & 1) << b;
+        }
+    }
+    let word = u32::from_ne_bytes(bytes);
+    crate::zeroize::zeroize(&mut state, 0);
+    crate::zeroize::zeroize(&mut bytes, 0);
+    word
+}
+
+/// Transposes `blocks` into the bitsliced representation
+fn pack(blocks: &[[u8; BLOCK_SIZE]; PARALLEL_BLOCKS]) -> State {
+    let mut state = [0; 8];
+    for i in 0..BLOCK_SIZE {
+        let bytes = u64::from_le_bytes(core::array::from_fn(|j| blocks[j][i]));
+        for (word, bits) in state.iter_mut().zip(transpose(bytes).to_le_bytes()) {
+            *word |= (bits as u128) << (8 * i);
+        }
+    }
+    state
+}
+
+/// The inverse of [`pack`]
+fn unpack(state: &State) -> [[u8; BLOCK_SIZE]; PARALLEL_BLOCKS] {
+    let mut blocks = [[0; BLOCK_SIZE]; PARALLEL_BLOCKS];
+    for i in 0..BLOCK_SIZE {
+        let bits = u64::from_le_bytes(core::array::from_fn(|b| (state[b] >> (8 * i)) as u8));
+        for (block, byte) in blocks.iter_mut().zip(transpose(bits).to_le_bytes()) {
+            block[i] = byte;
+        }
+    }
+    blocks
+}
+
+/// Transposes an 8x8 matrix of bits, where byte `i` is row `i`
+///
+/// Bit `j` of byte `i` becomes bit `i` of byte `j`.
+#[inline]
+const fn transpose(mut x: u64) -> u64 {
+    // swap ever larger blocks across the diagonal: 1x1, then 2x2, then 4x4
+    let t = (x ^ x >> 7) & 0x00aa_00aa_00aa_00aa;
+    x ^= t ^ t << 7;
+    let t = (x ^ x >> 14) & 0x0000_cccc_0000_cccc;
+    x ^= t ^ t << 14;
+    let t = (x ^ x >> 28) & 0x0000_0000_f0f0_f0f0;
+    x ^ t ^ t << 28
+}
+
+#[inline]
+fn add_round_key(state: &mut State, round_key: &[u8; BLOCK_SIZE]) {
+    let round_key = u128::from_le_bytes(*round_key);
+    for (b, word) in state.iter_mut().enumerate() {
+        // spread bit `b` of each byte of the key across every block
+        *word ^= (round_key >> b & LOW_BITS) * 0xff;
+    }
+}
+
+#[inline]
+fn shift_rows(state: &mut State) {
+    // row `r` rotates `r` columns, and each column is 32 bits wide
+    for word in state.iter_mut() {
+        *word = *word & ROW_0
+            | (*word & ROW_0 << 8).rotate_right(32)
+            | (*word & ROW_0 << 16).rotate_right(64)
+            | (*word & ROW_0 << 24).rotate_right(96);
+    }
+}
+
+#[inline]
+fn mix_columns(state: &mut State) {
+    // each byte becomes 2 * a0 + 3 * a1 + a2 + a3, where a0 is the byte and a1, a2, a3 are the
+    // bytes below it in its column, which is 2 * (a0 + a1) + a1 + (a2 + a3)
+    let below = state.map(|word| rotate_rows(word, 1));
+    let sums: State = core::array::from_fn(|b| state[b] ^ below[b]);
+    let doubled = double(&sums);
+    for (b, word) in state.iter_mut().enumerate() {
+        *word = doubled[b] ^ below[b] ^ rotate_rows(sums[b], 2);
+    }
+}
+
+/// Moves each byte of `word` `rows` rows up its column, wrapping around
+#[inline]
+const fn rotate_rows(word: u128, rows: u32) -> u128 {
+    let stays = u128::MAX / 0xffff_ffff * (u32::MAX >> (8 * rows)) as u128;
+    word >> (8 * rows) & stays | word << (32 - 8 * rows) & !stays
+}
+
+/// Multiplies each byte by 2 in GF(2^8)
+#[inline]
+const fn double(state: &State) -> State {
+    // the top bit overflows into x^8, which is x^4 + x^3 + x + 1
+    let top = state[7];
+    [
+        top,
+        state[0] ^ top,
+        state[1],
+        state[2] ^ top,
+        state[3] ^ top,
+        state[4],
+        state[5],
+        state[6],
+    ]
+}
+
+/// Applies the S-box to every byte of `state`
+///
+/// This is the circuit of Boyar and Peralta, which takes 113 gates: a linear layer,
+/// an inversion in GF(2^8) computed in a tower of smaller fields, and another linear layer,
+/// which also includes the affine transformation of the S-box.
+#[inline]
+fn sub_bytes(state: &mut State) {
+    let [x7, x6, x5, x4, x3, x2, x1, x0] = *state;
+
+    // top linear layer
+    let y14 = x3 ^ x5;
+    let y13 = x0 ^ x6;
+    let y9 = x0 ^ x3;
+    let y8 = x0 ^ x5;
+    let t0 = x1 ^ x2;
+    let y1 = t0 ^ x7;
+    let y4 = y1 ^ x3;
+    let y12 = y13 ^ y14;
+    let y2 = y1 ^ x0;
+    let y5 = y1 ^ x6;
+    let y3 = y5 ^ y8;
+    let t1 = x4 ^ y12;
+    let y15 = t1 ^ x5;
+    let y20 = t1 ^ x1;
+    let y6 = y15 ^ x7;
+    let y10 = y15 ^ t0;
+    let y11 = y20 ^ y9;
+    let y7 = x7 ^ y11;
+    let y17 = y10 ^ y11;
+    let y19 = y10 ^ y8;
+    let y16 = t0 ^ y11;
+    let y21 = y13 ^ y16;
+    let y18 = x0 ^ y16;
+
+    // non-linear layer
+    let t2 = y12 & y15;
+    let t3 = y3 & y6;
+    let t4 = t3 ^ t2;
+    let t5 = y4 & x7;
+    let t6 = t5 ^ t2;
+    let t7 = y13 & y16;
+    let t8 = y5 & y1;
+    let t9 = t8 ^ t7;
+    let t10 = y2 & y7;
+    let t11 = t10 ^ t7;
+    let t12 = y9 & y11;
+    let t13 = y14 & y17;
+    let t14 = t13 ^ t12;
+    let t15 = y8 & y10;
+    let t16 = t15 ^ t12;
+    let t17 = t4 ^ t14;
+    let t18 = t6 ^ t16;
+    let t19 = t9 ^ t14;
+    let t20 = t11 ^ t16;
+    let t21 = t17 ^ y20;
+    let t22 = t18 ^ y19;
+    let t23 = t19 ^ y21;
+    let t24 = t20 ^ y18;
+
+    let t25 = t21 ^ t22;
+    let t26 = t21 & t23;
+    let t27 = t24 ^ t26;
+    let t28 = t25 & t27;
+    let t29 = t28 ^ t22;
+    let t30 = t23 ^ t24;
+    let t31 = t22 ^ t26;
+    let t32 = t31 & t30;
+    let t33 = t32 ^ t24;
+    let t34 = t23 ^ t33;
+    let t35 = t27 ^ t33;
+    let t36 = t24 & t35;
+    let t37 = t36 ^ t34;
+    let t38 = t27 ^ t36;
+    let t39 = t29 & t38;
+    let t40 = t25 ^ t39;
+
+    let t41 = t40 ^ t37;
+    let t42 = t29 ^ t33;
+    let t43 = t29 ^ t40;
+    let t44 = t33 ^ t37;
+    let t45 = t42 ^ t41;
+    let z0 = t44 & y15;
+    let z1 = t37 & y6;
+    let z2 = t33 & x7;
+    let z3 = t43 & y16;
+    let z4 = t40 & y1;
+    let z5 = t29 & y7;
+    let z6 = t42 & y11;
+    let z7 = t45 & y17;
+    let z8 = t41 & y10;
+    let z9 = t44 & y12;
+    let z10 = t37 & y3;
+    let z11 = t33 & y4;
+    let z12 = t43 & y13;
+    let z13 = t40 & y5;
+    let z14 = t29 & y2;
+    let z15 = t42 & y9;
+    let z16 = t45 & y14;
+    let z17 = t41 & y8;
+
+    // bottom linear layer
+    let t46 = z15 ^ z16;
+    let t47 = z10 ^ z11;
+    let t48 = z5 ^ z13;
+    let t49 = z9 ^ z10;
+    let t50 = z2 ^ z12;
+    let t51 = z2 ^ z5;
+    let t52 = z7 ^ z8;
+    let t53 = z0 ^ z3;
+    let t54 = z6 ^ z7;
+    let t55 = z16 ^ z17;
+    let t56 = z12 ^ t48;
+    let t57 = t50 ^ t53;
+    let t58 = z4 ^ t46;
+    let t59 = z3 ^ t54;
+    let t60 = t46 ^ t57;
+    let t61 = z14 ^ t57;
+    let t62 = t52 ^ t58;
+    let t63 = t49 ^ t58;
+    let t64 = z4 ^ t59;
+    let t65 = t61 ^ t62;
+    let t66 = z1 ^ t63;
+    let s0 = t59 ^ t63;
+    let s6 = t56 ^ !t62;
+    let s7 = t48 ^ !t60;
+    let t67 = t64 ^ t65;
+    let s3 = t53 ^ t66;
+    let s4 = t51 ^ t66;
+    let s5 = t47 ^ t65;
+    let s1 = t64 ^ !s3;
+    let s2 = t55 ^ !t67;
+
+    *state = [s7, s6, s5, s4, s3, s2, s1, s0];
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{pack, unpack, BLOCK_SIZE, PARALLEL_BLOCKS};
+
+    /// Applies `step` to `block`, with a copy of `block` in every lane of the state
+    fn apply(step: fn(&mut super::State), block: [u8; BLOCK_SIZE]) -> [u8; BLOCK_SIZE] {
+        let mut state = pack(&[block; PARALLEL_BLOCKS]);
+        step(&mut state);
+        let blocks = unpack(&state);
+        assert!(blocks.iter().all(|lane| *lane == blocks[0]));
+        blocks[0]
+    }
+
+    #[test]
+    fn pack_unpack() {
+        let blocks = core::array::from_fn(|i| core::array::from_fn(|j| (i * 37 + j * 11) as u8));
+        let state = pack(&blocks);
+        // byte 0 of block 1 is 37, whose lowest bit is set
+        assert_eq!(state[0] >> 1 & 1, 1);
+        assert_eq!(unpack(&state), blocks);
+    }
+
+    #[test]
+    fn add_round_key() {
+        let state: [u8; 16] = [
+            0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37,
+            0x07, 0x34,
+        ];
+        let round_key: [u8; 16] = [
+            0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf,
+            0x4f, 0x3c,
+        ];
+        let output_state: [u8; 16] = [
+            0x19, 0x3d, 0xe3, 0xbe, 0xa0, 0xf4, 0xe2, 0x2b, 0x9a, 0xc6, 0x8d, 0x2a, 0xe9, 0xf8,
+            0x48, 0x08,
+        ];
+        let mut state = pack(&[state; PARALLEL_BLOCKS]);
+        super::add_round_key(&mut state, &round_key);
+        assert_eq!(unpack(&state), [output_state; PARALLEL_BLOCKS]);
+    }
+
+    #[test]
+    fn sub_bytes() {
+        let state: [u8; 16] = [
+            0x19, 0x3d, 0xe3, 0xbe, 0xa0, 0xf4, 0xe2, 0x2b, 0x9a, 0xc6, 0x8d, 0x2a, 0xe9, 0xf8,
+            0x48, 0x08,
+        ];
+        let output_state: [u8; 16] = [
+            0xd4, 0x27, 0x11, 0xae, 0xe0, 0xbf, 0x98, 0xf1, 0xb8, 0xb4, 0x5d, 0xe5, 0x1e, 0x41,
+            0x52, 0x30,
+        ];
+        assert_eq!(apply(super::sub_bytes, state), output_state);
+        assert_eq!(super::sub_word(0), 0x6363_6363);
+        assert_eq!(
+            super::sub_word(u32::from_ne_bytes([0x53, 0x00, 0x01, 0xff])),
+            u32::from_ne_bytes([0xed, 0x63, 0x7c, 0x16])
+        );
+    }
+
+    #[test]
+    fn shift_rows() {
+        let state: [u8; 16] = [
+            0xd4, 0x27, 0x11, 0xae, 0xe0, 0xbf, 0x98, 0xf1, 0xb8, 0xb4, 0x5d, 0xe5, 0x1e, 0x41,
+            0x52, 0x30,
+        ];
+        let output_state: [u8; 16] = [
+            0xd4, 0xbf, 0x5d, 0x30, 0xe0, 0xb4, 0x52, 0xae, 0xb8, 0x41, 0x11, 0xf1, 0x1e, 0x27,
+            0x98, 0xe5,
+        ];
+        assert_eq!(apply(super::shift_rows, state), output_state);
+    }
+
+    #[test]
+    fn mix_columns() {
+        let state: [u8; 16] = [
+            0xd4, 0xbf, 0x5d, 0x30, 0xe0, 0xb4, 0x52, 0xae, 0xb8, 0x41, 0x11, 0xf1, 0x1e, 0x27,
+            0x98, 0xe5,
+        ];
+        let output_state: [u8; 16] = [
+            0x04, 0x66, 0x81, 0xe5, 0xe0, 0xcb, 0x19, 0x9a, 0x48, 0xf8, 0xd3, 0x7a, 0x28, 0x06,
+            0x26, 0x4c,
+        ];
+        assert_eq!(apply(super::mix_columns, state), output_state);
+    }
+}
@@ -0,0 +1,93 @@
+//! An implementation of AES using the x86_64 AES-NI instructions
+//!
+//! These functions take the same round keys as the software implementation.
+use super::aes_core::{RoundKeys, BLOCK_SIZE, PARALLEL_BLOCKS};
+use core::arch::x86_64::{
+    __m128i, _mm_aesenc_si128, _mm_aesenclast_si128, _mm_load_si128, _mm_loadu_si128,
+    _mm_storeu_si128, _mm_xor_si128,
+};
+
+/// Encrypts `block` inline using `round_keys`
+///
+/// `N` is the number of round keys, which is one more than the number of rounds.
+///
+/// # Safety
+///
+/// The CPU must support the `aes` target feature.
+#[target_feature(enable = "aes")]
+pub(super) unsafe fn encrypt_inline<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    block: &mut [u8; BLOCK_SIZE],
+) {
+    let mut state = load(block);
+    state = _mm_xor_si128(state, load_key(round_keys, 0));
+    for i in 1..N - 1 {
+        state = _mm_aesenc_si128(state, load_key(round_keys, i));
+    }
+    state = _mm_aesenclast_si128(state, load_key(round_keys, N - 1));
+    store(block, state);
+}
+
+/// Encrypts `blocks` inline using `round_keys`
+///
+/// Blocks are encrypted [`PARALLEL_BLOCKS`] at a time,
+/// so that the latency of each `AESENC` is hidden behind the others.
+///
+/// # Safety
+///
+/// The CPU must support the `aes` target feature.
+#[target_feature(enable = "aes")]
+pub(super) unsafe fn encrypt_blocks_inline<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    blocks: &mut [[u8; BLOCK_SIZE]],
+) {
+    let mut chunks = blocks.chunks_exact_mut(PARALLEL_BLOCKS);
+    for chunk in &mut chunks {
+        // we can safely unwrap because `chunk` is guaranteed to have a length of
+        // `PARALLEL_BLOCKS`
+        encrypt_parallel(round_keys, chunk.try_into().unwrap());
+    }
+    for block in chunks.into_remainder() {
+        encrypt_inline(round_keys, block);
+    }
+}
+
+#[inline]
+#[target_feature(enable = "aes")]
+unsafe fn encrypt_parallel<const N: usize>(
+    round_keys: &RoundKeys<N>,
+    blocks: &mut [[u8; BLOCK_SIZE]; PARALLEL_BLOCKS],
+) {
+    let round_key = load_key(round_keys, 0);
+    let mut state = [round_key; PARALLEL_BLOCKS];
+    for (state, block) in state.iter_mut().zip(blocks.iter()) {
+        *state = _mm_xor_si128(load(block), round_key);
+    }
+    for i in 1..N - 1 {
+        let round_key = load_key(round_keys, i);
+        for state in state.iter_mut() {
+            *state = _mm_aesenc_si128(*state, round_key);
+        }
+    }
+    let round_key = load_key(round_keys, N - 1);
+    for (state, block) in state.iter().zip(blocks.iter_mut()) {
+        store(block, _mm_aesenclast_si128(*state, round_key));
+    }
+}
+
+#[inline(always)]
+unsafe fn load(block: &[u8; BLOCK_SIZE]) -> __m128i {
+    _mm_loadu_si128(block.as_ptr().cast())
+}
+
+/// Loads round key `i`, with an aligned load
+#[inline(always)]
+unsafe fn load_key<const N: usize>(round_keys: &RoundKeys<N>, i: usize) -> __m128i {
+    // `RoundKeys` is 16-byte aligned, and so is each round key in it
+    _mm_load_si128(round_keys[i].as_ptr().cast())
+}
+
+#[inline(always)]
+unsafe fn store(block: &mut [u8; BLOCK_SIZE], value: __m128i) {
+    _mm_storeu_si128(block.as_mut_ptr().cast(), value)
+}
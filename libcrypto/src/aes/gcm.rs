@@ -48,11 +48,17 @@
 //! assert_eq!(plain_text, "Top secret message".as_bytes());
 //! ```
 use super::aes_core;
+use super::ghash;
+use crate::buffers::{self, Buffers};
 
-const R: u128 = 0xe1 << 120;
 /// The size of an initialization vector, in bytes
 pub const IV_SIZE: usize = 12;
 
+/// The number of bytes encrypted and hashed together in one pass
+///
+/// This is small enough to stay in L1 cache between encryption and hashing.
+const STITCH_SIZE: usize = 4 * aes_core::PARALLEL_BLOCKS * aes_core::BLOCK_SIZE;
+
 /// An error that is returned when an encrypted message's tag
 /// does not match its generated tag
 ///
@@ -75,24 +81,44 @@ impl core::fmt::Display for BadData {
 /// See [`Gcm`]'s implementations for examples.
 pub struct Gcm<C: aes_core::AesCipher> {
     cipher: C,
-    h: u128,
+    h: ghash::HashKey,
 }
 
 impl<C: aes_core::AesCipher> Gcm<C> {
     /// Construct a new [`Gcm`] cipher.
+    ///
+    /// This precomputes the powers of the hash key used by GHASH.
     pub fn new(key: C::Key) -> Self {
         let cipher = C::new(key);
         let mut h = [0u8; aes_core::BLOCK_SIZE];
         cipher.encrypt_inline(&mut h);
 
-        Self {
+        let gcm = Self {
             cipher,
-            h: u128::from_be_bytes(h),
-        }
+            h: ghash::HashKey::new(h),
+        };
+        crate::zeroize::zeroize(&mut h, 0);
+        gcm
+    }
+
+    /// Replaces the key of `self` with `key`, as after a TLS 1.3 `KeyUpdate`
+    ///
+    /// This reuses the storage of the old key, which it overwrites,
+    /// and skips detecting the CPU features again.
+    pub fn rekey(&mut self, key: C::Key) {
+        self.cipher.rekey(key);
+        let mut h = [0u8; aes_core::BLOCK_SIZE];
+        self.cipher.encrypt_inline(&mut h);
+        self.h.rekey(h);
+        crate::zeroize::zeroize(&mut h, 0);
     }
+
     /// Encrypts `plain_text` inline, and generates an authentication tag
     /// for `plain_text` and `add_data`.
     ///
+    /// Encryption and authentication happen in a single pass over `plain_text`:
+    /// each batch of cipher text is hashed while it is still in cache.
+    ///
     /// WARNING: for security purposes,
     /// users MUST NOT use the same `init_vector` twice for the same key.
     pub fn encrypt_inline(
@@ -101,14 +127,7 @@ impl<C: aes_core::AesCipher> Gcm<C> {
         add_data: &[u8],
         init_vector: &[u8; IV_SIZE],
     ) -> [u8; aes_core::BLOCK_SIZE] {
-        let counter = {
-            let mut counter = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1];
-            counter[..init_vector.len()].copy_from_slice(init_vector);
-            counter
-        };
-        self.xor_bit_stream(plain_text, &counter);
-
-        self.g_hash(plain_text, add_data, &counter)
+        self.seal(Buffers::InPlace(plain_text), add_data, init_vector)
     }
 
     /// Encrypts `msg`, writing the encrypted msg to `buf` and returning an authentication tag
@@ -127,12 +146,40 @@ impl<C: aes_core::AesCipher> Gcm<C> {
         init_vector: &[u8; IV_SIZE],
         buf: &mut [u8],
     ) -> [u8; aes_core::BLOCK_SIZE] {
-        buf[..msg.len()].copy_from_slice(msg);
-        self.encrypt_inline(buf, add_data, init_vector)
+        self.seal(Buffers::separate(msg, buf), add_data, init_vector)
+    }
+
+    /// Encrypts the concatenation of `msg`, writing the encrypted msg across `buf`
+    /// and returning an authentication tag
+    ///
+    /// The segments of `msg` and `buf` don't need to line up.
+    /// Nothing is copied apart from the encryption itself,
+    /// so a message can be built from several buffers without first joining them.
+    ///
+    /// # Panics
+    ///
+    /// The function will panic if `buf` is shorter in total than `msg`
+    ///
+    /// WARNING: for security purposes,
+    /// users MUST NOT use the same `init_vector` twice for the same key.
+    pub fn encrypt_vectored(
+        &self,
+        msg: &[&[u8]],
+        add_data: &[u8],
+        init_vector: &[u8; IV_SIZE],
+        buf: &mut [&mut [u8]],
+    ) -> [u8; aes_core::BLOCK_SIZE] {
+        let mut stream = self.encrypt_stream(init_vector);
+        stream.update_add_data(add_data);
+        buffers::for_each_segment(msg, buf, |input, output| stream.update_into(input, output));
+        stream.finalize()
     }
 
     /// Decrypts `cipher_text` inline.
     ///
+    /// Decryption and authentication happen in a single pass over `cipher_text`.
+    /// If the tag doesn't match, `cipher_text` is restored to its original value
+    /// so that unauthenticated plain text is never released.
     pub fn decrypt_inline(
         &self,
         cipher_text: &mut [u8],
@@ -140,20 +187,19 @@ impl<C: aes_core::AesCipher> Gcm<C> {
         init_vector: &[u8; IV_SIZE],
         tag: &[u8; aes_core::BLOCK_SIZE],
     ) -> Result<(), BadData> {
-        let counter = {
-            // TODO: use uninitialized memory if necessary
-            let mut counter = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1];
-            counter[..init_vector.len()].copy_from_slice(init_vector);
-            counter
-        };
-        if self.g_hash(cipher_text, add_data, &counter) != *tag {
+        let counter = initial_counter(init_vector);
+        let generated_tag = self.open(Buffers::InPlace(cipher_text), add_data, &counter);
+        if !tags_match(&generated_tag, tag) {
+            self.xor_bit_stream(cipher_text, &counter, 0);
             return Err(BadData);
         }
-        self.xor_bit_stream(cipher_text, &counter);
         Ok(())
     }
 
-    /// Retuns an `Err(BadData)` if the message has been modified
+    /// Decrypts `msg`, writing the decrypted msg to `buf`
+    ///
+    /// Retuns an `Err(BadData)` if the message has been modified.
+    /// In that case, `buf` holds a copy of `msg` instead.
     ///
     /// # Panics
     ///
@@ -257,11 +303,175 @@ impl<C: aes_core::AesCipher> Gcm<C> {
         tag: &[u8; aes_core::BLOCK_SIZE],
         buf: &mut [u8],
     ) -> Result<(), BadData> {
-        buf[..msg.len()].copy_from_slice(msg);
-        self.decrypt_inline(buf, add_data, init_vector, tag)?;
+        let counter = initial_counter(init_vector);
+        let generated_tag = self.open(Buffers::separate(msg, buf), add_data, &counter);
+        if !tags_match(&generated_tag, tag) {
+            buf[..msg.len()].copy_from_slice(msg);
+            return Err(BadData);
+        }
         Ok(())
     }
 
+    /// Decrypts the concatenation of `msg`, writing the decrypted msg across `buf`
+    ///
+    /// Retuns an `Err(BadData)` if the message has been modified.
+    /// In that case, `buf` holds a copy of `msg` instead.
+    ///
+    /// The segments of `msg` and `buf` don't need to line up.
+    ///
+    /// # Panics
+    ///
+    /// The function will panic if `buf` is shorter in total than `msg`
+    pub fn decrypt_vectored(
+        &self,
+        msg: &[&[u8]],
+        add_data: &[u8],
+        init_vector: &[u8; IV_SIZE],
+        tag: &[u8; aes_core::BLOCK_SIZE],
+        buf: &mut [&mut [u8]],
+    ) -> Result<(), BadData> {
+        let mut stream = self.decrypt_stream(init_vector);
+        stream.update_add_data(add_data);
+        buffers::for_each_segment(msg, buf, |input, output| stream.update_into(input, output));
+        if stream.verify(tag).is_err() {
+            buffers::for_each_segment(msg, buf, |input, output| output.copy_from_slice(input));
+            return Err(BadData);
+        }
+        Ok(())
+    }
+
+    /// Starts encrypting a message that will be provided in pieces.
+    ///
+    /// See [`GcmStream`] for details.
+    ///
+    /// WARNING: for security purposes,
+    /// users MUST NOT use the same `init_vector` twice for the same key.
+    pub fn encrypt_stream(&self, init_vector: &[u8; IV_SIZE]) -> GcmStream<'_, C> {
+        GcmStream::new(self, init_vector, Direction::Encrypt)
+    }
+
+    /// Starts decrypting a message that will be provided in pieces.
+    ///
+    /// See [`GcmStream`] for details.
+    pub fn decrypt_stream(&self, init_vector: &[u8; IV_SIZE]) -> GcmStream<'_, C> {
+        GcmStream::new(self, init_vector, Direction::Decrypt)
+    }
+
+    /// Encrypts each of `messages` inline, writing its authentication tag to its `tag`
+    ///
+    /// This gives the same results as calling [`encrypt_inline`](Self::encrypt_inline) for each
+    /// message, but the key streams of consecutive messages are generated together, so the
+    /// pipeline stays full across message boundaries, and short messages share batches.
+    ///
+    /// WARNING: for security purposes,
+    /// users MUST NOT use the same `init_vector` twice for the same key.
+    pub fn encrypt_batch_inline(&self, messages: &mut [BatchMessage<'_>]) {
+        self.crypt_batch(messages, Direction::Encrypt, |message, tag| {
+            message.tag = tag
+        });
+    }
+
+    /// Decrypts each of `messages` inline, checking it against its `tag`
+    ///
+    /// This gives the same results as calling [`decrypt_inline`](Self::decrypt_inline) for each
+    /// message. If any tag doesn't match, every message is restored to its original value,
+    /// and `Err(BadData)` is returned.
+    pub fn decrypt_batch_inline(&self, messages: &mut [BatchMessage<'_>]) -> Result<(), BadData> {
+        let mut all_match = true;
+        self.crypt_batch(messages, Direction::Decrypt, |message, tag| {
+            all_match &= tags_match(&tag, &message.tag);
+        });
+        if !all_match {
+            for message in messages {
+                self.xor_bit_stream(message.data, &initial_counter(&message.init_vector), 0);
+            }
+            return Err(BadData);
+        }
+        Ok(())
+    }
+
+    /// Encrypts or decrypts each of `messages`, and calls `finish` with each message's tag
+    ///
+    /// Each message uses the counter blocks from its initial counter on. The first of those
+    /// masks the tag, and the rest are the key stream. The blocks for consecutive messages are
+    /// laid end to end and encrypted [`STITCH_SIZE`] bytes at a time, so every batch is full
+    /// until the last one.
+    fn crypt_batch(
+        &self,
+        messages: &mut [BatchMessage<'_>],
+        direction: Direction,
+        mut finish: impl FnMut(&mut BatchMessage<'_>, [u8; aes_core::BLOCK_SIZE]),
+    ) {
+        const STITCH_BLOCKS: usize = STITCH_SIZE / aes_core::BLOCK_SIZE;
+        let blocks_of =
+            |message: &BatchMessage<'_>| 1 + message.data.len().div_ceil(aes_core::BLOCK_SIZE);
+
+        let mut stream = [[0u8; aes_core::BLOCK_SIZE]; STITCH_BLOCKS];
+        // the message and block that the next batch of counters starts at
+        let (mut fill_message, mut fill_block) = (0, 0);
+        // the message and block that the next block of the key stream is used for
+        let (mut message, mut block) = (0, 0);
+        let mut tag = 0u128;
+        let mut mask = [0u8; aes_core::BLOCK_SIZE];
+
+        while message < messages.len() {
+            let mut filled = 0;
+            while filled < STITCH_BLOCKS && fill_message < messages.len() {
+                let total = blocks_of(&messages[fill_message]);
+                let count = (total - fill_block).min(STITCH_BLOCKS - filled);
+                let counter = initial_counter(&messages[fill_message].init_vector);
+                fill_counters(&mut stream[filled..][..count], &counter, fill_block as u32);
+                filled += count;
+                fill_block += count;
+                if fill_block == total {
+                    fill_message += 1;
+                    fill_block = 0;
+                }
+            }
+            self.cipher.encrypt_blocks_inline(&mut stream[..filled]);
+
+            let mut key_stream = &stream[..filled];
+            while !key_stream.is_empty() {
+                let current = &mut messages[message];
+                let total = blocks_of(current);
+                let count = (total - block).min(key_stream.len());
+                let mut blocks;
+                (blocks, key_stream) = key_stream.split_at(count);
+                if block == 0 {
+                    mask = blocks[0];
+                    blocks = &blocks[1..];
+                    tag = 0;
+                    self.h.update(&mut tag, current.add_data);
+                }
+
+                let start = (block.max(1) - 1) * aes_core::BLOCK_SIZE;
+                let end = current
+                    .data
+                    .len()
+                    .min(start + blocks.len() * aes_core::BLOCK_SIZE);
+                let data = &mut current.data[start..end];
+                if direction == Direction::Decrypt {
+                    self.h.update(&mut tag, data);
+                }
+                buffers::xor_in_place(data, blocks.as_flattened());
+                if direction == Direction::Encrypt {
+                    self.h.update(&mut tag, data);
+                }
+
+                block += count;
+                if block == total {
+                    let len = current.data.len();
+                    let tag = self.finish_tag_with_mask(tag, current.add_data.len(), len, &mask);
+                    finish(current, tag);
+                    message += 1;
+                    block = 0;
+                }
+            }
+        }
+        crate::zeroize::zeroize(&mut mask, 0);
+        crate::zeroize::zeroize(&mut stream, [0; aes_core::BLOCK_SIZE]);
+    }
+
     /// Encrypts or decrypts `data` in counter mode.
     ///
     /// Because XOR is its own inverse,
@@ -269,23 +479,97 @@ impl<C: aes_core::AesCipher> Gcm<C> {
     ///
     /// This is a linear operation.
     ///
-    /// This process can be parallel-ized,
-    /// but that has not been implemented yet.
-    fn xor_bit_stream(&self, data: &mut [u8], counter: &[u8; aes_core::BLOCK_SIZE]) {
-        let iv_as_int = u128::from_be_bytes(*counter);
+    /// `offset` is the index of the first block of `data`, counting from the start of the message.
+    /// This allows a message to be processed in pieces, as long as each piece but the last
+    /// is a multiple of [`aes_core::BLOCK_SIZE`] long.
+    fn xor_bit_stream(&self, data: &mut [u8], counter: &[u8; aes_core::BLOCK_SIZE], offset: u32) {
+        self.xor_bit_stream_with(Buffers::InPlace(data), counter, offset, |_| {}, |_| {});
+    }
 
-        for (counter, block) in data.chunks_mut(aes_core::BLOCK_SIZE).enumerate() {
-            let mut stream = (iv_as_int + 1 + counter as u128).to_be_bytes();
-            self.cipher.encrypt_inline(&mut stream);
+    /// Like [`xor_bit_stream`](Self::xor_bit_stream), but calls `before` on each batch of input
+    /// and `after` on each batch of output.
+    ///
+    /// Batches are [`STITCH_SIZE`] long, except for the last one,
+    /// so a batch is still in cache when `after` is called.
+    /// This lets GHASH share a single pass over memory with counter mode.
+    fn xor_bit_stream_with(
+        &self,
+        mut data: Buffers<'_>,
+        counter: &[u8; aes_core::BLOCK_SIZE],
+        offset: u32,
+        mut before: impl FnMut(&[u8]),
+        mut after: impl FnMut(&[u8]),
+    ) {
+        const STITCH_BLOCKS: usize = STITCH_SIZE / aes_core::BLOCK_SIZE;
 
-            for (data_byte, stream_byte) in block.iter_mut().zip(stream) {
-                *data_byte ^= stream_byte;
-            }
+        // the first block of the key stream is the block after `counter`
+        let mut block_index = offset.wrapping_add(1);
+        let mut stream = [[0u8; aes_core::BLOCK_SIZE]; STITCH_BLOCKS];
+
+        while !data.is_empty() {
+            let len = data.len().min(STITCH_SIZE);
+            let (mut chunk, rest) = data.split_at(len);
+            let stream = &mut stream[..chunk.len().div_ceil(aes_core::BLOCK_SIZE)];
+            fill_counters(stream, counter, block_index);
+            self.cipher.encrypt_blocks_inline(stream);
+            before(chunk.input());
+            chunk.xor(stream.as_flattened());
+            after(chunk.output());
+            block_index = block_index.wrapping_add(STITCH_BLOCKS as u32);
+            data = rest;
         }
+        crate::zeroize::zeroize(&mut stream, [0; aes_core::BLOCK_SIZE]);
+    }
+
+    /// Encrypts `data` and returns its authentication tag
+    fn seal(
+        &self,
+        data: Buffers<'_>,
+        add_data: &[u8],
+        init_vector: &[u8; IV_SIZE],
+    ) -> [u8; aes_core::BLOCK_SIZE] {
+        let counter = initial_counter(init_vector);
+        let len = data.len();
+        let mut tag = 0u128;
+        self.h.update(&mut tag, add_data);
+        self.xor_bit_stream_with(
+            data,
+            &counter,
+            0,
+            |_| {},
+            |cipher_text| self.h.update(&mut tag, cipher_text),
+        );
+        self.finish_tag(tag, add_data.len(), len, &counter)
+    }
+
+    /// Decrypts `data` and returns the tag generated for it
+    ///
+    /// The caller is responsible for comparing the tag
+    /// and for discarding the plain text if it doesn't match.
+    fn open(
+        &self,
+        data: Buffers<'_>,
+        add_data: &[u8],
+        counter: &[u8; aes_core::BLOCK_SIZE],
+    ) -> [u8; aes_core::BLOCK_SIZE] {
+        let len = data.len();
+        let mut tag = 0u128;
+        self.h.update(&mut tag, add_data);
+        self.xor_bit_stream_with(
+            data,
+            counter,
+            0,
+            |cipher_text| self.h.update(&mut tag, cipher_text),
+            |_| {},
+        );
+        self.finish_tag(tag, add_data.len(), len, counter)
     }
 
     /// produce an authentication tag for given data
     /// this tag can be used to verify the authenticity of the data
+    ///
+    /// Encryption and decryption hash as they go, so this is only used to test them.
+    #[cfg(test)]
     fn g_hash(
         &self,
         cipher_text: &[u8],
@@ -293,72 +577,318 @@ impl<C: aes_core::AesCipher> Gcm<C> {
         counter: &[u8; aes_core::BLOCK_SIZE],
     ) -> [u8; aes_core::BLOCK_SIZE] {
         let mut tag = 0u128;
+        self.h.update(&mut tag, add_data);
+        self.h.update(&mut tag, cipher_text);
+        self.finish_tag(tag, add_data.len(), cipher_text.len(), counter)
+    }
 
-        // TODO: use `array_chunks` once stabilized
-        for block in add_data.chunks_exact(aes_core::BLOCK_SIZE) {
-            // we can safely unwrap because `block` is guaranteed to have a length of
-            // `aes_core::BLOCK_SIZE`
-            add_block(&mut tag, block.try_into().unwrap(), self.h);
+    /// Absorbs the lengths of the additional data and the cipher text into `tag`,
+    /// and encrypts the result
+    fn finish_tag(
+        &self,
+        tag: u128,
+        add_data_len: usize,
+        cipher_text_len: usize,
+        counter: &[u8; aes_core::BLOCK_SIZE],
+    ) -> [u8; aes_core::BLOCK_SIZE] {
+        let mask = self.cipher.encrypt(counter);
+        self.finish_tag_with_mask(tag, add_data_len, cipher_text_len, &mask)
+    }
+
+    /// Like [`finish_tag`](Self::finish_tag), but with the initial counter already encrypted
+    fn finish_tag_with_mask(
+        &self,
+        mut tag: u128,
+        add_data_len: usize,
+        cipher_text_len: usize,
+        mask: &[u8; aes_core::BLOCK_SIZE],
+    ) -> [u8; aes_core::BLOCK_SIZE] {
+        let lengths = ((add_data_len as u128 * 8) << 64) + cipher_text_len as u128 * 8;
+        self.h.update_blocks(&mut tag, &lengths.to_be_bytes());
+
+        (u128::from_be_bytes(ghash::store(tag)) ^ u128::from_be_bytes(*mask)).to_be_bytes()
+    }
+}
+
+/// One message of a batch, encrypted or decrypted in place
+///
+/// See [`Gcm::encrypt_batch_inline`] and [`Gcm::decrypt_batch_inline`].
+#[derive(Default)]
+pub struct BatchMessage<'a> {
+    /// The message
+    pub data: &'a mut [u8],
+    /// The additional data, which is authenticated but not encrypted
+    pub add_data: &'a [u8],
+    /// The initialization vector
+    pub init_vector: [u8; IV_SIZE],
+    /// The tag, which is written when encrypting and checked when decrypting
+    pub tag: [u8; aes_core::BLOCK_SIZE],
+}
+
+/// Whether a [`GcmStream`] is encrypting or decrypting
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+enum Direction {
+    Encrypt,
+    Decrypt,
+}
+
+/// A message that is encrypted or decrypted in pieces
+///
+/// This holds the running GHASH state, the position in the key stream,
+/// and any partial block left over from the previous piece,
+/// so pieces may be of any length.
+///
+/// All additional data must be provided (via [`update_add_data`](Self::update_add_data))
+/// before any of the message (via [`update`](Self::update)).
+///
+/// <div class="warning">
+/// WARNING: when decrypting, plain text is produced before the tag is checked.
+/// It MUST NOT be used until <code>verify</code> has succeeded.
+/// </div>
+///
+/// # Examples
+///
+/// ```
+/// use libcrypto::aes::gcm::Gcm;
+/// use libcrypto::aes::Aes128;
+///
+/// let cipher = Gcm::<Aes128>::new([0x42; 16]);
+/// let init_vector = [0x24; 12];
+///
+/// let mut message = *b"Top secret message, in two parts";
+/// let mut stream = cipher.encrypt_stream(&init_vector);
+/// stream.update_add_data(b"Public information");
+/// let (first, second) = message.split_at_mut(5);
+/// stream.update(first);
+/// stream.update(second);
+/// let tag = stream.finalize();
+///
+/// let mut one_shot = *b"Top secret message, in two parts";
+/// assert_eq!(
+///     cipher.encrypt_inline(&mut one_shot, b"Public information", &init_vector),
+///     tag
+/// );
+/// assert_eq!(message, one_shot);
+///
+/// let mut stream = cipher.decrypt_stream(&init_vector);
+/// stream.update_add_data(b"Public information");
+/// stream.update(&mut message);
+/// stream.verify(&tag).expect("Our message has been modified!");
+/// assert_eq!(&message, b"Top secret message, in two parts");
+/// ```
+pub struct GcmStream<'a, C: aes_core::AesCipher> {
+    gcm: &'a Gcm<C>,
+    direction: Direction,
+    counter: [u8; aes_core::BLOCK_SIZE],
+    tag: u128,
+    add_data_len: usize,
+    msg_len: usize,
+    /// Whether the additional data has been fully absorbed
+    add_data_done: bool,
+    /// The cipher text (or additional data) of the current partial block
+    partial_block: [u8; aes_core::BLOCK_SIZE],
+    /// The key stream of the current partial block
+    key_stream: [u8; aes_core::BLOCK_SIZE],
+}
+
+impl<'a, C: aes_core::AesCipher> GcmStream<'a, C> {
+    fn new(gcm: &'a Gcm<C>, init_vector: &[u8; IV_SIZE], direction: Direction) -> Self {
+        Self {
+            gcm,
+            direction,
+            counter: initial_counter(init_vector),
+            tag: 0,
+            add_data_len: 0,
+            msg_len: 0,
+            add_data_done: false,
+            partial_block: [0; aes_core::BLOCK_SIZE],
+            key_stream: [0; aes_core::BLOCK_SIZE],
         }
+    }
 
-        let last_block = {
-            let end = add_data.len() % aes_core::BLOCK_SIZE;
-            // TODO: use uninitialized memory if necessary
-            let mut last_block = [0u8; aes_core::BLOCK_SIZE];
-            last_block[..end].copy_from_slice(&add_data[add_data.len() - end..]);
-            last_block
-        };
+    /// Authenticates the next piece of additional data
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if it is called after [`update`](Self::update)
+    pub fn update_add_data(&mut self, mut add_data: &[u8]) {
+        assert!(
+            !self.add_data_done,
+            "additional data must come before the message"
+        );
 
-        add_block(&mut tag, last_block, self.h);
+        let used = self.add_data_len % aes_core::BLOCK_SIZE;
+        self.add_data_len += add_data.len();
+        if used != 0 {
+            let len = add_data.len().min(aes_core::BLOCK_SIZE - used);
+            self.partial_block[used..used + len].copy_from_slice(&add_data[..len]);
+            add_data = &add_data[len..];
+            if used + len < aes_core::BLOCK_SIZE {
+                return;
+            }
+            self.gcm.h.update_blocks(&mut self.tag, &self.partial_block);
+        }
 
-        // TODO: use `array_chunks` once stabilized
-        for block in cipher_text.chunks_exact(aes_core::BLOCK_SIZE) {
-            add_block(&mut tag, block.try_into().unwrap(), self.h);
+        let split = add_data.len() - add_data.len() % aes_core::BLOCK_SIZE;
+        self.gcm.h.update_blocks(&mut self.tag, &add_data[..split]);
+        self.partial_block[..add_data.len() - split].copy_from_slice(&add_data[split..]);
+    }
+
+    /// Encrypts or decrypts the next piece of the message inline
+    pub fn update(&mut self, data: &mut [u8]) {
+        self.process(Buffers::InPlace(data));
+    }
+
+    /// Encrypts or decrypts the next piece of the message,
+    /// writing the result to the start of `output`
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `input.len()` > `output.len()`
+    pub fn update_into(&mut self, input: &[u8], output: &mut [u8]) {
+        self.process(Buffers::separate(input, output));
+    }
+
+    fn process(&mut self, mut data: Buffers<'_>) {
+        self.finish_add_data();
+
+        let used = self.msg_len % aes_core::BLOCK_SIZE;
+        self.msg_len += data.len();
+        if used != 0 {
+            let len = data.len().min(aes_core::BLOCK_SIZE - used);
+            let (head, tail) = data.split_at(len);
+            self.xor_partial(head, used);
+            data = tail;
+            if used + len < aes_core::BLOCK_SIZE {
+                return;
+            }
+            self.gcm.h.update_blocks(&mut self.tag, &self.partial_block);
         }
 
-        let last_block = {
-            let end = cipher_text.len() % aes_core::BLOCK_SIZE;
-            // TODO: use uninitialized memory if necessary
-            let mut last_block = [0u8; aes_core::BLOCK_SIZE];
-            last_block[..end].copy_from_slice(&cipher_text[cipher_text.len() - end..]);
-            last_block
-        };
+        // `data` now starts on a block boundary
+        let split = data.len() - data.len() % aes_core::BLOCK_SIZE;
+        let (blocks, excess) = data.split_at(split);
+        let offset = ((self.msg_len - excess.len() - split) / aes_core::BLOCK_SIZE) as u32;
+        let (gcm, tag) = (self.gcm, &mut self.tag);
+        match self.direction {
+            Direction::Encrypt => gcm.xor_bit_stream_with(
+                blocks,
+                &self.counter,
+                offset,
+                |_| {},
+                |cipher_text| gcm.h.update_blocks(tag, cipher_text),
+            ),
+            Direction::Decrypt => gcm.xor_bit_stream_with(
+                blocks,
+                &self.counter,
+                offset,
+                |cipher_text| gcm.h.update_blocks(tag, cipher_text),
+                |_| {},
+            ),
+        }
 
-        add_block(&mut tag, last_block, self.h);
+        if !excess.is_empty() {
+            let block_index = offset.wrapping_add((split / aes_core::BLOCK_SIZE) as u32);
+            fill_counters(
+                core::slice::from_mut(&mut self.key_stream),
+                &self.counter,
+                block_index.wrapping_add(1),
+            );
+            self.gcm.cipher.encrypt_inline(&mut self.key_stream);
+            self.xor_partial(excess, 0);
+        }
+    }
 
-        tag ^= ((add_data.len() as u128 * 8) << 64) + cipher_text.len() as u128 * 8;
-        tag = gf_2to128_mult(tag, self.h);
+    /// Finishes encryption, returning the authentication tag
+    ///
+    /// This may also be used when decrypting, to compare the tag manually.
+    pub fn finalize(mut self) -> [u8; aes_core::BLOCK_SIZE] {
+        self.finish_add_data();
+        self.finish_partial_block(self.msg_len);
+        self.gcm
+            .finish_tag(self.tag, self.add_data_len, self.msg_len, &self.counter)
+    }
 
-        let encrypted_iv = u128::from_be_bytes(self.cipher.encrypt(counter));
+    /// Finishes decryption, returning an `Err(BadData)` if the message has been modified
+    ///
+    /// If this fails, any plain text produced by [`update`](Self::update) MUST be discarded.
+    pub fn verify(self, tag: &[u8; aes_core::BLOCK_SIZE]) -> Result<(), BadData> {
+        match tags_match(&self.finalize(), tag) {
+            true => Ok(()),
+            false => Err(BadData),
+        }
+    }
 
-        tag ^= encrypted_iv;
-        tag.to_be_bytes()
+    /// XORs `data` with the key stream of the current partial block, starting at `start`,
+    /// keeping a copy of the cipher text for GHASH.
+    fn xor_partial(&mut self, mut data: Buffers<'_>, start: usize) {
+        let end = start + data.len();
+        if self.direction == Direction::Decrypt {
+            self.partial_block[start..end].copy_from_slice(data.input());
+        }
+        data.xor(&self.key_stream[start..end]);
+        if self.direction == Direction::Encrypt {
+            self.partial_block[start..end].copy_from_slice(data.output());
+        }
     }
-}
 
-/// Multiplication in GF(2^128)
-///
-/// Cannot overflow
-fn gf_2to128_mult(a: u128, b: u128) -> u128 {
-    let mut product = 0;
-    let mut temp = a;
-    for i in (0..128).rev() {
-        if b & (1 << i) == 1 << i {
-            product ^= temp;
+    /// Absorbs the last partial block of additional data, if that hasn't been done yet
+    fn finish_add_data(&mut self) {
+        if !self.add_data_done {
+            self.finish_partial_block(self.add_data_len);
+            self.add_data_done = true;
         }
-        if temp & 1 == 0 {
-            temp >>= 1;
-        } else {
-            temp = (temp >> 1) ^ R;
+    }
+
+    /// Pads and absorbs the current partial block, if there is one
+    ///
+    /// `len` is the total length of the data the partial block belongs to.
+    fn finish_partial_block(&mut self, len: usize) {
+        let used = len % aes_core::BLOCK_SIZE;
+        if used != 0 {
+            self.partial_block[used..].fill(0);
+            self.gcm.h.update_blocks(&mut self.tag, &self.partial_block);
         }
     }
-    product
 }
 
-/// A helper function for g_hash()
-fn add_block(tag: &mut u128, block: [u8; aes_core::BLOCK_SIZE], h: u128) {
-    *tag ^= u128::from_be_bytes(block);
-    *tag = gf_2to128_mult(*tag, h);
+impl<C: aes_core::AesCipher> Drop for GcmStream<'_, C> {
+    fn drop(&mut self) {
+        crate::zeroize::zeroize(&mut self.key_stream, 0);
+        crate::zeroize::zeroize(&mut self.partial_block, 0);
+    }
+}
+
+/// Constructs the initial counter block from `init_vector`
+fn initial_counter(init_vector: &[u8; IV_SIZE]) -> [u8; aes_core::BLOCK_SIZE] {
+    // TODO: use uninitialized memory if necessary
+    let mut counter = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1];
+    counter[..init_vector.len()].copy_from_slice(init_vector);
+    counter
+}
+
+/// Compares two tags in constant time
+pub(crate) fn tags_match(a: &[u8; aes_core::BLOCK_SIZE], b: &[u8; aes_core::BLOCK_SIZE]) -> bool {
+    let difference = a.iter().zip(b).fold(0, |difference, (a_byte, b_byte)| {
+        difference | (a_byte ^ b_byte)
+    });
+    core::hint::black_box(difference) == 0
+}
+
+/// Fills `blocks` with consecutive counter blocks, starting `first` blocks after `counter`
+///
+/// As specified by GCM, only the last 32 bits of the counter are incremented.
+fn fill_counters(
+    blocks: &mut [[u8; aes_core::BLOCK_SIZE]],
+    counter: &[u8; aes_core::BLOCK_SIZE],
+    first: u32,
+) {
+    // we can safely unwrap because the slice is guaranteed to have a length of 4
+    let start = u32::from_be_bytes(counter[IV_SIZE..].try_into().unwrap()).wrapping_add(first);
+    for (index, block) in blocks.iter_mut().enumerate() {
+        block[..IV_SIZE].copy_from_slice(&counter[..IV_SIZE]);
+        block[IV_SIZE..].copy_from_slice(&start.wrapping_add(index as u32).to_be_bytes());
+    }
 }
 
 #[cfg(test)]
@@ -391,10 +921,243 @@ mod tests {
             0x3d, 0x58, 0xe0, 0x91,
         ];
         let cipher = Gcm::<Aes128>::new(key);
-        cipher.xor_bit_stream(&mut plain_text, &counter);
+        cipher.xor_bit_stream(&mut plain_text, &counter, 0);
         assert_eq!(plain_text, cipher_text);
     }
 
+    #[test]
+    fn ctr_mode_offset() {
+        use super::aes_core::{AesCipher, BLOCK_SIZE};
+
+        let key = [0x42; 16];
+        let counter = [
+            0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88, 0xff, 0xff,
+            0xff, 0xfe,
+        ];
+        let cipher = Gcm::<Aes128>::new(key);
+
+        // long enough to cover several batches, a partial batch, and a partial block
+        let mut expected = [0u8; 421];
+        for (i, byte) in expected.iter_mut().enumerate() {
+            *byte = i as u8;
+        }
+        let mut whole = expected;
+        let mut pieces = expected;
+
+        // encrypt one block at a time, wrapping only the last 32 bits of the counter
+        for (i, block) in expected.chunks_mut(BLOCK_SIZE).enumerate() {
+            let mut stream = counter;
+            let last_word = u32::from_be_bytes(counter[12..].try_into().unwrap());
+            stream[12..].copy_from_slice(&last_word.wrapping_add(1 + i as u32).to_be_bytes());
+            cipher.cipher.encrypt_inline(&mut stream);
+            for (byte, stream_byte) in block.iter_mut().zip(stream) {
+                *byte ^= stream_byte;
+            }
+        }
+
+        cipher.xor_bit_stream(&mut whole, &counter, 0);
+        assert_eq!(whole, expected);
+
+        let (first, second) = pieces.split_at_mut(3 * BLOCK_SIZE);
+        cipher.xor_bit_stream(first, &counter, 0);
+        cipher.xor_bit_stream(second, &counter, 3);
+        assert_eq!(pieces, expected);
+    }
+
+    #[test]
+    fn stream() {
+        let cipher = Gcm::<Aes128>::new([0x61; 16]);
+        let init_vector = [0x19; super::IV_SIZE];
+
+        let mut add_data = [0u8; 53];
+        for (i, byte) in add_data.iter_mut().enumerate() {
+            *byte = (i * 3) as u8;
+        }
+        let mut expected = [0u8; super::STITCH_SIZE + 77];
+        for (i, byte) in expected.iter_mut().enumerate() {
+            *byte = (i * 11) as u8;
+        }
+        let original = expected;
+        let expected_tag = cipher.encrypt_inline(&mut expected, &add_data, &init_vector);
+
+        for piece_len in [1, 7, 16, 33, 600] {
+            let mut message = original;
+            let mut stream = cipher.encrypt_stream(&init_vector);
+            for piece in add_data.chunks(piece_len) {
+                stream.update_add_data(piece);
+            }
+            for piece in message.chunks_mut(piece_len) {
+                stream.update(piece);
+            }
+            assert_eq!(stream.finalize(), expected_tag);
+            assert_eq!(message, expected);
+
+            let mut stream = cipher.decrypt_stream(&init_vector);
+            stream.update_add_data(&add_data);
+            for piece in message.chunks_mut(piece_len) {
+                stream.update(piece);
+            }
+            stream.verify(&expected_tag).unwrap();
+            assert_eq!(message, original);
+        }
+
+        let mut message = expected;
+        message[3] ^= 0x80;
+        let mut stream = cipher.decrypt_stream(&init_vector);
+        stream.update_add_data(&add_data);
+        stream.update(&mut message);
+        assert!(stream.verify(&expected_tag).is_err());
+    }
+
+    #[test]
+    fn vectored() {
+        let cipher = Gcm::<Aes128>::new([0x33; 16]);
+        let init_vector = [0x44; super::IV_SIZE];
+        let add_data = [0x17, 0x03, 0x03, 0x01, 0x41];
+
+        let mut msg = [0u8; super::STITCH_SIZE + 29];
+        for (i, byte) in msg.iter_mut().enumerate() {
+            *byte = (i * 7) as u8;
+        }
+        let mut expected = [0u8; super::STITCH_SIZE + 29];
+        let expected_tag = cipher.encrypt(&msg, &add_data, &init_vector, &mut expected);
+
+        let (first, rest) = msg.split_at(3);
+        let (second, third) = rest.split_at(super::STITCH_SIZE - 10);
+        let mut buf = [0u8; super::STITCH_SIZE + 29];
+        let (buf_first, buf_second) = buf.split_at_mut(40);
+        let tag = cipher.encrypt_vectored(
+            &[first, &[], second, third],
+            &add_data,
+            &init_vector,
+            &mut [buf_first, buf_second],
+        );
+        assert_eq!(tag, expected_tag);
+        assert_eq!(buf, expected);
+
+        let (first, second) = expected.split_at(77);
+        let mut decrypted = [0u8; super::STITCH_SIZE + 29];
+        let (buf_first, buf_second) = decrypted.split_at_mut(16);
+        cipher
+            .decrypt_vectored(
+                &[first, second],
+                &add_data,
+                &init_vector,
+                &tag,
+                &mut [buf_first, buf_second],
+            )
+            .unwrap();
+        assert_eq!(decrypted, msg);
+
+        let mut bad_tag = tag;
+        bad_tag[15] ^= 1;
+        assert!(cipher
+            .decrypt_vectored(
+                &[&expected],
+                &add_data,
+                &init_vector,
+                &bad_tag,
+                &mut [&mut decrypted]
+            )
+            .is_err());
+        assert_eq!(decrypted, expected);
+    }
+
+    #[test]
+    fn rekey() {
+        use super::aes_core::Aes256;
+
+        let init_vector = [0x19; super::IV_SIZE];
+        let add_data = [0xaa; 20];
+        let mut cipher = Gcm::<Aes256>::new([0x61; 32]);
+        for key in [[0x62; 32], [0x00; 32], [0x61; 32]] {
+            cipher.rekey(key);
+            let fresh = Gcm::<Aes256>::new(key);
+            let mut message = [0x55u8; 100];
+            let mut expected = message;
+            let tag = cipher.encrypt_inline(&mut message, &add_data, &init_vector);
+            let expected_tag = fresh.encrypt_inline(&mut expected, &add_data, &init_vector);
+            assert_eq!(message, expected);
+            assert_eq!(tag, expected_tag);
+        }
+    }
+
+    #[test]
+    fn batch() {
+        use super::{BatchMessage, IV_SIZE};
+
+        let cipher = Gcm::<Aes128>::new([0x42; 16]);
+        // empty, partial-block, and multi-batch messages, so batches span message boundaries
+        const LENS: [usize; 10] = [0, 1, 15, 16, 17, 100, 0, 600, 1027, 3];
+        let add_data = [[0xad; 21]; LENS.len()];
+        let add_data_len = |i: usize| i % 4 * 7;
+        let init_vector = |i: usize| [i as u8; IV_SIZE];
+
+        let mut data = [0u8; 1779];
+        for (i, byte) in data.iter_mut().enumerate() {
+            *byte = (i * 7) as u8;
+        }
+        let original = data;
+
+        let mut expected = data;
+        let mut expected_tags = [[0; 16]; LENS.len()];
+        let mut rest = &mut expected[..];
+        for (i, len) in LENS.into_iter().enumerate() {
+            let msg;
+            (msg, rest) = rest.split_at_mut(len);
+            expected_tags[i] =
+                cipher.encrypt_inline(msg, &add_data[i][..add_data_len(i)], &init_vector(i));
+        }
+
+        let mut messages: [BatchMessage; LENS.len()] = Default::default();
+        let mut rest = &mut data[..];
+        for (i, message) in messages.iter_mut().enumerate() {
+            (message.data, rest) = rest.split_at_mut(LENS[i]);
+            message.add_data = &add_data[i][..add_data_len(i)];
+            message.init_vector = init_vector(i);
+        }
+        cipher.encrypt_batch_inline(&mut messages);
+        assert_eq!(
+            messages.each_ref().map(|message| message.tag),
+            expected_tags
+        );
+        let mut offset = 0;
+        for message in &messages {
+            assert_eq!(*message.data, expected[offset..][..message.data.len()]);
+            offset += message.data.len();
+        }
+
+        assert!(cipher.decrypt_batch_inline(&mut messages).is_ok());
+        messages[7].data[5] ^= 1;
+        assert!(cipher.decrypt_batch_inline(&mut messages).is_err());
+        messages[7].data[5] ^= 1;
+        assert_eq!(data, original);
+    }
+
+    #[test]
+    fn stream_empty() {
+        let cipher = Gcm::<Aes128>::new([0x61; 16]);
+        let init_vector = [0x19; super::IV_SIZE];
+        let add_data = [0xaa; 20];
+
+        let expected_tag = cipher.encrypt_inline(&mut [], &add_data, &init_vector);
+        let mut stream = cipher.encrypt_stream(&init_vector);
+        stream.update_add_data(&add_data[..3]);
+        stream.update_add_data(&add_data[3..]);
+        stream.update(&mut []);
+        assert_eq!(stream.finalize(), expected_tag);
+    }
+
+    #[test]
+    #[should_panic(expected = "additional data must come before the message")]
+    fn stream_add_data_after_empty_update() {
+        let cipher = Gcm::<Aes128>::new([0x61; 16]);
+        let mut stream = cipher.encrypt_stream(&[0x19; super::IV_SIZE]);
+        stream.update_add_data(b"abc");
+        stream.update(&mut []);
+        stream.update_add_data(b"de");
+    }
+
     #[test]
     fn g_hash() {
         let key = [
@@ -425,8 +1188,8 @@ mod tests {
             0xbe, 0xef, 0xab, 0xad, 0xda, 0xd2,
         ];
 
-        let h = 0xb83b533708bf535d0aa6e52980d53b78;
-        assert_eq!(cipher.h, h);
+        let h: u128 = 0xb83b533708bf535d0aa6e52980d53b78;
+        assert_eq!(cipher.h.powers[0], h.reverse_bits());
 
         assert_eq!(tag, cipher.g_hash(&cipher_text, &add_data, &counter));
     }
@@ -435,8 +1198,9 @@ mod tests {
     fn mult() {
         let a = 0x66e94bd4ef8a2c3b884cfa59ca342b2e;
         let b = 0x0388dace60b6a392f328c2b971b2fe78;
-        let product = 0x5e2ec746917062882c85b0685353deb7;
-        assert_eq!(super::gf_2to128_mult(a, b), product);
+        let product: u128 = 0x5e2ec746917062882c85b0685353deb7;
+        let load = |x: u128| super::ghash::load(&x.to_be_bytes());
+        assert_eq!(super::ghash::mult(load(a), load(b)), load(product));
     }
 
     #[test]
@@ -481,6 +1245,45 @@ mod tests {
         assert_eq!(plain_text, cipher_text);
     }
 
+    #[test]
+    fn encrypt_whole_blocks() {
+        // no additional data and a message that is a multiple of the block size,
+        // so that no padding block may be hashed
+        let key = [
+            0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30,
+            0x83, 0x08,
+        ];
+        let cipher = Gcm::<Aes128>::new(key);
+
+        let init_vector = [
+            0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88,
+        ];
+
+        let mut plain_text = [
+            0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5, 0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5,
+            0x26, 0x9a, 0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda, 0x2e, 0x4c, 0x30, 0x3d,
+            0x8a, 0x31, 0x8a, 0x72, 0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53, 0x2f, 0xcf,
+            0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25, 0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57,
+            0xba, 0x63, 0x7b, 0x39, 0x1a, 0xaf, 0xd2, 0x55,
+        ];
+        let tag = [
+            0x4d, 0x5c, 0x2a, 0xf3, 0x27, 0xcd, 0x64, 0xa6, 0x2c, 0xf3, 0x5a, 0xbd, 0x2b, 0xa6,
+            0xfa, 0xb4,
+        ];
+        let cipher_text = [
+            0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24, 0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0,
+            0xd4, 0x9c, 0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0, 0x35, 0xc1, 0x7e, 0x23,
+            0x29, 0xac, 0xa1, 0x2e, 0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c, 0x7d, 0x8f,
+            0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05, 0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97,
+            0x3d, 0x58, 0xe0, 0x91, 0x47, 0x3f, 0x59, 0x85,
+        ];
+        assert_eq!(
+            tag,
+            cipher.encrypt_inline(&mut plain_text, &[], &init_vector)
+        );
+        assert_eq!(plain_text, cipher_text);
+    }
+
     #[test]
     fn decrypt() {
         let key = [
@@ -516,9 +1319,39 @@ mod tests {
             0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05, 0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97,
             0x3d, 0x58, 0xe0, 0x91,
         ];
+        let original = cipher_text;
+        let mut bad_tag = tag;
+        bad_tag[0] ^= 1;
+        assert!(cipher
+            .decrypt_inline(&mut cipher_text, &add_data, &init_vector, &bad_tag)
+            .is_err());
+        assert_eq!(cipher_text, original);
+
         cipher
             .decrypt_inline(&mut cipher_text, &add_data, &init_vector, &tag)
             .unwrap();
         assert_eq!(plain_text, cipher_text);
     }
+
+    #[test]
+    fn round_trip_long() {
+        let cipher = Gcm::<Aes128>::new([0x17; 16]);
+        let init_vector = [0x29; super::IV_SIZE];
+        let add_data = [0x5a; 37];
+
+        let mut message = [0u8; 3 * super::STITCH_SIZE + 45];
+        for (i, byte) in message.iter_mut().enumerate() {
+            *byte = (i * 13) as u8;
+        }
+        let original = message;
+
+        let tag = cipher.encrypt_inline(&mut message, &add_data, &init_vector);
+        let counter = super::initial_counter(&init_vector);
+        assert_eq!(tag, cipher.g_hash(&message, &add_data, &counter));
+
+        cipher
+            .decrypt_inline(&mut message, &add_data, &init_vector, &tag)
+            .unwrap();
+        assert_eq!(message, original);
+    }
 }
@@ -0,0 +1,292 @@
+//! The GHASH universal hash function used by GCM
+//!
+//! GCM specifies its field elements "bit-reflected":
+//! the most significant bit of a big-endian block is the coefficient of `x^0`.
+//! Internally, this module reverses the bits of every block so that
+//! carry-less multiplication can be used directly.
+//! Values in this representation are referred to as "normal" below.
+//!
+//! Blocks are absorbed [`AGGREGATE_BLOCKS`] at a time:
+//! each block is multiplied by the appropriate power of `H`
+//! and the products are summed before being reduced only once.
+//!
+//! None of the implementations branch on or index memory by secret data.
+use super::aes_core::BLOCK_SIZE;
+
+/// The number of blocks absorbed per reduction
+pub(super) const AGGREGATE_BLOCKS: usize = 8;
+
+/// The implementation used to multiply field elements
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+enum Backend {
+    /// Constant-time integer multiplication
+    Software,
+    /// The PCLMULQDQ instruction
+    #[cfg(target_arch = "x86_64")]
+    Clmul,
+    /// The PMULL instruction
+    #[cfg(target_arch = "aarch64")]
+    Pmull,
+}
+
+impl Backend {
+    /// Picks the fastest implementation supported by the CPU
+    fn detect() -> Self {
+        if crate::cpu::has_clmul() {
+            #[cfg(target_arch = "x86_64")]
+            return Self::Clmul;
+            #[cfg(target_arch = "aarch64")]
+            return Self::Pmull;
+        }
+        Self::Software
+    }
+}
+
+/// Returns the name of the implementation new hash keys use
+pub(crate) fn backend_name() -> &'static str {
+    match Backend::detect() {
+        Backend::Software => "software",
+        #[cfg(target_arch = "x86_64")]
+        Backend::Clmul => "pclmulqdq",
+        #[cfg(target_arch = "aarch64")]
+        Backend::Pmull => "pmull",
+    }
+}
+
+/// The hash key `H` and its first [`AGGREGATE_BLOCKS`] powers
+pub(super) struct HashKey {
+    /// `powers[i]` is `H^(i + 1)`, in normal representation
+    pub(super) powers: [u128; AGGREGATE_BLOCKS],
+    backend: Backend,
+}
+
+impl HashKey {
+    /// Precomputes the powers of `h`
+    pub(super) fn new(h: [u8; BLOCK_SIZE]) -> Self {
+        let mut key = Self {
+            powers: [0; AGGREGATE_BLOCKS],
+            backend: Backend::detect(),
+        };
+        key.rekey(h);
+        key
+    }
+
+    /// Replaces the powers of the old hash key with those of `h`, in place
+    pub(super) fn rekey(&mut self, h: [u8; BLOCK_SIZE]) {
+        self.powers[0] = load(&h);
+        for i in 1..self.powers.len() {
+            self.powers[i] = mult(self.powers[i - 1], self.powers[0]);
+        }
+    }
+
+    /// Absorbs `data` into `tag`
+    ///
+    /// If `data` isn't a multiple of [`BLOCK_SIZE`] long, it is padded with zeros.
+    pub(super) fn update(&self, tag: &mut u128, data: &[u8]) {
+        let split = data.len() - data.len() % BLOCK_SIZE;
+        self.update_blocks(tag, &data[..split]);
+
+        let excess = &data[split..];
+        if !excess.is_empty() {
+            // TODO: use uninitialized memory if necessary
+            let mut last_block = [0u8; BLOCK_SIZE];
+            last_block[..excess.len()].copy_from_slice(excess);
+            self.update_blocks(tag, &last_block);
+        }
+    }
+
+    /// Absorbs `blocks` into `tag`
+    ///
+    /// `blocks` must be a multiple of [`BLOCK_SIZE`] long.
+    pub(super) fn update_blocks(&self, tag: &mut u128, blocks: &[u8]) {
+        debug_assert_eq!(blocks.len() % BLOCK_SIZE, 0);
+        match self.backend {
+            Backend::Software => update_blocks_software(&self.powers, tag, blocks),
+            // SAFETY: `Backend::Clmul` is only chosen if the CPU supports PCLMULQDQ and SSSE3
+            #[cfg(target_arch = "x86_64")]
+            Backend::Clmul => unsafe {
+                super::ghash_clmul::update_blocks(&self.powers, tag, blocks)
+            },
+            // SAFETY: `Backend::Pmull` is only chosen if the CPU supports PMULL
+            #[cfg(target_arch = "aarch64")]
+            Backend::Pmull => unsafe {
+                super::ghash_pmull::update_blocks(&self.powers, tag, blocks)
+            },
+        }
+    }
+}
+
+impl Drop for HashKey {
+    fn drop(&mut self) {
+        crate::zeroize::zeroize(&mut self.powers, 0);
+    }
+}
+
+/// Converts a big-endian GCM block to normal representation
+#[inline]
+pub(super) fn load(block: &[u8; BLOCK_SIZE]) -> u128 {
+    u128::from_be_bytes(*block).reverse_bits()
+}
+
+/// Converts a normal-representation field element to a big-endian GCM block
+#[inline]
+pub(super) fn store(element: u128) -> [u8; BLOCK_SIZE] {
+    element.reverse_bits().to_be_bytes()
+}
+
+/// Multiplication in GF(2^128), in normal representation
+///
+/// Cannot overflow
+#[inline]
+pub(super) fn mult(a: u128, b: u128) -> u128 {
+    let (low, high) = clmul128(a, b);
+    reduce(low, high)
+}
+
+fn update_blocks_software(powers: &[u128; AGGREGATE_BLOCKS], tag: &mut u128, blocks: &[u8]) {
+    let mut batches = blocks.chunks_exact(AGGREGATE_BLOCKS * BLOCK_SIZE);
+    for batch in &mut batches {
+        absorb_software(powers, tag, batch);
+    }
+    if !batches.remainder().is_empty() {
+        absorb_software(powers, tag, batches.remainder());
+    }
+}
+
+/// Absorbs up to [`AGGREGATE_BLOCKS`] blocks with a single reduction
+///
+/// With `n` blocks, `tag` becomes `(tag + X_1) * H^n + X_2 * H^(n - 1) + ... + X_n * H`
+fn absorb_software(powers: &[u128; AGGREGATE_BLOCKS], tag: &mut u128, blocks: &[u8]) {
+    let num_blocks = blocks.len() / BLOCK_SIZE;
+    let (mut low, mut high) = (0, 0);
+    // TODO: use `array_chunks` once stabilized
+    for (i, block) in blocks.chunks_exact(BLOCK_SIZE).enumerate() {
+        // we can safely unwrap because `block` is guaranteed to have a length of `BLOCK_SIZE`
+        let mut block = load(block.try_into().unwrap());
+        if i == 0 {
+            block ^= *tag;
+        }
+        let (product_low, product_high) = clmul128(block, powers[num_blocks - 1 - i]);
+        low ^= product_low;
+        high ^= product_high;
+    }
+    *tag = reduce(low, high);
+}
+
+/// Reduces a 256-bit product modulo `x^128 + x^7 + x^2 + x + 1`
+///
+/// `x^128` is congruent to `x^7 + x^2 + x + 1`, so `high` is folded into `low` twice:
+/// once for the full 128 bits and once for the 7 bits that overflow.
+#[inline]
+pub(super) const fn reduce(low: u128, high: u128) -> u128 {
+    let overflow = (high >> 127) ^ (high >> 126) ^ (high >> 121);
+    let folded = high ^ (high << 1) ^ (high << 2) ^ (high << 7);
+    low ^ folded ^ overflow ^ (overflow << 1) ^ (overflow << 2) ^ (overflow << 7)
+}
+
+/// 128x128 -> 256-bit carry-less multiplication, returning the low and high halves
+///
+/// This uses Karatsuba to need only three 64x64 multiplications.
+#[inline]
+const fn clmul128(a: u128, b: u128) -> (u128, u128) {
+    let (a0, a1) = (a as u64, (a >> 64) as u64);
+    let (b0, b1) = (b as u64, (b >> 64) as u64);
+    let low = clmul64(a0, b0);
+    let high = clmul64(a1, b1);
+    let middle = clmul64(a0 ^ a1, b0 ^ b1) ^ low ^ high;
+    (low ^ (middle << 64), high ^ (middle >> 64))
+}
+
+/// 64x64 -> 128-bit carry-less multiplication
+///
+/// The high half is found by multiplying the bit-reversed operands,
+/// because [`bmul64`] only produces the low half.
+#[inline]
+const fn clmul64(x: u64, y: u64) -> u128 {
+    let low = bmul64(x, y);
+    let high = bmul64(x.reverse_bits(), y.reverse_bits()).reverse_bits() >> 1;
+    low as u128 | (high as u128) << 64
+}
+
+/// The low 64 bits of a carry-less multiplication, using integer multiplication
+///
+/// Each operand is split into four parts with three-bit "holes" between the bits.
+/// The holes absorb the carries of integer multiplication, so that each
+/// bit of the product is correct modulo 2.
+/// (See BearSSL's `ghash_ctmul64.c`)
+///
+/// This is constant-time on any CPU with a constant-time multiplier.
+#[inline]
+const fn bmul64(x: u64, y: u64) -> u64 {
+    const M0: u64 = 0x1111111111111111;
+    const M1: u64 = 0x2222222222222222;
+    const M2: u64 = 0x4444444444444444;
+    const M3: u64 = 0x8888888888888888;
+    let (x0, x1, x2, x3) = (x & M0, x & M1, x & M2, x & M3);
+    let (y0, y1, y2, y3) = (y & M0, y & M1, y & M2, y & M3);
+    let z0 = x0.wrapping_mul(y0) ^ x1.wrapping_mul(y3) ^ x2.wrapping_mul(y2) ^ x3.wrapping_mul(y1);
+    let z1 = x0.wrapping_mul(y1) ^ x1.wrapping_mul(y0) ^ x2.wrapping_mul(y3) ^ x3.wrapping_mul(y2);
+    let z2 = x0.wrapping_mul(y2) ^ x1.wrapping_mul(y1) ^ x2.wrapping_mul(y0) ^ x3.wrapping_mul(y3);
+    let z3 = x0.wrapping_mul(y3) ^ x1.wrapping_mul(y2) ^ x2.wrapping_mul(y1) ^ x3.wrapping_mul(y0);
+    (z0 & M0) | (z1 & M1) | (z2 & M2) | (z3 & M3)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{Backend, HashKey, AGGREGATE_BLOCKS, BLOCK_SIZE};
+
+    #[test]
+    fn clmul64() {
+        // naive shift-and-add
+        let (x, y) = (0xb83b533708bf535d, 0x0aa6e52980d53b78);
+        let mut product = 0u128;
+        for i in 0..64 {
+            if y & (1 << i) != 0 {
+                product ^= (x as u128) << i;
+            }
+        }
+        assert_eq!(super::clmul64(x, y), product);
+    }
+
+    #[test]
+    fn backends_agree() {
+        let h = [
+            0x66, 0xe9, 0x4b, 0xd4, 0xef, 0x8a, 0x2c, 0x3b, 0x88, 0x4c, 0xfa, 0x59, 0xca, 0x34,
+            0x2b, 0x2e,
+        ];
+        let detected = HashKey::new(h);
+        let software = HashKey {
+            backend: Backend::Software,
+            ..HashKey::new(h)
+        };
+
+        let mut data = [0u8; (2 * AGGREGATE_BLOCKS + 5) * BLOCK_SIZE];
+        for (i, byte) in data.iter_mut().enumerate() {
+            *byte = (i * 7) as u8;
+        }
+        for len in [0, BLOCK_SIZE, 3 * BLOCK_SIZE, data.len()] {
+            let (mut detected_tag, mut software_tag) = (0x1234, 0x1234);
+            detected.update_blocks(&mut detected_tag, &data[..len]);
+            software.update_blocks(&mut software_tag, &data[..len]);
+            assert_eq!(detected_tag, software_tag);
+        }
+    }
+
+    #[test]
+    fn aggregation_matches_serial() {
+        let h = [0xa5; BLOCK_SIZE];
+        let key = HashKey::new(h);
+        let data = [0x3c; (AGGREGATE_BLOCKS + 3) * BLOCK_SIZE];
+
+        let mut serial = 0u128;
+        for block in data.chunks_exact(BLOCK_SIZE) {
+            serial = super::mult(
+                serial ^ super::load(block.try_into().unwrap()),
+                key.powers[0],
+            );
+        }
+        let mut aggregated = 0u128;
+        key.update_blocks(&mut aggregated, &data);
+        assert_eq!(aggregated, serial);
+    }
+}
@@ -0,0 +1,109 @@
+//! An implementation of GHASH using the x86_64 PCLMULQDQ instruction
+//!
+//! Field elements are in the same normal representation as in [`super::ghash`].
+use super::aes_core::BLOCK_SIZE;
+use super::ghash::AGGREGATE_BLOCKS;
+use core::arch::x86_64::{
+    __m128i, _mm_and_si128, _mm_clmulepi64_si128, _mm_loadu_si128, _mm_or_si128, _mm_set1_epi8,
+    _mm_set_epi64x, _mm_setzero_si128, _mm_shuffle_epi8, _mm_slli_si128, _mm_srli_epi16,
+    _mm_srli_si128, _mm_storeu_si128, _mm_xor_si128,
+};
+
+/// Absorbs `blocks` into `tag`
+///
+/// `blocks` must be a multiple of [`BLOCK_SIZE`] long.
+///
+/// # Safety
+///
+/// The CPU must support the `pclmulqdq` and `ssse3` target features.
+#[target_feature(enable = "pclmulqdq,ssse3")]
+pub(super) unsafe fn update_blocks(
+    powers: &[u128; AGGREGATE_BLOCKS],
+    tag: &mut u128,
+    blocks: &[u8],
+) {
+    let mut loaded_powers = [_mm_setzero_si128(); AGGREGATE_BLOCKS];
+    for (loaded, power) in loaded_powers.iter_mut().zip(powers) {
+        *loaded = from_u128(*power);
+    }
+    let mut state = from_u128(*tag);
+
+    let mut batches = blocks.chunks_exact(AGGREGATE_BLOCKS * BLOCK_SIZE);
+    for batch in &mut batches {
+        state = absorb(&loaded_powers, state, batch);
+    }
+    if !batches.remainder().is_empty() {
+        state = absorb(&loaded_powers, state, batches.remainder());
+    }
+    _mm_storeu_si128((tag as *mut u128).cast(), state);
+}
+
+/// Absorbs up to [`AGGREGATE_BLOCKS`] blocks with a single reduction
+#[inline]
+#[target_feature(enable = "pclmulqdq,ssse3")]
+unsafe fn absorb(powers: &[__m128i; AGGREGATE_BLOCKS], tag: __m128i, blocks: &[u8]) -> __m128i {
+    let num_blocks = blocks.len() / BLOCK_SIZE;
+    let mut low = _mm_setzero_si128();
+    let mut middle = _mm_setzero_si128();
+    let mut high = _mm_setzero_si128();
+    // TODO: use `array_chunks` once stabilized
+    for (i, block) in blocks.chunks_exact(BLOCK_SIZE).enumerate() {
+        let mut block = reverse_bits(_mm_loadu_si128(block.as_ptr().cast()));
+        if i == 0 {
+            block = _mm_xor_si128(block, tag);
+        }
+        let power = powers[num_blocks - 1 - i];
+        low = _mm_xor_si128(low, _mm_clmulepi64_si128(block, power, 0x00));
+        middle = _mm_xor_si128(middle, _mm_clmulepi64_si128(block, power, 0x01));
+        middle = _mm_xor_si128(middle, _mm_clmulepi64_si128(block, power, 0x10));
+        high = _mm_xor_si128(high, _mm_clmulepi64_si128(block, power, 0x11));
+    }
+    low = _mm_xor_si128(low, _mm_slli_si128(middle, 8));
+    high = _mm_xor_si128(high, _mm_srli_si128(middle, 8));
+    reduce(low, high)
+}
+
+/// Reduces a 256-bit product modulo `x^128 + x^7 + x^2 + x + 1`
+///
+/// The top 64-bit word is folded first, then the second-to-top word.
+#[inline]
+#[target_feature(enable = "pclmulqdq")]
+unsafe fn reduce(mut low: __m128i, mut high: __m128i) -> __m128i {
+    let poly = _mm_set_epi64x(0, 0x87);
+    let folded = _mm_clmulepi64_si128(high, poly, 0x01);
+    low = _mm_xor_si128(low, _mm_slli_si128(folded, 8));
+    high = _mm_xor_si128(high, _mm_srli_si128(folded, 8));
+    _mm_xor_si128(low, _mm_clmulepi64_si128(high, poly, 0x00))
+}
+
+/// The bit-reversal of each nibble, placed in the high half of a byte
+const REVERSED_HIGH: [u8; 16] = [
+    0x00, 0x80, 0x40, 0xc0, 0x20, 0xa0, 0x60, 0xe0, 0x10, 0x90, 0x50, 0xd0, 0x30, 0xb0, 0x70, 0xf0,
+];
+
+/// The bit-reversal of each nibble, placed in the low half of a byte
+const REVERSED_LOW: [u8; 16] = [
+    0x00, 0x08, 0x04, 0x0c, 0x02, 0x0a, 0x06, 0x0e, 0x01, 0x09, 0x05, 0x0d, 0x03, 0x0b, 0x07, 0x0f,
+];
+
+/// Reverses the bits of each byte of `value`
+///
+/// Applied to a little-endian load, this converts a GCM block to normal representation.
+#[inline]
+#[target_feature(enable = "ssse3")]
+unsafe fn reverse_bits(value: __m128i) -> __m128i {
+    let reversed_high = _mm_loadu_si128(REVERSED_HIGH.as_ptr().cast());
+    let reversed_low = _mm_loadu_si128(REVERSED_LOW.as_ptr().cast());
+    let mask = _mm_set1_epi8(0x0f);
+    let low_nibbles = _mm_and_si128(value, mask);
+    let high_nibbles = _mm_and_si128(_mm_srli_epi16(value, 4), mask);
+    _mm_or_si128(
+        _mm_shuffle_epi8(reversed_high, low_nibbles),
+        _mm_shuffle_epi8(reversed_low, high_nibbles),
+    )
+}
+
+#[inline(always)]
+unsafe fn from_u128(value: u128) -> __m128i {
+    _mm_loadu_si128((&value as *const u128).cast())
+}
@@ -0,0 +1,52 @@
+//! An implementation of GHASH using the aarch64 PMULL instruction
+//!
+//! Field elements are in the same normal representation as in [`super::ghash`].
+use super::aes_core::BLOCK_SIZE;
+use super::ghash::{self, AGGREGATE_BLOCKS};
+use core::arch::aarch64::{vgetq_lane_u64, vld1q_u8, vmull_p64, vrbitq_u8, vreinterpretq_u64_u8};
+
+/// Absorbs `blocks` into `tag`
+///
+/// `blocks` must be a multiple of [`BLOCK_SIZE`] long.
+///
+/// # Safety
+///
+/// The CPU must support the `aes` target feature, which includes PMULL.
+#[target_feature(enable = "aes")]
+pub(super) unsafe fn update_blocks(
+    powers: &[u128; AGGREGATE_BLOCKS],
+    tag: &mut u128,
+    blocks: &[u8],
+) {
+    let mut batches = blocks.chunks_exact(AGGREGATE_BLOCKS * BLOCK_SIZE);
+    for batch in &mut batches {
+        absorb(powers, tag, batch);
+    }
+    if !batches.remainder().is_empty() {
+        absorb(powers, tag, batches.remainder());
+    }
+}
+
+/// Absorbs up to [`AGGREGATE_BLOCKS`] blocks with a single reduction
+#[inline]
+#[target_feature(enable = "aes")]
+unsafe fn absorb(powers: &[u128; AGGREGATE_BLOCKS], tag: &mut u128, blocks: &[u8]) {
+    let num_blocks = blocks.len() / BLOCK_SIZE;
+    let (mut low, mut middle, mut high) = (0u128, 0u128, 0u128);
+    // TODO: use `array_chunks` once stabilized
+    for (i, block) in blocks.chunks_exact(BLOCK_SIZE).enumerate() {
+        // reversing the bits of each byte of a little-endian load gives normal representation
+        let block = vreinterpretq_u64_u8(vrbitq_u8(vld1q_u8(block.as_ptr())));
+        let (mut b0, mut b1) = (vgetq_lane_u64(block, 0), vgetq_lane_u64(block, 1));
+        if i == 0 {
+            b0 ^= *tag as u64;
+            b1 ^= (*tag >> 64) as u64;
+        }
+        let power = powers[num_blocks - 1 - i];
+        let (p0, p1) = (power as u64, (power >> 64) as u64);
+        low ^= vmull_p64(b0, p0);
+        middle ^= vmull_p64(b0, p1) ^ vmull_p64(b1, p0);
+        high ^= vmull_p64(b1, p1);
+    }
+    *tag = ghash::reduce(low ^ (middle << 64), high ^ (middle >> 64));
+}
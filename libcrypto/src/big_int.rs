@@ -3,6 +3,8 @@
 //! security depends on very large numbers.
 use core::ops::{Add, Deref, DerefMut, Div, Mul, Sub};
 
+pub mod montgomery;
+
 #[derive(Debug)]
 pub struct InputTooLargeError;
 
@@ -30,10 +32,10 @@ impl<const N: usize> BigInt<N> {
     /// The zero value of [`BigInt<N>`]
     ///
     /// note: this has the same value as [`BigInt<N>::MIN`]
-    pub const ZERO: Self = Self::new([0x0000000000; N]);
+    pub const ZERO: Self = Self::new([0; N]);
 
     /// The maximum value representable by [`BigInt<N>`]
-    pub const MAX: Self = Self::new([0xffffffffff; N]);
+    pub const MAX: Self = Self::new([u64::MAX; N]);
 
     /// The minimum value representable by [`BigInt<N>`]
     ///
@@ -51,6 +53,35 @@ impl<const N: usize> BigInt<N> {
         }
         (diff.into(), carry)
     }
+
+    /// Returns the full product of `self` and `rhs`
+    ///
+    /// `M` must be twice `N`. This is constant-time, and can be evaluated at compile time.
+    ///
+    /// Small products are computed column by column (Comba's method), which keeps the running
+    /// sum of each column in registers. Larger ones are split in half with Karatsuba's method,
+    /// which needs three half-size products instead of four.
+    pub const fn widening_mul<const M: usize>(self, rhs: Self) -> BigInt<M> {
+        const { assert!(M == 2 * N, "the product must be twice as wide") };
+        let x = reverse(self.0);
+        let y = reverse(rhs.0);
+        let mut product = [0; M];
+        karatsuba_mul(&x, &y, &mut product);
+        BigInt(reverse(product))
+    }
+
+    /// Returns the full square of `self`
+    ///
+    /// `M` must be twice `N`. This is faster than [`widening_mul`](Self::widening_mul), because
+    /// each product of two different limbs is only computed once. This is constant-time, and can
+    /// be evaluated at compile time.
+    pub const fn widening_square<const M: usize>(self) -> BigInt<M> {
+        const { assert!(M == 2 * N, "the square must be twice as wide") };
+        let x = reverse(self.0);
+        let mut square = [0; M];
+        karatsuba_square(&x, &mut square);
+        BigInt(reverse(square))
+    }
 }
 
 impl<const N: usize> Deref for BigInt<N> {
@@ -147,24 +178,25 @@ impl<const N: usize> Sub for BigInt<N> {
     }
 }
 
-impl Mul for BigInt<4> {
-    type Output = BigInt<8>;
-    /// Performs an expanding multiplication, meaning the output length will be double the input
-    /// length
-    #[allow(clippy::suspicious_arithmetic_impl)]
-    fn mul(self, rhs: Self) -> Self::Output {
-        let mut product = [0u64; 8];
-        for i in 0..self.len() {
-            let mut carry = 0;
-            for j in 0..rhs.len() {
-                (product[i + j], carry) = carry_mul(self[i], rhs[j], carry);
+/// Implements [`Mul`] for each width of [`BigInt`] used by this crate
+///
+/// The product has twice as many limbs as each factor.
+macro_rules! impl_mul {
+    ($($n:literal => $m:literal),*) => {$(
+        impl Mul for BigInt<$n> {
+            type Output = BigInt<$m>;
+            /// Performs an expanding multiplication, meaning the output length will be double the
+            /// input length
+            fn mul(self, rhs: Self) -> Self::Output {
+                self.widening_mul(rhs)
             }
-            product[i] = carry;
         }
-        product.into()
-    }
+    )*};
 }
 
+// the sizes of P-256 and P-384 field elements, 512-bit values, and RSA-2048 and RSA-4096 moduli
+impl_mul!(4 => 8, 6 => 12, 8 => 16, 32 => 64, 64 => 128);
+
 impl Div for BigInt<8> {
     type Output = (BigInt<4>, BigInt<4>);
     /// Returns the quotient and the remainder of the division, in that order
@@ -183,19 +215,286 @@ impl Div for BigInt<8> {
     }
 }
 
-const fn carry_add(x: u64, y: u64, carry: bool) -> (u64, bool) {
+/// Returns `limbs` in the opposite order
+///
+/// The kernels below work on little-endian limbs, which makes their indices simpler.
+const fn reverse<const N: usize>(limbs: [u64; N]) -> [u64; N] {
+    let mut reversed = [0; N];
+    let mut i = 0;
+    while i < N {
+        reversed[i] = limbs[N - 1 - i];
+        i += 1;
+    }
+    reversed
+}
+
+// `for` loops can't be used in a `const fn`, so the following functions use `while` loops.
+// They all take little-endian limbs.
+
+/// The widest factors that are multiplied directly, rather than with Karatsuba's method
+const KARATSUBA_THRESHOLD: usize = 32;
+
+/// The widest factors that can be split with Karatsuba's method
+///
+/// This bounds the scratch space each level needs.
+const KARATSUBA_MAX: usize = 64;
+
+/// A running column sum of 192 bits, as (low, high, top) limbs
+type Accumulator = (u64, u64, u64);
+
+/// Adds `product` to `acc`
+const fn accumulate((low, high, top): Accumulator, product: u128) -> Accumulator {
+    let (sum, overflowed) = (((high as u128) << 64) | low as u128).overflowing_add(product);
+    (sum as u64, (sum >> 64) as u64, top + overflowed as u64)
+}
+
+/// Writes `x * y` to `product`, column by column
+///
+/// `x` and `y` must have the same length, and `product` must be twice as long.
+const fn comba_mul(x: &[u64], y: &[u64], product: &mut [u64]) {
+    let n = x.len();
+    let mut acc = (0, 0, 0);
+    let mut column = 0;
+    while column < 2 * n - 1 {
+        // every pair of limbs whose indices add up to `column`
+        let mut i = column.saturating_sub(n - 1);
+        while i <= column && i < n {
+            acc = accumulate(acc, x[i] as u128 * y[column - i] as u128);
+            i += 1;
+        }
+        product[column] = acc.0;
+        acc = (acc.1, acc.2, 0);
+        column += 1;
+    }
+    product[2 * n - 1] = acc.0;
+}
+
+/// Writes `x * x` to `square`, column by column
+///
+/// `square` must be twice as long as `x`.
+const fn comba_square(x: &[u64], square: &mut [u64]) {
+    let n = x.len();
+    let mut acc = (0, 0, 0);
+    let mut column = 0;
+    while column < 2 * n - 1 {
+        // every pair of different limbs appears twice, so it is only multiplied once
+        let mut i = column.saturating_sub(n - 1);
+        while 2 * i < column {
+            let product = x[i] as u128 * x[column - i] as u128;
+            acc = accumulate(accumulate(acc, product), product);
+            i += 1;
+        }
+        if column % 2 == 0 {
+            acc = accumulate(acc, x[column / 2] as u128 * x[column / 2] as u128);
+        }
+        square[column] = acc.0;
+        acc = (acc.1, acc.2, 0);
+        column += 1;
+    }
+    square[2 * n - 1] = acc.0;
+}
+
+/// Writes `|x - y|` to `difference`, returning whether `x` < `y`
+const fn abs_difference(x: &[u64], y: &[u64], difference: &mut [u64]) -> bool {
+    let mut borrow = false;
+    let mut i = 0;
+    while i < x.len() {
+        (difference[i], borrow) = carry_sub(x[i], y[i], borrow);
+        i += 1;
+    }
+    // negate the difference if it wrapped around, by flipping every bit and adding one
+    let mask = (borrow as u64).wrapping_neg();
+    let mut carry = borrow;
+    let mut i = 0;
+    while i < x.len() {
+        (difference[i], carry) = carry_add(difference[i] ^ mask, 0, carry);
+        i += 1;
+    }
+    borrow
+}
+
+/// Adds `x` to `sum`, returning the carry out of the top
+const fn add_into(sum: &mut [u64], x: &[u64]) -> bool {
+    let mut carry = false;
+    let mut i = 0;
+    while i < sum.len() {
+        let limb = match i < x.len() {
+            true => x[i],
+            false => 0,
+        };
+        (sum[i], carry) = carry_add(sum[i], limb, carry);
+        i += 1;
+    }
+    carry
+}
+
+/// Writes `x * y` to `product`
+///
+/// `x` and `y` must have the same length, and `product` must be twice as long.
+///
+/// With x = x1 * B + x0 and y = y1 * B + y0, the product is
+/// z2 * B^2 + (z0 + z2 + (x0 - x1)(y1 - y0)) * B + z0, where z0 = x0 * y0 and z2 = x1 * y1.
+/// The sign of the middle product is handled with masks, so this is constant-time.
+const fn karatsuba_mul(x: &[u64], y: &[u64], product: &mut [u64]) {
+    let n = x.len();
+    if n <= KARATSUBA_THRESHOLD || n > KARATSUBA_MAX || n % 2 == 1 {
+        return comba_mul(x, y, product);
+    }
+    let half = n / 2;
+    let (x0, x1) = x.split_at(half);
+    let (y0, y1) = y.split_at(half);
+    {
+        let (z0, z2) = product.split_at_mut(n);
+        karatsuba_mul(x0, y0, z0);
+        karatsuba_mul(x1, y1, z2);
+    }
+
+    let mut dx = [0; KARATSUBA_MAX / 2];
+    let mut dy = [0; KARATSUBA_MAX / 2];
+    let negative = abs_difference(x0, x1, dx.split_at_mut(half).0)
+        ^ abs_difference(y1, y0, dy.split_at_mut(half).0);
+    let mut middle = [0; KARATSUBA_MAX];
+    karatsuba_mul(
+        dx.split_at(half).0,
+        dy.split_at(half).0,
+        middle.split_at_mut(n).0,
+    );
+    add_middle(product, middle.split_at(n).0, negative);
+}
+
+/// Writes `x * x` to `square`
+///
+/// `square` must be twice as long as `x`. This is [`karatsuba_mul`], where the middle product
+/// is always -(x0 - x1)^2.
+const fn karatsuba_square(x: &[u64], square: &mut [u64]) {
+    let n = x.len();
+    if n <= KARATSUBA_THRESHOLD || n > KARATSUBA_MAX || n % 2 == 1 {
+        return comba_square(x, square);
+    }
+    let half = n / 2;
+    let (x0, x1) = x.split_at(half);
+    {
+        let (z0, z2) = square.split_at_mut(n);
+        karatsuba_square(x0, z0);
+        karatsuba_square(x1, z2);
+    }
+
+    let mut dx = [0; KARATSUBA_MAX / 2];
+    abs_difference(x0, x1, dx.split_at_mut(half).0);
+    let mut middle = [0; KARATSUBA_MAX];
+    karatsuba_square(dx.split_at(half).0, middle.split_at_mut(n).0);
+    add_middle(square, middle.split_at(n).0, true);
+}
+
+/// Adds z0 + z2 + `middle` (or minus `middle`, if `negative` is set) to the middle of `product`
+///
+/// `product` must hold z0 in its low half and z2 in its high half.
+const fn add_middle(product: &mut [u64], middle: &[u64], negative: bool) {
+    let n = middle.len();
+    let half = n / 2;
+    // an extra limb holds the carry, and the sign of `middle`
+    let mut sum = [0; KARATSUBA_MAX + 1];
+    let sum = sum.split_at_mut(n + 1).0;
+    {
+        let (z0, z2) = product.split_at(n);
+        add_into(sum, z0);
+        add_into(sum, z2);
+    }
+    // subtracting is adding the two's complement: every bit flipped, plus one
+    let mask = (negative as u64).wrapping_neg();
+    let mut carry = negative;
+    let mut i = 0;
+    while i <= n {
+        let limb = match i < n {
+            true => middle[i],
+            false => 0,
+        };
+        (sum[i], carry) = carry_add(sum[i], limb ^ mask, carry);
+        i += 1;
+    }
+    // the middle term is x0 * y1 + x1 * y0, which can't be negative, so the last carry is dropped
+    add_into(product.split_at_mut(half).1, sum);
+}
+
+pub(crate) const fn carry_add(x: u64, y: u64, carry: bool) -> (u64, bool) {
     let (sum1, overflowed1) = x.overflowing_add(y);
     let (sum2, overflowed2) = sum1.overflowing_add(carry as u64);
     (sum2, overflowed1 || overflowed2)
 }
 
-const fn carry_mul(x: u64, y: u64, carry: u64) -> (u64, u64) {
+pub(crate) const fn carry_mul(x: u64, y: u64, carry: u64) -> (u64, u64) {
     let product = x as u128 * y as u128 + carry as u128;
     (product as u64, (product >> 64) as u64)
 }
 
-const fn carry_sub(x: u64, y: u64, carry: bool) -> (u64, bool) {
+pub(crate) const fn carry_sub(x: u64, y: u64, carry: bool) -> (u64, bool) {
     let (diff1, overflowed1) = x.overflowing_sub(y);
     let (diff2, overflowed2) = diff1.overflowing_sub(carry as u64);
     (diff2, overflowed1 || overflowed2)
 }
+
+#[cfg(test)]
+mod tests {
+    use super::BigInt;
+
+    /// Returns `N` pseudorandom limbs
+    fn limbs<const N: usize>(seed: u64) -> BigInt<N> {
+        let mut state = seed;
+        BigInt::new(core::array::from_fn(|_| {
+            // xorshift64
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            state
+        }))
+    }
+
+    /// Multiplies one limb at a time, for comparison
+    fn schoolbook<const N: usize, const M: usize>(x: BigInt<N>, y: BigInt<N>) -> BigInt<M> {
+        let mut product = [0u64; M];
+        for i in (0..N).rev() {
+            let mut carry = 0;
+            for j in (0..N).rev() {
+                let sum = x[i] as u128 * y[j] as u128 + product[i + j + 1] as u128 + carry;
+                product[i + j + 1] = sum as u64;
+                carry = sum >> 64;
+            }
+            product[i] = carry as u64;
+        }
+        product.into()
+    }
+
+    fn check<const N: usize, const M: usize>() {
+        for seed in 1..8 {
+            let x = limbs::<N>(seed);
+            let y = limbs::<N>(seed.wrapping_mul(0x9e3779b97f4a7c15));
+            assert_eq!(x.widening_mul::<M>(y), schoolbook::<N, M>(x, y));
+            assert_eq!(x.widening_square::<M>(), schoolbook::<N, M>(x, x));
+        }
+        let max = BigInt::<N>::MAX;
+        assert_eq!(max.widening_mul::<M>(max), schoolbook::<N, M>(max, max));
+        assert_eq!(max.widening_square::<M>(), schoolbook::<N, M>(max, max));
+        let zero = BigInt::<N>::ZERO;
+        assert_eq!(zero.widening_mul::<M>(max), BigInt::ZERO);
+    }
+
+    #[test]
+    fn mul() {
+        check::<1, 2>();
+        check::<4, 8>();
+        check::<6, 12>();
+        check::<8, 16>();
+        check::<32, 64>();
+        check::<64, 128>();
+
+        let x = limbs::<4>(1);
+        assert_eq!(x * x, x.widening_square());
+    }
+
+    #[test]
+    fn const_mul() {
+        const SQUARE: BigInt<8> = BigInt::<4>::MAX.widening_mul(BigInt::MAX);
+        // (2^256 - 1)^2 = 2^512 - 2^257 + 1
+        assert_eq!(SQUARE, BigInt::new([!0, !0, !0, !1, 0, 0, 0, 1]));
+    }
+}
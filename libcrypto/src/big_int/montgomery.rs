@@ -0,0 +1,317 @@
+//! Modular exponentiation with Montgomery multiplication
+//!
+//! A number `x` is stored as `x * R` modulo the modulus, where R = 2^(64 * `N`).
+//! The product of two such numbers can then be reduced by dividing by R, which only needs
+//! multiplications and shifts, rather than by the modulus.
+//!
+//! The arithmetic is constant-time. The exponent, however, decides the sequence of operations,
+//! so it must be public, as it is when verifying RSA signatures.
+use super::{carry_add, carry_mul, carry_sub, karatsuba_mul, karatsuba_square, BigInt};
+
+/// The largest window of exponent bits that is multiplied in at once
+const MAX_WINDOW: u32 = 5;
+
+/// An odd modulus, with the constants needed to multiply modulo it
+#[derive(Clone, Debug, PartialEq, Eq)]
+pub struct Modulus<const N: usize> {
+    /// The modulus, in little-endian limbs
+    modulus: [u64; N],
+    /// -modulus^-1 modulo 2^64
+    inverse: u64,
+    /// R^2 modulo the modulus
+    r_squared: [u64; N],
+}
+
+impl<const N: usize> Modulus<N> {
+    /// Prepares `modulus` for exponentiation, or returns `None` if it is even or one
+    pub fn new(modulus: BigInt<N>) -> Option<Self> {
+        let modulus = super::reverse(modulus.0);
+        let is_one = modulus[0] == 1 && modulus[1..].iter().all(|&limb| limb == 0);
+        if modulus[0] & 1 == 0 || is_one {
+            return None;
+        }
+
+        // Newton's method doubles the number of correct low bits each step,
+        // and every odd number is its own inverse modulo 8
+        let mut inverse = modulus[0];
+        for _ in 0..5 {
+            inverse = inverse.wrapping_mul(2u64.wrapping_sub(modulus[0].wrapping_mul(inverse)));
+        }
+
+        let mut modulus = Self {
+            modulus,
+            inverse: inverse.wrapping_neg(),
+            r_squared: [0; N],
+        };
+        modulus.r_squared = modulus.compute_r_squared();
+        Some(modulus)
+    }
+
+    /// Returns the modulus
+    pub fn get(&self) -> BigInt<N> {
+        BigInt(super::reverse(self.modulus))
+    }
+
+    /// Returns the number of significant bits in the modulus
+    pub fn bits(&self) -> u32 {
+        // we can safely unwrap because the modulus is odd, so it can't be zero
+        let top = self.modulus.iter().rposition(|&limb| limb != 0).unwrap();
+        top as u32 * 64 + (64 - self.modulus[top].leading_zeros())
+    }
+
+    /// Returns `base`^`exponent` modulo the modulus
+    ///
+    /// `exponent` is big-endian, and may have leading zeros. Runs of zero bits are skipped,
+    /// and the remaining bits are handled several at a time, with a table of odd powers of
+    /// `base` (sliding windows).
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `base` is not less than the modulus.
+    pub fn pow(&self, base: &BigInt<N>, exponent: &[u8]) -> BigInt<N> {
+        let base = self.to_montgomery(base);
+        let bit = |i: usize| exponent[exponent.len() - 1 - i / 8] >> (i % 8) & 1;
+        let Some(top) = (0..exponent.len() * 8).rev().find(|&i| bit(i) == 1) else {
+            return self.out_of_montgomery(&self.one());
+        };
+        let bits = top as u32 + 1;
+        let window = match bits {
+            0..=23 => 1,
+            24..=79 => 3,
+            80..=239 => 4,
+            _ => MAX_WINDOW,
+        };
+
+        // base, base^3, base^5, ..., base^(2^window - 1)
+        let mut odd_powers = [[0; N]; 1 << (MAX_WINDOW - 1)];
+        odd_powers[0] = base;
+        let base_squared = self.square(&base);
+        for i in 1..1 << (window - 1) {
+            odd_powers[i] = self.mul(&odd_powers[i - 1], &base_squared);
+        }
+
+        // the top bit is set, so the accumulator starts at the first window instead of at one
+        let mut acc = None;
+        let mut i = top as isize;
+        while i >= 0 {
+            if bit(i as usize) == 0 {
+                if let Some(acc) = &mut acc {
+                    *acc = self.square(acc);
+                }
+                i -= 1;
+                continue;
+            }
+            // the window ends at its lowest set bit, which makes its value odd
+            let mut low = (i - window as isize + 1).max(0);
+            while bit(low as usize) == 0 {
+                low += 1;
+            }
+            let mut value = 0;
+            for j in (low..=i).rev() {
+                value = value << 1 | bit(j as usize) as usize;
+            }
+            let power = &odd_powers[value >> 1];
+            acc = Some(match acc {
+                Some(mut acc) => {
+                    for _ in low..=i {
+                        acc = self.square(&acc);
+                    }
+                    self.mul(&acc, power)
+                },
+                None => *power,
+            });
+            i = low - 1;
+        }
+        // we can safely unwrap because the exponent has at least one set bit
+        self.out_of_montgomery(&acc.unwrap())
+    }
+
+    /// Returns `base`^65537 modulo the modulus
+    ///
+    /// 65537 (2^16 + 1) is by far the most common RSA public exponent. This needs just 16
+    /// squarings and two multiplications. The last multiplication is by `base` itself, rather
+    /// than by `base` in Montgomery form, which also takes the result out of Montgomery form.
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `base` is not less than the modulus.
+    pub fn pow_65537(&self, base: &BigInt<N>) -> BigInt<N> {
+        let mut acc = self.to_montgomery(base);
+        for _ in 0..16 {
+            acc = self.square(&acc);
+        }
+        BigInt(super::reverse(self.mul(&acc, &super::reverse(base.0))))
+    }
+
+    /// Returns `x`, which must be less than the modulus, in Montgomery form
+    fn to_montgomery(&self, x: &BigInt<N>) -> [u64; N] {
+        assert!(x.0 < self.get().0, "the base must be less than the modulus");
+        self.mul(&super::reverse(x.0), &self.r_squared)
+    }
+
+    /// Returns `x` out of Montgomery form
+    fn out_of_montgomery(&self, x: &[u64; N]) -> BigInt<N> {
+        let mut wide = [*x, [0; N]];
+        BigInt(super::reverse(self.reduce(wide.as_flattened_mut())))
+    }
+
+    /// Returns one in Montgomery form, which is R modulo the modulus
+    fn one(&self) -> [u64; N] {
+        let mut one = [0; N];
+        one[0] = 1;
+        self.mul(&one, &self.r_squared)
+    }
+
+    /// Returns `x * y / R` modulo the modulus
+    fn mul(&self, x: &[u64; N], y: &[u64; N]) -> [u64; N] {
+        let mut product = [[0; N]; 2];
+        karatsuba_mul(x, y, product.as_flattened_mut());
+        self.reduce(product.as_flattened_mut())
+    }
+
+    /// Returns `x * x / R` modulo the modulus
+    fn square(&self, x: &[u64; N]) -> [u64; N] {
+        let mut square = [[0; N]; 2];
+        karatsuba_square(x, square.as_flattened_mut());
+        self.reduce(square.as_flattened_mut())
+    }
+
+    /// Returns `x / R` modulo the modulus, destroying `x`
+    ///
+    /// `x` must be `2 * N` limbs long and less than the modulus times R.
+    fn reduce(&self, x: &mut [u64]) -> [u64; N] {
+        // add the multiple of the modulus that clears the lowest limb, one limb at a time
+        let mut top_carry = false;
+        for i in 0..N {
+            let factor = x[i].wrapping_mul(self.inverse);
+            let mut carry = 0;
+            for (x, &limb) in x[i..i + N].iter_mut().zip(&self.modulus) {
+                let (product, high) = carry_mul(factor, limb, carry);
+                let overflowed;
+                (*x, overflowed) = x.overflowing_add(product);
+                carry = high + overflowed as u64;
+            }
+            (x[i + N], top_carry) = carry_add(x[i + N], carry, top_carry);
+        }
+        // the result is less than twice the modulus
+        let mut result = [0; N];
+        result.copy_from_slice(&x[N..]);
+        self.subtract_if_larger(result, top_carry)
+    }
+
+    /// Returns `x` minus the modulus if `x` (plus 2^(64 * `N`), if `overflowed` is set) is at
+    /// least the modulus, or `x` otherwise
+    fn subtract_if_larger(&self, x: [u64; N], overflowed: bool) -> [u64; N] {
+        let mut difference = [0; N];
+        let mut borrow = false;
+        for i in 0..N {
+            (difference[i], borrow) = carry_sub(x[i], self.modulus[i], borrow);
+        }
+        let mask = ((overflowed | !borrow) as u64).wrapping_neg();
+        core::array::from_fn(|i| difference[i] & mask | x[i] & !mask)
+    }
+
+    /// Returns R^2 modulo the modulus
+    ///
+    /// Doubling 2^(`bits` - 1) until it reaches 2^t * R, where R^2 = (2^t)^(2^k) * R, lets k
+    /// squarings in Montgomery form do the rest, which is much faster than doubling all the way.
+    fn compute_r_squared(&self) -> [u64; N] {
+        let r_bits = 64 * N as u32;
+        let squarings = r_bits.trailing_zeros();
+        let t = r_bits >> squarings;
+
+        let top = self.bits() - 1;
+        let mut x = [0; N];
+        x[top as usize / 64] = 1 << (top % 64);
+        for _ in top..r_bits + t {
+            let mut carry = false;
+            for limb in x.iter_mut() {
+                (*limb, carry) = carry_add(*limb, *limb, carry);
+            }
+            x = self.subtract_if_larger(x, carry);
+        }
+        for _ in 0..squarings {
+            x = self.square(&x);
+        }
+        x
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{BigInt, Modulus};
+
+    /// Returns `base`^`exponent` modulo `modulus`, one bit at a time, without Montgomery form
+    fn pow_slowly(base: u128, exponent: u64, modulus: u128) -> u128 {
+        let mul = |x: u128, y: u128| {
+            // double-and-add, so that nothing overflows
+            let mut product = 0;
+            for i in (0..128).rev() {
+                product = (product << 1) % modulus;
+                if y >> i & 1 == 1 {
+                    product = (product + x) % modulus;
+                }
+            }
+            product
+        };
+        let mut acc = 1;
+        for i in (0..64).rev() {
+            acc = mul(acc, acc);
+            if exponent >> i & 1 == 1 {
+                acc = mul(acc, base);
+            }
+        }
+        acc
+    }
+
+    fn big_int(x: u128) -> BigInt<2> {
+        BigInt::new([(x >> 64) as u64, x as u64])
+    }
+
+    #[test]
+    fn pow() {
+        // moduli below 2^127 fit in `pow_slowly`, and the smaller ones leave the top limb empty
+        let moduli = [
+            0x7fff_ffff_ffff_ffff_ffff_ffff_ffff_ffff,
+            0x1_0000_0000_0000_0001,
+            3,
+        ];
+        let exponents = [
+            0,
+            1,
+            2,
+            3,
+            17,
+            65537,
+            0xd2a3_f1c5,
+            0xfedc_ba98_7654_3210,
+            u64::MAX,
+        ];
+        for modulus in moduli {
+            let m = Modulus::new(big_int(modulus)).unwrap();
+            assert_eq!(m.get(), big_int(modulus));
+            for base in [0, 1, 2, 0x1234_5678_9abc_def0_1234_5678, modulus - 1] {
+                let base = base % modulus;
+                for exponent in exponents {
+                    assert_eq!(
+                        m.pow(&big_int(base), &exponent.to_be_bytes()),
+                        big_int(pow_slowly(base, exponent, modulus)),
+                        "{base:#x}^{exponent:#x} mod {modulus:#x}",
+                    );
+                }
+                assert_eq!(
+                    m.pow_65537(&big_int(base)),
+                    big_int(pow_slowly(base, 65537, modulus))
+                );
+            }
+        }
+    }
+
+    #[test]
+    fn invalid_modulus() {
+        assert!(Modulus::new(BigInt::<4>::ZERO).is_none());
+        assert!(Modulus::new(BigInt::<4>::from(1)).is_none());
+        assert!(Modulus::new(BigInt::<4>::from(0x1000)).is_none());
+        assert_eq!(Modulus::new(BigInt::<4>::MAX).unwrap().bits(), 256);
+    }
+}
@@ -0,0 +1,199 @@
+//! Helpers shared by the stream ciphers for reading and writing their data
+//!
+//! A stream cipher either transforms a buffer in place,
+//! or reads from one buffer and writes to another.
+//! [`Buffers`] lets the same code handle both without copying.
+
+/// The data a stream cipher operates on
+pub(crate) enum Buffers<'a> {
+    /// A single buffer, transformed in place
+    InPlace(&'a mut [u8]),
+    /// An input buffer and an output buffer of the same length
+    Separate(&'a [u8], &'a mut [u8]),
+}
+
+impl<'a> Buffers<'a> {
+    /// Reads from `input` and writes to the start of `output`
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `input.len()` > `output.len()`
+    pub(crate) fn separate(input: &'a [u8], output: &'a mut [u8]) -> Self {
+        Self::Separate(input, &mut output[..input.len()])
+    }
+
+    /// The number of bytes to be processed
+    pub(crate) fn len(&self) -> usize {
+        match self {
+            Self::InPlace(data) => data.len(),
+            Self::Separate(input, _) => input.len(),
+        }
+    }
+
+    /// Whether there is nothing to be processed
+    pub(crate) fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Borrows the buffers again, so they can still be used after passing them on
+    pub(crate) fn reborrow(&mut self) -> Buffers<'_> {
+        match self {
+            Self::InPlace(data) => Buffers::InPlace(data),
+            Self::Separate(input, output) => Buffers::Separate(input, output),
+        }
+    }
+
+    /// Splits the buffers into the first `mid` bytes and the rest
+    pub(crate) fn split_at(self, mid: usize) -> (Self, Self) {
+        match self {
+            Self::InPlace(data) => {
+                let (head, tail) = data.split_at_mut(mid);
+                (Self::InPlace(head), Self::InPlace(tail))
+            },
+            Self::Separate(input, output) => {
+                let (input_head, input_tail) = input.split_at(mid);
+                let (output_head, output_tail) = output.split_at_mut(mid);
+                (
+                    Self::Separate(input_head, output_head),
+                    Self::Separate(input_tail, output_tail),
+                )
+            },
+        }
+    }
+
+    /// The data to be read
+    ///
+    /// When processing in place, this is only the input until [`xor`](Self::xor) is called.
+    pub(crate) fn input(&self) -> &[u8] {
+        match self {
+            Self::InPlace(data) => data,
+            Self::Separate(input, _) => input,
+        }
+    }
+
+    /// The data that has been written
+    pub(crate) fn output(&self) -> &[u8] {
+        match self {
+            Self::InPlace(data) => data,
+            Self::Separate(_, output) => output,
+        }
+    }
+
+    /// XORs the input with `stream`, writing the result to the output
+    ///
+    /// `stream` must be at least as long as the input
+    pub(crate) fn xor(&mut self, stream: &[u8]) {
+        match self {
+            Self::InPlace(data) => xor_in_place(data, stream),
+            Self::Separate(input, output) => xor_into(output, input, stream),
+        }
+    }
+}
+
+/// The size of the integers used to XOR
+const WORD_SIZE: usize = core::mem::size_of::<u128>();
+
+/// XORs `stream` into `data`, one [`u128`] at a time
+///
+/// `stream` must be at least as long as `data`
+pub(crate) fn xor_in_place(data: &mut [u8], stream: &[u8]) {
+    let split = data.len() - data.len() % WORD_SIZE;
+    let (data_words, data_excess) = data.split_at_mut(split);
+    let (stream_words, stream_excess) = stream.split_at(split);
+
+    // TODO: use `array_chunks` once stabilized
+    for (data_word, stream_word) in data_words
+        .chunks_exact_mut(WORD_SIZE)
+        .zip(stream_words.chunks_exact(WORD_SIZE))
+    {
+        // we can safely unwrap because both words are guaranteed to have a length of
+        // `WORD_SIZE`
+        let xored = u128::from_ne_bytes(data_word.try_into().unwrap())
+            ^ u128::from_ne_bytes(stream_word.try_into().unwrap());
+        data_word.copy_from_slice(&xored.to_ne_bytes());
+    }
+
+    for (data_byte, stream_byte) in data_excess.iter_mut().zip(stream_excess) {
+        *data_byte ^= stream_byte;
+    }
+}
+
+/// Writes `input` XOR `stream` to `output`, one [`u128`] at a time
+///
+/// `output` and `stream` must be at least as long as `input`
+pub(crate) fn xor_into(output: &mut [u8], input: &[u8], stream: &[u8]) {
+    let split = input.len() - input.len() % WORD_SIZE;
+    let (input_words, input_excess) = input.split_at(split);
+    let (output_words, output_excess) = output.split_at_mut(split);
+    let (stream_words, stream_excess) = stream.split_at(split);
+
+    // TODO: use `array_chunks` once stabilized
+    for ((output_word, input_word), stream_word) in output_words
+        .chunks_exact_mut(WORD_SIZE)
+        .zip(input_words.chunks_exact(WORD_SIZE))
+        .zip(stream_words.chunks_exact(WORD_SIZE))
+    {
+        // we can safely unwrap because all words are guaranteed to have a length of
+        // `WORD_SIZE`
+        let xored = u128::from_ne_bytes(input_word.try_into().unwrap())
+            ^ u128::from_ne_bytes(stream_word.try_into().unwrap());
+        output_word.copy_from_slice(&xored.to_ne_bytes());
+    }
+
+    for ((output_byte, input_byte), stream_byte) in output_excess
+        .iter_mut()
+        .zip(input_excess)
+        .zip(stream_excess)
+    {
+        *output_byte = input_byte ^ stream_byte;
+    }
+}
+
+/// Pairs up the concatenation of `inputs` with the concatenation of `outputs`,
+/// calling `f` on each pair of equally long segments, in order
+///
+/// # Panics
+///
+/// This function will panic if `outputs` are shorter in total than `inputs`
+pub(crate) fn for_each_segment(
+    inputs: &[&[u8]],
+    outputs: &mut [&mut [u8]],
+    mut f: impl FnMut(&[u8], &mut [u8]),
+) {
+    let mut outputs = outputs.iter_mut().map(|output| &mut **output);
+    let mut output: &mut [u8] = &mut [];
+    for &input in inputs {
+        let mut input = input;
+        while !input.is_empty() {
+            while output.is_empty() {
+                output = outputs.next().expect("outputs are shorter than inputs");
+            }
+            let len = input.len().min(output.len());
+            let (output_head, output_tail) = core::mem::take(&mut output).split_at_mut(len);
+            f(&input[..len], output_head);
+            input = &input[len..];
+            output = output_tail;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    #[test]
+    fn for_each_segment() {
+        let inputs: [&[u8]; 3] = [b"Hello", b", ", b"world!"];
+        let mut first = [0u8; 3];
+        let mut second = [0u8; 0];
+        let mut third = [0u8; 12];
+        let mut outputs: [&mut [u8]; 3] = [&mut first, &mut second, &mut third];
+
+        let mut segments = 0;
+        super::for_each_segment(&inputs, &mut outputs, |input, output| {
+            output.copy_from_slice(input);
+            segments += 1;
+        });
+        assert_eq!(segments, 4);
+        assert_eq!(&first, b"Hel");
+        assert_eq!(&third[..10], b"lo, world!");
+    }
+}
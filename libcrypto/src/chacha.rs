@@ -1,2 +1,4 @@
 pub mod chacha20;
+pub mod chacha20_poly1305;
 pub mod poly1305;
+pub(crate) mod poly1305_lanes;
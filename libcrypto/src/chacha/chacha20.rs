@@ -1,3 +1,10 @@
+use crate::buffers::{self, Buffers};
+use crate::lanes::Lanes;
+#[cfg(target_arch = "aarch64")]
+use crate::lanes::Neon;
+#[cfg(target_arch = "x86_64")]
+use crate::lanes::Sse2;
+
 const fn quarter_round(mut a: u32, mut b: u32, mut c: u32, mut d: u32) -> (u32, u32, u32, u32) {
     a = a.wrapping_add(b);
     d ^= a;
@@ -40,8 +47,9 @@ fn inner_block(state: &mut [u32; 16]) {
         quarter_round(state[3], state[4], state[9], state[14]);
 }
 
-fn block(key: [u8; 32], nonce: [u8; 12], counter: u32) -> [u8; 64] {
-    let mut state = config_state(key, nonce, counter);
+/// Computes the key stream block with the state `state`
+fn block(state: &[u32; 16]) -> [u8; 64] {
+    let mut state = *state;
 
     let mut working_state = state;
 
@@ -63,6 +71,277 @@ fn block(key: [u8; 32], nonce: [u8; 12], counter: u32) -> [u8; 64] {
     output
 }
 
+/// Computes `LANES` consecutive key stream blocks at once, starting with the block with the
+/// state `state`, and writes them to `out`
+///
+/// The states are interleaved: `working_state[i]` holds word `i` of every block,
+/// so each step of a quarter round is one SIMD instruction on all of the blocks.
+/// Only the block counters differ between the blocks.
+///
+/// `out` must be exactly `64 * LANES` long.
+#[inline(always)]
+fn blocks<V: Lanes<LANES>, const LANES: usize>(state: &[u32; 16], out: &mut [u8]) {
+    debug_assert_eq!(out.len(), 64 * LANES);
+    let mut counters = [state[12]; LANES];
+    for (lane, counter) in counters.iter_mut().enumerate() {
+        *counter = counter.wrapping_add(lane as u32);
+    }
+    let mut state = state.map(V::splat);
+    state[12] = V::load(&counters);
+
+    let mut working_state = state;
+
+    for _ in 0..10 {
+        let [x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15] =
+            &mut working_state;
+        quarter_round_lanes(x0, x4, x8, x12);
+        quarter_round_lanes(x1, x5, x9, x13);
+        quarter_round_lanes(x2, x6, x10, x14);
+        quarter_round_lanes(x3, x7, x11, x15);
+        quarter_round_lanes(x0, x5, x10, x15);
+        quarter_round_lanes(x1, x6, x11, x12);
+        quarter_round_lanes(x2, x7, x8, x13);
+        quarter_round_lanes(x3, x4, x9, x14);
+    }
+
+    // add original state and working state, then de-interleave the blocks
+    let mut words = [[0u32; LANES]; 16];
+    for ((words, state), working_state) in words.iter_mut().zip(state).zip(working_state) {
+        *words = state.add(working_state).store();
+    }
+    // TODO: use `array_chunks` once stabilized
+    for (lane, block) in out.chunks_exact_mut(64).enumerate() {
+        for (output_chunk, words) in block.chunks_exact_mut(4).zip(&words) {
+            output_chunk.copy_from_slice(&words[lane].to_le_bytes());
+        }
+    }
+}
+
+/// [`quarter_round`] on every lane at once
+#[inline(always)]
+fn quarter_round_lanes<V: Lanes<LANES>, const LANES: usize>(
+    a: &mut V,
+    b: &mut V,
+    c: &mut V,
+    d: &mut V,
+) {
+    *a = a.add(*b);
+    *d = d.xor(*a).rotate_left(16);
+    *c = c.add(*d);
+    *b = b.xor(*c).rotate_left(12);
+    *a = a.add(*b);
+    *d = d.xor(*a).rotate_left(8);
+    *c = c.add(*d);
+    *b = b.xor(*c).rotate_left(7);
+}
+
+/// [`blocks`] with 4 lanes, in SSE2 or NEON registers where available
+fn blocks_portable(state: &[u32; 16], out: &mut [u8]) {
+    #[cfg(target_arch = "x86_64")]
+    blocks::<Sse2, 4>(state, out);
+    #[cfg(target_arch = "aarch64")]
+    blocks::<Neon, 4>(state, out);
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    blocks::<[u32; 4], 4>(state, out);
+}
+
+/// [`blocks`] on arrays of lanes
+///
+/// Operating on the arrays in place, one step of a quarter round at a time,
+/// lets the compiler keep them in vector registers when compiled for AVX2 or AVX-512.
+/// It does much worse with the by-value methods of [`Lanes`].
+///
+/// `out` must be exactly `64 * LANES` long.
+#[cfg(target_arch = "x86_64")]
+#[inline(always)]
+fn wide_blocks<const LANES: usize>(state: &[u32; 16], out: &mut [u8]) {
+    debug_assert_eq!(out.len(), 64 * LANES);
+    let mut state = state.map(|word| [word; LANES]);
+    for (lane, counter) in state[12].iter_mut().enumerate() {
+        *counter = counter.wrapping_add(lane as u32);
+    }
+
+    let mut working_state = state;
+
+    for _ in 0..10 {
+        let [x0, x1, x2, x3, x4, x5, x6, x7, x8, x9, x10, x11, x12, x13, x14, x15] =
+            &mut working_state;
+        wide_quarter_round(x0, x4, x8, x12);
+        wide_quarter_round(x1, x5, x9, x13);
+        wide_quarter_round(x2, x6, x10, x14);
+        wide_quarter_round(x3, x7, x11, x15);
+        wide_quarter_round(x0, x5, x10, x15);
+        wide_quarter_round(x1, x6, x11, x12);
+        wide_quarter_round(x2, x7, x8, x13);
+        wide_quarter_round(x3, x4, x9, x14);
+    }
+
+    // add original state and working state, de-interleaving the blocks
+    // TODO: use `array_chunks` once stabilized
+    for (lane, block) in out.chunks_exact_mut(64).enumerate() {
+        for ((output_chunk, state_words), working_state_words) in
+            block.chunks_exact_mut(4).zip(&state).zip(&working_state)
+        {
+            let word = state_words[lane].wrapping_add(working_state_words[lane]);
+            output_chunk.copy_from_slice(&word.to_le_bytes());
+        }
+    }
+}
+
+/// [`quarter_round`] on every lane at once, in place
+#[cfg(target_arch = "x86_64")]
+#[inline(always)]
+fn wide_quarter_round<const LANES: usize>(
+    a: &mut [u32; LANES],
+    b: &mut [u32; LANES],
+    c: &mut [u32; LANES],
+    d: &mut [u32; LANES],
+) {
+    for lane in 0..LANES {
+        a[lane] = a[lane].wrapping_add(b[lane]);
+    }
+    for lane in 0..LANES {
+        d[lane] = (d[lane] ^ a[lane]).rotate_left(16);
+    }
+    for lane in 0..LANES {
+        c[lane] = c[lane].wrapping_add(d[lane]);
+    }
+    for lane in 0..LANES {
+        b[lane] = (b[lane] ^ c[lane]).rotate_left(12);
+    }
+    for lane in 0..LANES {
+        a[lane] = a[lane].wrapping_add(b[lane]);
+    }
+    for lane in 0..LANES {
+        d[lane] = (d[lane] ^ a[lane]).rotate_left(8);
+    }
+    for lane in 0..LANES {
+        c[lane] = c[lane].wrapping_add(d[lane]);
+    }
+    for lane in 0..LANES {
+        b[lane] = (b[lane] ^ c[lane]).rotate_left(7);
+    }
+}
+
+/// [`wide_blocks`] with 8 lanes, compiled for AVX2
+///
+/// # Safety
+///
+/// The CPU must support the `avx2` target feature.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn blocks_avx2(state: &[u32; 16], out: &mut [u8]) {
+    wide_blocks::<8>(state, out);
+}
+
+/// [`wide_blocks`] with 16 lanes, compiled for AVX-512
+///
+/// # Safety
+///
+/// The CPU must support the `avx512f` target feature.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx512f")]
+unsafe fn blocks_avx512(state: &[u32; 16], out: &mut [u8]) {
+    wide_blocks::<16>(state, out);
+}
+
+/// The most key stream blocks computed at once
+const MAX_LANES: usize = 16;
+
+/// Returns the name of the implementation used to compute the key stream
+pub(crate) fn backend_name() -> &'static str {
+    Backend::detect().name()
+}
+
+/// The implementation used to compute the key stream
+///
+/// Every implementation computes several blocks at once, with as many lanes
+/// as the widest SIMD registers available hold.
+/// SSE2 and NEON are always available, giving 4 lanes.
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+enum Backend {
+    /// 4 lanes
+    Portable,
+    /// 8 lanes
+    #[cfg(target_arch = "x86_64")]
+    Avx2,
+    /// 16 lanes
+    #[cfg(target_arch = "x86_64")]
+    Avx512,
+}
+
+impl Backend {
+    /// Picks the widest implementation supported by the CPU
+    fn detect() -> Self {
+        #[cfg(target_arch = "x86_64")]
+        {
+            if crate::cpu::has_avx512f() {
+                return Self::Avx512;
+            }
+            if crate::cpu::has_avx2() {
+                return Self::Avx2;
+            }
+        }
+        Self::Portable
+    }
+
+    /// Returns the name of the implementation
+    const fn name(self) -> &'static str {
+        match self {
+            Self::Portable => "portable",
+            #[cfg(target_arch = "x86_64")]
+            Self::Avx2 => "avx2",
+            #[cfg(target_arch = "x86_64")]
+            Self::Avx512 => "avx512",
+        }
+    }
+
+    /// Writes the key stream, starting with the block with the state `state`, to `out`,
+    /// and advances the block counter of `state` past it
+    ///
+    /// `out` must be a multiple of 64 long.
+    fn key_stream(self, state: &mut [u32; 16], out: &mut [u8]) {
+        debug_assert_eq!(out.len() % 64, 0);
+        let mut out = out;
+        #[cfg(target_arch = "x86_64")]
+        {
+            if self == Self::Avx512 {
+                // SAFETY: `Backend::Avx512` is only chosen if the CPU supports AVX-512
+                out = fill(out, state, 16, |state, out| unsafe {
+                    blocks_avx512(state, out)
+                });
+            }
+            if self != Self::Portable {
+                // SAFETY: `Backend::Avx2` and `Backend::Avx512` are only chosen
+                // if the CPU supports AVX2
+                out = fill(out, state, 8, |state, out| unsafe {
+                    blocks_avx2(state, out)
+                });
+            }
+        }
+        out = fill(out, state, 4, blocks_portable);
+        fill(out, state, 1, |state, out| {
+            out.copy_from_slice(&block(state))
+        });
+    }
+}
+
+/// Writes as much of the key stream to `out` as possible, `lanes` blocks at a time with `f`,
+/// and returns the rest of `out`
+fn fill<'a>(
+    out: &'a mut [u8],
+    state: &mut [u32; 16],
+    lanes: usize,
+    mut f: impl FnMut(&[u32; 16], &mut [u8]),
+) -> &'a mut [u8] {
+    let mut chunks = out.chunks_exact_mut(64 * lanes);
+    for chunk in &mut chunks {
+        f(state, chunk);
+        state[12] = state[12].wrapping_add(lanes as u32);
+    }
+    chunks.into_remainder()
+}
+
 fn config_state(key: [u8; 32], nonce: [u8; 12], counter: u32) -> [u32; 16] {
     // TODO: use uninitialized memory if necessary
     let mut state = [
@@ -87,6 +366,66 @@ fn config_state(key: [u8; 32], nonce: [u8; 12], counter: u32) -> [u32; 16] {
     state
 }
 
+/// The key stream for one message, along with the position in it
+///
+/// This lets a message be encrypted in pieces of any length.
+/// The key and nonce are only parsed once, when the key stream is created.
+pub(super) struct KeyStream {
+    /// The state of the next block to be generated
+    state: [u32; 16],
+    backend: Backend,
+    /// The current block of the key stream
+    block: [u8; 64],
+    /// How many bytes of `block` have been used
+    used: usize,
+}
+
+impl KeyStream {
+    pub(super) fn new(key: [u8; 32], nonce: [u8; 12], counter: u32) -> Self {
+        Self {
+            state: config_state(key, nonce, counter),
+            backend: Backend::detect(),
+            block: [0; 64],
+            used: 64,
+        }
+    }
+
+    /// XORs the next `data.len()` bytes of the key stream with `data`
+    pub(super) fn apply(&mut self, mut data: Buffers<'_>) {
+        if self.used < self.block.len() {
+            let len = data.len().min(self.block.len() - self.used);
+            let (mut head, tail) = data.split_at(len);
+            head.xor(&self.block[self.used..self.used + len]);
+            self.used += len;
+            data = tail;
+        }
+
+        // whole blocks are computed straight into `stream`, as many at once as possible
+        let mut stream = [0u8; 64 * MAX_LANES];
+        while data.len() >= 64 {
+            let len = (data.len() - data.len() % 64).min(stream.len());
+            self.backend.key_stream(&mut self.state, &mut stream[..len]);
+            let (mut head, tail) = data.split_at(len);
+            head.xor(&stream[..len]);
+            data = tail;
+        }
+        crate::zeroize::zeroize(&mut stream, 0);
+
+        if !data.is_empty() {
+            self.backend.key_stream(&mut self.state, &mut self.block);
+            data.xor(&self.block[..data.len()]);
+            self.used = data.len();
+        }
+    }
+}
+
+impl Drop for KeyStream {
+    fn drop(&mut self) {
+        crate::zeroize::zeroize(&mut self.state, 0);
+        crate::zeroize::zeroize(&mut self.block, 0);
+    }
+}
+
 /// Encrypts `msg` inline
 ///
 /// `counter` can be any number, often `0` or `1`
@@ -94,12 +433,7 @@ fn config_state(key: [u8; 32], nonce: [u8; 12], counter: u32) -> [u32; 16] {
 /// WARNING: users MUST NOT use the same `nonce`
 /// more than once with the same key
 pub fn encrypt_inline(msg: &mut [u8], key: [u8; 32], nonce: [u8; 12], counter: u32) {
-    for (index, chunk) in msg.chunks_mut(64).enumerate() {
-        let key_stream = block(key, nonce, counter + index as u32);
-        for (chunk_byte, key_stream_byte) in chunk.iter_mut().zip(key_stream.iter()) {
-            *chunk_byte ^= key_stream_byte
-        }
-    }
+    KeyStream::new(key, nonce, counter).apply(Buffers::InPlace(msg));
 }
 
 /// Encrypts `msg`, writing the encrypted msg to `buf`
@@ -115,8 +449,36 @@ pub fn encrypt_inline(msg: &mut [u8], key: [u8; 32], nonce: [u8; 12], counter: u
 /// WARNING: users MUST NOT use the same `nonce`
 /// more than once with the same key
 pub fn encrypt(msg: &[u8], key: [u8; 32], nonce: [u8; 12], counter: u32, buf: &mut [u8]) {
-    buf[..msg.len()].copy_from_slice(msg);
-    encrypt_inline(buf, key, nonce, counter);
+    KeyStream::new(key, nonce, counter).apply(Buffers::separate(msg, buf));
+}
+
+/// Encrypts the concatenation of `msg`, writing the encrypted msg across `buf`
+///
+/// The segments of `msg` and `buf` don't need to line up.
+/// Nothing is copied apart from the encryption itself,
+/// so a message can be built from several buffers without first joining them.
+///
+/// # Panics
+///
+/// The function will panic if `buf` is shorter in total than `msg`
+///
+/// # Usage notes
+///
+/// `counter` can be any number, often `0` or `1`
+///
+/// WARNING: users MUST NOT use the same `nonce`
+/// more than once with the same key
+pub fn encrypt_vectored(
+    msg: &[&[u8]],
+    key: [u8; 32],
+    nonce: [u8; 12],
+    counter: u32,
+    buf: &mut [&mut [u8]],
+) {
+    let mut key_stream = KeyStream::new(key, nonce, counter);
+    buffers::for_each_segment(msg, buf, |input, output| {
+        key_stream.apply(Buffers::Separate(input, output))
+    });
 }
 
 #[cfg(test)]
@@ -154,7 +516,32 @@ mod tests {
             0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2, 0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9,
             0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e,
         ];
-        assert_eq!(output_state, super::block(key, nonce, counter));
+        assert_eq!(
+            output_state,
+            super::block(&super::config_state(key, nonce, counter))
+        );
+    }
+
+    #[test]
+    fn key_stream() {
+        // 29 blocks use every number of lanes, and the counter wraps around partway
+        let mut state = super::config_state([0x17; 32], [0x71; 12], u32::MAX - 20);
+        let mut expected = [0u8; 29 * 64];
+        for block in expected.chunks_exact_mut(64) {
+            block.copy_from_slice(&super::block(&state));
+            state[12] = state[12].wrapping_add(1);
+        }
+
+        let initial_state = super::config_state([0x17; 32], [0x71; 12], u32::MAX - 20);
+        let mut out = [0u8; 29 * 64];
+        let mut state = initial_state;
+        super::Backend::detect().key_stream(&mut state, &mut out);
+        assert_eq!(out, expected);
+        assert_eq!(state[12], 8);
+
+        let mut state = initial_state;
+        super::Backend::Portable.key_stream(&mut state, &mut out);
+        assert_eq!(out, expected);
     }
 
     #[test]
@@ -193,4 +580,32 @@ mod tests {
         super::encrypt_inline(&mut plain_text, key, nonce, counter);
         assert_eq!(plain_text, cipher_text);
     }
+
+    #[test]
+    fn vectored() {
+        let key = [0x42; 32];
+        let nonce = [0x24; 12];
+        let mut msg = [0u8; 300];
+        for (i, byte) in msg.iter_mut().enumerate() {
+            *byte = (i * 5) as u8;
+        }
+        let mut expected = [0u8; 300];
+        super::encrypt(&msg, key, nonce, 1, &mut expected);
+
+        let (first, rest) = msg.split_at(5);
+        let (second, third) = rest.split_at(100);
+        let mut buf = [0u8; 300];
+        let (buf_first, buf_second) = buf.split_at_mut(64);
+        super::encrypt_vectored(
+            &[first, second, third],
+            key,
+            nonce,
+            1,
+            &mut [buf_first, buf_second],
+        );
+        assert_eq!(buf, expected);
+
+        super::encrypt_inline(&mut msg, key, nonce, 1);
+        assert_eq!(msg, expected);
+    }
 }
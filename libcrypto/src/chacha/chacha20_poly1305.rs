@@ -0,0 +1,508 @@
+//! The ChaCha20-Poly1305 AEAD, as specified in RFC 8439
+//!
+//! This combines the ChaCha20 stream cipher with the Poly1305 authenticator.
+//! It is much faster than AES-GCM in software, so it is a good choice for CPUs without
+//! AES instructions.
+//!
+//! # Examples
+//!
+//! ```
+//! use libcrypto::chacha::chacha20_poly1305::ChaCha20Poly1305;
+//!
+//! let plain_text = "Top secret message".as_bytes();
+//! let additional_data = "Public information".as_bytes();
+//!
+//! let key = [0x42; 32];
+//! let nonce = [0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88];
+//!
+//! let cipher = ChaCha20Poly1305::new(key);
+//!
+//! let mut encrypted_message = vec![0u8; plain_text.len()];
+//! let tag = cipher.encrypt(&plain_text, &additional_data, &nonce, &mut encrypted_message);
+//!
+//! let mut decrypted_message = vec![0u8; encrypted_message.len()];
+//! cipher
+//!     .decrypt(&encrypted_message, &additional_data, &nonce, &tag, &mut decrypted_message)
+//!     .expect("Our message has been modified!");
+//!
+//! assert_eq!(decrypted_message, plain_text);
+//! ```
+use super::chacha20::KeyStream;
+use super::poly1305::{self, Poly1305};
+use crate::aes::gcm::{self, BadData};
+use crate::buffers::{self, Buffers};
+
+/// The size of a key, in bytes
+pub const KEY_SIZE: usize = 32;
+/// The size of a nonce, in bytes
+pub const NONCE_SIZE: usize = 12;
+/// The size of a tag, in bytes
+pub const TAG_SIZE: usize = poly1305::TAG_SIZE;
+
+/// The number of bytes encrypted and authenticated together in one pass
+///
+/// This is small enough to stay in L1 cache between encryption and authentication.
+const STITCH_SIZE: usize = 1024;
+
+/// A type that allows for authenticated encryption and decryption with ChaCha20-Poly1305
+///
+/// See [`ChaCha20Poly1305`]'s implementations for examples.
+pub struct ChaCha20Poly1305 {
+    key: [u8; KEY_SIZE],
+}
+
+impl ChaCha20Poly1305 {
+    /// Construct a new [`ChaCha20Poly1305`] cipher.
+    pub fn new(key: [u8; KEY_SIZE]) -> Self {
+        Self { key }
+    }
+
+    /// Encrypts `plain_text` inline, and generates an authentication tag
+    /// for `plain_text` and `add_data`.
+    ///
+    /// Encryption and authentication happen in a single pass over `plain_text`.
+    ///
+    /// WARNING: for security purposes,
+    /// users MUST NOT use the same `nonce` twice for the same key.
+    pub fn encrypt_inline(
+        &self,
+        plain_text: &mut [u8],
+        add_data: &[u8],
+        nonce: &[u8; NONCE_SIZE],
+    ) -> [u8; TAG_SIZE] {
+        let mut stream = self.encrypt_stream(nonce);
+        stream.update_add_data(add_data);
+        stream.update(plain_text);
+        stream.finalize()
+    }
+
+    /// Encrypts `msg`, writing the encrypted msg to `buf` and returning an authentication tag
+    ///
+    /// # Panics
+    ///
+    /// The function will panic if `msg.len()` > `buf.len()`
+    ///
+    /// WARNING: for security purposes,
+    /// users MUST NOT use the same `nonce` twice for the same key.
+    pub fn encrypt(
+        &self,
+        msg: &[u8],
+        add_data: &[u8],
+        nonce: &[u8; NONCE_SIZE],
+        buf: &mut [u8],
+    ) -> [u8; TAG_SIZE] {
+        let mut stream = self.encrypt_stream(nonce);
+        stream.update_add_data(add_data);
+        stream.update_into(msg, buf);
+        stream.finalize()
+    }
+
+    /// Encrypts the concatenation of `msg`, writing the encrypted msg across `buf`
+    /// and returning an authentication tag
+    ///
+    /// The segments of `msg` and `buf` don't need to line up.
+    ///
+    /// # Panics
+    ///
+    /// The function will panic if `buf` is shorter in total than `msg`
+    ///
+    /// WARNING: for security purposes,
+    /// users MUST NOT use the same `nonce` twice for the same key.
+    pub fn encrypt_vectored(
+        &self,
+        msg: &[&[u8]],
+        add_data: &[u8],
+        nonce: &[u8; NONCE_SIZE],
+        buf: &mut [&mut [u8]],
+    ) -> [u8; TAG_SIZE] {
+        let mut stream = self.encrypt_stream(nonce);
+        stream.update_add_data(add_data);
+        buffers::for_each_segment(msg, buf, |input, output| stream.update_into(input, output));
+        stream.finalize()
+    }
+
+    /// Decrypts `cipher_text` inline.
+    ///
+    /// Decryption and authentication happen in a single pass over `cipher_text`.
+    /// If the tag doesn't match, `cipher_text` is restored to its original value
+    /// so that unauthenticated plain text is never released.
+    pub fn decrypt_inline(
+        &self,
+        cipher_text: &mut [u8],
+        add_data: &[u8],
+        nonce: &[u8; NONCE_SIZE],
+        tag: &[u8; TAG_SIZE],
+    ) -> Result<(), BadData> {
+        let mut stream = self.decrypt_stream(nonce);
+        stream.update_add_data(add_data);
+        stream.update(cipher_text);
+        if stream.verify(tag).is_err() {
+            // the message starts at block 1, after the Poly1305 key
+            KeyStream::new(self.key, *nonce, 1).apply(Buffers::InPlace(cipher_text));
+            return Err(BadData);
+        }
+        Ok(())
+    }
+
+    /// Decrypts `msg`, writing the decrypted msg to `buf`
+    ///
+    /// Retuns an `Err(BadData)` if the message has been modified.
+    /// In that case, `buf` holds a copy of `msg` instead.
+    ///
+    /// # Panics
+    ///
+    /// The function will panic if `msg.len()` > `buf.len()`
+    pub fn decrypt(
+        &self,
+        msg: &[u8],
+        add_data: &[u8],
+        nonce: &[u8; NONCE_SIZE],
+        tag: &[u8; TAG_SIZE],
+        buf: &mut [u8],
+    ) -> Result<(), BadData> {
+        let mut stream = self.decrypt_stream(nonce);
+        stream.update_add_data(add_data);
+        stream.update_into(msg, buf);
+        if stream.verify(tag).is_err() {
+            buf[..msg.len()].copy_from_slice(msg);
+            return Err(BadData);
+        }
+        Ok(())
+    }
+
+    /// Decrypts the concatenation of `msg`, writing the decrypted msg across `buf`
+    ///
+    /// Retuns an `Err(BadData)` if the message has been modified.
+    /// In that case, `buf` holds a copy of `msg` instead.
+    ///
+    /// The segments of `msg` and `buf` don't need to line up.
+    ///
+    /// # Panics
+    ///
+    /// The function will panic if `buf` is shorter in total than `msg`
+    pub fn decrypt_vectored(
+        &self,
+        msg: &[&[u8]],
+        add_data: &[u8],
+        nonce: &[u8; NONCE_SIZE],
+        tag: &[u8; TAG_SIZE],
+        buf: &mut [&mut [u8]],
+    ) -> Result<(), BadData> {
+        let mut stream = self.decrypt_stream(nonce);
+        stream.update_add_data(add_data);
+        buffers::for_each_segment(msg, buf, |input, output| stream.update_into(input, output));
+        if stream.verify(tag).is_err() {
+            buffers::for_each_segment(msg, buf, |input, output| output.copy_from_slice(input));
+            return Err(BadData);
+        }
+        Ok(())
+    }
+
+    /// Starts encrypting a message that will be provided in pieces.
+    ///
+    /// See [`ChaCha20Poly1305Stream`] for details.
+    ///
+    /// WARNING: for security purposes,
+    /// users MUST NOT use the same `nonce` twice for the same key.
+    pub fn encrypt_stream(&self, nonce: &[u8; NONCE_SIZE]) -> ChaCha20Poly1305Stream {
+        ChaCha20Poly1305Stream::new(self.key, nonce, Direction::Encrypt)
+    }
+
+    /// Starts decrypting a message that will be provided in pieces.
+    ///
+    /// See [`ChaCha20Poly1305Stream`] for details.
+    pub fn decrypt_stream(&self, nonce: &[u8; NONCE_SIZE]) -> ChaCha20Poly1305Stream {
+        ChaCha20Poly1305Stream::new(self.key, nonce, Direction::Decrypt)
+    }
+}
+
+impl Drop for ChaCha20Poly1305 {
+    fn drop(&mut self) {
+        crate::zeroize::zeroize(&mut self.key, 0);
+    }
+}
+
+/// Whether a stream encrypts or decrypts
+///
+/// It is always the cipher text that is authenticated,
+/// so this decides whether that happens before or after the key stream is applied.
+#[derive(Clone, Copy, PartialEq, Eq)]
+enum Direction {
+    Encrypt,
+    Decrypt,
+}
+
+/// A message that is encrypted or decrypted in pieces
+///
+/// The pieces may have any length.
+/// All additional data must be provided before the message.
+///
+/// # Examples
+///
+/// ```
+/// use libcrypto::chacha::chacha20_poly1305::ChaCha20Poly1305;
+///
+/// let cipher = ChaCha20Poly1305::new([0x42; 32]);
+/// let nonce = [0x24; 12];
+///
+/// let mut message = *b"Top secret message, in two parts";
+/// let mut stream = cipher.encrypt_stream(&nonce);
+/// stream.update_add_data(b"Public information");
+/// let (first, second) = message.split_at_mut(5);
+/// stream.update(first);
+/// stream.update(second);
+/// let tag = stream.finalize();
+///
+/// let mut one_shot = *b"Top secret message, in two parts";
+/// assert_eq!(
+///     cipher.encrypt_inline(&mut one_shot, b"Public information", &nonce),
+///     tag
+/// );
+/// assert_eq!(message, one_shot);
+///
+/// let mut stream = cipher.decrypt_stream(&nonce);
+/// stream.update_add_data(b"Public information");
+/// stream.update(&mut message);
+/// stream.verify(&tag).expect("Our message has been modified!");
+/// assert_eq!(&message, b"Top secret message, in two parts");
+/// ```
+pub struct ChaCha20Poly1305Stream {
+    direction: Direction,
+    key_stream: KeyStream,
+    mac: Poly1305,
+    add_data_len: u64,
+    msg_len: u64,
+    /// Whether the additional data has been padded and absorbed
+    add_data_done: bool,
+}
+
+impl ChaCha20Poly1305Stream {
+    fn new(key: [u8; KEY_SIZE], nonce: &[u8; NONCE_SIZE], direction: Direction) -> Self {
+        // the Poly1305 key is the start of block 0, and the message is encrypted from block 1
+        let mut key_stream = KeyStream::new(key, *nonce, 0);
+        let mut block = [0; 64];
+        key_stream.apply(Buffers::InPlace(&mut block));
+        // we can safely unwrap because the slice is guaranteed to have a length of 32
+        let mac = Poly1305::new(block[..poly1305::KEY_SIZE].try_into().unwrap());
+        crate::zeroize::zeroize(&mut block, 0);
+        Self {
+            direction,
+            key_stream,
+            mac,
+            add_data_len: 0,
+            msg_len: 0,
+            add_data_done: false,
+        }
+    }
+
+    /// Authenticates the next piece of additional data
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if it is called after [`update`](Self::update)
+    pub fn update_add_data(&mut self, add_data: &[u8]) {
+        assert!(
+            !self.add_data_done,
+            "additional data must come before the message"
+        );
+        self.add_data_len += add_data.len() as u64;
+        self.mac.update(add_data);
+    }
+
+    /// Encrypts or decrypts the next piece of the message inline
+    pub fn update(&mut self, data: &mut [u8]) {
+        self.process(Buffers::InPlace(data));
+    }
+
+    /// Encrypts or decrypts the next piece of the message,
+    /// writing the result to the start of `output`
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `input.len()` > `output.len()`
+    pub fn update_into(&mut self, input: &[u8], output: &mut [u8]) {
+        self.process(Buffers::separate(input, output));
+    }
+
+    fn process(&mut self, mut data: Buffers<'_>) {
+        if !self.add_data_done {
+            self.mac.pad_to_block();
+            self.add_data_done = true;
+        }
+        self.msg_len += data.len() as u64;
+
+        while !data.is_empty() {
+            let len = data.len().min(STITCH_SIZE);
+            let (mut head, tail) = data.split_at(len);
+            if self.direction == Direction::Decrypt {
+                self.mac.update(head.input());
+            }
+            self.key_stream.apply(head.reborrow());
+            if self.direction == Direction::Encrypt {
+                self.mac.update(head.output());
+            }
+            data = tail;
+        }
+    }
+
+    /// Finishes encryption, returning the authentication tag
+    ///
+    /// This may also be used when decrypting, to compare the tag manually.
+    pub fn finalize(mut self) -> [u8; TAG_SIZE] {
+        self.mac.pad_to_block();
+        self.mac.update(&self.add_data_len.to_le_bytes());
+        self.mac.update(&self.msg_len.to_le_bytes());
+        self.mac.finalize()
+    }
+
+    /// Finishes decryption, returning an `Err(BadData)` if the message has been modified
+    ///
+    /// If this fails, any plain text produced by [`update`](Self::update) MUST be discarded.
+    pub fn verify(self, tag: &[u8; TAG_SIZE]) -> Result<(), BadData> {
+        match gcm::tags_match(&self.finalize(), tag) {
+            true => Ok(()),
+            false => Err(BadData),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::ChaCha20Poly1305;
+
+    #[test]
+    fn chacha20_poly1305() {
+        // RFC 8439, section 2.8.2
+        let key = [
+            0x80, 0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8a, 0x8b, 0x8c, 0x8d,
+            0x8e, 0x8f, 0x90, 0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0x9b,
+            0x9c, 0x9d, 0x9e, 0x9f,
+        ];
+        let nonce = [
+            0x07, 0x00, 0x00, 0x00, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+        ];
+        let add_data = [
+            0x50, 0x51, 0x52, 0x53, 0xc0, 0xc1, 0xc2, 0xc3, 0xc4, 0xc5, 0xc6, 0xc7,
+        ];
+        let plain_text = *b"Ladies and Gentlemen of the class of '99: \
+            If I could offer you only one tip for the future, sunscreen would be it.";
+        let cipher_text = [
+            0xd3, 0x1a, 0x8d, 0x34, 0x64, 0x8e, 0x60, 0xdb, 0x7b, 0x86, 0xaf, 0xbc, 0x53, 0xef,
+            0x7e, 0xc2, 0xa4, 0xad, 0xed, 0x51, 0x29, 0x6e, 0x08, 0xfe, 0xa9, 0xe2, 0xb5, 0xa7,
+            0x36, 0xee, 0x62, 0xd6, 0x3d, 0xbe, 0xa4, 0x5e, 0x8c, 0xa9, 0x67, 0x12, 0x82, 0xfa,
+            0xfb, 0x69, 0xda, 0x92, 0x72, 0x8b, 0x1a, 0x71, 0xde, 0x0a, 0x9e, 0x06, 0x0b, 0x29,
+            0x05, 0xd6, 0xa5, 0xb6, 0x7e, 0xcd, 0x3b, 0x36, 0x92, 0xdd, 0xbd, 0x7f, 0x2d, 0x77,
+            0x8b, 0x8c, 0x98, 0x03, 0xae, 0xe3, 0x28, 0x09, 0x1b, 0x58, 0xfa, 0xb3, 0x24, 0xe4,
+            0xfa, 0xd6, 0x75, 0x94, 0x55, 0x85, 0x80, 0x8b, 0x48, 0x31, 0xd7, 0xbc, 0x3f, 0xf4,
+            0xde, 0xf0, 0x8e, 0x4b, 0x7a, 0x9d, 0xe5, 0x76, 0xd2, 0x65, 0x86, 0xce, 0xc6, 0x4b,
+            0x61, 0x16,
+        ];
+        let tag = [
+            0x1a, 0xe1, 0x0b, 0x59, 0x4f, 0x09, 0xe2, 0x6a, 0x7e, 0x90, 0x2e, 0xcb, 0xd0, 0x60,
+            0x06, 0x91,
+        ];
+        let cipher = ChaCha20Poly1305::new(key);
+
+        let mut buf = plain_text;
+        assert_eq!(cipher.encrypt_inline(&mut buf, &add_data, &nonce), tag);
+        assert_eq!(buf, cipher_text);
+
+        cipher
+            .decrypt_inline(&mut buf, &add_data, &nonce, &tag)
+            .unwrap();
+        assert_eq!(buf, plain_text);
+    }
+
+    #[test]
+    fn bad_data() {
+        let cipher = ChaCha20Poly1305::new([0x42; 32]);
+        let nonce = [0x24; 12];
+        let mut msg = [0u8; 300];
+        for (i, byte) in msg.iter_mut().enumerate() {
+            *byte = (i * 3) as u8;
+        }
+        let mut cipher_text = [0u8; 300];
+        let tag = cipher.encrypt(&msg, b"header", &nonce, &mut cipher_text);
+
+        let mut bad_tag = tag;
+        bad_tag[3] ^= 1;
+        let mut buf = cipher_text;
+        assert!(cipher
+            .decrypt_inline(&mut buf, b"header", &nonce, &bad_tag)
+            .is_err());
+        assert_eq!(buf, cipher_text);
+
+        let mut buf = [0u8; 300];
+        assert!(cipher
+            .decrypt(&cipher_text, b"Header", &nonce, &tag, &mut buf)
+            .is_err());
+        assert_eq!(buf, cipher_text);
+
+        cipher
+            .decrypt(&cipher_text, b"header", &nonce, &tag, &mut buf)
+            .unwrap();
+        assert_eq!(buf, msg);
+    }
+
+    #[test]
+    fn vectored() {
+        let cipher = ChaCha20Poly1305::new([0x42; 32]);
+        let nonce = [0x24; 12];
+        let mut msg = [0u8; 2500];
+        for (i, byte) in msg.iter_mut().enumerate() {
+            *byte = (i * 5) as u8;
+        }
+        let mut expected = [0u8; 2500];
+        let tag = cipher.encrypt(&msg, b"header", &nonce, &mut expected);
+
+        let (first, rest) = msg.split_at(5);
+        let (second, third) = rest.split_at(1100);
+        let mut buf = [0u8; 2500];
+        let (buf_first, buf_second) = buf.split_at_mut(64);
+        let vectored_tag = cipher.encrypt_vectored(
+            &[first, second, third],
+            b"header",
+            &nonce,
+            &mut [buf_first, buf_second],
+        );
+        assert_eq!(vectored_tag, tag);
+        assert_eq!(buf, expected);
+
+        let mut decrypted = [0u8; 2500];
+        let (decrypted_first, decrypted_second) = decrypted.split_at_mut(1000);
+        let (buf_first, buf_second) = buf.split_at(7);
+        cipher
+            .decrypt_vectored(
+                &[buf_first, buf_second],
+                b"header",
+                &nonce,
+                &tag,
+                &mut [decrypted_first, decrypted_second],
+            )
+            .unwrap();
+        assert_eq!(decrypted, msg);
+    }
+
+    #[test]
+    fn stream_empty() {
+        let cipher = ChaCha20Poly1305::new([0x42; 32]);
+        let nonce = [0x24; 12];
+        let expected_tag = cipher.encrypt_inline(&mut [], b"abcde", &nonce);
+
+        let mut stream = cipher.encrypt_stream(&nonce);
+        stream.update_add_data(b"abc");
+        stream.update_add_data(b"de");
+        stream.update(&mut []);
+        assert_eq!(stream.finalize(), expected_tag);
+    }
+
+    #[test]
+    #[should_panic(expected = "additional data must come before the message")]
+    fn stream_add_data_after_empty_update() {
+        let cipher = ChaCha20Poly1305::new([0x42; 32]);
+        let mut stream = cipher.encrypt_stream(&[0x24; 12]);
+        stream.update_add_data(b"abc");
+        stream.update(&mut []);
+        stream.update_add_data(b"de");
+    }
+}
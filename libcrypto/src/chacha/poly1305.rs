@@ -1 +1,315 @@
+//! An implementation of the Poly1305 one-time authenticator
+//!
+//! The accumulator is kept in three limbs of radix 2^44, so that each block
+//! takes only a few 64-bit multiplications.
+//! Long messages are handled several blocks at a time instead,
+//! with AVX2 on x86_64 and NEON on aarch64 (see `poly1305_lanes`).
+//!
+//! WARNING: a key MUST NOT be used to authenticate more than one message.
 
+/// The size of a key, in bytes
+pub const KEY_SIZE: usize = 32;
+/// The size of a tag, in bytes
+pub const TAG_SIZE: usize = 16;
+pub(super) const BLOCK_SIZE: usize = 16;
+
+/// The mask of a 44-bit limb
+const MASK_44: u64 = (1 << 44) - 1;
+/// The mask of the top limb, which only has 42 bits
+const MASK_42: u64 = (1 << 42) - 1;
+
+/// The bit set just above each full block
+const HIGH_BIT: u64 = 1 << 40;
+
+/// Calculates the Poly1305 tag of `msg` with the one-time key `key`
+///
+/// # Examples
+///
+/// ```
+/// use libcrypto::chacha::poly1305;
+///
+/// let key = [
+///     0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33, 0x7f, 0x44, 0x52, 0xfe, 0x42, 0xd5, 0x06,
+///     0xa8, 0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd, 0x4a, 0xbf, 0xf6, 0xaf, 0x41, 0x49,
+///     0xf5, 0x1b,
+/// ];
+/// let tag = [
+///     0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6, 0xc2, 0x2b, 0x8b, 0xaf, 0x0c, 0x01, 0x27,
+///     0xa9,
+/// ];
+/// assert_eq!(poly1305::poly1305(b"Cryptographic Forum Research Group", key), tag);
+/// ```
+pub fn poly1305(msg: &[u8], key: [u8; KEY_SIZE]) -> [u8; TAG_SIZE] {
+    let mut mac = Poly1305::new(key);
+    mac.update(msg);
+    mac.finalize()
+}
+
+/// A Poly1305 tag that is computed incrementally
+#[derive(Clone)]
+pub struct Poly1305 {
+    /// The accumulator
+    h: [u64; 3],
+    /// The clamped first half of the key
+    r: [u64; 3],
+    /// The second half of the key, added at the end
+    pad: [u64; 2],
+    /// Computed the first time a message is long enough to use them
+    lanes: Option<super::poly1305_lanes::Powers>,
+    /// The start of the current, incomplete block
+    buffer: [u8; BLOCK_SIZE],
+    /// How many bytes of `buffer` are used
+    used: usize,
+}
+
+impl Poly1305 {
+    /// Starts authenticating a new message with the one-time key `key`
+    pub fn new(key: [u8; KEY_SIZE]) -> Self {
+        let (r, pad) = key.split_at(16);
+        // we can safely unwrap because `r` is guaranteed to have a length of 16
+        let r = split_limbs(r.try_into().unwrap());
+        // clamp `r`, as required by the specification
+        let r = [
+            r[0] & 0xffc0fffffff,
+            r[1] & 0xfffffc0ffff,
+            r[2] & 0x00ffffffc0f,
+        ];
+        // we can safely unwrap because both halves are guaranteed to have a length of 8
+        let pad = [
+            u64::from_le_bytes(pad[..8].try_into().unwrap()),
+            u64::from_le_bytes(pad[8..].try_into().unwrap()),
+        ];
+        Self {
+            h: [0; 3],
+            r,
+            pad,
+            lanes: None,
+            buffer: [0; BLOCK_SIZE],
+            used: 0,
+        }
+    }
+
+    /// Appends `data` to the message
+    pub fn update(&mut self, mut data: &[u8]) {
+        if self.used != 0 {
+            let len = data.len().min(BLOCK_SIZE - self.used);
+            self.buffer[self.used..self.used + len].copy_from_slice(&data[..len]);
+            self.used += len;
+            data = &data[len..];
+            if self.used < BLOCK_SIZE {
+                return;
+            }
+            update_blocks(&mut self.h, &self.r, &self.buffer, HIGH_BIT);
+            self.used = 0;
+        }
+
+        if data.len() >= super::poly1305_lanes::MIN_LEN {
+            if self.lanes.is_none() {
+                self.lanes = super::poly1305_lanes::Powers::new(self.r);
+            }
+            if let Some(powers) = &self.lanes {
+                data = powers.update_blocks(&mut self.h, data);
+            }
+        }
+        let split = data.len() - data.len() % BLOCK_SIZE;
+        update_blocks(&mut self.h, &self.r, &data[..split], HIGH_BIT);
+        self.buffer[..data.len() - split].copy_from_slice(&data[split..]);
+        self.used = data.len() - split;
+    }
+
+    /// Pads the message to a multiple of [`BLOCK_SIZE`] with zeros
+    ///
+    /// This is how ChaCha20-Poly1305 separates the additional data from the cipher text.
+    pub(super) fn pad_to_block(&mut self) {
+        if self.used != 0 {
+            self.buffer[self.used..].fill(0);
+            update_blocks(&mut self.h, &self.r, &self.buffer, HIGH_BIT);
+            self.used = 0;
+        }
+    }
+
+    /// Returns the tag of the message
+    pub fn finalize(mut self) -> [u8; TAG_SIZE] {
+        if self.used != 0 {
+            // the last block has a 1 just after the message instead of above the block
+            self.buffer[self.used] = 1;
+            self.buffer[self.used + 1..].fill(0);
+            update_blocks(&mut self.h, &self.r, &self.buffer, 0);
+        }
+        let [h0, h1, h2] = reduce(self.h);
+
+        // add `pad` modulo 2^128
+        let [pad0, pad1] = self.pad;
+        let h0 = h0 + (pad0 & MASK_44);
+        let h1 = h1 + (((pad0 >> 44) | (pad1 << 20)) & MASK_44) + (h0 >> 44);
+        let h2 = h2 + (pad1 >> 24) + (h1 >> 44);
+        let (h0, h1) = (h0 & MASK_44, h1 & MASK_44);
+
+        let mut tag = [0; TAG_SIZE];
+        tag[..8].copy_from_slice(&(h0 | h1 << 44).to_le_bytes());
+        tag[8..].copy_from_slice(&((h1 >> 20) | h2 << 24).to_le_bytes());
+        tag
+    }
+}
+
+impl Drop for Poly1305 {
+    fn drop(&mut self) {
+        crate::zeroize::zeroize(&mut self.h, 0);
+        crate::zeroize::zeroize(&mut self.r, 0);
+        crate::zeroize::zeroize(&mut self.pad, 0);
+        crate::zeroize::zeroize(&mut self.buffer, 0);
+    }
+}
+
+impl core::fmt::Debug for Poly1305 {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        // the key and accumulator are secret
+        f.debug_struct("Poly1305").finish_non_exhaustive()
+    }
+}
+
+/// Splits a little-endian 128-bit number into limbs of radix 2^44
+fn split_limbs(bytes: &[u8; 16]) -> [u64; 3] {
+    let n = u128::from_le_bytes(*bytes);
+    [
+        n as u64 & MASK_44,
+        (n >> 44) as u64 & MASK_44,
+        (n >> 88) as u64,
+    ]
+}
+
+/// Absorbs each block of `blocks` into `h`, adding `high_bit` to the top limb of each block
+///
+/// `blocks` must be a multiple of [`BLOCK_SIZE`] long.
+fn update_blocks(h: &mut [u64; 3], r: &[u64; 3], blocks: &[u8], high_bit: u64) {
+    // TODO: use `array_chunks` once stabilized
+    for block in blocks.chunks_exact(BLOCK_SIZE) {
+        // we can safely unwrap because `block` is guaranteed to have a length of `BLOCK_SIZE`
+        let [m0, m1, m2] = split_limbs(block.try_into().unwrap());
+        *h = multiply([h[0] + m0, h[1] + m1, h[2] + m2 + high_bit], r);
+    }
+}
+
+/// Returns `h * r`, partially reduced modulo 2^130 - 5
+///
+/// Each limb of the result is within a few bits of its radix, which leaves room to add a block.
+pub(super) fn multiply(h: [u64; 3], r: &[u64; 3]) -> [u64; 3] {
+    // 2^132 = 4 * 2^130 = 20 modulo 2^130 - 5, so the limbs that overflow wrap around times 20
+    let s1 = r[1] * 20;
+    let s2 = r[2] * 20;
+    let mul = |a: u64, b: u64| a as u128 * b as u128;
+
+    let d0 = mul(h[0], r[0]) + mul(h[1], s2) + mul(h[2], s1);
+    let d1 = mul(h[0], r[1]) + mul(h[1], r[0]) + mul(h[2], s2);
+    let d2 = mul(h[0], r[2]) + mul(h[1], r[1]) + mul(h[2], r[0]);
+
+    let d1 = d1 + (d0 >> 44);
+    let d2 = d2 + (d1 >> 44);
+    let h0 = (d0 as u64 & MASK_44) + (d2 >> 42) as u64 * 5;
+    let h1 = (d1 as u64 & MASK_44) + (h0 >> 44);
+    [h0 & MASK_44, h1, d2 as u64 & MASK_42]
+}
+
+/// Fully reduces `h` modulo 2^130 - 5
+pub(super) fn reduce([h0, h1, h2]: [u64; 3]) -> [u64; 3] {
+    // carry until every limb fits
+    let h2 = h2 + (h1 >> 44);
+    let h1 = h1 & MASK_44;
+    let h0 = h0 + (h2 >> 42) * 5;
+    let h2 = h2 & MASK_42;
+    let h1 = h1 + (h0 >> 44);
+    let h0 = h0 & MASK_44;
+    let h2 = h2 + (h1 >> 44);
+    let h1 = h1 & MASK_44;
+    let h0 = h0 + (h2 >> 42) * 5;
+    let h2 = h2 & MASK_42;
+    let h1 = h1 + (h0 >> 44);
+    let h0 = h0 & MASK_44;
+    let h2 = h2 + (h1 >> 44);
+    let h1 = h1 & MASK_44;
+
+    // `h` is now less than 2 * (2^130 - 5), so subtract 2^130 - 5 once if it isn't too small
+    let g0 = h0 + 5;
+    let g1 = h1 + (g0 >> 44);
+    let g2 = (h2 + (g1 >> 44)).wrapping_sub(1 << 42);
+    // all ones if `g2` didn't underflow, in which case `g` is the reduced value
+    let mask = (g2 >> 63).wrapping_sub(1);
+    [
+        (h0 & !mask) | (g0 & MASK_44 & mask),
+        (h1 & !mask) | (g1 & MASK_44 & mask),
+        (h2 & !mask) | (g2 & mask),
+    ]
+}
+
+#[cfg(test)]
+mod tests {
+    #[test]
+    fn poly1305() {
+        // RFC 8439, section 2.5.2
+        let key = [
+            0x85, 0xd6, 0xbe, 0x78, 0x57, 0x55, 0x6d, 0x33, 0x7f, 0x44, 0x52, 0xfe, 0x42, 0xd5,
+            0x06, 0xa8, 0x01, 0x03, 0x80, 0x8a, 0xfb, 0x0d, 0xb2, 0xfd, 0x4a, 0xbf, 0xf6, 0xaf,
+            0x41, 0x49, 0xf5, 0x1b,
+        ];
+        let tag = [
+            0xa8, 0x06, 0x1d, 0xc1, 0x30, 0x51, 0x36, 0xc6, 0xc2, 0x2b, 0x8b, 0xaf, 0x0c, 0x01,
+            0x27, 0xa9,
+        ];
+        let msg = b"Cryptographic Forum Research Group";
+        assert_eq!(super::poly1305(msg, key), tag);
+
+        let mut mac = super::Poly1305::new(key);
+        for piece in msg.chunks(5) {
+            mac.update(piece);
+        }
+        assert_eq!(mac.finalize(), tag);
+    }
+
+    #[test]
+    fn long_message() {
+        let mut key = [0u8; 32];
+        for (i, byte) in key.iter_mut().enumerate() {
+            *byte = (i * 7 + 3) as u8;
+        }
+        let mut msg = [0u8; 1000];
+        for (i, byte) in msg.iter_mut().enumerate() {
+            *byte = (i * 13 + 5) as u8;
+        }
+        let tag = [
+            0x7d, 0x68, 0x52, 0xd0, 0x35, 0x15, 0xcb, 0x77, 0x74, 0xfd, 0x8c, 0x1a, 0x46, 0x26,
+            0x44, 0x6c,
+        ];
+        assert_eq!(super::poly1305(&msg, key), tag);
+
+        // pieces too short for lanes, and pieces that leave the lanes a partial group
+        for piece_len in [100, 333] {
+            let mut mac = super::Poly1305::new(key);
+            for piece in msg.chunks(piece_len) {
+                mac.update(piece);
+            }
+            assert_eq!(mac.finalize(), tag);
+        }
+    }
+
+    #[test]
+    fn reduction() {
+        // RFC 8439, appendix A.3, test vectors 6 and 7: `h` ends up
+        // just above and just below 2^130 - 5
+        let mut key = [0u8; 32];
+        key[0] = 2;
+        let mut pad_key = key;
+        pad_key[16..].fill(0xff);
+        let mut msg = [0u8; 16];
+        msg[0] = 2;
+        assert_eq!(super::poly1305(&[0xff; 16], key), {
+            let mut tag = [0; 16];
+            tag[0] = 3;
+            tag
+        });
+        assert_eq!(super::poly1305(&msg, pad_key), {
+            let mut tag = [0; 16];
+            tag[0] = 3;
+            tag
+        });
+    }
+}
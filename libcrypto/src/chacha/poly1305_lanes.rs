@@ -0,0 +1,273 @@
+//! Poly1305 on several blocks at once
+//!
+//! Each of `LANES` lanes accumulates every `LANES`th block, multiplying by r^`LANES` instead
+//! of r. At the end, lane `i` is multiplied by the power of r it is still missing, and the
+//! lanes are added together.
+//!
+//! The lanes use five limbs of radix 2^26, so that every product of two limbs is a
+//! 32-by-32-bit multiplication into a 64-bit lane, which SIMD instructions can do
+//! (`VPMULUDQ` with AVX2, giving 4 lanes, and `UMULL` with NEON, giving 2).
+//! Other targets don't use this at all.
+
+/// The mask of a 26-bit limb
+const MASK_26: u64 = (1 << 26) - 1;
+
+/// The bit set just above each full block
+const HIGH_BIT: u64 = 1 << 24;
+
+/// The most lanes used on any target
+const MAX_LANES: usize = 4;
+
+/// The shortest data worth handling in lanes
+///
+/// Setting up and combining the lanes costs about as much as this many bytes.
+pub(super) const MIN_LEN: usize = 4 * MAX_LANES * super::poly1305::BLOCK_SIZE;
+
+/// The powers of r needed to authenticate in lanes
+#[derive(Clone)]
+pub(super) struct Powers {
+    /// r, r^2, ..., r^`MAX_LANES`, fully reduced and in radix 2^26
+    powers: [[u64; 5]; MAX_LANES],
+}
+
+impl Powers {
+    /// Precomputes the powers of `r`, or returns `None` if the CPU can't use lanes
+    ///
+    /// `r` is in radix 2^44.
+    pub(super) fn new(r: [u64; 3]) -> Option<Self> {
+        if !available() {
+            return None;
+        }
+        let mut powers = [[0; 5]; MAX_LANES];
+        let mut power = r;
+        for limbs in powers.iter_mut() {
+            *limbs = to_radix_26(super::poly1305::reduce(power));
+            power = super::poly1305::multiply(power, &r);
+        }
+        Some(Self { powers })
+    }
+
+    /// Absorbs as many whole blocks from the start of `data` into `h` as is worthwhile,
+    /// returning the rest of `data`
+    ///
+    /// `h` is in radix 2^44.
+    pub(super) fn update_blocks<'a>(&self, h: &mut [u64; 3], data: &'a [u8]) -> &'a [u8] {
+        let group_size = LANES * super::poly1305::BLOCK_SIZE;
+        let split = data.len() - data.len() % group_size;
+        if split < MIN_LEN {
+            return data;
+        }
+        #[cfg(target_arch = "x86_64")]
+        // SAFETY: `Powers` is only constructed if the CPU supports AVX2
+        unsafe {
+            update_lanes_avx2(h, &self.powers, &data[..split]);
+        }
+        #[cfg(target_arch = "aarch64")]
+        update_lanes::<LANES>(h, &self.powers, &data[..split]);
+        &data[split..]
+    }
+}
+
+impl Drop for Powers {
+    fn drop(&mut self) {
+        crate::zeroize::zeroize(&mut self.powers, [0; 5]);
+    }
+}
+
+/// The number of lanes used on this target
+#[cfg(target_arch = "x86_64")]
+const LANES: usize = 4;
+#[cfg(not(target_arch = "x86_64"))]
+const LANES: usize = 2;
+
+/// Whether the CPU can use lanes
+fn available() -> bool {
+    #[cfg(target_arch = "x86_64")]
+    {
+        crate::cpu::has_avx2()
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        true
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        false
+    }
+}
+
+/// Returns the name of the implementation new MACs use
+pub(crate) fn backend_name() -> &'static str {
+    match available() {
+        true if cfg!(target_arch = "x86_64") => "avx2",
+        true => "lanes",
+        false => "scalar",
+    }
+}
+
+/// [`update_lanes`] with 4 lanes, compiled for AVX2
+///
+/// # Safety
+///
+/// The CPU must support the `avx2` target feature.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn update_lanes_avx2(h: &mut [u64; 3], powers: &[[u64; 5]; MAX_LANES], blocks: &[u8]) {
+    update_lanes::<4>(h, powers, blocks);
+}
+
+/// Absorbs each block of `blocks` into `h`, `LANES` blocks at a time
+///
+/// `blocks` must be a non-zero multiple of `LANES` blocks long.
+///
+/// The lanes are arrays, operated on one lane at a time,
+/// which the compiler turns into SIMD instructions.
+#[inline(always)]
+fn update_lanes<const LANES: usize>(
+    h: &mut [u64; 3],
+    powers: &[[u64; 5]; MAX_LANES],
+    blocks: &[u8],
+) {
+    let group_size = LANES * super::poly1305::BLOCK_SIZE;
+    debug_assert!(!blocks.is_empty() && blocks.len() % group_size == 0);
+
+    // TODO: use `array_chunks` once stabilized
+    let mut groups = blocks.chunks_exact(group_size);
+    // we can safely unwrap because `blocks` is guaranteed to be at least one group long
+    let mut acc = load_group::<LANES>(groups.next().unwrap());
+    // the accumulator so far joins the first lane
+    for (limbs, h_limb) in acc.iter_mut().zip(to_radix_26(*h)) {
+        limbs[0] += h_limb;
+    }
+
+    let r = powers[LANES - 1].map(|limb| [limb; LANES]);
+    for group in groups {
+        acc = multiply(&acc, &r);
+        let block = load_group::<LANES>(group);
+        for (limbs, block_limbs) in acc.iter_mut().zip(&block) {
+            for lane in 0..LANES {
+                limbs[lane] += block_limbs[lane];
+            }
+        }
+    }
+
+    // the first lane is missing r^LANES, and the last is missing r
+    let mut r = [[0; LANES]; 5];
+    for (i, limbs) in r.iter_mut().enumerate() {
+        for (lane, limb) in limbs.iter_mut().enumerate() {
+            *limb = powers[LANES - 1 - lane][i];
+        }
+    }
+    let acc = multiply(&acc, &r);
+
+    let mut sum = [0; 5];
+    for (sum, limbs) in sum.iter_mut().zip(&acc) {
+        *sum = limbs.iter().sum();
+    }
+    *h = from_radix_26(sum);
+}
+
+/// Returns `a * r` in each lane, partially reduced modulo 2^130 - 5
+///
+/// Each limb of `a` must be less than 2^28, and each limb of `r` less than 2^26.
+/// Each limb of the result is less than 2^26, apart from the second, which may be slightly
+/// larger. That leaves room to add a block.
+#[inline(always)]
+fn multiply<const LANES: usize>(a: &[[u64; LANES]; 5], r: &[[u64; LANES]; 5]) -> [[u64; LANES]; 5] {
+    // only the low 32 bits are multiplied, which lets this be a single SIMD instruction
+    let mul = |a: u64, b: u64| (a as u32 as u64) * (b as u32 as u64);
+    let mut product = [[0; LANES]; 5];
+    for lane in 0..LANES {
+        let [a0, a1, a2, a3, a4] = [a[0][lane], a[1][lane], a[2][lane], a[3][lane], a[4][lane]];
+        let [r0, r1, r2, r3, r4] = [r[0][lane], r[1][lane], r[2][lane], r[3][lane], r[4][lane]];
+        // 2^130 = 5 modulo 2^130 - 5, so the limbs that overflow wrap around times 5
+        let [s1, s2, s3, s4] = [r1 * 5, r2 * 5, r3 * 5, r4 * 5];
+
+        let d0 = mul(a0, r0) + mul(a1, s4) + mul(a2, s3) + mul(a3, s2) + mul(a4, s1);
+        let d1 = mul(a0, r1) + mul(a1, r0) + mul(a2, s4) + mul(a3, s3) + mul(a4, s2);
+        let d2 = mul(a0, r2) + mul(a1, r1) + mul(a2, r0) + mul(a3, s4) + mul(a4, s3);
+        let d3 = mul(a0, r3) + mul(a1, r2) + mul(a2, r1) + mul(a3, r0) + mul(a4, s4);
+        let d4 = mul(a0, r4) + mul(a1, r3) + mul(a2, r2) + mul(a3, r1) + mul(a4, r0);
+
+        let d1 = d1 + (d0 >> 26);
+        let d2 = d2 + (d1 >> 26);
+        let d3 = d3 + (d2 >> 26);
+        let d4 = d4 + (d3 >> 26);
+        let d0 = (d0 & MASK_26) + (d4 >> 26) * 5;
+        let d1 = (d1 & MASK_26) + (d0 >> 26);
+
+        product[0][lane] = d0 & MASK_26;
+        product[1][lane] = d1;
+        product[2][lane] = d2 & MASK_26;
+        product[3][lane] = d3 & MASK_26;
+        product[4][lane] = d4 & MASK_26;
+    }
+    product
+}
+
+/// Splits each of `LANES` blocks into limbs of radix 2^26, one block per lane
+#[inline(always)]
+fn load_group<const LANES: usize>(group: &[u8]) -> [[u64; LANES]; 5] {
+    let mut limbs = [[0; LANES]; 5];
+    // TODO: use `array_chunks` once stabilized
+    for (lane, block) in group.chunks_exact(super::poly1305::BLOCK_SIZE).enumerate() {
+        // we can safely unwrap because `block` is guaranteed to have a length of `BLOCK_SIZE`
+        let n = u128::from_le_bytes(block.try_into().unwrap());
+        limbs[0][lane] = n as u64 & MASK_26;
+        limbs[1][lane] = (n >> 26) as u64 & MASK_26;
+        limbs[2][lane] = (n >> 52) as u64 & MASK_26;
+        limbs[3][lane] = (n >> 78) as u64 & MASK_26;
+        limbs[4][lane] = (n >> 104) as u64 | HIGH_BIT;
+    }
+    limbs
+}
+
+/// Converts `h` from partially reduced radix 2^44 to radix 2^26
+///
+/// Each limb of the result is less than 2^26, apart from the last, which may be slightly larger.
+fn to_radix_26([h0, h1, h2]: [u64; 3]) -> [u64; 5] {
+    // the middle limb may have overflowed its 44 bits
+    let h2 = h2 + (h1 >> 44);
+    let h1 = h1 & ((1 << 44) - 1);
+    [
+        h0 & MASK_26,
+        ((h0 >> 26) | (h1 << 18)) & MASK_26,
+        (h1 >> 8) & MASK_26,
+        ((h1 >> 34) | (h2 << 10)) & MASK_26,
+        h2 >> 16,
+    ]
+}
+
+/// Converts `h` from radix 2^26 to partially reduced radix 2^44
+///
+/// The limbs of `h` may be many bits larger than 26 bits.
+fn from_radix_26([h0, h1, h2, h3, h4]: [u64; 5]) -> [u64; 3] {
+    // carry until all but the last limb fit
+    let h1 = h1 + (h0 >> 26);
+    let h2 = h2 + (h1 >> 26);
+    let h3 = h3 + (h2 >> 26);
+    let h4 = h4 + (h3 >> 26);
+    let h0 = (h0 & MASK_26) + (h4 >> 26) * 5;
+    let h4 = h4 & MASK_26;
+    let h1 = (h1 & MASK_26) + (h0 >> 26);
+    let h2 = (h2 & MASK_26) + (h1 >> 26);
+    let h3 = (h3 & MASK_26) + (h2 >> 26);
+    let h4 = h4 + (h3 >> 26);
+    let [h0, h1, h2, h3] = [h0, h1, h2, h3].map(|limb| limb & MASK_26);
+
+    const MASK_44: u64 = (1 << 44) - 1;
+    [
+        (h0 | (h1 << 26)) & MASK_44,
+        ((h1 >> 18) | (h2 << 8) | (h3 << 34)) & MASK_44,
+        (h3 >> 10) | (h4 << 16),
+    ]
+}
+
+#[cfg(test)]
+mod tests {
+    #[test]
+    fn radix_conversion() {
+        let h = [0xfedcba98765, 0x123456789ab, 0x3ffffffffff];
+        assert_eq!(super::from_radix_26(super::to_radix_26(h)), h);
+    }
+}
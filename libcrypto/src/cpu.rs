@@ -0,0 +1,448 @@
+//! Runtime detection of CPU features, and the table that dispatches on them
+//!
+//! Because this crate is `no_std`, we can't use `std::is_x86_feature_detected`.
+//! Instead, we query the CPU (or the operating system) directly.
+//!
+//! If a feature is enabled at compile time (e.g. via `-C target-cpu=native`),
+//! detection is skipped entirely.
+//!
+//! `cpuid` is slow (especially in a virtual machine, where it traps to the hypervisor),
+//! so the features are only detected once, the first time any primitive needs them. They are kept
+//! in a single table, which every primitive reads to pick its implementation. [`restrict`] can
+//! turn features off in the table, such as to compare the hardware and software implementations,
+//! and [`backends`] reports the implementations it selects.
+//!
+//! # Examples
+//!
+//! ```
+//! use libcrypto::cpu::{self, Features};
+//!
+//! // force the software implementations
+//! cpu::restrict(Features::default());
+//! assert_eq!(cpu::backends().aes, "bitsliced");
+//!
+//! // and go back to the fastest ones
+//! cpu::restrict(cpu::detected());
+//! ```
+use core::sync::atomic::{AtomicU32, Ordering};
+
+/// The CPU features that select the hardware implementations
+///
+/// Without [`aes`](Self::aes), AES falls back to the bitsliced software implementation, which is
+/// several times slower.
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Default)]
+pub struct Features {
+    /// The AES instructions, used by AES
+    pub aes: bool,
+    /// Carry-less multiplication, used by GHASH
+    pub clmul: bool,
+    /// The SHA-256 instructions, used by SHA-256
+    pub sha256: bool,
+    /// AVX2, used by ChaCha20, Poly1305, and multi-buffer SHA-256 on x86_64
+    pub avx2: bool,
+    /// AVX-512, used by ChaCha20 on x86_64
+    pub avx512f: bool,
+}
+
+/// A feature name that isn't one of those [`Features::without`] takes
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub struct UnknownFeatureError;
+
+impl core::fmt::Display for UnknownFeatureError {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "unknown CPU feature")
+    }
+}
+
+// TODO: uncomment the following line once stabilized
+// impl core::error::Error for UnknownFeatureError {};
+
+impl Features {
+    /// Every feature
+    pub const ALL: Self = Self {
+        aes: true,
+        clmul: true,
+        sha256: true,
+        avx2: true,
+        avx512f: true,
+    };
+
+    /// Returns `self` without the features named in `names`
+    ///
+    /// `names` is a comma-separated list of `aes`, `clmul`, `sha256`, `avx2`, `avx512f`, and `all`,
+    /// such as is taken from an environment variable to pass to [`restrict`].
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if any name is unknown.
+    ///
+    /// # Examples
+    ///
+    /// ```
+    /// use libcrypto::cpu::Features;
+    ///
+    /// let features = Features::ALL.without("aes, avx512f").unwrap();
+    /// assert!(!features.aes && features.clmul && !features.avx512f);
+    /// assert_eq!(Features::ALL.without("all"), Ok(Features::default()));
+    /// assert!(Features::ALL.without("mmx").is_err());
+    /// ```
+    pub fn without(mut self, names: &str) -> Result<Self, UnknownFeatureError> {
+        for name in names
+            .split(',')
+            .map(str::trim)
+            .filter(|name| !name.is_empty())
+        {
+            match name {
+                "aes" => self.aes = false,
+                "clmul" => self.clmul = false,
+                "sha256" => self.sha256 = false,
+                "avx2" => self.avx2 = false,
+                "avx512f" => self.avx512f = false,
+                "all" => self = Self::default(),
+                _ => return Err(UnknownFeatureError),
+            }
+        }
+        Ok(self)
+    }
+
+    /// Returns the features in both `self` and `other`
+    pub const fn intersection(self, other: Self) -> Self {
+        Self {
+            aes: self.aes && other.aes,
+            clmul: self.clmul && other.clmul,
+            sha256: self.sha256 && other.sha256,
+            avx2: self.avx2 && other.avx2,
+            avx512f: self.avx512f && other.avx512f,
+        }
+    }
+
+    const fn to_bits(self) -> u32 {
+        self.aes as u32
+            | (self.clmul as u32) << 1
+            | (self.sha256 as u32) << 2
+            | (self.avx2 as u32) << 3
+            | (self.avx512f as u32) << 4
+    }
+
+    const fn from_bits(bits: u32) -> Self {
+        Self {
+            aes: bits & 1 != 0,
+            clmul: bits & 1 << 1 != 0,
+            sha256: bits & 1 << 2 != 0,
+            avx2: bits & 1 << 3 != 0,
+            avx512f: bits & 1 << 4 != 0,
+        }
+    }
+}
+
+/// The features in use, as the bits of [`Features::to_bits`] along with [`FILLED`],
+/// or 0 before they are detected
+static IN_USE: AtomicU32 = AtomicU32::new(0);
+
+/// Marks [`IN_USE`] as filled, since no features at all is a valid table
+const FILLED: u32 = 1 << 31;
+
+/// Returns the features the CPU supports, whether or not they are in use
+pub fn detected() -> Features {
+    Features {
+        aes: detect_aes(),
+        clmul: detect_clmul(),
+        sha256: detect_sha256(),
+        #[cfg(target_arch = "x86_64")]
+        avx2: detect_avx2(),
+        #[cfg(target_arch = "x86_64")]
+        avx512f: detect_avx512f(),
+        #[cfg(not(target_arch = "x86_64"))]
+        avx2: false,
+        #[cfg(not(target_arch = "x86_64"))]
+        avx512f: false,
+    }
+}
+
+/// Returns the features in use, detecting them the first time
+///
+/// These are the features that were detected, less any turned off with [`restrict`].
+#[inline]
+pub fn features() -> Features {
+    // the table is a single value, so it needs no ordering with anything else
+    let bits = IN_USE.load(Ordering::Relaxed);
+    if bits & FILLED != 0 {
+        return Features::from_bits(bits);
+    }
+    let detected = detected();
+    // don't overwrite a table filled in the meantime, which may be restricted
+    match IN_USE.compare_exchange(
+        0,
+        detected.to_bits() | FILLED,
+        Ordering::Relaxed,
+        Ordering::Relaxed,
+    ) {
+        Ok(_) => detected,
+        Err(bits) => Features::from_bits(bits),
+    }
+}
+
+/// Uses only the features of `allowed` that the CPU supports, returning the features now in use
+///
+/// Features that aren't allowed fall back to software, or to narrower vectors. Features can be
+/// turned back on by calling this again, but never beyond what the CPU supports.
+///
+/// Ciphers and hashers that already exist keep the implementations they were created with.
+///
+/// The table never holds a feature the CPU lacks, so the hardware implementations can rely on it.
+pub fn restrict(allowed: Features) -> Features {
+    let features = detected().intersection(allowed);
+    IN_USE.store(features.to_bits() | FILLED, Ordering::Relaxed);
+    features
+}
+
+/// The name of the implementation each primitive uses
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub struct Backends {
+    /// AES: `aes-ni`, `armv8`, or `bitsliced`
+    pub aes: &'static str,
+    /// GHASH, used by AES-GCM: `pclmulqdq`, `pmull`, or `software`
+    pub ghash: &'static str,
+    /// SHA-256: `sha-ni`, `armv8`, or `software`
+    pub sha256: &'static str,
+    /// SHA-256 of many messages at once: the [`sha256`](Self::sha256) backend when that uses the
+    /// SHA-256 instructions, and otherwise `avx2`, `sse2`, `neon`, or `software`
+    pub sha256_many: &'static str,
+    /// ChaCha20: `avx512`, `avx2`, or `portable`
+    pub chacha20: &'static str,
+    /// Poly1305: `avx2`, `lanes`, or `scalar`
+    pub poly1305: &'static str,
+}
+
+impl core::fmt::Display for Backends {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(
+            f,
+            "aes={} ghash={} sha256={} sha256_many={} chacha20={} poly1305={}",
+            self.aes, self.ghash, self.sha256, self.sha256_many, self.chacha20, self.poly1305
+        )
+    }
+}
+
+/// Returns the implementations the primitives use, given the features in use
+pub fn backends() -> Backends {
+    Backends {
+        aes: crate::aes::aes_core::backend_name(),
+        ghash: crate::aes::ghash::backend_name(),
+        sha256: crate::sha2::sha256::backend_name(),
+        sha256_many: crate::sha2::sha256_multi::backend_name(),
+        chacha20: crate::chacha::chacha20::backend_name(),
+        poly1305: crate::chacha::poly1305_lanes::backend_name(),
+    }
+}
+
+/// Returns whether AES is using the AES instructions
+#[inline]
+pub(crate) fn has_aes() -> bool {
+    features().aes
+}
+
+/// Returns whether GHASH is using carry-less multiplication
+#[inline]
+pub(crate) fn has_clmul() -> bool {
+    features().clmul
+}
+
+/// Returns whether SHA-256 is using the SHA-256 instructions
+#[inline]
+pub(crate) fn has_sha256() -> bool {
+    features().sha256
+}
+
+/// Returns whether AVX2 is in use
+#[cfg(target_arch = "x86_64")]
+#[inline]
+pub(crate) fn has_avx2() -> bool {
+    features().avx2
+}
+
+/// Returns whether AVX-512 is in use
+#[cfg(target_arch = "x86_64")]
+#[inline]
+pub(crate) fn has_avx512f() -> bool {
+    features().avx512f
+}
+
+/// Returns whether the CPU supports the AES instructions
+///
+/// On x86_64 this is AES-NI. On aarch64 this is the ARMv8 Cryptography Extensions.
+fn detect_aes() -> bool {
+    #[cfg(target_arch = "x86_64")]
+    {
+        cfg!(target_feature = "aes") || x86_64::cpuid_1_ecx() & x86_64::ECX_AES != 0
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        cfg!(target_feature = "aes") || aarch64::hwcap() & aarch64::HWCAP_AES != 0
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        false
+    }
+}
+
+/// Returns whether the CPU supports 64-bit carry-less multiplication
+///
+/// On x86_64 this is PCLMULQDQ (along with SSSE3, which is needed to byte-swap vectors).
+/// On aarch64 this is PMULL.
+fn detect_clmul() -> bool {
+    #[cfg(target_arch = "x86_64")]
+    {
+        const ECX_CLMUL: u32 = x86_64::ECX_PCLMULQDQ | x86_64::ECX_SSSE3;
+        cfg!(all(target_feature = "pclmulqdq", target_feature = "ssse3"))
+            || x86_64::cpuid_1_ecx() & ECX_CLMUL == ECX_CLMUL
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        cfg!(target_feature = "aes") || aarch64::hwcap() & aarch64::HWCAP_PMULL != 0
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        false
+    }
+}
+
+/// Returns whether the CPU supports the SHA-256 instructions
+///
+/// On x86_64 these are the SHA extensions (along with SSSE3 and SSE4.1, which are needed
+/// to shuffle the state). On aarch64 these are the ARMv8 SHA2 instructions.
+fn detect_sha256() -> bool {
+    #[cfg(target_arch = "x86_64")]
+    {
+        const ECX_SHUFFLE: u32 = x86_64::ECX_SSSE3 | x86_64::ECX_SSE4_1;
+        cfg!(all(
+            target_feature = "sha",
+            target_feature = "ssse3",
+            target_feature = "sse4.1"
+        )) || (x86_64::cpuid_7_ebx() & x86_64::EBX_SHA != 0
+            && x86_64::cpuid_1_ecx() & ECX_SHUFFLE == ECX_SHUFFLE)
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        cfg!(target_feature = "sha2") || aarch64::hwcap() & aarch64::HWCAP_SHA2 != 0
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        false
+    }
+}
+
+/// Returns whether the CPU and operating system support AVX2
+#[cfg(target_arch = "x86_64")]
+fn detect_avx2() -> bool {
+    cfg!(target_feature = "avx2")
+        || (x86_64::cpuid_7_ebx() & x86_64::EBX_AVX2 != 0 && x86_64::os_saves(x86_64::XCR0_SSE_AVX))
+}
+
+/// Returns whether the CPU and operating system support the AVX-512 foundation instructions
+#[cfg(target_arch = "x86_64")]
+fn detect_avx512f() -> bool {
+    cfg!(target_feature = "avx512f")
+        || (x86_64::cpuid_7_ebx() & x86_64::EBX_AVX512F != 0
+            && x86_64::os_saves(x86_64::XCR0_AVX512))
+}
+
+#[cfg(target_arch = "x86_64")]
+mod x86_64 {
+    use core::sync::atomic::{AtomicU64, Ordering};
+
+    pub(super) const ECX_PCLMULQDQ: u32 = 1 << 1;
+    pub(super) const ECX_SSSE3: u32 = 1 << 9;
+    pub(super) const ECX_SSE4_1: u32 = 1 << 19;
+    pub(super) const ECX_AES: u32 = 1 << 25;
+    pub(super) const ECX_OSXSAVE: u32 = 1 << 27;
+    pub(super) const ECX_AVX: u32 = 1 << 28;
+    pub(super) const EBX_AVX2: u32 = 1 << 5;
+    pub(super) const EBX_AVX512F: u32 = 1 << 16;
+    pub(super) const EBX_SHA: u32 = 1 << 29;
+
+    /// The `xmm` and `ymm` registers
+    pub(super) const XCR0_SSE_AVX: u64 = 0b110;
+    /// The `xmm`, `ymm`, and `zmm` registers, along with the AVX-512 mask registers
+    pub(super) const XCR0_AVX512: u64 = 0b1110_0110;
+
+    /// Returns the feature flags reported in `ecx` by `cpuid` leaf 1
+    pub(super) fn cpuid_1_ecx() -> u32 {
+        static CACHE: AtomicU64 = AtomicU64::new(0);
+        // SAFETY: the `cpuid` instruction is available on every x86_64 CPU
+        cached(&CACHE, || unsafe { core::arch::x86_64::__cpuid(1).ecx })
+    }
+
+    /// Returns the feature flags reported in `ebx` by `cpuid` leaf 7, subleaf 0
+    ///
+    /// Older CPUs don't have leaf 7, in which case no features are reported.
+    pub(super) fn cpuid_7_ebx() -> u32 {
+        static CACHE: AtomicU64 = AtomicU64::new(0);
+        // SAFETY: the `cpuid` instruction is available on every x86_64 CPU
+        cached(&CACHE, || unsafe {
+            if core::arch::x86_64::__get_cpuid_max(0).0 < 7 {
+                return 0;
+            }
+            core::arch::x86_64::__cpuid_count(7, 0).ebx
+        })
+    }
+
+    /// Returns the value stored in `cache`, calling `query` to fill it the first time
+    ///
+    /// Every bit of a `cpuid` register may be set, so an extra bit marks `cache` as filled.
+    /// Racing threads may both call `query`, but they get the same result.
+    fn cached(cache: &AtomicU64, query: impl FnOnce() -> u32) -> u32 {
+        const FILLED: u64 = 1 << 32;
+        let value = cache.load(Ordering::Relaxed);
+        if value & FILLED != 0 {
+            return value as u32;
+        }
+        let value = query();
+        cache.store(value as u64 | FILLED, Ordering::Relaxed);
+        value
+    }
+
+    /// Returns whether the operating system saves all of the registers in `xcr0_mask`
+    /// on context switches
+    ///
+    /// Without this, AVX instructions can't be used even if the CPU supports them.
+    pub(super) fn os_saves(xcr0_mask: u64) -> bool {
+        const ECX_XSAVE_AVX: u32 = ECX_OSXSAVE | ECX_AVX;
+        if cpuid_1_ecx() & ECX_XSAVE_AVX != ECX_XSAVE_AVX {
+            return false;
+        }
+        // SAFETY: `OSXSAVE` being set means `xgetbv` is available
+        unsafe { xcr0() & xcr0_mask == xcr0_mask }
+    }
+
+    #[target_feature(enable = "xsave")]
+    unsafe fn xcr0() -> u64 {
+        core::arch::x86_64::_xgetbv(0)
+    }
+}
+
+#[cfg(target_arch = "aarch64")]
+mod aarch64 {
+    pub(super) const HWCAP_AES: u64 = 1 << 3;
+    pub(super) const HWCAP_PMULL: u64 = 1 << 4;
+    pub(super) const HWCAP_SHA2: u64 = 1 << 6;
+
+    #[cfg(target_os = "linux")]
+    extern "C" {
+        fn getauxval(r#type: core::ffi::c_ulong) -> core::ffi::c_ulong;
+    }
+
+    /// Returns the `AT_HWCAP` auxiliary vector entry
+    #[cfg(target_os = "linux")]
+    pub(super) fn hwcap() -> u64 {
+        const AT_HWCAP: core::ffi::c_ulong = 16;
+        // SAFETY: `getauxval` has no preconditions
+        unsafe { getauxval(AT_HWCAP) as u64 }
+    }
+
+    /// We have no way of asking the operating system, so we assume nothing is supported
+    #[cfg(not(target_os = "linux"))]
+    pub(super) fn hwcap() -> u64 {
+        0
+    }
+}
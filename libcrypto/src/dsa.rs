@@ -1 +1,2 @@
 pub mod ecdsa;
+pub mod rsa;
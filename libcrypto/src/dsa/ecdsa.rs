@@ -1,63 +1,245 @@
-// const G: Point = Point::new(
-//     FieldEl::new([
-//         0x6b, 0x17, 0xd1, 0xf2, 0xe1, 0x2c, 0x42, 0x47, 0xf8, 0xbc, 0xe6, 0xe5, 0x63, 0xa4, 0x40,
-//         0xf2, 0x77, 0x03, 0x7d, 0x81, 0x2d, 0xeb, 0x33, 0xa0, 0xf4, 0xa1, 0x39, 0x45, 0xd8, 0x98,
-//         0xc2, 0x96,
-//     ]),
-//     FieldEl::new([
-//         0x4f, 0xe3, 0x42, 0xe2, 0xfe, 0x1a, 0x7f, 0x9b, 0x8e, 0xe7, 0xeb, 0x4a, 0x7c, 0x0f, 0x9e,
-//         0x16, 0x2b, 0xce, 0x33, 0x57, 0x6b, 0x31, 0x5e, 0xce, 0xcb, 0xb6, 0x40, 0x68, 0x37, 0xbf,
-//         0x51, 0xf5,
-//     ]),
-// );
-//
-// const N: FieldEl = FieldEl::new([
-//     0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
-//     0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51,
-// ]);
-//
-// struct Point(FieldEl, FieldEl);
-//
-// impl Point {
-//     const fn new(x: FieldEl, y: FieldEl) -> Point {
-//         Point(x, y)
-//     }
-//
-//     fn mult_scalar(&self, scalar: FieldEl) -> Point {
-//         todo!();
-//     }
-// }
-
-/// Represents a big integer less than `N`
-fn generate_signature(
-    msg: &[u8],
-    key: [u8; 32],
-    hash_func: fn(&[u8]) -> [u8; 32],
-) -> ([u8; 32], [u8; 32]) {
-    // let hash = hash_func(msg);
-    // let key = key;
-    //
-    // let mut r = FieldEl::from([0u8; 32]);
-    // let mut s = [0u8; 32];
-    //
-    // // this will eventually exit because `key`
-    // // is generated non-deterministically
-    // while r == [0u8; 32] || s == [0u8; 32] {
-    //     let scalar = generate_secret_number();
-    //     let inverse = inverse(scalar);
-    //
-    //     let new_point = G.mult_scalar(scalar);
-    //     r = new_point.0;
-    //     s = inverse * (hash + r * key);
-    // }
-    // (r, s)
-    todo!()
-}
-
-// fn generate_secret_number() -> FieldEl {
-//     todo!()
-// }
-//
-// fn inverse(num: FieldEl) -> FieldEl {
-//     todo!();
-// }
+//! ECDSA (the Elliptic Curve Digital Signature Algorithm) over secp256r1
+use crate::elliptic_curve::secp256r1::{FieldElement, Point, Scalar, ELEMENT_SIZE};
+
+/// An error that is returned when a signature does not match its message and public key
+#[derive(Debug)]
+pub struct BadSignature;
+
+impl core::fmt::Display for BadSignature {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "signature did not match message")
+    }
+}
+
+// TODO: impl `Error` trait once stabilized in core
+// impl core::error::Error for BadSignature {}
+
+/// An ECDSA signature, made up of two big-endian integers
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Signature {
+    /// The x-coordinate of a random point, modulo the order of the curve
+    pub r: [u8; ELEMENT_SIZE],
+    /// The proof that the signer knows the private key
+    pub s: [u8; ELEMENT_SIZE],
+}
+
+/// A signature to check with [`verify_many`]
+#[derive(Debug, Clone, Copy)]
+pub struct Verification<'a> {
+    /// The public key of the signer
+    pub public_key: &'a Point,
+    /// The hash of the signed message
+    pub hash: &'a [u8],
+    /// The signature of the message
+    pub signature: &'a Signature,
+}
+
+/// The number of signatures that [`verify_many`] shares one inversion between
+const BATCH_SIZE: usize = 16;
+
+/// Verifies that `signature` was made by `public_key` for the message whose hash is `hash`
+///
+/// If `hash` is longer than 256 bits, only its first 256 bits are used.
+///
+/// # Errors
+///
+/// This function will return an error if `signature` is not valid.
+pub fn verify(public_key: &Point, hash: &[u8], signature: &Signature) -> Result<(), BadSignature> {
+    let (r, s) = parse(signature)?;
+    check(public_key, hash, r, s.invert())
+}
+
+/// Verifies each of `verifications`, writing whether it was valid
+/// to the corresponding element of `results`
+///
+/// This is faster than verifying each one separately with [`verify`]: every signature needs
+/// an inversion modulo the order of the curve, which is done for many of them at once with
+/// Montgomery's trick.
+///
+/// # Panics
+///
+/// This function will panic if `verifications.len()` != `results.len()`
+pub fn verify_many(verifications: &[Verification<'_>], results: &mut [bool]) {
+    assert_eq!(verifications.len(), results.len());
+    for (verifications, results) in verifications
+        .chunks(BATCH_SIZE)
+        .zip(results.chunks_mut(BATCH_SIZE))
+    {
+        let mut parsed = [None; BATCH_SIZE];
+        // invalid signatures still have something to invert, so they don't spoil the batch
+        let mut s_values = [Scalar::ONE; BATCH_SIZE];
+        for (i, verification) in verifications.iter().enumerate() {
+            parsed[i] = parse(verification.signature).ok();
+            if let Some((_, s)) = parsed[i] {
+                s_values[i] = s;
+            }
+        }
+        let s_inverses = invert_batch(&s_values);
+
+        for (i, (verification, result)) in verifications.iter().zip(results).enumerate() {
+            *result = match parsed[i] {
+                Some((r, _)) => {
+                    check(verification.public_key, verification.hash, r, s_inverses[i]).is_ok()
+                },
+                None => false,
+            };
+        }
+    }
+}
+
+/// Decodes r and s from `signature`, checking that neither is zero
+/// or too large
+fn parse(signature: &Signature) -> Result<(Scalar, Scalar), BadSignature> {
+    let r = Scalar::from_be_bytes(&signature.r).map_err(|_| BadSignature)?;
+    let s = Scalar::from_be_bytes(&signature.s).map_err(|_| BadSignature)?;
+    if r.is_zero() || s.is_zero() {
+        return Err(BadSignature);
+    }
+    Ok((r, s))
+}
+
+/// Finishes verifying a signature, given r and the inverse of s
+fn check(public_key: &Point, hash: &[u8], r: Scalar, s_inv: Scalar) -> Result<(), BadSignature> {
+    if public_key.is_identity() {
+        return Err(BadSignature);
+    }
+    let u1 = hash_to_scalar(hash) * s_inv;
+    let u2 = r * s_inv;
+    let point = public_key.mul_base_and_scalar_vartime(&u1.to_be_bytes(), &u2.to_be_bytes());
+
+    // the x-coordinate of `point` is reduced modulo the order of the curve to give r,
+    // so it is either r or r + n, where n is the order
+    // we can safely unwrap because r is less than n, which is less than the field modulus
+    let x = FieldElement::from_be_bytes(&r.to_be_bytes()).unwrap();
+    if point.has_affine_x(x) {
+        return Ok(());
+    }
+    // we can safely unwrap because n is less than the field modulus
+    let order = FieldElement::try_from(Scalar::ORDER).unwrap();
+    // r + n must also be less than the field modulus
+    let fits = FieldElement::MODULUS - Scalar::ORDER > x.into();
+    match fits && point.has_affine_x(x + order) {
+        true => Ok(()),
+        false => Err(BadSignature),
+    }
+}
+
+/// Converts the leftmost 256 bits of `hash` into a scalar
+fn hash_to_scalar(hash: &[u8]) -> Scalar {
+    let mut bytes = [0; ELEMENT_SIZE];
+    let len = hash.len().min(ELEMENT_SIZE);
+    // a shorter hash is a smaller integer
+    bytes[ELEMENT_SIZE - len..].copy_from_slice(&hash[..len]);
+    Scalar::from_be_bytes_reduced(&bytes)
+}
+
+/// Inverts every element of `scalars`, using a single inversion
+///
+/// This is Montgomery's trick: the product of every scalar is inverted, and each inverse is
+/// that inverse times the product of every other scalar.
+fn invert_batch(scalars: &[Scalar; BATCH_SIZE]) -> [Scalar; BATCH_SIZE] {
+    // products[i] is the product of the first `i` scalars
+    let mut products = [Scalar::ONE; BATCH_SIZE];
+    for i in 1..BATCH_SIZE {
+        products[i] = products[i - 1] * scalars[i - 1];
+    }
+    // the inverse of the product of the first `i` + 1 scalars
+    let mut inverse = (products[BATCH_SIZE - 1] * scalars[BATCH_SIZE - 1]).invert();
+
+    let mut inverses = [Scalar::ZERO; BATCH_SIZE];
+    for i in (0..BATCH_SIZE).rev() {
+        inverses[i] = inverse * products[i];
+        inverse = inverse * scalars[i];
+    }
+    inverses
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{Signature, Verification};
+    use crate::elliptic_curve::secp256r1::Point;
+    use crate::sha2::sha256;
+
+    // the public key from RFC 6979, section A.2.5
+    const PUBLIC_KEY: [u8; 65] = [
+        0x04, 0x60, 0xfe, 0xd4, 0xba, 0x25, 0x5a, 0x9d, 0x31, 0xc9, 0x61, 0xeb, 0x74, 0xc6, 0x35,
+        0x6d, 0x68, 0xc0, 0x49, 0xb8, 0x92, 0x3b, 0x61, 0xfa, 0x6c, 0xe6, 0x69, 0x62, 0x2e, 0x60,
+        0xf2, 0x9f, 0xb6, 0x79, 0x03, 0xfe, 0x10, 0x08, 0xb8, 0xbc, 0x99, 0xa4, 0x1a, 0xe9, 0xe9,
+        0x56, 0x28, 0xbc, 0x64, 0xf2, 0xf1, 0xb2, 0x0c, 0x2d, 0x7e, 0x9f, 0x51, 0x77, 0xa3, 0xc2,
+        0x94, 0xd4, 0x46, 0x22, 0x99,
+    ];
+
+    // the signatures of "sample" and "test" with SHA-256, from RFC 6979, section A.2.5
+    const SAMPLE: Signature = Signature {
+        r: [
+            0xef, 0xd4, 0x8b, 0x2a, 0xac, 0xb6, 0xa8, 0xfd, 0x11, 0x40, 0xdd, 0x9c, 0xd4, 0x5e,
+            0x81, 0xd6, 0x9d, 0x2c, 0x87, 0x7b, 0x56, 0xaa, 0xf9, 0x91, 0xc3, 0x4d, 0x0e, 0xa8,
+            0x4e, 0xaf, 0x37, 0x16,
+        ],
+        s: [
+            0xf7, 0xcb, 0x1c, 0x94, 0x2d, 0x65, 0x7c, 0x41, 0xd4, 0x36, 0xc7, 0xa1, 0xb6, 0xe2,
+            0x9f, 0x65, 0xf3, 0xe9, 0x00, 0xdb, 0xb9, 0xaf, 0xf4, 0x06, 0x4d, 0xc4, 0xab, 0x2f,
+            0x84, 0x3a, 0xcd, 0xa8,
+        ],
+    };
+    const TEST: Signature = Signature {
+        r: [
+            0xf1, 0xab, 0xb0, 0x23, 0x51, 0x83, 0x51, 0xcd, 0x71, 0xd8, 0x81, 0x56, 0x7b, 0x1e,
+            0xa6, 0x63, 0xed, 0x3e, 0xfc, 0xf6, 0xc5, 0x13, 0x2b, 0x35, 0x4f, 0x28, 0xd3, 0xb0,
+            0xb7, 0xd3, 0x83, 0x67,
+        ],
+        s: [
+            0x01, 0x9f, 0x41, 0x13, 0x74, 0x2a, 0x2b, 0x14, 0xbd, 0x25, 0x92, 0x6b, 0x49, 0xc6,
+            0x49, 0x15, 0x5f, 0x26, 0x7e, 0x60, 0xd3, 0x81, 0x4b, 0x4c, 0x0c, 0xc8, 0x42, 0x50,
+            0xe4, 0x6f, 0x00, 0x83,
+        ],
+    };
+
+    #[test]
+    fn verify() {
+        let public_key = Point::from_uncompressed(&PUBLIC_KEY).unwrap();
+        let sample = sha256(b"sample");
+        let test = sha256(b"test");
+        assert!(super::verify(&public_key, &sample, &SAMPLE).is_ok());
+        assert!(super::verify(&public_key, &test, &TEST).is_ok());
+
+        assert!(super::verify(&public_key, &test, &SAMPLE).is_err());
+        assert!(super::verify(&Point::G, &sample, &SAMPLE).is_err());
+        assert!(super::verify(&Point::IDENTITY, &sample, &SAMPLE).is_err());
+        let mut bad_signature = SAMPLE;
+        bad_signature.s[31] ^= 1;
+        assert!(super::verify(&public_key, &sample, &bad_signature).is_err());
+        bad_signature.s = [0; 32];
+        assert!(super::verify(&public_key, &sample, &bad_signature).is_err());
+        bad_signature.s = [0xff; 32];
+        assert!(super::verify(&public_key, &sample, &bad_signature).is_err());
+
+        // only the first 256 bits of a longer hash are used
+        let mut long_hash = [0xaa; 48];
+        long_hash[..32].copy_from_slice(&sample);
+        assert!(super::verify(&public_key, &long_hash, &SAMPLE).is_ok());
+    }
+
+    #[test]
+    fn verify_many() {
+        let public_key = Point::from_uncompressed(&PUBLIC_KEY).unwrap();
+        let hashes = [sha256(b"sample"), sha256(b"test")];
+        let mut bad_signature = TEST;
+        bad_signature.r[0] ^= 0x80;
+        let signatures = [SAMPLE, TEST, bad_signature];
+
+        // long enough to need more than one batch
+        let cases: [(usize, usize); 37] =
+            core::array::from_fn(|i| (i % 2, [i % 2, 2, i % 2, 1 - i % 2][i % 4]));
+        let verifications = cases.map(|(hash, signature)| Verification {
+            public_key: &public_key,
+            hash: &hashes[hash],
+            signature: &signatures[signature],
+        });
+        let mut results = [false; 37];
+        super::verify_many(&verifications, &mut results);
+        for ((hash, signature), result) in cases.iter().zip(results) {
+            assert_eq!(result, hash == signature, "{hash} {signature}");
+        }
+    }
+}
@@ -0,0 +1,558 @@
+//! RSA signature verification, with PKCS #1 v1.5 and PSS padding (RFC 8017)
+//!
+//! Only verification is supported, so everything here is public and nothing needs to be secret.
+use crate::big_int::{montgomery::Modulus, BigInt};
+use crate::sha2::{Sha256, Sha512};
+
+/// An error that is returned when a public key is malformed or too weak
+#[derive(Debug)]
+pub struct InvalidKey;
+
+impl core::fmt::Display for InvalidKey {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "invalid RSA public key")
+    }
+}
+
+// TODO: impl `Error` trait once stabilized in core
+// impl core::error::Error for InvalidKey {}
+
+/// An error that is returned when a signature does not match its message and public key
+#[derive(Debug)]
+pub struct BadSignature;
+
+impl core::fmt::Display for BadSignature {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "signature did not match message")
+    }
+}
+
+// TODO: impl `Error` trait once stabilized in core
+// impl core::error::Error for BadSignature {}
+
+/// The hash function a message was hashed with before it was signed
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum HashFunction {
+    /// SHA-256
+    Sha256,
+    /// SHA-512
+    Sha512,
+}
+
+impl HashFunction {
+    /// Returns the length of a hash, in bytes
+    pub const fn hash_len(self) -> usize {
+        match self {
+            Self::Sha256 => 32,
+            Self::Sha512 => 64,
+        }
+    }
+
+    /// Returns the DER encoding of the `DigestInfo` that a PKCS #1 v1.5 signature puts
+    /// before the hash, up to the hash itself (RFC 8017, section 9.2)
+    const fn digest_info(self) -> &'static [u8] {
+        match self {
+            Self::Sha256 => &[
+                0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02,
+                0x01, 0x05, 0x00, 0x04, 0x20,
+            ],
+            Self::Sha512 => &[
+                0x30, 0x51, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02,
+                0x03, 0x05, 0x00, 0x04, 0x40,
+            ],
+        }
+    }
+
+    /// Writes the hash of the concatenation of `parts` to the start of `hash`
+    fn hash(self, parts: &[&[u8]], hash: &mut [u8]) {
+        match self {
+            Self::Sha256 => {
+                let mut hasher = Sha256::new();
+                parts.iter().for_each(|part| hasher.update(part));
+                hash[..self.hash_len()].copy_from_slice(&hasher.finalize());
+            },
+            Self::Sha512 => {
+                let mut hasher = Sha512::new();
+                parts.iter().for_each(|part| hasher.update(part));
+                hash[..self.hash_len()].copy_from_slice(&hasher.finalize());
+            },
+        }
+    }
+}
+
+/// The smallest modulus accepted, in bits
+pub const MIN_MODULUS_BITS: u32 = 2048;
+
+/// An RSA public key whose modulus fits in `N` 64-bit limbs
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct PublicKey<const N: usize> {
+    modulus: Modulus<N>,
+    exponent: u64,
+    /// The length of the modulus, and so of every signature, in bytes
+    len: usize,
+}
+
+/// A public key with a modulus of up to 2048 bits
+pub type PublicKey2048 = PublicKey<32>;
+
+/// A public key with a modulus of up to 4096 bits
+pub type PublicKey4096 = PublicKey<64>;
+
+impl<const N: usize> PublicKey<N> {
+    /// Constructs a public key from its big-endian modulus and public exponent
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if the modulus is even, shorter than
+    /// [`MIN_MODULUS_BITS`], or longer than `N` limbs, or if the exponent is even, one,
+    /// or longer than 64 bits.
+    pub fn new(modulus: &[u8], exponent: &[u8]) -> Result<Self, InvalidKey> {
+        let modulus = strip_leading_zeros(modulus);
+        let exponent = strip_leading_zeros(exponent);
+        if modulus.len() > N * 8 || exponent.len() > 8 {
+            return Err(InvalidKey);
+        }
+        let modulus = Modulus::new(from_be_bytes(modulus)).ok_or(InvalidKey)?;
+        let mut exponent_bytes = [0; 8];
+        exponent_bytes[8 - exponent.len()..].copy_from_slice(exponent);
+        let exponent = u64::from_be_bytes(exponent_bytes);
+        if modulus.bits() < MIN_MODULUS_BITS || exponent & 1 == 0 || exponent == 1 {
+            return Err(InvalidKey);
+        }
+        Ok(Self {
+            len: modulus.bits().div_ceil(8) as usize,
+            modulus,
+            exponent,
+        })
+    }
+
+    /// Verifies a PKCS #1 v1.5 `signature` of the message whose hash is `hash`
+    /// (RFC 8017, section 8.2.2)
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if `signature` is not valid,
+    /// or if `hash` is not as long as a hash from `hash_function`.
+    pub fn verify_pkcs1v15(
+        &self,
+        hash_function: HashFunction,
+        hash: &[u8],
+        signature: &[u8],
+    ) -> Result<(), BadSignature> {
+        let digest_info = hash_function.digest_info();
+        // there must be at least 8 bytes of padding
+        if hash.len() != hash_function.hash_len() || self.len < digest_info.len() + hash.len() + 11
+        {
+            return Err(BadSignature);
+        }
+        let mut encoded = self.recover(signature)?;
+        let encoded = self.encoded(&mut encoded);
+
+        // rather than parsing the encoded message, build the one expected and compare them
+        let mut expected = [[0; 8]; N];
+        let expected = self.encoded(&mut expected);
+        let (padding, digest) = expected.split_at_mut(self.len - digest_info.len() - hash.len());
+        padding[1] = 0x01;
+        let padding_len = padding.len();
+        padding[2..padding_len - 1].fill(0xff);
+        digest[..digest_info.len()].copy_from_slice(digest_info);
+        digest[digest_info.len()..].copy_from_slice(hash);
+
+        match encoded == expected {
+            true => Ok(()),
+            false => Err(BadSignature),
+        }
+    }
+
+    /// Verifies a PSS `signature` of the message whose hash is `hash`
+    /// (RFC 8017, section 8.1.2)
+    ///
+    /// Both the message and the mask generation function (MGF1) use `hash_function`,
+    /// and the salt must be as long as a hash, as TLS 1.3 requires (RFC 8446, section 4.2.3).
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if `signature` is not valid,
+    /// or if `hash` is not as long as a hash from `hash_function`.
+    pub fn verify_pss(
+        &self,
+        hash_function: HashFunction,
+        hash: &[u8],
+        signature: &[u8],
+    ) -> Result<(), BadSignature> {
+        let hash_len = hash_function.hash_len();
+        let salt_len = hash_len;
+        // the encoded message has one bit less than the modulus
+        let bits = self.modulus.bits() - 1;
+        let len = bits.div_ceil(8) as usize;
+        if hash.len() != hash_len || len < hash_len + salt_len + 2 {
+            return Err(BadSignature);
+        }
+        let mut encoded = self.recover(signature)?;
+        let encoded = self.encoded(&mut encoded);
+        let (leading_zero, encoded) = encoded.split_at_mut(self.len - len);
+        let unused_bits = 8 * len as u32 - bits;
+        if leading_zero.iter().any(|&byte| byte != 0)
+            || encoded[0] & !(0xff >> unused_bits) != 0
+            || encoded[len - 1] != 0xbc
+        {
+            return Err(BadSignature);
+        }
+
+        let (db, rest) = encoded.split_at_mut(len - hash_len - 1);
+        let expected_hash = &rest[..hash_len];
+        mgf1_xor(hash_function, expected_hash, db);
+        db[0] &= 0xff >> unused_bits;
+        let (padding, salt) = db.split_at(db.len() - salt_len);
+        let (zeros, one) = padding.split_at(padding.len() - 1);
+        if zeros.iter().any(|&byte| byte != 0) || one[0] != 0x01 {
+            return Err(BadSignature);
+        }
+
+        let mut actual_hash = [0; 64];
+        hash_function.hash(&[&[0; 8], hash, salt], &mut actual_hash);
+        match actual_hash[..hash_len] == *expected_hash {
+            true => Ok(()),
+            false => Err(BadSignature),
+        }
+    }
+
+    /// Returns `signature`^e modulo n, which is the encoded message,
+    /// as `N` big-endian limbs of big-endian bytes
+    fn recover(&self, signature: &[u8]) -> Result<[[u8; 8]; N], BadSignature> {
+        if signature.len() != self.len {
+            return Err(BadSignature);
+        }
+        let signature = from_be_bytes(signature);
+        if signature >= self.modulus.get() {
+            return Err(BadSignature);
+        }
+        let message = match self.exponent {
+            65537 => self.modulus.pow_65537(&signature),
+            exponent => self.modulus.pow(&signature, &exponent.to_be_bytes()),
+        };
+        Ok(<[u64; N]>::from(message).map(u64::to_be_bytes))
+    }
+
+    /// Returns the last `self.len` bytes of `limbs`, which is the length of an encoded message
+    fn encoded<'a>(&self, limbs: &'a mut [[u8; 8]; N]) -> &'a mut [u8] {
+        let bytes = limbs.as_flattened_mut();
+        let start = bytes.len() - self.len;
+        &mut bytes[start..]
+    }
+}
+
+/// XORs `data` with the mask generated from `seed` by MGF1 (RFC 8017, appendix B.2.1)
+fn mgf1_xor(hash_function: HashFunction, seed: &[u8], data: &mut [u8]) {
+    let mut mask = [0; 64];
+    for (counter, chunk) in (0u32..).zip(data.chunks_mut(hash_function.hash_len())) {
+        hash_function.hash(&[seed, &counter.to_be_bytes()], &mut mask);
+        for (byte, mask) in chunk.iter_mut().zip(mask) {
+            *byte ^= mask;
+        }
+    }
+}
+
+/// Returns `bytes` without its leading zero bytes
+fn strip_leading_zeros(bytes: &[u8]) -> &[u8] {
+    let start = bytes
+        .iter()
+        .position(|&byte| byte != 0)
+        .unwrap_or(bytes.len());
+    &bytes[start..]
+}
+
+/// Converts big-endian `bytes`, which must be at most `N` limbs long, to a [`BigInt`]
+fn from_be_bytes<const N: usize>(bytes: &[u8]) -> BigInt<N> {
+    let mut limbs = [[0; 8]; N];
+    let padded = limbs.as_flattened_mut();
+    let start = padded.len() - bytes.len();
+    padded[start..].copy_from_slice(bytes);
+    BigInt::new(limbs.map(u64::from_be_bytes))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{HashFunction, PublicKey, PublicKey2048, PublicKey4096};
+    use crate::sha2::{sha256, sha512};
+
+    const MESSAGE: &[u8] = b"turtls test message";
+
+    // keys and signatures generated with OpenSSL, with a public exponent of 65537
+    const MODULUS_2048: [u8; 256] = [
+        0xac, 0x08, 0x67, 0x48, 0x9f, 0x2d, 0x50, 0x4f, 0xa1, 0xb6, 0x80, 0xad, 0xe9, 0xd7, 0x19,
+        0x15, 0x77, 0xfe, 0x71, 0x72, 0xdb, 0xe1, 0xe3, 0x8b, 0x3c, 0xe3, 0x85, 0x6a, 0x19, 0xdb,
+        0xe9, 0x72, 0xc7, 0x83, 0x07, 0x4f, 0xca, 0xd9, 0xa5, 0x8e, 0x9c, 0x8f, 0x5f, 0x79, 0x48,
+        0xd6, 0xe1, 0x3b, 0x0a, 0x72, 0x77, 0xeb, 0x7c, 0x18, 0xc8, 0xf5, 0x5e, 0x0e, 0x56, 0xcc,
+        0x4b, 0x14, 0xc7, 0xfe, 0xf7, 0x0f, 0xfd, 0xd5, 0x7a, 0x3a, 0xfa, 0xfe, 0x19, 0x1c, 0x9f,
+        0x8f, 0x96, 0xe6, 0x40, 0x8b, 0xed, 0x46, 0xf3, 0xe7, 0xcb, 0x8c, 0x6b, 0xe8, 0x08, 0xfd,
+        0x50, 0xb6, 0x49, 0x57, 0xcb, 0x5a, 0x3b, 0xb1, 0xbf, 0x6e, 0xac, 0xa0, 0x91, 0x2c, 0xdf,
+        0x30, 0xe7, 0xfd, 0x06, 0x6a, 0x3c, 0xf8, 0x80, 0x2f, 0xaf, 0xc7, 0xff, 0xc0, 0xdf, 0x09,
+        0x93, 0x67, 0x64, 0x97, 0x32, 0x51, 0x36, 0xa4, 0x07, 0xad, 0xf5, 0xf9, 0x26, 0x56, 0x90,
+        0x67, 0xa2, 0xa9, 0xdb, 0xc4, 0x9e, 0x94, 0x1e, 0x9b, 0x21, 0x51, 0xef, 0xb4, 0x3d, 0xf1,
+        0x47, 0x81, 0x9b, 0xc8, 0x29, 0x98, 0x0c, 0x51, 0x48, 0x1b, 0xe6, 0x4b, 0xb0, 0x0f, 0x6d,
+        0x94, 0x4e, 0x0c, 0x6f, 0xa5, 0x38, 0x24, 0x3e, 0xa2, 0x79, 0x19, 0xfd, 0xbf, 0x94, 0xcb,
+        0x3b, 0xeb, 0x72, 0x39, 0xa8, 0xac, 0x88, 0xc9, 0x41, 0x2e, 0xbb, 0x66, 0x76, 0xfe, 0xbf,
+        0x67, 0xe5, 0xb5, 0x9d, 0xc7, 0xc8, 0x45, 0xa8, 0x8d, 0x46, 0xc0, 0x57, 0x2a, 0xd9, 0x6d,
+        0x6c, 0xb5, 0xaa, 0x08, 0x38, 0x8c, 0x60, 0x62, 0x64, 0x58, 0x9a, 0x91, 0xe1, 0x9b, 0x4f,
+        0xcc, 0xec, 0x54, 0x06, 0xaa, 0xa0, 0x52, 0x69, 0x56, 0x87, 0x81, 0x12, 0xe7, 0x2d, 0x82,
+        0xeb, 0x8f, 0x7b, 0x18, 0x9f, 0xa2, 0x8b, 0xde, 0xea, 0x11, 0x28, 0x65, 0xec, 0xce, 0x8b,
+        0x8b,
+    ];
+    // signatures of `MESSAGE` with SHA-256
+    const PKCS1V15_2048: [u8; 256] = [
+        0x51, 0x7b, 0x68, 0x4a, 0x54, 0xa6, 0xf4, 0x5b, 0x85, 0x65, 0x4e, 0xc2, 0xae, 0xec, 0xf2,
+        0x9e, 0xda, 0x4e, 0x2e, 0x8b, 0x3a, 0x2b, 0x10, 0x1b, 0x76, 0x2b, 0xd2, 0xbb, 0xe1, 0x84,
+        0xd8, 0xc9, 0x77, 0x78, 0x3e, 0x2d, 0x4c, 0xad, 0xdf, 0xeb, 0x8f, 0x8b, 0x7c, 0xd3, 0xa3,
+        0xf2, 0xc5, 0xc3, 0xfb, 0x3d, 0xd3, 0x38, 0xd3, 0xbc, 0xaf, 0x25, 0xcd, 0xdc, 0x49, 0xb1,
+        0x9c, 0x9a, 0x71, 0x43, 0xd1, 0xd9, 0xed, 0x0d, 0x49, 0xbc, 0x29, 0x26, 0x9a, 0xb9, 0xd3,
+        0x47, 0x69, 0x9b, 0x70, 0x93, 0x47, 0x04, 0x5c, 0x05, 0x29, 0x49, 0x4e, 0xfc, 0x42, 0x0c,
+        0x92, 0xb5, 0x98, 0xc8, 0x13, 0xce, 0x3c, 0xd1, 0x96, 0x61, 0x69, 0x60, 0x0b, 0xdf, 0xb0,
+        0xcf, 0xe2, 0x71, 0x0e, 0x3b, 0x8d, 0xcf, 0xc1, 0x93, 0xa3, 0x31, 0x3e, 0xea, 0xc5, 0x23,
+        0x27, 0x6b, 0xb8, 0xee, 0x4b, 0xe8, 0xce, 0x3e, 0x64, 0x35, 0x3b, 0x90, 0xda, 0xa6, 0xc1,
+        0x49, 0x8c, 0x53, 0x7a, 0xcd, 0xbf, 0x26, 0xb7, 0xcd, 0x50, 0xba, 0x42, 0xcc, 0xca, 0x14,
+        0x66, 0x38, 0xad, 0xdc, 0x0d, 0xe1, 0x6c, 0x99, 0x9b, 0x71, 0xe9, 0x44, 0xa2, 0x40, 0x12,
+        0x84, 0x86, 0xa4, 0x83, 0x6f, 0x19, 0x2e, 0x08, 0xe8, 0x1e, 0x58, 0x9c, 0xa6, 0xb3, 0x14,
+        0x64, 0x60, 0xb8, 0x35, 0x7a, 0x0f, 0xc9, 0xa7, 0x94, 0x35, 0xaa, 0x37, 0x91, 0xce, 0x9d,
+        0x13, 0x56, 0x6a, 0x05, 0xc5, 0x54, 0xe9, 0x8e, 0x62, 0x21, 0xfd, 0xf5, 0x78, 0x28, 0x6f,
+        0x73, 0xf0, 0x0a, 0x55, 0x12, 0x32, 0xb6, 0xce, 0xd2, 0xb1, 0xe2, 0xe4, 0xe7, 0x41, 0x12,
+        0xd7, 0x14, 0xf0, 0x1d, 0xc9, 0x88, 0x1e, 0xa6, 0xab, 0x36, 0xb5, 0xbb, 0x0b, 0x3b, 0x4e,
+        0xb1, 0xde, 0xea, 0x1f, 0xd6, 0xfe, 0x45, 0x0f, 0x85, 0x78, 0x71, 0xdb, 0x14, 0x57, 0xfc,
+        0x34,
+    ];
+    const PSS_2048: [u8; 256] = [
+        0x1c, 0x6f, 0x59, 0x83, 0xcc, 0x21, 0x30, 0x6b, 0xd5, 0x65, 0x91, 0x39, 0xc7, 0x06, 0xd8,
+        0x1a, 0x62, 0xfd, 0x76, 0x65, 0x5e, 0xd2, 0x37, 0x2a, 0x3b, 0x81, 0x62, 0x75, 0x29, 0xc4,
+        0x3d, 0x77, 0x25, 0xf3, 0xa4, 0x68, 0xfc, 0xf5, 0x7c, 0x54, 0xbe, 0x66, 0xa3, 0x2e, 0x01,
+        0xfa, 0x71, 0x33, 0x0b, 0xe2, 0x7b, 0xea, 0xaa, 0x26, 0x84, 0x1d, 0xea, 0xf8, 0x60, 0xe6,
+        0x61, 0x9a, 0xae, 0x9d, 0x6a, 0xa1, 0x4c, 0x87, 0x2f, 0x9a, 0xb1, 0x9a, 0xfa, 0x6d, 0xbb,
+        0x8f, 0x84, 0x53, 0xf4, 0x15, 0xc9, 0x6b, 0xfa, 0x57, 0xfb, 0xad, 0xec, 0x64, 0x0a, 0x7b,
+        0x1f, 0xa5, 0xf7, 0x82, 0x7d, 0x1a, 0x3b, 0x53, 0xb6, 0x2e, 0x08, 0x95, 0xde, 0x69, 0x77,
+        0x71, 0x16, 0x44, 0x15, 0x9b, 0x5e, 0x85, 0xce, 0xed, 0x5e, 0xf9, 0x59, 0x1f, 0x1f, 0x81,
+        0x98, 0x56, 0x9f, 0x6e, 0xd3, 0xd7, 0x2e, 0x48, 0x1d, 0x73, 0xba, 0x5d, 0x28, 0xf3, 0x11,
+        0x19, 0x15, 0xc4, 0xea, 0x10, 0x13, 0x13, 0x8c, 0x6c, 0x79, 0x96, 0x4d, 0xe7, 0x35, 0x8d,
+        0xc0, 0x59, 0x5a, 0x4d, 0xcc, 0xd8, 0xc1, 0x7e, 0xbf, 0x10, 0xef, 0x43, 0xf0, 0x44, 0xcb,
+        0xaf, 0xf1, 0x93, 0x9e, 0x2f, 0x27, 0xd1, 0x46, 0x75, 0xbc, 0x77, 0x22, 0x37, 0x29, 0x3c,
+        0xac, 0xf8, 0x43, 0x57, 0x64, 0x96, 0x04, 0xe9, 0xb1, 0xc7, 0xc1, 0x9a, 0xcc, 0x91, 0xe5,
+        0xda, 0xaf, 0xd0, 0x4c, 0x10, 0x20, 0xa8, 0xf8, 0xa2, 0x11, 0x5a, 0x67, 0x57, 0x6d, 0xcc,
+        0xb2, 0xa9, 0x6f, 0x58, 0x65, 0x7a, 0xa6, 0xe5, 0x54, 0xc0, 0x4c, 0xb5, 0x3f, 0xd4, 0x56,
+        0xdc, 0xec, 0x91, 0xfe, 0x66, 0xa9, 0x60, 0xf2, 0xb1, 0x8c, 0xc6, 0x79, 0x03, 0x0b, 0x90,
+        0x37, 0x32, 0xab, 0x58, 0x3e, 0x19, 0x6e, 0xa6, 0x74, 0x4f, 0x30, 0x42, 0x8d, 0x7f, 0xb6,
+        0x4e,
+    ];
+    const MODULUS_4096: [u8; 512] = [
+        0xe5, 0x00, 0x8b, 0xba, 0xe8, 0x54, 0xda, 0x16, 0x25, 0xdb, 0xde, 0xfb, 0x4d, 0x8f, 0x3d,
+        0xcd, 0x95, 0x32, 0xc9, 0x80, 0x7f, 0xea, 0x2e, 0x23, 0x02, 0x2c, 0x9c, 0x99, 0xd0, 0x7a,
+        0x29, 0xe7, 0x44, 0x5b, 0x30, 0x80, 0xa9, 0xe9, 0x38, 0x8f, 0x70, 0xbf, 0x45, 0x9c, 0x18,
+        0xa1, 0x93, 0xc4, 0x92, 0xb5, 0xef, 0xd5, 0x5d, 0x24, 0xdb, 0xd6, 0x07, 0x76, 0x34, 0x0d,
+        0xe0, 0x3d, 0x32, 0xbd, 0x86, 0x6d, 0xb7, 0xd5, 0xc8, 0x57, 0x3b, 0x6d, 0x30, 0x73, 0x8b,
+        0xdc, 0xdd, 0xbc, 0x9d, 0xf2, 0xc1, 0xc7, 0xa8, 0x33, 0xd6, 0xe4, 0x81, 0xb9, 0xf2, 0xe1,
+        0x1e, 0x07, 0x89, 0xfe, 0xd1, 0xe6, 0x80, 0x6d, 0x9a, 0x9a, 0x44, 0xe8, 0xc5, 0x8b, 0x69,
+        0x1c, 0xc4, 0x31, 0x71, 0x29, 0xe6, 0x6f, 0xee, 0x0e, 0x6d, 0x6d, 0xb2, 0x62, 0x57, 0xed,
+        0x90, 0xb0, 0x17, 0xca, 0x90, 0x7b, 0x29, 0x6b, 0x6b, 0x0a, 0x3a, 0x7a, 0x3d, 0x9a, 0xe9,
+        0x3c, 0x41, 0x2f, 0xf8, 0x3a, 0x66, 0xfa, 0x3a, 0x32, 0x31, 0x69, 0x1c, 0xa0, 0x63, 0x50,
+        0x67, 0xb6, 0xe2, 0x8e, 0xd1, 0x68, 0xe2, 0x13, 0x97, 0x2c, 0x6f, 0x4d, 0x42, 0xe0, 0xdf,
+        0xbe, 0xda, 0x74, 0x05, 0xe0, 0x91, 0xb1, 0x58, 0x10, 0xc6, 0xcb, 0x61, 0xce, 0x92, 0xff,
+        0xb1, 0xb9, 0x10, 0x30, 0x15, 0xfe, 0xb1, 0x12, 0x17, 0x33, 0xf2, 0x0f, 0x07, 0xd0, 0x9b,
+        0x82, 0xc8, 0x1a, 0x0f, 0x59, 0xe2, 0xeb, 0x41, 0x9f, 0xb3, 0x5b, 0x0d, 0x06, 0x43, 0xf1,
+        0xda, 0x2b, 0x58, 0xef, 0x63, 0x0f, 0xcc, 0x50, 0x1f, 0xa5, 0x7d, 0x74, 0x34, 0x3f, 0x43,
+        0xd2, 0x1f, 0xe6, 0x73, 0x14, 0x2a, 0xbf, 0xec, 0x1c, 0x3a, 0x2b, 0x57, 0xfc, 0xe3, 0xb1,
+        0x17, 0x41, 0x2e, 0x4c, 0x3c, 0xbb, 0x08, 0x20, 0xa0, 0x71, 0xf7, 0xce, 0xcd, 0xbb, 0xf1,
+        0xfd, 0xf6, 0xce, 0x3a, 0x58, 0xa3, 0x23, 0xf3, 0x99, 0xd3, 0xd3, 0xe3, 0x48, 0x56, 0xa3,
+        0x0e, 0xee, 0xc9, 0x50, 0x6c, 0x37, 0x93, 0x11, 0xd9, 0xd3, 0xde, 0x73, 0x0a, 0x96, 0x49,
+        0xb8, 0x31, 0x1d, 0x21, 0x9b, 0xd7, 0x0b, 0x71, 0x67, 0xfa, 0x85, 0x17, 0x9d, 0xd2, 0x65,
+        0x26, 0xb3, 0x5f, 0x8a, 0x29, 0x81, 0xf9, 0xd7, 0x9e, 0x70, 0xef, 0x9f, 0xc8, 0xab, 0x63,
+        0x5a, 0x0a, 0xea, 0x11, 0x8c, 0xfb, 0x51, 0x00, 0x6a, 0x8a, 0xf5, 0xcb, 0xc1, 0xa6, 0xd7,
+        0x96, 0x2f, 0xcc, 0x70, 0x92, 0xb3, 0x54, 0x61, 0xe1, 0xd8, 0x15, 0x11, 0x9c, 0xf9, 0x73,
+        0x28, 0x21, 0xda, 0x7e, 0xf6, 0xdb, 0xed, 0xf4, 0x19, 0x10, 0x52, 0xdf, 0x7f, 0x5e, 0xb5,
+        0xac, 0x54, 0x05, 0x21, 0xc7, 0x91, 0xd5, 0x7e, 0xaa, 0x78, 0x6f, 0x98, 0xa3, 0x22, 0x52,
+        0xfe, 0x45, 0x1e, 0xa4, 0xef, 0x54, 0x36, 0x69, 0x8e, 0x99, 0x24, 0xba, 0x75, 0xd2, 0x70,
+        0x67, 0xad, 0x73, 0x33, 0xca, 0x87, 0x5a, 0x4d, 0x54, 0xd2, 0x01, 0xba, 0xac, 0xa4, 0x2c,
+        0x2f, 0x88, 0x70, 0xe3, 0xe3, 0x0d, 0x3a, 0x4a, 0xe5, 0x5f, 0x62, 0x7d, 0x1c, 0x80, 0x35,
+        0xb8, 0x31, 0xe8, 0x1c, 0xff, 0xf5, 0x6a, 0xff, 0x14, 0xe4, 0xec, 0xce, 0xdf, 0x52, 0xb8,
+        0x41, 0x98, 0xc0, 0x32, 0x15, 0x5b, 0x11, 0x1c, 0xa3, 0xea, 0x91, 0xfa, 0xc5, 0x73, 0x97,
+        0xf1, 0x37, 0x58, 0x16, 0x14, 0x41, 0xe9, 0x60, 0x95, 0x87, 0x30, 0x94, 0x46, 0xe5, 0xe2,
+        0xa6, 0x65, 0x31, 0xf5, 0xe1, 0xd2, 0xfd, 0xa8, 0x6e, 0x2c, 0xd8, 0x3a, 0x6c, 0x01, 0x64,
+        0xbc, 0x92, 0xf3, 0xb1, 0xee, 0xa7, 0x01, 0x93, 0x64, 0xd5, 0xf2, 0x01, 0x3b, 0x1d, 0x8c,
+        0x31, 0xfa, 0xa6, 0xb6, 0x8d, 0xd1, 0x53, 0x86, 0x24, 0xa0, 0xe3, 0xf2, 0xce, 0xae, 0x11,
+        0x51, 0xfb,
+    ];
+    // signature of `MESSAGE` with SHA-512
+    const PSS_4096: [u8; 512] = [
+        0x08, 0x40, 0x2f, 0x7b, 0x20, 0xaf, 0x89, 0xbc, 0x98, 0xdc, 0xb3, 0x9e, 0x4b, 0x5c, 0xd0,
+        0x2d, 0xd5, 0x4c, 0x78, 0xb9, 0xad, 0x17, 0x09, 0xdc, 0x4f, 0xf6, 0xed, 0x0a, 0x31, 0xbe,
+        0x86, 0x97, 0x67, 0x8c, 0x3e, 0x26, 0x0f, 0xc4, 0x0a, 0x63, 0x5d, 0xe6, 0xef, 0x8c, 0x9d,
+        0x3f, 0xb5, 0x83, 0xbb, 0xee, 0xde, 0x49, 0xc2, 0xd6, 0x08, 0x9e, 0xcc, 0xf3, 0xc2, 0x3c,
+        0x4a, 0xb6, 0x24, 0x0f, 0xf7, 0x7f, 0x1b, 0xc1, 0x1e, 0x26, 0xde, 0x41, 0x00, 0xc5, 0x87,
+        0x09, 0x38, 0x0c, 0x4a, 0x49, 0xdd, 0x19, 0x44, 0x98, 0xd4, 0x62, 0xb4, 0x3f, 0x93, 0x8c,
+        0x25, 0x1a, 0x04, 0x7d, 0xe0, 0x3c, 0x9d, 0x5b, 0x13, 0x5e, 0x28, 0xef, 0x17, 0xbb, 0xdd,
+        0xa1, 0x5d, 0xc2, 0x22, 0x91, 0x47, 0xf7, 0x8d, 0xf9, 0xec, 0x32, 0x73, 0x1b, 0x8c, 0x41,
+        0xaf, 0x67, 0x25, 0xfa, 0xe7, 0x8d, 0x91, 0x92, 0x76, 0x4d, 0xda, 0x7a, 0x6e, 0xc2, 0x74,
+        0xe3, 0x09, 0xef, 0xd0, 0xa6, 0x4b, 0x5d, 0x29, 0xe5, 0x12, 0x8b, 0x85, 0x4d, 0xf6, 0x40,
+        0x12, 0x5a, 0xaa, 0x2f, 0x33, 0x83, 0x9b, 0xfa, 0x90, 0x60, 0x10, 0x7d, 0xd1, 0xe2, 0xe7,
+        0xf4, 0x51, 0xbc, 0xfc, 0x6f, 0xea, 0x6e, 0xcd, 0xec, 0x59, 0x23, 0x75, 0xf7, 0x49, 0x3c,
+        0x09, 0x9b, 0xdd, 0xdb, 0xd2, 0x77, 0x39, 0x6e, 0x7c, 0xdc, 0xbe, 0x4d, 0x39, 0x79, 0x03,
+        0xc5, 0xd6, 0x5d, 0xe6, 0x16, 0x70, 0x00, 0xf6, 0x8e, 0xa0, 0x6b, 0xa8, 0xf9, 0x0b, 0x7e,
+        0xda, 0xe1, 0x27, 0x4f, 0x0b, 0x6e, 0x2e, 0x95, 0x14, 0x86, 0x98, 0xc8, 0xcb, 0x00, 0x9d,
+        0x11, 0x47, 0xe3, 0xa9, 0x29, 0x1e, 0x16, 0xab, 0x8f, 0x12, 0xfd, 0x50, 0xc2, 0x48, 0x9b,
+        0xe5, 0xd1, 0x79, 0xe1, 0xde, 0x7b, 0xaa, 0xf6, 0x15, 0x3b, 0x12, 0x6f, 0x81, 0xaf, 0xc9,
+        0x55, 0xd0, 0x6b, 0xba, 0x90, 0x86, 0x49, 0x83, 0x51, 0xa9, 0x05, 0x14, 0x99, 0xee, 0x3f,
+        0xac, 0x4b, 0x89, 0x2e, 0x9b, 0x05, 0x7c, 0xac, 0xad, 0x4d, 0x69, 0x3c, 0x92, 0xb8, 0xb3,
+        0x3d, 0x0b, 0x95, 0x3f, 0x61, 0x21, 0x55, 0xa9, 0x66, 0x31, 0x6e, 0x60, 0x7e, 0x32, 0x73,
+        0x68, 0x18, 0xc7, 0x3f, 0xfb, 0x05, 0xe8, 0x1b, 0x48, 0x73, 0x53, 0xd1, 0xe8, 0x8c, 0xfc,
+        0x83, 0x9b, 0x12, 0x1a, 0x05, 0xa6, 0x5e, 0x76, 0x3c, 0x23, 0x17, 0x6f, 0x70, 0x78, 0x5c,
+        0x02, 0x71, 0xf6, 0xf8, 0xbb, 0x1f, 0xb2, 0x4b, 0x5a, 0xbd, 0x21, 0x8a, 0x34, 0xcd, 0x43,
+        0x70, 0x59, 0x17, 0x19, 0x11, 0x8d, 0xf9, 0x39, 0x8b, 0xdb, 0x81, 0x4c, 0xf8, 0xcc, 0x23,
+        0xa9, 0x15, 0x6c, 0x7d, 0xfa, 0x57, 0xe3, 0xcd, 0xd7, 0x84, 0x96, 0x28, 0x7a, 0xc1, 0xf5,
+        0xbd, 0x46, 0xb0, 0xbe, 0x93, 0x02, 0xfb, 0x2b, 0x9f, 0xe2, 0xc9, 0xc4, 0x92, 0xed, 0x46,
+        0xb0, 0xae, 0x93, 0x51, 0x69, 0x7d, 0xdd, 0x71, 0x3c, 0x39, 0xab, 0xc1, 0x82, 0xcb, 0x0f,
+        0xf1, 0xa6, 0xbb, 0x74, 0x38, 0x77, 0x18, 0xeb, 0x91, 0x50, 0xdf, 0xa4, 0x59, 0x14, 0x44,
+        0xcb, 0xe5, 0x22, 0xe2, 0x0b, 0xbc, 0x16, 0xe1, 0x04, 0x07, 0xb9, 0x06, 0xd6, 0xbb, 0xa3,
+        0x06, 0x94, 0x5d, 0xad, 0x01, 0xcf, 0xb6, 0x72, 0x2d, 0x1b, 0xa2, 0x8f, 0x40, 0x9f, 0x0b,
+        0xfa, 0x15, 0xb4, 0x60, 0x16, 0x7c, 0x97, 0xfd, 0x33, 0xc0, 0x26, 0x5a, 0xc9, 0x44, 0x7c,
+        0x1f, 0xdb, 0xe4, 0x1b, 0xc2, 0xd3, 0x61, 0xce, 0xfe, 0xc3, 0xc4, 0x86, 0x41, 0x56, 0x77,
+        0xf3, 0x24, 0x68, 0xd1, 0xbc, 0xb6, 0xb8, 0x9c, 0xd2, 0x82, 0x50, 0x6e, 0x3d, 0x11, 0x99,
+        0x4f, 0x10, 0xb5, 0xe3, 0x47, 0x0e, 0x0f, 0x73, 0x2f, 0x9a, 0x07, 0x36, 0x65, 0xca, 0xe3,
+        0xb4, 0x2a,
+    ];
+    // a key with a public exponent of 3
+    const MODULUS_E3: [u8; 256] = [
+        0xe2, 0x71, 0x31, 0x32, 0xec, 0xf8, 0xf2, 0x6d, 0xef, 0x2c, 0x28, 0x52, 0x85, 0xe6, 0x00,
+        0x00, 0x2f, 0x8b, 0xcc, 0x0f, 0x7b, 0xda, 0x01, 0xe1, 0x15, 0x81, 0x97, 0xb0, 0xdd, 0xc2,
+        0xd2, 0x1a, 0xe7, 0x4e, 0xde, 0x83, 0xb5, 0xc4, 0x2b, 0x5b, 0x98, 0x2b, 0x32, 0x40, 0x34,
+        0x7b, 0x47, 0xe0, 0xf9, 0x7c, 0xe2, 0x27, 0x96, 0xef, 0xb9, 0x14, 0xb3, 0x1e, 0xdd, 0xb4,
+        0xc7, 0x90, 0x0b, 0x08, 0xb1, 0xac, 0xab, 0x6b, 0xbb, 0x69, 0xb1, 0x98, 0x9e, 0xf0, 0xfa,
+        0x96, 0xfd, 0x33, 0xbe, 0x98, 0xe2, 0x09, 0x5d, 0x9e, 0x1f, 0xdb, 0x48, 0x60, 0xd2, 0xc9,
+        0x5c, 0x87, 0xc9, 0x35, 0xa7, 0x08, 0xb6, 0xb1, 0x1c, 0xcc, 0xb8, 0x02, 0xc0, 0x37, 0xe3,
+        0x9a, 0x1d, 0x54, 0x01, 0xae, 0x44, 0xc9, 0x84, 0xb9, 0xa7, 0x5e, 0x2e, 0x4a, 0xb2, 0xe1,
+        0x93, 0x6e, 0xed, 0x75, 0x68, 0x97, 0x38, 0xb4, 0x41, 0x2a, 0x20, 0x68, 0xf2, 0xc3, 0x69,
+        0x93, 0x17, 0xa7, 0xd8, 0xe6, 0x0c, 0xd9, 0x30, 0x75, 0x96, 0x80, 0x67, 0xfc, 0x95, 0x31,
+        0xac, 0xec, 0xde, 0x2d, 0xfe, 0x7b, 0x10, 0x30, 0x14, 0xc2, 0x1c, 0x65, 0xd2, 0xc5, 0xaa,
+        0xdf, 0x17, 0x7d, 0x30, 0xb6, 0xf9, 0xc3, 0x64, 0x8c, 0x2f, 0x71, 0x28, 0x28, 0x64, 0x4b,
+        0x00, 0x46, 0x7a, 0xa3, 0x08, 0x21, 0xc0, 0xc5, 0xbd, 0xaa, 0x49, 0x7f, 0x81, 0x27, 0x3e,
+        0x50, 0x36, 0x4e, 0x60, 0xb0, 0x7d, 0x8e, 0xb2, 0x26, 0x2c, 0xb6, 0x1f, 0x26, 0x39, 0xc1,
+        0x79, 0x28, 0x22, 0x00, 0x03, 0x8b, 0x81, 0xd4, 0xf6, 0x94, 0xf8, 0xed, 0x04, 0x16, 0x97,
+        0x59, 0xda, 0x9f, 0xdc, 0x6e, 0x02, 0xa9, 0x72, 0x6a, 0xd5, 0x79, 0x6f, 0x52, 0x19, 0xa7,
+        0x8f, 0xc6, 0xeb, 0xdf, 0xa0, 0x2f, 0x4e, 0x30, 0x34, 0x02, 0x00, 0xb9, 0xbf, 0x16, 0x70,
+        0x37,
+    ];
+    // signature of `MESSAGE` with SHA-256
+    const PKCS1V15_E3: [u8; 256] = [
+        0xce, 0x1e, 0xd6, 0xb3, 0x95, 0x69, 0x76, 0x23, 0xc3, 0x63, 0xb2, 0x38, 0xb4, 0x77, 0x27,
+        0x47, 0xbb, 0x3f, 0x9d, 0xe5, 0x90, 0xc9, 0x6b, 0xe3, 0x72, 0xd2, 0x1b, 0xc3, 0xa4, 0xe0,
+        0x2b, 0xfc, 0x73, 0xee, 0x67, 0x8f, 0xf7, 0xa4, 0x0a, 0x89, 0xf6, 0xd5, 0x96, 0x6e, 0x8a,
+        0x53, 0xc1, 0xb6, 0xbb, 0x19, 0xf6, 0xde, 0xff, 0x15, 0x27, 0x96, 0x7a, 0xa1, 0x00, 0x36,
+        0x4d, 0x32, 0x27, 0xc0, 0xfa, 0x50, 0xfc, 0xa7, 0xc6, 0x96, 0xa3, 0xce, 0x13, 0x60, 0xa8,
+        0x54, 0xfe, 0xa0, 0xc3, 0x1a, 0x6a, 0x82, 0x21, 0x00, 0x0b, 0x35, 0x88, 0xe1, 0x59, 0x6e,
+        0x81, 0x8f, 0x8d, 0x7c, 0xd3, 0xc8, 0x9c, 0x20, 0x45, 0xad, 0x62, 0x4e, 0xdc, 0x4e, 0x15,
+        0xfb, 0x02, 0x97, 0x46, 0x74, 0xea, 0x05, 0x19, 0x4c, 0xa8, 0x0f, 0x85, 0x2d, 0x02, 0x06,
+        0x51, 0x40, 0x13, 0xa4, 0xe9, 0x83, 0x4d, 0xbc, 0xf1, 0xd6, 0xc6, 0xbb, 0x1d, 0xfe, 0x22,
+        0x78, 0x89, 0x6c, 0xbf, 0xb2, 0x0e, 0xc5, 0x2c, 0x5c, 0x2d, 0xa1, 0x31, 0x48, 0xf0, 0xc4,
+        0xbc, 0x19, 0xb5, 0xa2, 0x0b, 0xde, 0xd8, 0x23, 0xc9, 0xd2, 0xe8, 0x84, 0xd3, 0xd9, 0xc7,
+        0x8e, 0x29, 0xda, 0xba, 0xe0, 0xa2, 0x1e, 0x11, 0xf0, 0x92, 0x88, 0x9e, 0x69, 0x26, 0xd6,
+        0x06, 0x40, 0x6b, 0xc7, 0x6c, 0xb5, 0x73, 0x48, 0x86, 0x3d, 0xd6, 0x78, 0x7b, 0xe7, 0xfb,
+        0x4e, 0xf1, 0xa8, 0xcd, 0x62, 0x6e, 0x0f, 0x0e, 0x14, 0xd5, 0xaa, 0x8d, 0x31, 0xd9, 0xa3,
+        0x8d, 0x52, 0x47, 0xeb, 0xf0, 0x71, 0x04, 0x08, 0x7a, 0xda, 0x05, 0xa6, 0x49, 0xf3, 0x28,
+        0xd0, 0x12, 0xd8, 0x18, 0x29, 0x23, 0xcf, 0xdd, 0x66, 0xfa, 0xd3, 0xa7, 0xd9, 0x27, 0x02,
+        0xb7, 0x8b, 0x11, 0xf7, 0x3a, 0x84, 0x26, 0x31, 0xef, 0xfc, 0x6b, 0x4e, 0xde, 0x1f, 0x6c,
+        0x5e,
+    ];
+
+    #[test]
+    fn verify_pkcs1v15() {
+        let key = PublicKey2048::new(&MODULUS_2048, &[0x01, 0x00, 0x01]).unwrap();
+        let hash = sha256(MESSAGE);
+        assert!(key
+            .verify_pkcs1v15(HashFunction::Sha256, &hash, &PKCS1V15_2048)
+            .is_ok());
+
+        assert!(key
+            .verify_pkcs1v15(
+                HashFunction::Sha256,
+                &sha256(b"other message"),
+                &PKCS1V15_2048
+            )
+            .is_err());
+        assert!(key
+            .verify_pkcs1v15(HashFunction::Sha256, &hash, &PSS_2048)
+            .is_err());
+        assert!(key
+            .verify_pkcs1v15(HashFunction::Sha512, &sha512(MESSAGE), &PKCS1V15_2048)
+            .is_err());
+        let mut bad_signature = PKCS1V15_2048;
+        bad_signature[100] ^= 1;
+        assert!(key
+            .verify_pkcs1v15(HashFunction::Sha256, &hash, &bad_signature)
+            .is_err());
+        // the signature must be less than the modulus, and exactly as long
+        assert!(key
+            .verify_pkcs1v15(HashFunction::Sha256, &hash, &MODULUS_2048)
+            .is_err());
+        assert!(key
+            .verify_pkcs1v15(HashFunction::Sha256, &hash, &PKCS1V15_2048[1..])
+            .is_err());
+
+        // an exponent other than 65537
+        let key = PublicKey2048::new(&MODULUS_E3, &[0x03]).unwrap();
+        assert!(key
+            .verify_pkcs1v15(HashFunction::Sha256, &hash, &PKCS1V15_E3)
+            .is_ok());
+        let key = PublicKey2048::new(&MODULUS_E3, &[0x05]).unwrap();
+        assert!(key
+            .verify_pkcs1v15(HashFunction::Sha256, &hash, &PKCS1V15_E3)
+            .is_err());
+    }
+
+    #[test]
+    fn verify_pss() {
+        let key = PublicKey2048::new(&MODULUS_2048, &[0x01, 0x00, 0x01]).unwrap();
+        let hash = sha256(MESSAGE);
+        assert!(key
+            .verify_pss(HashFunction::Sha256, &hash, &PSS_2048)
+            .is_ok());
+        assert!(key
+            .verify_pss(HashFunction::Sha256, &sha256(b"other message"), &PSS_2048)
+            .is_err());
+        assert!(key
+            .verify_pss(HashFunction::Sha256, &hash, &PKCS1V15_2048)
+            .is_err());
+        let mut bad_signature = PSS_2048;
+        bad_signature[255] ^= 1;
+        assert!(key
+            .verify_pss(HashFunction::Sha256, &hash, &bad_signature)
+            .is_err());
+
+        let key = PublicKey4096::new(&MODULUS_4096, &[0x01, 0x00, 0x01]).unwrap();
+        let hash = sha512(MESSAGE);
+        assert!(key
+            .verify_pss(HashFunction::Sha512, &hash, &PSS_4096)
+            .is_ok());
+        assert!(key
+            .verify_pss(HashFunction::Sha256, &sha256(MESSAGE), &PSS_4096)
+            .is_err());
+
+        // a modulus shorter than the key type allows
+        let key = PublicKey4096::new(&MODULUS_2048, &[0x01, 0x00, 0x01]).unwrap();
+        assert!(key
+            .verify_pss(HashFunction::Sha256, &sha256(MESSAGE), &PSS_2048)
+            .is_ok());
+    }
+
+    #[test]
+    fn invalid_key() {
+        let exponent = [0x01, 0x00, 0x01];
+        // leading zeros, as in DER integers, are fine
+        let mut padded = [0; 257];
+        padded[1..].copy_from_slice(&MODULUS_2048);
+        assert!(PublicKey2048::new(&padded, &[0, 0, 1, 0, 1]).is_ok());
+
+        assert!(PublicKey::<16>::new(&MODULUS_2048, &exponent).is_err());
+        assert!(PublicKey4096::new(&MODULUS_2048[128..], &exponent).is_err());
+        let mut even = MODULUS_2048;
+        even[255] &= 0xfe;
+        assert!(PublicKey2048::new(&even, &exponent).is_err());
+        assert!(PublicKey2048::new(&MODULUS_2048, &[0x01]).is_err());
+        assert!(PublicKey2048::new(&MODULUS_2048, &[0x01, 0x00, 0x00]).is_err());
+        assert!(PublicKey2048::new(&MODULUS_2048, &[0xff; 9]).is_err());
+    }
+}
@@ -1 +1,2 @@
+pub mod curve25519;
 pub mod secp256r1;
@@ -0,0 +1,771 @@
+//! X25519 key exchange over Curve25519 (RFC 7748), and the field underlying it
+//!
+//! Field elements are five limbs of 51 bits, which leaves room in each 64-bit limb for
+//! the carries of a few additions, and lets every product of two limbs fit in a [`u128`].
+//!
+//! Public keys are computed on the birationally equivalent twisted Edwards curve
+//! (the one used by Ed25519), with a precomputed table of multiples of the base point,
+//! and then mapped to Curve25519. Shared secrets use the Montgomery ladder.
+//!
+//! Every operation is constant-time.
+
+/// The size of a private key, public key, or shared secret, in bytes
+pub const KEY_SIZE: usize = 32;
+
+/// The number of 51-bit limbs in a field element
+const LIMBS: usize = 5;
+
+/// The mask of a 51-bit limb
+const MASK_51: u64 = (1 << 51) - 1;
+
+/// An error that is returned when a peer's public key has a small order,
+/// which would make the shared secret zero, no matter the private key
+#[derive(Debug)]
+pub struct InvalidPoint;
+
+impl core::fmt::Display for InvalidPoint {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "point has a small order")
+    }
+}
+
+// TODO: impl `Error` trait once stabilized in core
+// impl core::error::Error for InvalidPoint {}
+
+/// Returns the public key of `private_key`
+///
+/// `private_key` should be chosen uniformly at random. It is the same as
+/// `x25519(private_key, &9)`, but several times faster.
+pub fn public_key(private_key: &[u8; KEY_SIZE]) -> [u8; KEY_SIZE] {
+    EdwardsPoint::mul_base(&clamp(private_key)).to_montgomery_u()
+}
+
+/// Performs X25519 Diffie-Hellman, returning the shared secret
+///
+/// # Errors
+///
+/// This function will return an error if the shared secret would be zero,
+/// which happens exactly when `peer_public_key` has a small order (RFC 7748, section 6.1).
+pub fn shared_secret(
+    private_key: &[u8; KEY_SIZE],
+    peer_public_key: &[u8; KEY_SIZE],
+) -> Result<[u8; KEY_SIZE], InvalidPoint> {
+    let secret = x25519(private_key, peer_public_key);
+    // combine every byte, so that the time taken doesn't depend on which one is non-zero
+    match secret.iter().fold(0, |acc, byte| acc | byte) {
+        0 => Err(InvalidPoint),
+        _ => Ok(secret),
+    }
+}
+
+/// The X25519 function: the u-coordinate of `scalar` times the point with u-coordinate `u`
+/// (RFC 7748, section 5)
+///
+/// `scalar` is clamped first, and the top bit of `u` is ignored, as the RFC requires.
+pub fn x25519(scalar: &[u8; KEY_SIZE], u: &[u8; KEY_SIZE]) -> [u8; KEY_SIZE] {
+    let scalar = clamp(scalar);
+    let x1 = FieldElement::from_le_bytes(u);
+    let [mut x2, mut z2] = [FieldElement::ONE, FieldElement::ZERO];
+    let [mut x3, mut z3] = [x1, FieldElement::ONE];
+
+    // (x2 : z2) is the multiple of u by the bits of the scalar so far, and (x3 : z3) is one more
+    let mut swap = 0;
+    for bit in (0..255).rev() {
+        let bit_set = (scalar[bit / 8] >> (bit % 8) & 1) as u64;
+        swap ^= bit_set;
+        FieldElement::swap(swap, &mut x2, &mut x3);
+        FieldElement::swap(swap, &mut z2, &mut z3);
+        swap = bit_set;
+
+        let a = x2.add(z2);
+        let aa = a.square();
+        let b = x2.sub(z2);
+        let bb = b.square();
+        let e = aa.sub(bb);
+        let c = x3.add(z3);
+        let d = x3.sub(z3);
+        let da = d.mul(a);
+        let cb = c.mul(b);
+        x3 = da.add(cb).square();
+        z3 = x1.mul(da.sub(cb).square());
+        x2 = aa.mul(bb);
+        z2 = e.mul(aa.add(e.mul_small(A24)));
+    }
+    FieldElement::swap(swap, &mut x2, &mut x3);
+    FieldElement::swap(swap, &mut z2, &mut z3);
+
+    x2.mul(z2.invert()).to_le_bytes()
+}
+
+/// (A - 2) / 4, where A = 486662 is the Montgomery curve coefficient
+const A24: u64 = 121665;
+
+/// Clamps `scalar` to a multiple of the cofactor, 8, with its top bit at bit 254
+fn clamp(scalar: &[u8; KEY_SIZE]) -> [u8; KEY_SIZE] {
+    let mut scalar = *scalar;
+    scalar[0] &= 248;
+    scalar[KEY_SIZE - 1] &= 127;
+    scalar[KEY_SIZE - 1] |= 64;
+    scalar
+}
+
+/// Returns all ones if `condition` is true, and zero otherwise
+///
+/// The compiler must not know the result is one of two values, or it might introduce a branch.
+const fn mask(condition: bool) -> u64 {
+    core::hint::black_box((condition as u64).wrapping_neg())
+}
+
+/// An element of the field of integers modulo p = 2^255 - 19
+///
+/// Internally, it is five little-endian limbs of 51 bits, which aren't fully reduced:
+/// each limb may be a little larger than 51 bits, and the value may be a little larger than p.
+/// [`mul`](Self::mul) and [`square`](Self::square) accept limbs of up to 54 bits,
+/// which is enough for the sum of two results of any other operation.
+///
+/// Each operation is a `const fn`, which lets the table of points be computed at compile time.
+#[derive(Debug, Clone, Copy)]
+struct FieldElement([u64; LIMBS]);
+
+impl FieldElement {
+    /// The additive identity
+    const ZERO: Self = Self([0; LIMBS]);
+
+    /// The multiplicative identity
+    const ONE: Self = Self([1, 0, 0, 0, 0]);
+
+    /// 16 * p, which is added before subtracting, so that no limb underflows
+    const SIXTEEN_P: [u64; LIMBS] = [
+        16 * (MASK_51 - 18),
+        16 * MASK_51,
+        16 * MASK_51,
+        16 * MASK_51,
+        16 * MASK_51,
+    ];
+
+    /// Decodes a little-endian integer, ignoring its top bit
+    const fn from_le_bytes(bytes: &[u8; KEY_SIZE]) -> Self {
+        let mut words = [0; 4];
+        let mut i = 0;
+        while i < 4 {
+            let mut word = [0; 8];
+            let mut j = 0;
+            while j < 8 {
+                word[j] = bytes[8 * i + j];
+                j += 1;
+            }
+            words[i] = u64::from_le_bytes(word);
+            i += 1;
+        }
+        Self([
+            words[0] & MASK_51,
+            (words[0] >> 51 | words[1] << 13) & MASK_51,
+            (words[1] >> 38 | words[2] << 26) & MASK_51,
+            (words[2] >> 25 | words[3] << 39) & MASK_51,
+            (words[3] >> 12) & MASK_51,
+        ])
+    }
+
+    /// Encodes `self`, fully reduced, as a little-endian integer
+    const fn to_le_bytes(self) -> [u8; KEY_SIZE] {
+        let mut limbs = self.carry().0;
+        // `limbs` is now less than 2p, so it is at least p exactly when adding 19 carries
+        // out of bit 255
+        let mut quotient = (limbs[0] + 19) >> 51;
+        let mut i = 1;
+        while i < LIMBS {
+            quotient = (limbs[i] + quotient) >> 51;
+            i += 1;
+        }
+        limbs[0] += 19 * quotient;
+        let mut i = 0;
+        while i < LIMBS - 1 {
+            limbs[i + 1] += limbs[i] >> 51;
+            limbs[i] &= MASK_51;
+            i += 1;
+        }
+        limbs[LIMBS - 1] &= MASK_51;
+
+        let words = [
+            limbs[0] | limbs[1] << 51,
+            limbs[1] >> 13 | limbs[2] << 38,
+            limbs[2] >> 26 | limbs[3] << 25,
+            limbs[3] >> 39 | limbs[4] << 12,
+        ];
+        let mut bytes = [0; KEY_SIZE];
+        let mut i = 0;
+        while i < KEY_SIZE {
+            bytes[i] = (words[i / 8] >> (8 * (i % 8))) as u8;
+            i += 1;
+        }
+        bytes
+    }
+
+    /// Returns `self + rhs`, without carrying between limbs
+    const fn add(self, rhs: Self) -> Self {
+        let mut sum = [0; LIMBS];
+        let mut i = 0;
+        while i < LIMBS {
+            sum[i] = self.0[i] + rhs.0[i];
+            i += 1;
+        }
+        Self(sum)
+    }
+
+    /// Returns `self - rhs`
+    ///
+    /// Each limb of `rhs` must be less than 2^55 - 304.
+    const fn sub(self, rhs: Self) -> Self {
+        let mut difference = [0; LIMBS];
+        let mut i = 0;
+        while i < LIMBS {
+            difference[i] = self.0[i] + Self::SIXTEEN_P[i] - rhs.0[i];
+            i += 1;
+        }
+        Self(difference).carry()
+    }
+
+    /// Returns `self` with each limb carried into the next, so that every limb has at most
+    /// 51 bits, apart from the second, which may have slightly more
+    const fn carry(self) -> Self {
+        let mut limbs = self.0;
+        let mut i = 0;
+        while i < LIMBS - 1 {
+            limbs[i + 1] += limbs[i] >> 51;
+            limbs[i] &= MASK_51;
+            i += 1;
+        }
+        // 2^255 = 19 modulo p, so the carry out of the top wraps around times 19
+        limbs[0] += 19 * (limbs[LIMBS - 1] >> 51);
+        limbs[LIMBS - 1] &= MASK_51;
+        limbs[1] += limbs[0] >> 51;
+        limbs[0] &= MASK_51;
+        Self(limbs)
+    }
+
+    /// Returns `self * rhs`
+    #[inline(always)]
+    const fn mul(self, rhs: Self) -> Self {
+        let [a0, a1, a2, a3, a4] = self.0;
+        let [b0, b1, b2, b3, b4] = rhs.0;
+        // the limbs that overflow 2^255 wrap around times 19
+        let [s1, s2, s3, s4] = [19 * b1, 19 * b2, 19 * b3, 19 * b4];
+        Self::reduce([
+            mul_wide(a0, b0)
+                + mul_wide(a1, s4)
+                + mul_wide(a2, s3)
+                + mul_wide(a3, s2)
+                + mul_wide(a4, s1),
+            mul_wide(a0, b1)
+                + mul_wide(a1, b0)
+                + mul_wide(a2, s4)
+                + mul_wide(a3, s3)
+                + mul_wide(a4, s2),
+            mul_wide(a0, b2)
+                + mul_wide(a1, b1)
+                + mul_wide(a2, b0)
+                + mul_wide(a3, s4)
+                + mul_wide(a4, s3),
+            mul_wide(a0, b3)
+                + mul_wide(a1, b2)
+                + mul_wide(a2, b1)
+                + mul_wide(a3, b0)
+                + mul_wide(a4, s4),
+            mul_wide(a0, b4)
+                + mul_wide(a1, b3)
+                + mul_wide(a2, b2)
+                + mul_wide(a3, b1)
+                + mul_wide(a4, b0),
+        ])
+    }
+
+    /// Returns `self * self`
+    ///
+    /// This is faster than [`mul`](Self::mul), because each product of two different limbs is
+    /// only computed once.
+    #[inline(always)]
+    const fn square(self) -> Self {
+        let [a0, a1, a2, a3, a4] = self.0;
+        let [d0, d1, d2, d3] = [2 * a0, 2 * a1, 2 * a2, 2 * a3];
+        let [s3, s4] = [19 * a3, 19 * a4];
+        Self::reduce([
+            mul_wide(a0, a0) + mul_wide(d1, s4) + mul_wide(d2, s3),
+            mul_wide(d0, a1) + mul_wide(d2, s4) + mul_wide(a3, s3),
+            mul_wide(d0, a2) + mul_wide(a1, a1) + mul_wide(d3, s4),
+            mul_wide(d0, a3) + mul_wide(d1, a2) + mul_wide(a4, s4),
+            mul_wide(d0, a4) + mul_wide(d1, a3) + mul_wide(a2, a2),
+        ])
+    }
+
+    /// Returns `self` squared `n` times
+    const fn square_times(mut self, n: usize) -> Self {
+        let mut i = 0;
+        while i < n {
+            self = self.square();
+            i += 1;
+        }
+        self
+    }
+
+    /// Returns `self * small`, where `small` must be less than 2^25
+    const fn mul_small(self, small: u64) -> Self {
+        let mut product = [0; LIMBS];
+        let mut i = 0;
+        while i < LIMBS {
+            product[i] = mul_wide(self.0[i], small);
+            i += 1;
+        }
+        Self::reduce(product)
+    }
+
+    /// Carries the column sums of a product into limbs
+    ///
+    /// Each column must be less than 2^115, so that the carry out of the top fits in a [`u64`].
+    #[inline(always)]
+    const fn reduce(mut columns: [u128; LIMBS]) -> Self {
+        let mut limbs = [0; LIMBS];
+        let mut i = 0;
+        while i < LIMBS - 1 {
+            columns[i + 1] += columns[i] >> 51;
+            limbs[i] = columns[i] as u64 & MASK_51;
+            i += 1;
+        }
+        limbs[LIMBS - 1] = columns[LIMBS - 1] as u64 & MASK_51;
+        let carry = (columns[LIMBS - 1] >> 51) as u64;
+        // 19 times the carry may not fit in a limb, so it is carried once more
+        let low = limbs[0] as u128 + 19 * carry as u128;
+        limbs[0] = low as u64 & MASK_51;
+        limbs[1] += (low >> 51) as u64;
+        Self(limbs)
+    }
+
+    /// Returns the multiplicative inverse of `self`, or zero if `self` is zero
+    ///
+    /// This raises `self` to the power of p - 2 = 2^255 - 21 (Fermat's little theorem),
+    /// with the usual addition chain of 254 squarings and 11 multiplications.
+    const fn invert(self) -> Self {
+        let x2 = self.square();
+        let x9 = x2.square_times(2).mul(self);
+        let x11 = x9.mul(x2);
+        // x_5_0 is self^(2^5 - 1), and so on
+        let x_5_0 = x11.square().mul(x9);
+        let x_10_0 = x_5_0.square_times(5).mul(x_5_0);
+        let x_20_0 = x_10_0.square_times(10).mul(x_10_0);
+        let x_40_0 = x_20_0.square_times(20).mul(x_20_0);
+        let x_50_0 = x_40_0.square_times(10).mul(x_10_0);
+        let x_100_0 = x_50_0.square_times(50).mul(x_50_0);
+        let x_200_0 = x_100_0.square_times(100).mul(x_100_0);
+        let x_250_0 = x_200_0.square_times(50).mul(x_50_0);
+        // 2^255 - 21 = (2^250 - 1) * 2^5 + 11
+        x_250_0.square_times(5).mul(x11)
+    }
+
+    /// Returns `if_set` if `condition` is all ones, or `if_clear` if it is zero
+    fn select(condition: u64, if_set: Self, if_clear: Self) -> Self {
+        Self(core::array::from_fn(|i| {
+            (if_set.0[i] & condition) | (if_clear.0[i] & !condition)
+        }))
+    }
+
+    /// Swaps `x` and `y` if `condition` is one, and leaves them if it is zero
+    fn swap(condition: u64, x: &mut Self, y: &mut Self) {
+        let mask = core::hint::black_box(condition.wrapping_neg());
+        for (x, y) in x.0.iter_mut().zip(y.0.iter_mut()) {
+            let difference = (*x ^ *y) & mask;
+            *x ^= difference;
+            *y ^= difference;
+        }
+    }
+}
+
+/// Returns the full product of `x` and `y`
+#[inline(always)]
+const fn mul_wide(x: u64, y: u64) -> u128 {
+    x as u128 * y as u128
+}
+
+/// The coefficient d of the twisted Edwards curve -x^2 + y^2 = 1 + d * x^2 * y^2, times 2
+const D2: FieldElement = FieldElement([
+    0x69b9426b2f159,
+    0x35050762add7a,
+    0x3cf44c0038052,
+    0x6738cc7407977,
+    0x2406d9dc56dff,
+]);
+
+/// A point on the twisted Edwards curve, in extended coordinates
+///
+/// (X : Y : Z : T) represents the affine point (X / Z, Y / Z), where T = X * Y / Z.
+/// The curve is birationally equivalent to Curve25519, and its addition formulas
+/// (Hisil, Wong, Carter, and Dawson, 2008) are complete: they work for any two points,
+/// including equal points and the identity.
+#[derive(Clone, Copy)]
+struct EdwardsPoint {
+    x: FieldElement,
+    y: FieldElement,
+    z: FieldElement,
+    t: FieldElement,
+}
+
+impl EdwardsPoint {
+    /// The identity, (0, 1)
+    const IDENTITY: Self = Self {
+        x: FieldElement::ZERO,
+        y: FieldElement::ONE,
+        z: FieldElement::ONE,
+        t: FieldElement::ZERO,
+    };
+
+    /// The base point, which corresponds to u = 9 on Curve25519
+    const BASE: Self = {
+        let x = FieldElement([
+            0x62d608f25d51a,
+            0x412a4b4f6592a,
+            0x75b7171a4b31d,
+            0x1ff60527118fe,
+            0x216936d3cd6e5,
+        ]);
+        let y = FieldElement([
+            0x6666666666658,
+            0x4cccccccccccc,
+            0x1999999999999,
+            0x3333333333333,
+            0x6666666666666,
+        ]);
+        Self {
+            x,
+            y,
+            z: FieldElement::ONE,
+            t: x.mul(y),
+        }
+    };
+
+    /// Returns `self + rhs`
+    const fn add(self, rhs: Self) -> Self {
+        let a = self.y.sub(self.x).mul(rhs.y.sub(rhs.x));
+        let b = self.y.add(self.x).mul(rhs.y.add(rhs.x));
+        let c = self.t.mul(D2).mul(rhs.t);
+        let d = self.z.mul(rhs.z);
+        Self::from_sums(a, b, c, d.add(d))
+    }
+
+    /// Returns `self + rhs`, which is cheaper than with an [`EdwardsPoint`]
+    #[inline(always)]
+    const fn add_niels(self, rhs: &NielsPoint) -> Self {
+        let a = self.y.sub(self.x).mul(rhs.y_minus_x);
+        let b = self.y.add(self.x).mul(rhs.y_plus_x);
+        let c = self.t.mul(rhs.xy2d);
+        Self::from_sums(a, b, c, self.z.add(self.z))
+    }
+
+    /// The end of both addition formulas, where `a` = (Y1 - X1)(Y2 - X2),
+    /// `b` = (Y1 + X1)(Y2 + X2), `c` = 2d * T1 * T2, and `d` = 2 * Z1 * Z2
+    #[inline(always)]
+    const fn from_sums(a: FieldElement, b: FieldElement, c: FieldElement, d: FieldElement) -> Self {
+        let e = b.sub(a);
+        let f = d.sub(c);
+        let g = d.add(c);
+        let h = b.add(a);
+        Self {
+            x: e.mul(f),
+            y: g.mul(h),
+            z: f.mul(g),
+            t: e.mul(h),
+        }
+    }
+
+    /// Returns `self + self`
+    #[inline(always)]
+    const fn double(self) -> Self {
+        let a = self.x.square();
+        let b = self.y.square();
+        let c = self.z.square();
+        let c = c.add(c);
+        let h = a.add(b);
+        let e = h.sub(self.x.add(self.y).square());
+        let g = a.sub(b);
+        let f = c.add(g);
+        Self {
+            x: e.mul(f),
+            y: g.mul(h),
+            z: f.mul(g),
+            t: e.mul(h),
+        }
+    }
+
+    /// Returns `if_set` if `condition` is all ones, or `if_clear` if it is zero
+    fn select(condition: u64, if_set: &Self, if_clear: &Self) -> Self {
+        Self {
+            x: FieldElement::select(condition, if_set.x, if_clear.x),
+            y: FieldElement::select(condition, if_set.y, if_clear.y),
+            z: FieldElement::select(condition, if_set.z, if_clear.z),
+            t: FieldElement::select(condition, if_set.t, if_clear.t),
+        }
+    }
+
+    /// Returns `scalar` times the base point
+    ///
+    /// `scalar` is a little-endian integer. This uses combs over [`BASE_TABLE`], so it only needs
+    /// `SPACING` - 1 doublings.
+    fn mul_base(scalar: &[u8; KEY_SIZE]) -> Self {
+        let mut product = Self::IDENTITY;
+        for column in (0..SPACING).rev() {
+            if column != SPACING - 1 {
+                product = product.double();
+            }
+            for (comb, multiples) in BASE_TABLE.iter().enumerate() {
+                let digit = teeth(scalar, comb, column);
+                let sum = product.add_niels(&NielsPoint::lookup(multiples, digit));
+                // the table has no entry for zero, so nothing is added
+                product = Self::select(mask(digit != 0), &sum, &product);
+            }
+        }
+        product
+    }
+
+    /// Returns the u-coordinate of the corresponding point on Curve25519,
+    /// u = (1 + y) / (1 - y), encoded as a little-endian integer
+    fn to_montgomery_u(self) -> [u8; KEY_SIZE] {
+        let u = self.z.add(self.y).mul(self.z.sub(self.y).invert());
+        u.to_le_bytes()
+    }
+}
+
+/// An affine point that is cheap to add to an [`EdwardsPoint`], as (y + x, y - x, 2d * x * y)
+#[derive(Clone, Copy)]
+struct NielsPoint {
+    y_plus_x: FieldElement,
+    y_minus_x: FieldElement,
+    xy2d: FieldElement,
+}
+
+impl NielsPoint {
+    /// Returns `multiples[digit - 1]`, reading every entry so that the time taken and the memory
+    /// accessed don't depend on `digit`
+    ///
+    /// If `digit` is zero, the result is meaningless.
+    fn lookup(multiples: &[NielsPoint; MULTIPLES], digit: usize) -> Self {
+        let mut result = multiples[0];
+        for (j, candidate) in multiples.iter().enumerate() {
+            let condition = mask(j + 1 == digit);
+            result.y_plus_x = FieldElement::select(condition, candidate.y_plus_x, result.y_plus_x);
+            result.y_minus_x =
+                FieldElement::select(condition, candidate.y_minus_x, result.y_minus_x);
+            result.xy2d = FieldElement::select(condition, candidate.xy2d, result.xy2d);
+        }
+        result
+    }
+}
+
+/// The number of teeth of each comb, which is the number of bits of the scalar looked up at once
+const TEETH: usize = 4;
+
+/// The number of combs
+const COMBS: usize = 2;
+
+/// The distance between the teeth of a comb, in bits
+const SPACING: usize = 8 * KEY_SIZE / (TEETH * COMBS);
+
+/// The number of multiples of the base point precomputed for each comb
+const MULTIPLES: usize = (1 << TEETH) - 1;
+
+/// Returns the bits of `scalar` under the teeth of `comb`, when it is at `column`
+///
+/// Tooth `t` of comb `c` is at bit `column + SPACING * (c + COMBS * t)`,
+/// so together, the combs cover every bit of `scalar` as `column` goes from 0 to `SPACING` - 1.
+fn teeth(scalar: &[u8; KEY_SIZE], comb: usize, column: usize) -> usize {
+    let mut digit = 0;
+    for tooth in 0..TEETH {
+        let bit = column + SPACING * (comb + COMBS * tooth);
+        digit |= ((scalar[bit / 8] as usize >> (bit % 8)) & 1) << tooth;
+    }
+    digit
+}
+
+/// The multiples of the base point under each comb
+///
+/// `BASE_TABLE[c][d - 1]` is the sum of 2^(`SPACING` * (`c` + `COMBS` * `t`)) * B over every
+/// bit `t` set in `d`, where B is the base point.
+static BASE_TABLE: [[NielsPoint; MULTIPLES]; COMBS] = base_table();
+
+/// Computes [`BASE_TABLE`]
+const fn base_table() -> [[NielsPoint; MULTIPLES]; COMBS] {
+    // powers[k] is 2^(SPACING * k) * B
+    let mut powers = [EdwardsPoint::BASE; TEETH * COMBS];
+    let mut k = 1;
+    while k < TEETH * COMBS {
+        powers[k] = powers[k - 1];
+        let mut i = 0;
+        while i < SPACING {
+            powers[k] = powers[k].double();
+            i += 1;
+        }
+        k += 1;
+    }
+
+    // the multiples for comb `c` start at `c` * `MULTIPLES`
+    let mut points = [EdwardsPoint::IDENTITY; COMBS * MULTIPLES];
+    let mut comb = 0;
+    while comb < COMBS {
+        let multiples = comb * MULTIPLES;
+        let mut digit = 1;
+        while digit <= MULTIPLES {
+            // each multiple is a smaller one plus the power for the highest tooth
+            let tooth = digit.ilog2() as usize;
+            let power = powers[comb + COMBS * tooth];
+            let rest = digit - (1 << tooth);
+            points[multiples + digit - 1] = match rest {
+                0 => power,
+                _ => points[multiples + rest - 1].add(power),
+            };
+            digit += 1;
+        }
+        comb += 1;
+    }
+
+    // products[k] is the product of the Z coordinates of the first `k` points,
+    // so that every Z coordinate can be inverted with one inversion (Montgomery's trick)
+    let mut products = [FieldElement::ONE; COMBS * MULTIPLES];
+    let mut k = 1;
+    while k < COMBS * MULTIPLES {
+        products[k] = products[k - 1].mul(points[k - 1].z);
+        k += 1;
+    }
+    let mut inverse = products[COMBS * MULTIPLES - 1]
+        .mul(points[COMBS * MULTIPLES - 1].z)
+        .invert();
+
+    let empty = NielsPoint {
+        y_plus_x: FieldElement::ZERO,
+        y_minus_x: FieldElement::ZERO,
+        xy2d: FieldElement::ZERO,
+    };
+    let mut table = [[empty; MULTIPLES]; COMBS];
+    let mut k = COMBS * MULTIPLES;
+    while k > 0 {
+        k -= 1;
+        let point = points[k];
+        let z_inverse = inverse.mul(products[k]);
+        inverse = inverse.mul(point.z);
+        let x = point.x.mul(z_inverse);
+        let y = point.y.mul(z_inverse);
+        table[k / MULTIPLES][k % MULTIPLES] = NielsPoint {
+            y_plus_x: y.add(x).carry(),
+            y_minus_x: y.sub(x),
+            xy2d: x.mul(y).mul(D2),
+        };
+    }
+    table
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{FieldElement, KEY_SIZE};
+
+    /// The u-coordinate of the base point
+    const BASE_U: [u8; KEY_SIZE] = {
+        let mut u = [0; KEY_SIZE];
+        u[0] = 9;
+        u
+    };
+
+    fn bytes(hex: &str) -> [u8; KEY_SIZE] {
+        let mut bytes = [0; KEY_SIZE];
+        for (i, byte) in bytes.iter_mut().enumerate() {
+            *byte = u8::from_str_radix(&hex[2 * i..2 * i + 2], 16).unwrap();
+        }
+        bytes
+    }
+
+    #[test]
+    fn field_arithmetic() {
+        let p_minus_one = bytes("ecffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f");
+        let minus_one = FieldElement::from_le_bytes(&p_minus_one);
+        let one = FieldElement::ONE;
+        assert_eq!(minus_one.to_le_bytes(), p_minus_one);
+        assert_eq!(FieldElement::ZERO.sub(one).to_le_bytes(), p_minus_one);
+        assert_eq!(minus_one.add(one).to_le_bytes(), [0; KEY_SIZE]);
+        assert_eq!(minus_one.square().to_le_bytes(), one.to_le_bytes());
+        assert_eq!(minus_one.mul(minus_one).to_le_bytes(), one.to_le_bytes());
+
+        // p itself, and other values from p to 2^255 - 1, are reduced
+        let p = bytes("edffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f");
+        assert_eq!(FieldElement::from_le_bytes(&p).to_le_bytes(), [0; KEY_SIZE]);
+        let mut two = [0; KEY_SIZE];
+        two[0] = 2;
+        let two_more = bytes("efffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff7f");
+        assert_eq!(FieldElement::from_le_bytes(&two_more).to_le_bytes(), two);
+        // the top bit is ignored
+        let mut high = two;
+        high[KEY_SIZE - 1] = 0x80;
+        assert_eq!(FieldElement::from_le_bytes(&high).to_le_bytes(), two);
+
+        let x = FieldElement::from_le_bytes(&bytes(
+            "a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4",
+        ));
+        assert_eq!(x.mul(x.invert()).to_le_bytes(), one.to_le_bytes());
+        assert_eq!(x.square().to_le_bytes(), x.mul(x).to_le_bytes());
+        assert_eq!(x.mul_small(3).to_le_bytes(), x.add(x).add(x).to_le_bytes());
+        assert_eq!(x.sub(x).to_le_bytes(), [0; KEY_SIZE]);
+        assert_eq!(FieldElement::ZERO.invert().to_le_bytes(), [0; KEY_SIZE]);
+    }
+
+    // the test vectors from RFC 7748, section 5.2
+    #[test]
+    fn x25519() {
+        let scalar = bytes("a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4");
+        let u = bytes("e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c");
+        let expected = bytes("c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552");
+        assert_eq!(super::x25519(&scalar, &u), expected);
+
+        let scalar = bytes("4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d");
+        let u = bytes("e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493");
+        let expected = bytes("95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957");
+        assert_eq!(super::x25519(&scalar, &u), expected);
+
+        let mut scalar = BASE_U;
+        let mut u = BASE_U;
+        for i in 0..1000 {
+            (scalar, u) = (super::x25519(&scalar, &u), scalar);
+            if i == 0 {
+                let expected =
+                    bytes("422c8e7a6227d7bca1350b3e2bb7279f7897b87bb6854b783c60e80311ae3079");
+                assert_eq!(scalar, expected);
+            }
+        }
+        let expected = bytes("684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51");
+        assert_eq!(scalar, expected);
+    }
+
+    // the test vectors from RFC 7748, section 6.1
+    #[test]
+    fn ecdh() {
+        let alice = bytes("77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a");
+        let alice_public =
+            bytes("8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a");
+        let bob = bytes("5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb");
+        let bob_public = bytes("de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f");
+        let shared = bytes("4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742");
+
+        assert_eq!(super::public_key(&alice), alice_public);
+        assert_eq!(super::public_key(&bob), bob_public);
+        assert_eq!(super::shared_secret(&alice, &bob_public).unwrap(), shared);
+        assert_eq!(super::shared_secret(&bob, &alice_public).unwrap(), shared);
+
+        // the fixed-base path agrees with the ladder
+        let mut private_key = alice;
+        for _ in 0..16 {
+            private_key = super::x25519(&private_key, &bob_public);
+            assert_eq!(
+                super::public_key(&private_key),
+                super::x25519(&private_key, &BASE_U)
+            );
+        }
+
+        // zero and one have small orders
+        let mut one = [0; KEY_SIZE];
+        one[0] = 1;
+        assert!(super::shared_secret(&alice, &[0; KEY_SIZE]).is_err());
+        assert!(super::shared_secret(&alice, &one).is_err());
+    }
+}
@@ -1,24 +1,264 @@
-use crate::big_int::BigInt;
-use core::ops::{Add, Deref, Mul, Sub};
+//! The secp256r1 (also known as P-256) curve, and the field underlying it
+//!
+//! Field elements are kept in Montgomery form: `x` is stored as `x * R mod p`, where `R` is
+//! 2^256. This turns the reduction after each multiplication into a few more multiplications
+//! and additions, instead of a division.
+//!
+//! Every operation is constant-time.
+use crate::big_int::{carry_add, carry_mul, carry_sub, BigInt, InputTooLargeError};
+use core::ops::{Add, Mul, Neg, Sub};
 
-#[derive(Debug, PartialEq, Eq, PartialOrd, Ord, Clone, Copy)]
-/// A big integer with the invariant that its value is less than its modulus
-pub struct FieldElement(BigInt<4>);
+/// The number of 64-bit limbs in a field element
+const LIMBS: usize = 4;
+
+/// The size of an encoded field element or scalar, in bytes
+pub const ELEMENT_SIZE: usize = 32;
+
+/// The size of an uncompressed encoded point, in bytes
+pub const POINT_SIZE: usize = 1 + 2 * ELEMENT_SIZE;
+
+/// The field modulus, p = 2^256 - 2^224 + 2^192 + 2^96 - 1, as little-endian limbs
+const P: [u64; LIMBS] = [
+    0xffffffffffffffff,
+    0x00000000ffffffff,
+    0x0000000000000000,
+    0xffffffff00000001,
+];
+
+/// -p^-1 modulo 2^64
+///
+/// Because the lowest limb of p is 2^64 - 1, this is 1, so the multiplier of each reduction
+/// step is simply the lowest limb.
+const P_INV: u64 = 1;
+
+/// R^2 modulo p, used to convert into Montgomery form
+const R_SQUARED: [u64; LIMBS] = [
+    0x0000000000000003,
+    0xfffffffbffffffff,
+    0xfffffffffffffffe,
+    0x00000004fffffffd,
+];
+
+/// An error that is returned when an encoded point is not on the curve
+#[derive(Debug)]
+pub struct InvalidPoint;
+
+impl core::fmt::Display for InvalidPoint {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "point is not on the curve")
+    }
+}
+
+// TODO: impl `Error` trait once stabilized in core
+// impl core::error::Error for InvalidPoint {}
+
+/// Returns the public key of `private_key`, as an uncompressed point
+///
+/// `private_key` is a big-endian integer, which should be chosen uniformly at random
+/// from 1 to n - 1, where n is the order of the curve.
+///
+/// # Panics
+///
+/// This function will panic if `private_key` is a multiple of n, such as zero.
+pub fn public_key(private_key: &[u8; ELEMENT_SIZE]) -> [u8; POINT_SIZE] {
+    Point::mul_base(private_key)
+        .to_uncompressed()
+        .expect("private key should not be a multiple of the curve order")
+}
+
+/// Performs elliptic-curve Diffie-Hellman, returning the shared secret
+///
+/// The shared secret is the x-coordinate of `private_key` times `peer_public_key`.
+///
+/// # Errors
+///
+/// This function will return an error if `peer_public_key` is not a point on the curve,
+/// or if the shared secret would be the identity.
+pub fn shared_secret(
+    private_key: &[u8; ELEMENT_SIZE],
+    peer_public_key: &[u8; POINT_SIZE],
+) -> Result<[u8; ELEMENT_SIZE], InvalidPoint> {
+    let peer = Point::from_uncompressed(peer_public_key)?;
+    let (x, _) = peer
+        .mul_scalar(private_key)
+        .to_affine()
+        .ok_or(InvalidPoint)?;
+    Ok(x.to_be_bytes())
+}
+
+/// An element of the field of integers modulo [`MODULUS`](Self::MODULUS)
+///
+/// Internally, it is a little-endian array of limbs, in Montgomery form and always fully
+/// reduced. This means two elements are equal exactly when their limbs are.
+///
+/// Besides implementing the arithmetic operators, each operation is available as a `const fn`,
+/// which lets tables of points be computed at compile time.
+#[derive(Debug, PartialEq, Eq, Clone, Copy)]
+pub struct FieldElement([u64; LIMBS]);
 
 impl FieldElement {
-    pub const MODULUS: Self = Self(BigInt::new([
+    /// The field modulus
+    pub const MODULUS: BigInt<4> = BigInt::new([P[3], P[2], P[1], P[0]]);
+
+    /// The additive identity
+    pub const ZERO: Self = Self([0; LIMBS]);
+
+    /// The multiplicative identity
+    ///
+    /// In Montgomery form, this is R modulo p.
+    pub const ONE: Self = Self([
+        0x0000000000000001,
         0xffffffff00000000,
         0xffffffffffffffff,
-        0xbce6faada7179e84,
-        0xf3b9cac2fc632551,
-    ]));
+        0x00000000fffffffe,
+    ]);
+
+    /// Converts little-endian limbs, which must be less than p, into Montgomery form
+    const fn from_limbs(limbs: [u64; LIMBS]) -> Self {
+        Self(reduce(mul_wide(&limbs, &R_SQUARED), &P, P_INV))
+    }
+
+    /// Decodes a big-endian integer into a field element
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if `bytes` is not less than
+    /// [`MODULUS`](Self::MODULUS).
+    pub fn from_be_bytes(bytes: &[u8; ELEMENT_SIZE]) -> Result<Self, InputTooLargeError> {
+        let limbs = limbs_from_be_bytes(bytes);
+        if !sub_limbs(&limbs, &P).1 {
+            return Err(InputTooLargeError);
+        }
+        Ok(Self::from_limbs(limbs))
+    }
+
+    /// Encodes `self` as a big-endian integer
+    pub fn to_be_bytes(self) -> [u8; ELEMENT_SIZE] {
+        let mut wide = [0; 2 * LIMBS];
+        wide[..LIMBS].copy_from_slice(&self.0);
+        limbs_to_be_bytes(&reduce(wide, &P, P_INV))
+    }
+
+    /// Performs constant-time addition modulo [`MODULUS`](Self::MODULUS)
+    pub const fn add(self, rhs: Self) -> Self {
+        let (sum, carry) = add_limbs(&self.0, &rhs.0);
+        Self(subtract_modulus(&sum, carry, &P))
+    }
+
+    /// Performs constant-time subtraction modulo [`MODULUS`](Self::MODULUS)
+    pub const fn sub(self, rhs: Self) -> Self {
+        let (difference, borrow) = sub_limbs(&self.0, &rhs.0);
+        // add the modulus back if the subtraction wrapped around
+        let modulus = mask(borrow);
+        let (sum, _) = add_limbs(
+            &difference,
+            &[
+                P[0] & modulus,
+                P[1] & modulus,
+                P[2] & modulus,
+                P[3] & modulus,
+            ],
+        );
+        Self(sum)
+    }
+
+    /// Performs constant-time negation modulo [`MODULUS`](Self::MODULUS)
+    pub const fn neg(self) -> Self {
+        Self::ZERO.sub(self)
+    }
+
+    /// Performs constant-time multiplication modulo [`MODULUS`](Self::MODULUS)
+    pub const fn mul(self, rhs: Self) -> Self {
+        Self(reduce(mul_wide(&self.0, &rhs.0), &P, P_INV))
+    }
+
+    /// Returns `self * self`
+    ///
+    /// This is faster than multiplying `self` by itself.
+    pub const fn square(self) -> Self {
+        Self(reduce(square_wide(&self.0), &P, P_INV))
+    }
+
+    /// Returns `self` squared `n` times
+    const fn square_times(mut self, n: usize) -> Self {
+        let mut i = 0;
+        while i < n {
+            self = self.square();
+            i += 1;
+        }
+        self
+    }
+
+    /// Returns the multiplicative inverse of `self`
+    ///
+    /// The inverse of zero doesn't exist, so zero is returned instead.
+    ///
+    /// By Fermat's little theorem, the inverse of `x` is x^(p - 2). That power is computed with
+    /// a fixed addition chain, so the time taken doesn't depend on `self`.
+    pub const fn invert(self) -> Self {
+        // x_n is self^(2^n - 1), which is `n` ones in binary
+        let x1 = self;
+        let x2 = x1.square().mul(x1);
+        let x3 = x2.square().mul(x1);
+        let x6 = x3.square_times(3).mul(x3);
+        let x12 = x6.square_times(6).mul(x6);
+        let x15 = x12.square_times(3).mul(x3);
+        let x30 = x15.square_times(15).mul(x15);
+        let x32 = x30.square_times(2).mul(x2);
+
+        // p - 2 is 32 ones, 31 zeros, a one, 96 zeros, 94 ones, a zero, and a one
+        let power = x32.square_times(32).mul(x1);
+        let power = power.square_times(96 + 32).mul(x32);
+        let power = power.square_times(32).mul(x32);
+        let power = power.square_times(30).mul(x30);
+        power.square_times(2).mul(x1)
+    }
+
+    /// Returns whether `self` is zero, in constant time
+    pub fn is_zero(self) -> bool {
+        let bits = self.0.iter().fold(0, |bits, limb| bits | limb);
+        core::hint::black_box(bits) == 0
+    }
+
+    /// Returns `if_set` if every bit of `condition` is set, and `if_clear` if none are
+    fn select(condition: u64, if_set: Self, if_clear: Self) -> Self {
+        let mut limbs = [0; LIMBS];
+        for (i, limb) in limbs.iter_mut().enumerate() {
+            *limb = (if_set.0[i] & condition) | (if_clear.0[i] & !condition);
+        }
+        Self(limbs)
+    }
+}
+
+impl TryFrom<BigInt<4>> for FieldElement {
+    type Error = InputTooLargeError;
+    /// Converts `value` into a field element, as long as it is less than
+    /// [`MODULUS`](Self::MODULUS)
+    fn try_from(value: BigInt<4>) -> Result<Self, Self::Error> {
+        // the words of `BigInt` are big-endian
+        let limbs = [value[3], value[2], value[1], value[0]];
+        if !sub_limbs(&limbs, &P).1 {
+            return Err(InputTooLargeError);
+        }
+        Ok(Self::from_limbs(limbs))
+    }
+}
+
+impl From<FieldElement> for BigInt<4> {
+    /// Converts `value` out of Montgomery form
+    fn from(value: FieldElement) -> Self {
+        let mut wide = [0; 2 * LIMBS];
+        wide[..LIMBS].copy_from_slice(&value.0);
+        let [l0, l1, l2, l3] = reduce(wide, &P, P_INV);
+        BigInt::new([l3, l2, l1, l0])
+    }
 }
 
 impl Add for FieldElement {
     type Output = Self;
     /// Performs constant-time addition modulo [`MODULUS`](Self::MODULUS)
     fn add(self, rhs: Self) -> Self::Output {
-        Self(self.0 + rhs.0) - Self::MODULUS
+        FieldElement::add(self, rhs)
     }
 }
 
@@ -26,20 +266,1127 @@ impl Sub for FieldElement {
     type Output = Self;
     /// Performs constant-time subtraction modulo [`MODULUS`](Self::MODULUS)
     fn sub(self, rhs: Self) -> Self::Output {
-        let (difference, carry) = self.0.overflowing_sub(rhs.0);
-        Self(difference + Self::MODULUS.0 * carry)
-        // todo!()
+        FieldElement::sub(self, rhs)
+    }
+}
+
+impl Neg for FieldElement {
+    type Output = Self;
+    /// Performs constant-time negation modulo [`MODULUS`](Self::MODULUS)
+    fn neg(self) -> Self::Output {
+        FieldElement::neg(self)
     }
 }
 
-// TODO: use montgomery field for more efficient modular multiplication
 impl Mul for FieldElement {
     type Output = Self;
-    /// Performs subtraction modulo [`MODULUS`](Self::MODULUS)
+    /// Performs constant-time multiplication modulo [`MODULUS`](Self::MODULUS)
+    fn mul(self, rhs: Self) -> Self::Output {
+        FieldElement::mul(self, rhs)
+    }
+}
+
+/// The order of the curve, n, as little-endian limbs
+const N: [u64; LIMBS] = [
+    0xf3b9cac2fc632551,
+    0xbce6faada7179e84,
+    0xffffffffffffffff,
+    0xffffffff00000000,
+];
+
+/// -n^-1 modulo 2^64
+const N_INV: u64 = 0xccd1c8aaee00bc4f;
+
+/// R^2 modulo n, used to convert into Montgomery form
+const N_R_SQUARED: [u64; LIMBS] = [
+    0x83244c95be79eea2,
+    0x4699799c49bd6fa6,
+    0x2845b2392b6bec59,
+    0x66e12d94f3d95620,
+];
+
+/// An integer modulo the order of the curve, [`ORDER`](Self::ORDER)
+///
+/// Like [`FieldElement`], it is kept in Montgomery form and always fully reduced.
+/// Every operation is constant-time.
+#[derive(Debug, PartialEq, Eq, Clone, Copy)]
+pub struct Scalar([u64; LIMBS]);
+
+impl Scalar {
+    /// The order of the curve, which is the number of points on it
+    pub const ORDER: BigInt<4> = BigInt::new([N[3], N[2], N[1], N[0]]);
+
+    /// The additive identity
+    pub const ZERO: Self = Self([0; LIMBS]);
+
+    /// The multiplicative identity
     ///
-    // TODO: fix this doc link
-    /// WARNING: because [`BigInt::div`](crate::big_int::BigInt::div) is not yet constant-time, neither is this operation
+    /// In Montgomery form, this is R modulo n.
+    pub const ONE: Self = Self([
+        0x0c46353d039cdaaf,
+        0x4319055258e8617b,
+        0x0000000000000000,
+        0x00000000ffffffff,
+    ]);
+
+    /// Decodes a big-endian integer into a scalar
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if `bytes` is not less than [`ORDER`](Self::ORDER).
+    pub fn from_be_bytes(bytes: &[u8; ELEMENT_SIZE]) -> Result<Self, InputTooLargeError> {
+        let limbs = limbs_from_be_bytes(bytes);
+        if !sub_limbs(&limbs, &N).1 {
+            return Err(InputTooLargeError);
+        }
+        Ok(Self::from_limbs(limbs))
+    }
+
+    /// Decodes a big-endian integer into a scalar, reducing it modulo [`ORDER`](Self::ORDER)
+    pub fn from_be_bytes_reduced(bytes: &[u8; ELEMENT_SIZE]) -> Self {
+        // 2^256 is less than twice the order, so one subtraction is enough
+        let limbs = subtract_modulus(&limbs_from_be_bytes(bytes), false, &N);
+        Self::from_limbs(limbs)
+    }
+
+    /// Converts little-endian limbs, which must be less than n, into Montgomery form
+    fn from_limbs(limbs: [u64; LIMBS]) -> Self {
+        Self(reduce(mul_wide(&limbs, &N_R_SQUARED), &N, N_INV))
+    }
+
+    /// Encodes `self` as a big-endian integer
+    pub fn to_be_bytes(self) -> [u8; ELEMENT_SIZE] {
+        let mut wide = [0; 2 * LIMBS];
+        wide[..LIMBS].copy_from_slice(&self.0);
+        limbs_to_be_bytes(&reduce(wide, &N, N_INV))
+    }
+
+    /// Returns whether `self` is zero, in constant time
+    pub fn is_zero(self) -> bool {
+        FieldElement(self.0).is_zero()
+    }
+
+    /// Returns the multiplicative inverse of `self`
+    ///
+    /// The inverse of zero doesn't exist, so zero is returned instead.
+    ///
+    /// By Fermat's little theorem, the inverse of `x` is x^(n - 2). That power is computed
+    /// 4 bits of the exponent at a time. The exponent is fixed, so the time taken doesn't depend
+    /// on `self`.
+    pub fn invert(self) -> Self {
+        // powers[i] is self^i
+        let mut powers = [Self::ONE; 16];
+        for i in 1..powers.len() {
+            powers[i] = powers[i - 1] * self;
+        }
+
+        let mut exponent = N;
+        exponent[0] -= 2;
+        let mut power = powers[0];
+        for limb in exponent.iter().rev() {
+            for shift in (0..64).step_by(4).rev() {
+                for _ in 0..4 {
+                    power = power * power;
+                }
+                power = power * powers[(limb >> shift) as usize & 0xf];
+            }
+        }
+        power
+    }
+}
+
+impl Add for Scalar {
+    type Output = Self;
+    /// Performs constant-time addition modulo [`ORDER`](Self::ORDER)
+    fn add(self, rhs: Self) -> Self::Output {
+        let (sum, carry) = add_limbs(&self.0, &rhs.0);
+        Self(subtract_modulus(&sum, carry, &N))
+    }
+}
+
+impl Mul for Scalar {
+    type Output = Self;
+    /// Performs constant-time multiplication modulo [`ORDER`](Self::ORDER)
     fn mul(self, rhs: Self) -> Self::Output {
-        Self(((self.0 * rhs.0) / Self::MODULUS.0.into()).1)
+        Self(reduce(mul_wide(&self.0, &rhs.0), &N, N_INV))
+    }
+}
+
+/// Splits a big-endian integer into little-endian limbs
+fn limbs_from_be_bytes(bytes: &[u8; ELEMENT_SIZE]) -> [u64; LIMBS] {
+    let mut limbs = [0; LIMBS];
+    // TODO: use `array_chunks` once stabilized
+    for (limb, chunk) in limbs.iter_mut().rev().zip(bytes.chunks_exact(8)) {
+        // we can safely unwrap because the chunk is guaranteed to have a length of 8
+        *limb = u64::from_be_bytes(chunk.try_into().unwrap());
+    }
+    limbs
+}
+
+/// Joins little-endian limbs into a big-endian integer
+fn limbs_to_be_bytes(limbs: &[u64; LIMBS]) -> [u8; ELEMENT_SIZE] {
+    let mut bytes = [0; ELEMENT_SIZE];
+    // TODO: use `array_chunks` once stabilized
+    for (chunk, limb) in bytes.chunks_exact_mut(8).zip(limbs.iter().rev()) {
+        chunk.copy_from_slice(&limb.to_be_bytes());
+    }
+    bytes
+}
+
+/// Returns all ones if `condition` is true, and zero otherwise
+///
+/// The compiler must not know the result is one of two values, or it might introduce a branch.
+const fn mask(condition: bool) -> u64 {
+    core::hint::black_box((condition as u64).wrapping_neg())
+}
+
+/// Returns `x * y + z + carry`, split into its low and high halves
+#[inline(always)]
+const fn mul_add(x: u64, y: u64, z: u64, carry: u64) -> (u64, u64) {
+    // this can't overflow, because (2^64 - 1)^2 + 2 * (2^64 - 1) = 2^128 - 1
+    let (low, high) = carry_mul(x, y, carry);
+    let (low, overflowed) = carry_add(low, z, false);
+    (low, high + overflowed as u64)
+}
+
+// `for` loops can't be used in a `const fn`, so the following functions use `while` loops
+
+/// Returns `x + y` and whether the addition overflowed
+#[inline(always)]
+const fn add_limbs(x: &[u64; LIMBS], y: &[u64; LIMBS]) -> ([u64; LIMBS], bool) {
+    let mut sum = [0; LIMBS];
+    let mut carry = false;
+    let mut i = 0;
+    while i < LIMBS {
+        (sum[i], carry) = carry_add(x[i], y[i], carry);
+        i += 1;
+    }
+    (sum, carry)
+}
+
+/// Returns `x - y` and whether the subtraction underflowed
+#[inline(always)]
+const fn sub_limbs(x: &[u64; LIMBS], y: &[u64; LIMBS]) -> ([u64; LIMBS], bool) {
+    let mut difference = [0; LIMBS];
+    let mut borrow = false;
+    let mut i = 0;
+    while i < LIMBS {
+        (difference[i], borrow) = carry_sub(x[i], y[i], borrow);
+        i += 1;
+    }
+    (difference, borrow)
+}
+
+/// Fully reduces `x` (plus 2^256 if `carry` is set), which must be less than twice `modulus`
+#[inline(always)]
+const fn subtract_modulus(x: &[u64; LIMBS], carry: bool, modulus: &[u64; LIMBS]) -> [u64; LIMBS] {
+    let (difference, borrow) = sub_limbs(x, modulus);
+    // the subtraction is kept if it didn't wrap around,
+    // or if there was a carry for it to wrap around from
+    let keep = mask(carry | !borrow);
+    let mut result = [0; LIMBS];
+    let mut i = 0;
+    while i < LIMBS {
+        result[i] = (difference[i] & keep) | (x[i] & !keep);
+        i += 1;
+    }
+    result
+}
+
+/// Returns the full product `x * y`
+#[inline(always)]
+const fn mul_wide(x: &[u64; LIMBS], y: &[u64; LIMBS]) -> [u64; 2 * LIMBS] {
+    let mut product = [0; 2 * LIMBS];
+    let mut i = 0;
+    while i < LIMBS {
+        let mut carry = 0;
+        let mut j = 0;
+        while j < LIMBS {
+            (product[i + j], carry) = mul_add(x[i], y[j], product[i + j], carry);
+            j += 1;
+        }
+        product[i + LIMBS] = carry;
+        i += 1;
+    }
+    product
+}
+
+/// Returns the full product `x * x`
+///
+/// Each product of two different limbs appears twice, so it is only computed once and doubled.
+#[inline(always)]
+const fn square_wide(x: &[u64; LIMBS]) -> [u64; 2 * LIMBS] {
+    let mut product = [0; 2 * LIMBS];
+    let mut i = 0;
+    while i < LIMBS {
+        let mut carry = 0;
+        let mut j = i + 1;
+        while j < LIMBS {
+            (product[i + j], carry) = mul_add(x[i], x[j], product[i + j], carry);
+            j += 1;
+        }
+        product[i + LIMBS] = carry;
+        i += 1;
+    }
+
+    // the products of different limbs add up to less than 2^511, so doubling them can't overflow
+    let mut i = 2 * LIMBS - 1;
+    while i > 0 {
+        product[i] = (product[i] << 1) | (product[i - 1] >> 63);
+        i -= 1;
+    }
+    product[0] <<= 1;
+
+    let mut carry = false;
+    let mut i = 0;
+    while i < LIMBS {
+        let (low, high) = carry_mul(x[i], x[i], 0);
+        (product[2 * i], carry) = carry_add(product[2 * i], low, carry);
+        (product[2 * i + 1], carry) = carry_add(product[2 * i + 1], high, carry);
+        i += 1;
+    }
+    product
+}
+
+/// Returns `x / R` modulo `modulus`, fully reduced
+///
+/// `x` must be less than `modulus * R`, and `modulus_inv` must be -`modulus`^-1 modulo 2^64.
+///
+/// Each step adds the multiple of `modulus` that clears the lowest remaining limb of `x`,
+/// so that after all the steps, the low half of `x` is zero and can be dropped.
+#[inline(always)]
+const fn reduce(mut x: [u64; 2 * LIMBS], modulus: &[u64; LIMBS], modulus_inv: u64) -> [u64; LIMBS] {
+    // the carry out of the top of `x`, which can be at most 1
+    let mut top = 0;
+    let mut i = 0;
+    while i < LIMBS {
+        let multiplier = x[i].wrapping_mul(modulus_inv);
+        let mut carry = 0;
+        let mut j = 0;
+        while j < LIMBS {
+            (x[i + j], carry) = mul_add(multiplier, modulus[j], x[i + j], carry);
+            j += 1;
+        }
+        // at most one of these can overflow
+        let (sum, overflowed1) = carry_add(x[i + LIMBS], carry, false);
+        let (sum, overflowed2) = carry_add(sum, top, false);
+        x[i + LIMBS] = sum;
+        top = (overflowed1 | overflowed2) as u64;
+        i += 1;
+    }
+    let result = [x[LIMBS], x[LIMBS + 1], x[LIMBS + 2], x[LIMBS + 3]];
+    subtract_modulus(&result, top != 0, modulus)
+}
+
+/// The coefficient b of the curve equation, y^2 = x^3 - 3x + b
+const B: FieldElement = FieldElement::from_limbs([
+    0x3bce3c3e27d2604b,
+    0x651d06b0cc53b0f6,
+    0xb3ebbd55769886bc,
+    0x5ac635d8aa3a93e7,
+]);
+
+/// A point on the curve
+///
+/// Internally, it uses projective coordinates (X : Y : Z), which stand for the affine point
+/// (X / Z, Y / Z). This avoids an inversion for every operation. The identity is (0 : 1 : 0).
+///
+/// Points are added with the complete formulas of Renes, Costello, and Batina
+/// (<https://eprint.iacr.org/2015/1060>, algorithms 4 to 6). They have no special cases,
+/// such as a point being added to itself or to the identity, so they are constant-time.
+#[derive(Debug, Clone, Copy)]
+pub struct Point {
+    x: FieldElement,
+    y: FieldElement,
+    z: FieldElement,
+}
+
+impl Point {
+    /// The identity, or point at infinity
+    pub const IDENTITY: Self = Self {
+        x: FieldElement::ZERO,
+        y: FieldElement::ONE,
+        z: FieldElement::ZERO,
+    };
+
+    /// The generator, or base point
+    pub const G: Self = Self {
+        x: FieldElement::from_limbs([
+            0xf4a13945d898c296,
+            0x77037d812deb33a0,
+            0xf8bce6e563a440f2,
+            0x6b17d1f2e12c4247,
+        ]),
+        y: FieldElement::from_limbs([
+            0xcbb6406837bf51f5,
+            0x2bce33576b315ece,
+            0x8ee7eb4a7c0f9e16,
+            0x4fe342e2fe1a7f9b,
+        ]),
+        z: FieldElement::ONE,
+    };
+
+    /// Constructs a point from its affine coordinates
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if (`x`, `y`) is not on the curve.
+    pub fn from_affine(x: FieldElement, y: FieldElement) -> Result<Self, InvalidPoint> {
+        let three = FieldElement::ONE + FieldElement::ONE + FieldElement::ONE;
+        let rhs = (x.square() - three) * x + B;
+        if y.square() != rhs {
+            return Err(InvalidPoint);
+        }
+        Ok(Self {
+            x,
+            y,
+            z: FieldElement::ONE,
+        })
+    }
+
+    /// Decodes an uncompressed point, as specified by SEC 1
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if `bytes` is not an uncompressed point on the curve.
+    pub fn from_uncompressed(bytes: &[u8; POINT_SIZE]) -> Result<Self, InvalidPoint> {
+        if bytes[0] != 0x04 {
+            return Err(InvalidPoint);
+        }
+        // we can safely unwrap because the slices are guaranteed to have a length of 32
+        let x = FieldElement::from_be_bytes(bytes[1..33].try_into().unwrap());
+        let y = FieldElement::from_be_bytes(bytes[33..].try_into().unwrap());
+        match (x, y) {
+            (Ok(x), Ok(y)) => Self::from_affine(x, y),
+            _ => Err(InvalidPoint),
+        }
+    }
+
+    /// Returns the affine coordinates of `self`, or `None` if `self` is the identity
+    pub fn to_affine(self) -> Option<(FieldElement, FieldElement)> {
+        if self.is_identity() {
+            return None;
+        }
+        let z_inv = self.z.invert();
+        Some((self.x * z_inv, self.y * z_inv))
+    }
+
+    /// Encodes `self` as an uncompressed point, as specified by SEC 1,
+    /// or returns `None` if `self` is the identity
+    pub fn to_uncompressed(self) -> Option<[u8; POINT_SIZE]> {
+        let (x, y) = self.to_affine()?;
+        let mut bytes = [0; POINT_SIZE];
+        bytes[0] = 0x04;
+        bytes[1..33].copy_from_slice(&x.to_be_bytes());
+        bytes[33..].copy_from_slice(&y.to_be_bytes());
+        Some(bytes)
+    }
+
+    /// Returns whether `self` is the identity
+    pub fn is_identity(self) -> bool {
+        self.z.is_zero()
+    }
+
+    /// Returns `self + rhs`
+    pub const fn add(self, rhs: Self) -> Self {
+        let (x1, y1, z1) = (self.x, self.y, self.z);
+        let (x2, y2, z2) = (rhs.x, rhs.y, rhs.z);
+        let t0 = x1.mul(x2);
+        let t1 = y1.mul(y2);
+        let t2 = z1.mul(z2);
+        let t3 = x1.add(y1).mul(x2.add(y2)).sub(t0.add(t1));
+        let t4 = y1.add(z1).mul(y2.add(z2)).sub(t1.add(t2));
+        let y3 = x1.add(z1).mul(x2.add(z2)).sub(t0.add(t2));
+        let x3 = y3.sub(B.mul(t2));
+        let x3 = x3.add(x3).add(x3);
+        let z3 = t1.sub(x3);
+        let x3 = t1.add(x3);
+        let y3 = B.mul(y3);
+        let t2 = t2.add(t2).add(t2);
+        let y3 = y3.sub(t2).sub(t0);
+        let y3 = y3.add(y3).add(y3);
+        let t0 = t0.add(t0).add(t0).sub(t2);
+        Self {
+            x: t3.mul(x3).sub(t4.mul(y3)),
+            y: x3.mul(z3).add(t0.mul(y3)),
+            z: t4.mul(z3).add(t3.mul(t0)),
+        }
+    }
+
+    /// Returns `self + rhs`, where `rhs` must not be the identity
+    const fn add_affine(self, rhs: &AffinePoint) -> Self {
+        let (x1, y1, z1) = (self.x, self.y, self.z);
+        let (x2, y2) = (rhs.x, rhs.y);
+        let t0 = x1.mul(x2);
+        let t1 = y1.mul(y2);
+        let t3 = x2.add(y2).mul(x1.add(y1)).sub(t0.add(t1));
+        let t4 = y2.mul(z1).add(y1);
+        let y3 = x2.mul(z1).add(x1);
+        let x3 = y3.sub(B.mul(z1));
+        let x3 = x3.add(x3).add(x3);
+        let z3 = t1.sub(x3);
+        let x3 = t1.add(x3);
+        let y3 = B.mul(y3);
+        let t2 = z1.add(z1).add(z1);
+        let y3 = y3.sub(t2).sub(t0);
+        let y3 = y3.add(y3).add(y3);
+        let t0 = t0.add(t0).add(t0).sub(t2);
+        Self {
+            x: t3.mul(x3).sub(t4.mul(y3)),
+            y: x3.mul(z3).add(t0.mul(y3)),
+            z: t4.mul(z3).add(t3.mul(t0)),
+        }
+    }
+
+    /// Returns `self + self`
+    ///
+    /// This is faster than adding `self` to itself.
+    pub const fn double(self) -> Self {
+        let (x, y, z) = (self.x, self.y, self.z);
+        let t0 = x.square();
+        let t1 = y.square();
+        let t2 = z.square();
+        let t3 = x.mul(y);
+        let t3 = t3.add(t3);
+        let z3 = x.mul(z);
+        let z3 = z3.add(z3);
+        let y3 = B.mul(t2).sub(z3);
+        let y3 = y3.add(y3).add(y3);
+        let x3 = t1.sub(y3);
+        let y3 = x3.mul(t1.add(y3));
+        let x3 = x3.mul(t3);
+        let t2 = t2.add(t2).add(t2);
+        let z3 = B.mul(z3).sub(t2).sub(t0);
+        let z3 = z3.add(z3).add(z3);
+        let t0 = t0.add(t0).add(t0).sub(t2);
+        let y3 = y3.add(t0.mul(z3));
+        let t0 = y.mul(z);
+        let t0 = t0.add(t0);
+        let x3 = x3.sub(t0.mul(z3));
+        let z3 = t0.mul(t1);
+        let z3 = z3.add(z3);
+        Self {
+            x: x3,
+            y: y3,
+            z: z3.add(z3),
+        }
+    }
+
+    /// Returns `if_set` if every bit of `condition` is set, and `if_clear` if none are
+    fn select(condition: u64, if_set: &Self, if_clear: &Self) -> Self {
+        Self {
+            x: FieldElement::select(condition, if_set.x, if_clear.x),
+            y: FieldElement::select(condition, if_set.y, if_clear.y),
+            z: FieldElement::select(condition, if_set.z, if_clear.z),
+        }
+    }
+
+    /// Returns `scalar` times the generator, [`G`](Self::G)
+    ///
+    /// `scalar` is a big-endian integer. This is faster than [`mul_scalar`](Self::mul_scalar),
+    /// because multiples of `G` are precomputed in [`BASE_TABLE`].
+    pub fn mul_base(scalar: &[u8; ELEMENT_SIZE]) -> Self {
+        let mut product = Self::IDENTITY;
+        for column in (0..SPACING).rev() {
+            if column != SPACING - 1 {
+                product = product.double();
+            }
+            for (comb, multiples) in BASE_TABLE.iter().enumerate() {
+                let digit = teeth(scalar, comb, column);
+                let sum = product.add_affine(&AffinePoint::lookup(multiples, digit));
+                // the table has no entry for zero, so nothing is added
+                product = Self::select(mask(digit != 0), &sum, &product);
+            }
+        }
+        product
+    }
+
+    /// Returns `scalar` times `self`
+    ///
+    /// `scalar` is a big-endian integer.
+    pub fn mul_scalar(self, scalar: &[u8; ELEMENT_SIZE]) -> Self {
+        // multiples[i] is i * self
+        let mut multiples = [Self::IDENTITY; 1 << WINDOW_BITS];
+        multiples[1] = self;
+        for i in 2..multiples.len() {
+            multiples[i] = match i % 2 {
+                0 => multiples[i / 2].double(),
+                _ => multiples[i - 1].add(self),
+            };
+        }
+
+        let mut product = Self::IDENTITY;
+        for i in (0..WINDOWS).rev() {
+            for _ in 0..WINDOW_BITS {
+                product = product.double();
+            }
+            let digit = window(scalar, i);
+            let mut multiple = Self::IDENTITY;
+            for (j, candidate) in multiples.iter().enumerate() {
+                multiple = Self::select(mask(j == digit), candidate, &multiple);
+            }
+            product = product.add(multiple);
+        }
+        product
+    }
+
+    /// Returns `base_scalar` times the generator, [`G`](Self::G), plus `scalar` times `self`
+    ///
+    /// The scalars are big-endian integers. This is much faster than [`mul_base`](Self::mul_base)
+    /// and [`mul_scalar`](Self::mul_scalar) separately: both multiplications share their
+    /// doublings, and the scalars are in non-adjacent form, which needs fewer additions.
+    ///
+    /// WARNING: this is NOT constant-time, so it must only be used with public values,
+    /// such as when verifying a signature.
+    pub fn mul_base_and_scalar_vartime(
+        self,
+        base_scalar: &[u8; ELEMENT_SIZE],
+        scalar: &[u8; ELEMENT_SIZE],
+    ) -> Self {
+        let base_digits = non_adjacent_form::<BASE_NAF_WIDTH>(base_scalar);
+        let digits = non_adjacent_form::<NAF_WIDTH>(scalar);
+
+        // odd_multiples[i] is (2 * i + 1) * self
+        let mut odd_multiples = [self; 1 << (NAF_WIDTH - 2)];
+        let double = self.double();
+        for i in 1..odd_multiples.len() {
+            odd_multiples[i] = odd_multiples[i - 1].add(double);
+        }
+
+        let mut product = Self::IDENTITY;
+        // nothing needs doubling until the first digit that isn't zero
+        let Some(top) = (0..digits.len())
+            .rev()
+            .find(|&i| base_digits[i] != 0 || digits[i] != 0)
+        else {
+            return product;
+        };
+        for i in (0..=top).rev() {
+            product = product.double();
+            let digit = base_digits[i];
+            if digit != 0 {
+                let mut multiple = BASE_ODD_MULTIPLES[digit.unsigned_abs() as usize / 2];
+                if digit < 0 {
+                    multiple.y = -multiple.y;
+                }
+                product = product.add_affine(&multiple);
+            }
+            let digit = digits[i];
+            if digit != 0 {
+                let multiple = odd_multiples[digit.unsigned_abs() as usize / 2];
+                product = match digit < 0 {
+                    true => product.add(-multiple),
+                    false => product.add(multiple),
+                };
+            }
+        }
+        product
+    }
+
+    /// Returns whether the affine x-coordinate of `self` is `x`
+    ///
+    /// This is cheaper than [`to_affine`](Self::to_affine), because it needs no inversion.
+    pub fn has_affine_x(self, x: FieldElement) -> bool {
+        !self.is_identity() && self.x == x * self.z
+    }
+}
+
+impl PartialEq for Point {
+    fn eq(&self, other: &Self) -> bool {
+        // (X1 / Z1, Y1 / Z1) = (X2 / Z2, Y2 / Z2), without the divisions
+        self.x * other.z == other.x * self.z && self.y * other.z == other.y * self.z
+    }
+}
+
+impl Eq for Point {}
+
+impl Add for Point {
+    type Output = Self;
+    fn add(self, rhs: Self) -> Self::Output {
+        Point::add(self, rhs)
+    }
+}
+
+impl Neg for Point {
+    type Output = Self;
+    fn neg(self) -> Self::Output {
+        Self { y: -self.y, ..self }
+    }
+}
+
+/// The number of bits of the scalar in each window of [`Point::mul_scalar`]
+const WINDOW_BITS: usize = 4;
+
+/// The number of windows in a scalar
+const WINDOWS: usize = 8 * ELEMENT_SIZE / WINDOW_BITS;
+
+/// Returns the `i`th window of `scalar`, counting from the least significant
+fn window(scalar: &[u8; ELEMENT_SIZE], i: usize) -> usize {
+    let byte = scalar[ELEMENT_SIZE - 1 - i / 2];
+    (byte as usize >> (WINDOW_BITS * (i % 2))) & ((1 << WINDOW_BITS) - 1)
+}
+
+/// A point that isn't the identity, in affine coordinates
+///
+/// Adding one of these to a [`Point`] is cheaper than adding two [`Point`]s.
+#[derive(Clone, Copy)]
+struct AffinePoint {
+    x: FieldElement,
+    y: FieldElement,
+}
+
+impl AffinePoint {
+    /// Returns `multiples[digit - 1]`, reading every entry so that the time taken and the memory
+    /// accessed don't depend on `digit`
+    ///
+    /// If `digit` is zero, the result is meaningless.
+    fn lookup(multiples: &[AffinePoint; MULTIPLES], digit: usize) -> Self {
+        let mut result = multiples[0];
+        for (j, candidate) in multiples.iter().enumerate() {
+            let condition = mask(j + 1 == digit);
+            result.x = FieldElement::select(condition, candidate.x, result.x);
+            result.y = FieldElement::select(condition, candidate.y, result.y);
+        }
+        result
+    }
+}
+
+/// The number of teeth of each comb, which is the number of bits of the scalar looked up at once
+const TEETH: usize = 4;
+
+/// The number of combs
+const COMBS: usize = 2;
+
+/// The distance between the teeth of a comb, in bits
+const SPACING: usize = 8 * ELEMENT_SIZE / (TEETH * COMBS);
+
+/// The number of multiples of G precomputed for each comb
+const MULTIPLES: usize = (1 << TEETH) - 1;
+
+/// Returns the bits of `scalar` under the teeth of `comb`, when it is at `column`
+///
+/// Tooth `t` of comb `c` is at bit `column + SPACING * (c + COMBS * t)`,
+/// so together, the combs cover every bit of `scalar` as `column` goes from 0 to `SPACING` - 1.
+fn teeth(scalar: &[u8; ELEMENT_SIZE], comb: usize, column: usize) -> usize {
+    let mut digit = 0;
+    for tooth in 0..TEETH {
+        let bit = column + SPACING * (comb + COMBS * tooth);
+        let byte = scalar[ELEMENT_SIZE - 1 - bit / 8];
+        digit |= ((byte as usize >> (bit % 8)) & 1) << tooth;
+    }
+    digit
+}
+
+/// The multiples of G under each comb
+///
+/// `BASE_TABLE[c][d - 1]` is the sum of 2^(`SPACING` * (`c` + `COMBS` * `t`)) * G over every
+/// bit `t` set in `d`. This means [`Point::mul_base`] only needs `SPACING` - 1 doublings,
+/// and the whole table is small enough to stay in L1 cache.
+static BASE_TABLE: [[AffinePoint; MULTIPLES]; COMBS] = base_table();
+
+/// Computes [`BASE_TABLE`]
+const fn base_table() -> [[AffinePoint; MULTIPLES]; COMBS] {
+    // powers[k] is 2^(SPACING * k) * G
+    let mut powers = [Point::G; TEETH * COMBS];
+    let mut k = 1;
+    while k < TEETH * COMBS {
+        powers[k] = powers[k - 1];
+        let mut i = 0;
+        while i < SPACING {
+            powers[k] = powers[k].double();
+            i += 1;
+        }
+        k += 1;
+    }
+
+    // the multiples for comb `c` start at `c` * `MULTIPLES`
+    let mut points = [Point::IDENTITY; COMBS * MULTIPLES];
+    let mut comb = 0;
+    while comb < COMBS {
+        let multiples = comb * MULTIPLES;
+        let mut digit = 1;
+        while digit <= MULTIPLES {
+            // each multiple is a smaller one plus the power for the highest tooth
+            let tooth = digit.ilog2() as usize;
+            let power = powers[comb + COMBS * tooth];
+            let rest = digit - (1 << tooth);
+            points[multiples + digit - 1] = match rest {
+                0 => power,
+                _ => points[multiples + rest - 1].add(power),
+            };
+            digit += 1;
+        }
+        comb += 1;
+    }
+
+    let points = to_affine_batch(&points);
+    let mut table = [[points[0]; MULTIPLES]; COMBS];
+    let mut k = 0;
+    while k < COMBS * MULTIPLES {
+        table[k / MULTIPLES][k % MULTIPLES] = points[k];
+        k += 1;
+    }
+    table
+}
+
+/// The width of the non-adjacent form of the scalar multiplying G
+/// in [`Point::mul_base_and_scalar_vartime`]
+const BASE_NAF_WIDTH: usize = 7;
+
+/// The width of the non-adjacent form of the other scalar
+/// in [`Point::mul_base_and_scalar_vartime`]
+const NAF_WIDTH: usize = 5;
+
+/// `BASE_ODD_MULTIPLES[i]` is (2 * `i` + 1) * G
+static BASE_ODD_MULTIPLES: [AffinePoint; 1 << (BASE_NAF_WIDTH - 2)] = {
+    let mut points = [Point::G; 1 << (BASE_NAF_WIDTH - 2)];
+    let double = Point::G.double();
+    let mut i = 1;
+    while i < points.len() {
+        points[i] = points[i - 1].add(double);
+        i += 1;
+    }
+    to_affine_batch(&points)
+};
+
+/// Converts each of `points`, none of which can be the identity, to affine coordinates
+///
+/// Every Z coordinate is inverted together, with Montgomery's trick,
+/// so this costs a single inversion.
+const fn to_affine_batch<const N: usize>(points: &[Point; N]) -> [AffinePoint; N] {
+    // products[k] is the product of the Z coordinates of the first `k` points
+    let mut products = [FieldElement::ONE; N];
+    let mut k = 1;
+    while k < N {
+        products[k] = products[k - 1].mul(points[k - 1].z);
+        k += 1;
+    }
+    // the inverse of the product of the Z coordinates of the first `k` + 1 points
+    let mut inverse = products[N - 1].mul(points[N - 1].z).invert();
+
+    let mut affine = [AffinePoint {
+        x: FieldElement::ZERO,
+        y: FieldElement::ZERO,
+    }; N];
+    let mut k = N;
+    while k > 0 {
+        k -= 1;
+        let z_inv = inverse.mul(products[k]);
+        inverse = inverse.mul(points[k].z);
+        affine[k] = AffinePoint {
+            x: points[k].x.mul(z_inv),
+            y: points[k].y.mul(z_inv),
+        };
+    }
+    affine
+}
+
+/// Returns the width-`WIDTH` non-adjacent form of `scalar`, least significant digit first
+///
+/// Each digit is either zero or odd and less than 2^(`WIDTH` - 1) in absolute value,
+/// and any `WIDTH` consecutive digits have at most one that isn't zero.
+/// The sum of each digit times 2^(its index) is `scalar`.
+///
+/// WARNING: this is NOT constant-time.
+fn non_adjacent_form<const WIDTH: usize>(
+    scalar: &[u8; ELEMENT_SIZE],
+) -> [i8; 8 * ELEMENT_SIZE + 1] {
+    // an extra limb leaves room for the carries
+    let mut k = [0u64; LIMBS + 1];
+    k[..LIMBS].copy_from_slice(&limbs_from_be_bytes(scalar));
+
+    let mut digits = [0; 8 * ELEMENT_SIZE + 1];
+    for digit in digits.iter_mut() {
+        if k[0] & 1 == 1 {
+            let window = (k[0] & ((1 << WIDTH) - 1)) as i64;
+            let value = match window >= 1 << (WIDTH - 1) {
+                true => window - (1 << WIDTH),
+                false => window,
+            };
+            // subtract the digit, which clears the lowest `WIDTH` bits
+            let mut carry = value.unsigned_abs();
+            for limb in k.iter_mut() {
+                let overflowed;
+                (*limb, overflowed) = match value > 0 {
+                    true => limb.overflowing_sub(carry),
+                    false => limb.overflowing_add(carry),
+                };
+                carry = overflowed as u64;
+            }
+            *digit = value as i8;
+        }
+        // shift `k` right by one bit
+        for i in 0..LIMBS {
+            k[i] = (k[i] >> 1) | (k[i + 1] << 63);
+        }
+        k[LIMBS] >>= 1;
+    }
+    digits
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{FieldElement, Point, Scalar};
+    use crate::big_int::BigInt;
+
+    // the coordinates of the generator point
+    const X: BigInt<4> = BigInt::new([
+        0x6b17d1f2e12c4247,
+        0xf8bce6e563a440f2,
+        0x77037d812deb33a0,
+        0xf4a13945d898c296,
+    ]);
+    const Y: BigInt<4> = BigInt::new([
+        0x4fe342e2fe1a7f9b,
+        0x8ee7eb4a7c0f9e16,
+        0x2bce33576b315ece,
+        0xcbb6406837bf51f5,
+    ]);
+
+    // the private key and public key from RFC 6979, section A.2.5
+    const PRIVATE_KEY: [u8; 32] = [
+        0xc9, 0xaf, 0xa9, 0xd8, 0x45, 0xba, 0x75, 0x16, 0x6b, 0x5c, 0x21, 0x57, 0x67, 0xb1, 0xd6,
+        0x93, 0x4e, 0x50, 0xc3, 0xdb, 0x36, 0xe8, 0x9b, 0x12, 0x7b, 0x8a, 0x62, 0x2b, 0x12, 0x0f,
+        0x67, 0x21,
+    ];
+    const PUBLIC_X: [u8; 32] = [
+        0x60, 0xfe, 0xd4, 0xba, 0x25, 0x5a, 0x9d, 0x31, 0xc9, 0x61, 0xeb, 0x74, 0xc6, 0x35, 0x6d,
+        0x68, 0xc0, 0x49, 0xb8, 0x92, 0x3b, 0x61, 0xfa, 0x6c, 0xe6, 0x69, 0x62, 0x2e, 0x60, 0xf2,
+        0x9f, 0xb6,
+    ];
+    const PUBLIC_Y: [u8; 32] = [
+        0x79, 0x03, 0xfe, 0x10, 0x08, 0xb8, 0xbc, 0x99, 0xa4, 0x1a, 0xe9, 0xe9, 0x56, 0x28, 0xbc,
+        0x64, 0xf2, 0xf1, 0xb2, 0x0c, 0x2d, 0x7e, 0x9f, 0x51, 0x77, 0xa3, 0xc2, 0x94, 0xd4, 0x46,
+        0x22, 0x99,
+    ];
+
+    // n - 1, where n is the order of the curve
+    const ORDER_MINUS_ONE: [u8; 32] = [
+        0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63,
+        0x25, 0x50,
+    ];
+
+    fn element(value: BigInt<4>) -> FieldElement {
+        FieldElement::try_from(value).unwrap()
+    }
+
+    fn scalar(value: u16) -> [u8; 32] {
+        let mut scalar = [0; 32];
+        scalar[30..].copy_from_slice(&value.to_be_bytes());
+        scalar
+    }
+
+    #[test]
+    fn conversion() {
+        assert_eq!(BigInt::from(element(X)), X);
+        assert_eq!(element(1u64.into()), FieldElement::ONE);
+        assert!(FieldElement::try_from(FieldElement::MODULUS).is_err());
+        let max = FieldElement::MODULUS - 1u64.into();
+        assert_eq!(BigInt::from(element(max)), max);
+
+        let x = FieldElement::from_be_bytes(&PUBLIC_X).unwrap();
+        assert_eq!(x.to_be_bytes(), PUBLIC_X);
+        assert!(FieldElement::from_be_bytes(&[0xff; 32]).is_err());
+    }
+
+    #[test]
+    fn add_sub() {
+        let sum = BigInt::new([
+            0xbafb14d5df46c1e3,
+            0x87a4d22fdfb3df08,
+            0xa2d1b0d8991c926f,
+            0xc05779ae1058148b,
+        ]);
+        let difference = BigInt::new([
+            0xe4cb70ef1cee3d54,
+            0x962b0465186b5d23,
+            0xb4cab5d73d462b2d,
+            0xd71507225f268f5e,
+        ]);
+        assert_eq!(BigInt::from(element(X) + element(Y)), sum);
+        assert_eq!(BigInt::from(element(Y) - element(X)), difference);
+        assert_eq!(element(X) + -element(X), FieldElement::ZERO);
+        assert_eq!(-FieldElement::ZERO, FieldElement::ZERO);
+    }
+
+    #[test]
+    fn mul() {
+        let product = BigInt::new([
+            0x823cd15f6dd3c719,
+            0x33565064513a6b2b,
+            0xd183e554c6a08622,
+            0xf713ebbbface98be,
+        ]);
+        let square = BigInt::new([
+            0x98f6b84d29bef2b2,
+            0x81819a5e0e3690d8,
+            0x33b699495d694dd1,
+            0x002ae56c426b3f8c,
+        ]);
+        assert_eq!(BigInt::from(element(X) * element(Y)), product);
+        assert_eq!(BigInt::from(element(X).square()), square);
+        assert_eq!(element(X) * element(X), element(X).square());
+        assert_eq!(element(X) * FieldElement::ONE, element(X));
+
+        let max = element(FieldElement::MODULUS - 1u64.into());
+        assert_eq!(max.square(), FieldElement::ONE);
+        assert_eq!(max * max, FieldElement::ONE);
+    }
+
+    #[test]
+    fn invert() {
+        let inverse = BigInt::new([
+            0xe060cbb088706d5d,
+            0x24936933b69b16ab,
+            0x707d656273744b65,
+            0x664c49e577f35238,
+        ]);
+        assert_eq!(BigInt::from(element(X).invert()), inverse);
+        assert_eq!(element(Y).invert() * element(Y), FieldElement::ONE);
+        assert_eq!(FieldElement::ONE.invert(), FieldElement::ONE);
+        assert_eq!(FieldElement::ZERO.invert(), FieldElement::ZERO);
+    }
+
+    #[test]
+    fn point_arithmetic() {
+        let g = Point::G;
+        assert_eq!(Point::from_affine(element(X), element(Y)).unwrap(), g);
+        assert!(Point::from_affine(element(Y), element(X)).is_err());
+
+        assert_eq!(g + Point::IDENTITY, g);
+        assert_eq!(Point::IDENTITY + g, g);
+        assert_eq!(g + g, g.double());
+        assert_eq!(g.double() + g, g + g.double());
+        assert!((g + -g).is_identity());
+        assert!(Point::IDENTITY.double().is_identity());
+        assert!(Point::IDENTITY.to_uncompressed().is_none());
+    }
+
+    #[test]
+    fn mul_base() {
+        let public_key = Point::mul_base(&PRIVATE_KEY).to_uncompressed().unwrap();
+        assert_eq!(public_key[0], 0x04);
+        assert_eq!(public_key[1..33], PUBLIC_X);
+        assert_eq!(public_key[33..], PUBLIC_Y);
+
+        assert!(Point::mul_base(&[0; 32]).is_identity());
+        assert_eq!(Point::mul_base(&scalar(1)), Point::G);
+        assert_eq!(Point::mul_base(&scalar(3)), Point::G.double() + Point::G);
+        assert_eq!(Point::mul_base(&ORDER_MINUS_ONE), -Point::G);
+    }
+
+    #[test]
+    fn mul_scalar() {
+        let g = Point::G;
+        assert_eq!(g.mul_scalar(&PRIVATE_KEY), Point::mul_base(&PRIVATE_KEY));
+        assert_eq!(g.mul_scalar(&ORDER_MINUS_ONE), -g);
+        assert!(g.mul_scalar(&[0; 32]).is_identity());
+        assert!(Point::IDENTITY.mul_scalar(&PRIVATE_KEY).is_identity());
+
+        let point = g.mul_scalar(&scalar(0xab));
+        assert_eq!(
+            point.mul_scalar(&scalar(2)),
+            Point::mul_base(&scalar(0x156))
+        );
+        assert_eq!(
+            point.mul_scalar(&scalar(0x10)),
+            g.mul_scalar(&scalar(0xab0))
+        );
+    }
+
+    #[test]
+    fn ecdh() {
+        let peer_private_key = [
+            0x5f, 0x9b, 0x9a, 0x2b, 0x3d, 0x8a, 0x3a, 0x0c, 0x4e, 0x4d, 0xb8, 0xee, 0x28, 0xda,
+            0x4a, 0x7e, 0x9f, 0x2a, 0x3b, 0x97, 0x13, 0x3f, 0x75, 0x75, 0xc9, 0x39, 0xc8, 0xbb,
+            0xd6, 0xdb, 0x3a, 0x32,
+        ];
+        let peer_public_key = [
+            0x04, 0x11, 0x17, 0x46, 0xda, 0x98, 0x99, 0xf5, 0x36, 0x89, 0x7c, 0x53, 0x37, 0x36,
+            0x08, 0xea, 0x08, 0x87, 0x9e, 0x55, 0x94, 0x71, 0x5a, 0xcf, 0xbb, 0x45, 0x82, 0x19,
+            0x74, 0x56, 0xa3, 0xf0, 0xaf, 0x65, 0xe1, 0x34, 0xa3, 0x4c, 0xc3, 0xe5, 0x47, 0xf5,
+            0x28, 0x96, 0x9d, 0xd1, 0x70, 0xee, 0x81, 0x76, 0x6e, 0xcc, 0xcb, 0x7c, 0xe3, 0xde,
+            0xa0, 0x26, 0x62, 0x50, 0xb6, 0x50, 0x5e, 0xf1, 0x59,
+        ];
+        let shared_secret = [
+            0x5f, 0xd4, 0x02, 0xcc, 0x2b, 0x31, 0x82, 0x37, 0xb0, 0x3d, 0xff, 0x72, 0xfa, 0xd9,
+            0x2b, 0x88, 0x02, 0x96, 0x65, 0x17, 0x63, 0xea, 0x14, 0x0b, 0xa8, 0xfa, 0x10, 0xe8,
+            0x58, 0x93, 0x97, 0x19,
+        ];
+        assert_eq!(super::public_key(&peer_private_key), peer_public_key);
+        let public_key = super::public_key(&PRIVATE_KEY);
+        assert_eq!(
+            super::shared_secret(&PRIVATE_KEY, &peer_public_key).unwrap(),
+            shared_secret
+        );
+        assert_eq!(
+            super::shared_secret(&peer_private_key, &public_key).unwrap(),
+            shared_secret
+        );
+
+        let mut bad_key = peer_public_key;
+        bad_key[64] ^= 1;
+        assert!(super::shared_secret(&PRIVATE_KEY, &bad_key).is_err());
+        bad_key = peer_public_key;
+        bad_key[0] = 0x02;
+        assert!(super::shared_secret(&PRIVATE_KEY, &bad_key).is_err());
+    }
+
+    #[test]
+    fn scalar_arithmetic() {
+        let a = Scalar::from_be_bytes(&[
+            0x12, 0x34, 0x56, 0x78, 0x90, 0xab, 0xcd, 0xef, 0x12, 0x34, 0x56, 0x78, 0x90, 0xab,
+            0xcd, 0xef, 0x12, 0x34, 0x56, 0x78, 0x90, 0xab, 0xcd, 0xef, 0x12, 0x34, 0x56, 0x78,
+            0x90, 0xab, 0xcd, 0xef,
+        ])
+        .unwrap();
+        let square = [
+            0x93, 0xd4, 0xa2, 0xe3, 0x93, 0xfe, 0x1a, 0x62, 0x1b, 0xc0, 0xdb, 0x99, 0x69, 0xdc,
+            0x1e, 0x68, 0xd7, 0xf9, 0x1e, 0xe2, 0x4a, 0xe8, 0xe0, 0x4a, 0xad, 0x53, 0xce, 0x0e,
+            0x83, 0x48, 0x51, 0xd8,
+        ];
+        let inverse = [
+            0xdd, 0xbe, 0x67, 0xfb, 0x14, 0x71, 0x4a, 0xb5, 0xc0, 0xd9, 0x09, 0x91, 0x3a, 0x16,
+            0xbb, 0x6a, 0x2a, 0xf6, 0x3a, 0xdf, 0xab, 0x8d, 0x3a, 0x5b, 0xe9, 0x86, 0x58, 0x01,
+            0x1a, 0x91, 0x07, 0x77,
+        ];
+        assert_eq!((a * a).to_be_bytes(), square);
+        assert_eq!(a.invert().to_be_bytes(), inverse);
+        assert_eq!(a.invert() * a, Scalar::ONE);
+        assert!(Scalar::ZERO.invert().is_zero());
+
+        let max = Scalar::from_be_bytes(&ORDER_MINUS_ONE).unwrap();
+        assert_eq!(max.to_be_bytes(), ORDER_MINUS_ONE);
+        assert!((max + Scalar::ONE).is_zero());
+        let mut order = ORDER_MINUS_ONE;
+        order[31] += 1;
+        assert!(Scalar::from_be_bytes(&order).is_err());
+        assert!(Scalar::from_be_bytes_reduced(&order).is_zero());
+        assert_eq!(Scalar::from_be_bytes_reduced(&ORDER_MINUS_ONE), max);
+    }
+
+    #[test]
+    fn mul_base_and_scalar() {
+        let point = Point::mul_base(&PRIVATE_KEY);
+        let scalars = [
+            [0; 32],
+            scalar(1),
+            scalar(0x1234),
+            ORDER_MINUS_ONE,
+            PRIVATE_KEY,
+            [0xff; 32],
+        ];
+        for base_scalar in &scalars {
+            for scalar in &scalars {
+                assert_eq!(
+                    point.mul_base_and_scalar_vartime(base_scalar, scalar),
+                    Point::mul_base(base_scalar) + point.mul_scalar(scalar),
+                );
+            }
+        }
+        assert!(point.has_affine_x(FieldElement::from_be_bytes(&PUBLIC_X).unwrap()));
+        assert!(!point.has_affine_x(FieldElement::from_be_bytes(&PUBLIC_Y).unwrap()));
+        assert!(!Point::IDENTITY.has_affine_x(FieldElement::ZERO));
     }
 }
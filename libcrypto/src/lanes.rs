@@ -0,0 +1,225 @@
+//! SIMD registers of 32-bit lanes
+//!
+//! [`Lanes`] lets an algorithm be written once, with one word of each of several
+//! independent computations in each lane, and compiled for whichever registers are available.
+
+#[cfg(target_arch = "aarch64")]
+use core::arch::aarch64::{
+    uint32x4_t, vaddq_u32, vandq_u32, vbicq_u32, vdupq_n_s32, vdupq_n_u32, veorq_u32, vld1q_u32,
+    vorrq_u32, vshlq_u32, vst1q_u32,
+};
+#[cfg(target_arch = "x86_64")]
+use core::arch::x86_64::{
+    __m128i, _mm_add_epi32, _mm_and_si128, _mm_andnot_si128, _mm_cvtsi32_si128, _mm_loadu_si128,
+    _mm_or_si128, _mm_set1_epi32, _mm_sll_epi32, _mm_srl_epi32, _mm_storeu_si128, _mm_xor_si128,
+};
+
+/// A SIMD register holding one 32-bit word from each of `LANES` lanes
+///
+/// The methods are always inlined, so that they are compiled
+/// with the target features of the function they are used in.
+pub(crate) trait Lanes<const LANES: usize>: Copy {
+    fn load(words: &[u32; LANES]) -> Self;
+    fn store(self) -> [u32; LANES];
+    fn splat(word: u32) -> Self;
+    fn add(self, other: Self) -> Self;
+    fn xor(self, other: Self) -> Self;
+    fn and(self, other: Self) -> Self;
+    /// `!self & other`
+    fn and_not(self, other: Self) -> Self;
+    fn or(self, other: Self) -> Self;
+    fn shift_right(self, amount: i32) -> Self;
+    fn shift_left(self, amount: i32) -> Self;
+
+    #[inline(always)]
+    fn rotate_right(self, amount: i32) -> Self {
+        self.shift_right(amount).or(self.shift_left(32 - amount))
+    }
+
+    #[inline(always)]
+    fn rotate_left(self, amount: i32) -> Self {
+        self.rotate_right(32 - amount)
+    }
+}
+
+/// 4 lanes in an SSE2 register
+///
+/// SSE2 is part of x86_64, so it is always available.
+#[cfg(target_arch = "x86_64")]
+#[derive(Clone, Copy)]
+pub(crate) struct Sse2(__m128i);
+
+// SAFETY (for every method): SSE2 is always available on x86_64
+#[cfg(target_arch = "x86_64")]
+impl Lanes<4> for Sse2 {
+    #[inline(always)]
+    fn load(words: &[u32; 4]) -> Self {
+        Self(unsafe { _mm_loadu_si128(words.as_ptr().cast()) })
+    }
+    #[inline(always)]
+    fn store(self) -> [u32; 4] {
+        let mut words = [0; 4];
+        unsafe { _mm_storeu_si128(words.as_mut_ptr().cast(), self.0) };
+        words
+    }
+    #[inline(always)]
+    fn splat(word: u32) -> Self {
+        Self(unsafe { _mm_set1_epi32(word as i32) })
+    }
+    #[inline(always)]
+    fn add(self, other: Self) -> Self {
+        Self(unsafe { _mm_add_epi32(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn xor(self, other: Self) -> Self {
+        Self(unsafe { _mm_xor_si128(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn and(self, other: Self) -> Self {
+        Self(unsafe { _mm_and_si128(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn and_not(self, other: Self) -> Self {
+        Self(unsafe { _mm_andnot_si128(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn or(self, other: Self) -> Self {
+        Self(unsafe { _mm_or_si128(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn shift_right(self, amount: i32) -> Self {
+        Self(unsafe { _mm_srl_epi32(self.0, _mm_cvtsi32_si128(amount)) })
+    }
+    #[inline(always)]
+    fn shift_left(self, amount: i32) -> Self {
+        Self(unsafe { _mm_sll_epi32(self.0, _mm_cvtsi32_si128(amount)) })
+    }
+}
+
+/// Any number of lanes in an array
+///
+/// Each operation is a loop over the lanes, which the compiler vectorizes.
+/// This is used for AVX2: the `_mm256` intrinsics can't be inlined into the methods of
+/// [`Lanes`], which have no target features, but these loops can be compiled for AVX2
+/// once inlined into a function compiled for AVX2.
+impl<const LANES: usize> Lanes<LANES> for [u32; LANES] {
+    #[inline(always)]
+    fn load(words: &[u32; LANES]) -> Self {
+        *words
+    }
+    #[inline(always)]
+    fn store(self) -> [u32; LANES] {
+        self
+    }
+    #[inline(always)]
+    fn splat(word: u32) -> Self {
+        [word; LANES]
+    }
+    #[inline(always)]
+    fn add(mut self, other: Self) -> Self {
+        for (word, other_word) in self.iter_mut().zip(other) {
+            *word = word.wrapping_add(other_word);
+        }
+        self
+    }
+    #[inline(always)]
+    fn xor(mut self, other: Self) -> Self {
+        for (word, other_word) in self.iter_mut().zip(other) {
+            *word ^= other_word;
+        }
+        self
+    }
+    #[inline(always)]
+    fn and(mut self, other: Self) -> Self {
+        for (word, other_word) in self.iter_mut().zip(other) {
+            *word &= other_word;
+        }
+        self
+    }
+    #[inline(always)]
+    fn and_not(mut self, other: Self) -> Self {
+        for (word, other_word) in self.iter_mut().zip(other) {
+            *word = !*word & other_word;
+        }
+        self
+    }
+    #[inline(always)]
+    fn or(mut self, other: Self) -> Self {
+        for (word, other_word) in self.iter_mut().zip(other) {
+            *word |= other_word;
+        }
+        self
+    }
+    #[inline(always)]
+    fn shift_right(self, amount: i32) -> Self {
+        self.map(|word| word >> amount)
+    }
+    #[inline(always)]
+    fn shift_left(self, amount: i32) -> Self {
+        self.map(|word| word << amount)
+    }
+    #[inline(always)]
+    fn rotate_right(self, amount: i32) -> Self {
+        self.map(|word| word.rotate_right(amount as u32))
+    }
+    #[inline(always)]
+    fn rotate_left(self, amount: i32) -> Self {
+        self.map(|word| word.rotate_left(amount as u32))
+    }
+}
+
+/// 4 lanes in a NEON register
+///
+/// NEON is part of aarch64, so it is always available.
+#[cfg(target_arch = "aarch64")]
+#[derive(Clone, Copy)]
+pub(crate) struct Neon(uint32x4_t);
+
+// SAFETY (for every method): NEON is always available on aarch64
+#[cfg(target_arch = "aarch64")]
+impl Lanes<4> for Neon {
+    #[inline(always)]
+    fn load(words: &[u32; 4]) -> Self {
+        Self(unsafe { vld1q_u32(words.as_ptr()) })
+    }
+    #[inline(always)]
+    fn store(self) -> [u32; 4] {
+        let mut words = [0; 4];
+        unsafe { vst1q_u32(words.as_mut_ptr(), self.0) };
+        words
+    }
+    #[inline(always)]
+    fn splat(word: u32) -> Self {
+        Self(unsafe { vdupq_n_u32(word) })
+    }
+    #[inline(always)]
+    fn add(self, other: Self) -> Self {
+        Self(unsafe { vaddq_u32(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn xor(self, other: Self) -> Self {
+        Self(unsafe { veorq_u32(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn and(self, other: Self) -> Self {
+        Self(unsafe { vandq_u32(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn and_not(self, other: Self) -> Self {
+        // `vbicq_u32(a, b)` is `a & !b`
+        Self(unsafe { vbicq_u32(other.0, self.0) })
+    }
+    #[inline(always)]
+    fn or(self, other: Self) -> Self {
+        Self(unsafe { vorrq_u32(self.0, other.0) })
+    }
+    #[inline(always)]
+    fn shift_right(self, amount: i32) -> Self {
+        // shifting left by a negative amount shifts right
+        Self(unsafe { vshlq_u32(self.0, vdupq_n_s32(-amount)) })
+    }
+    #[inline(always)]
+    fn shift_left(self, amount: i32) -> Self {
+        Self(unsafe { vshlq_u32(self.0, vdupq_n_s32(amount)) })
+    }
+}
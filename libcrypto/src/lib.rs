@@ -1,8 +1,10 @@
 //! This crate implements various cryptographic functions,
-//! including AES in GCM and SHA-256.
+//! including AES in GCM, ChaCha20-Poly1305, and SHA-256.
 //!
-//! This crate implements these functions purely in software.
-//! Hardware implementations are a future goal.
+//! Where the CPU supports them, hardware instructions are used
+//! (currently for AES, GHASH, and SHA-256 on x86_64 and aarch64).
+//! Otherwise, these functions fall back to pure software implementations.
+//! The [`cpu`] module reports which are in use, and can turn the hardware ones off.
 //!
 //! <div class="warning">
 //! WARNING: This code has not been audited. Use at your own risk.
@@ -12,7 +14,11 @@
 
 pub mod aes;
 pub mod big_int;
+mod buffers;
 pub mod chacha;
+pub mod cpu;
 pub mod dsa;
 pub mod elliptic_curve;
+mod lanes;
 pub mod sha2;
+pub mod zeroize;
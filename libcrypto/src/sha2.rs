@@ -1,5 +1,10 @@
 pub mod sha256;
+#[cfg(target_arch = "aarch64")]
+mod sha256_armv8;
+pub(crate) mod sha256_multi;
+#[cfg(target_arch = "x86_64")]
+mod sha256_ni;
 pub mod sha512;
 
-pub use sha256::sha256;
-pub use sha512::sha512;
+pub use sha256::{sha256, sha256_many, Sha256};
+pub use sha512::{sha512, Sha512};
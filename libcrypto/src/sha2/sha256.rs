@@ -1,12 +1,15 @@
-//! A software implementation of SHA-256
+//! An implementation of SHA-256
+//!
+//! The compression function uses the SHA extensions on x86_64
+//! and the SHA2 instructions on aarch64 when the CPU supports them.
 
-const BLOCK_SIZE: usize = 64;
-const HASH_SIZE: usize = 32;
+pub(super) const BLOCK_SIZE: usize = 64;
+pub(super) const HASH_SIZE: usize = 32;
 
 /// The first 32 bits of the fractional parts of
 /// the cube roots of the first 64 prime numbers
 // TODO: name this something useful
-const K: [u32; 64] = [
+pub(super) const K: [u32; 64] = [
     0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
     0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
     0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
@@ -75,35 +78,205 @@ const fn little_sigma_1(x: u32) -> u32 {
 /// assert_eq!(sha2::sha256(message), hash);
 /// ```
 pub fn sha256(msg: &[u8]) -> [u8; HASH_SIZE] {
-    let mut hash: [u32; HASH_SIZE / 4] = [
-        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab,
-        0x5be0cd19,
-    ];
-    msg
-        // TODO: use `array_chunks` once stabilized
-        .chunks_exact(BLOCK_SIZE)
-        // we can safely unwrap because `key_chunk` is guaranteed to have a length of `BLOCK_SIZE`
-        .map(|block| be_bytes_to_u32_array(block.try_into().unwrap()))
-        .for_each(|block| update_hash(&mut hash, &block));
-
-    // let padding_size = BLOCK_SIZE - (msg.len() % BLOCK_SIZE);
-    let msg_excess = &msg[msg.len() - (msg.len() % BLOCK_SIZE)..];
-    let mut last_block = [0u8; BLOCK_SIZE];
-    last_block[..msg_excess.len()].copy_from_slice(msg_excess);
-
-    // we can write here unconditionally because the excess must be less than `BLOCK_SIZE`
-    last_block[msg_excess.len()] = 0x80;
-    if msg_excess.len() < BLOCK_SIZE - 9 {
-        last_block[BLOCK_SIZE - 8..].copy_from_slice(&(msg.len() as u64 * 8).to_be_bytes());
-        update_hash(&mut hash, &be_bytes_to_u32_array(&last_block));
-    } else {
-        update_hash(&mut hash, &be_bytes_to_u32_array(&last_block));
-        let mut extra_block = [0u8; BLOCK_SIZE];
-        extra_block[BLOCK_SIZE - 8..].copy_from_slice(&(msg.len() as u64 * 8).to_be_bytes());
-        update_hash(&mut hash, &be_bytes_to_u32_array(&extra_block));
+    let mut hasher = Sha256::new();
+    hasher.update(msg);
+    hasher.finalize()
+}
+
+/// Calculates the SHA-256 hash of each message of `msgs`,
+/// writing it to the corresponding element of `hashes`
+///
+/// When there are many short messages, this is faster than hashing each one separately:
+/// several messages are hashed at once using SIMD instructions.
+/// (If the CPU has SHA-256 instructions,
+/// the messages are hashed one at a time with those instead.)
+///
+/// # Panics
+///
+/// This function will panic if `msgs.len()` != `hashes.len()`
+///
+/// # Examples
+///
+/// ```
+/// use libcrypto::sha2;
+///
+/// let msgs: [&[u8]; 3] = [b"abc", b"", b"a longer message"];
+/// let mut hashes = [[0u8; 32]; 3];
+/// sha2::sha256_many(&msgs, &mut hashes);
+/// for (msg, hash) in msgs.iter().zip(hashes) {
+///     assert_eq!(sha2::sha256(msg), hash);
+/// }
+/// ```
+pub fn sha256_many(msgs: &[&[u8]], hashes: &mut [[u8; HASH_SIZE]]) {
+    assert_eq!(
+        msgs.len(),
+        hashes.len(),
+        "there must be exactly one hash per message"
+    );
+    let backend = Backend::detect();
+    // the SHA-256 instructions are faster than even 8 lanes of SIMD
+    if backend != Backend::Software {
+        for (msg, hash) in msgs.iter().zip(hashes) {
+            let mut hasher = Sha256 {
+                backend,
+                ..Sha256::new()
+            };
+            hasher.update(msg);
+            *hash = hasher.finalize();
+        }
+        return;
+    }
+    super::sha256_multi::hash_many(msgs, hashes);
+}
+
+/// The initial hash value
+pub(super) const INITIAL_HASH: [u32; HASH_SIZE / 4] = [
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+];
+
+/// A SHA-256 hash that is computed incrementally
+///
+/// The state is small and contains no pointers,
+/// so cloning it to take the hash of a prefix of the message is cheap.
+///
+/// # Examples
+///
+/// ```
+/// use libcrypto::sha2::{self, Sha256};
+///
+/// let mut hasher = Sha256::new();
+/// hasher.update(b"first message");
+/// let snapshot = hasher.clone();
+/// hasher.update(b", second message");
+///
+/// assert_eq!(hasher.finalize(), sha2::sha256(b"first message, second message"));
+/// assert_eq!(snapshot.finalize(), sha2::sha256(b"first message"));
+/// ```
+#[derive(Clone, Debug)]
+pub struct Sha256 {
+    hash: [u32; HASH_SIZE / 4],
+    backend: Backend,
+    /// The start of the current, incomplete block
+    buffer: [u8; BLOCK_SIZE],
+    /// The length of the message so far, in bytes
+    len: u64,
+}
+
+impl Sha256 {
+    /// Starts hashing a new message
+    pub fn new() -> Self {
+        Self {
+            hash: INITIAL_HASH,
+            backend: Backend::detect(),
+            buffer: [0; BLOCK_SIZE],
+            len: 0,
+        }
     }
 
-    to_be_bytes_from_hash(hash)
+    /// Appends `data` to the message
+    pub fn update(&mut self, mut data: &[u8]) {
+        let used = (self.len % BLOCK_SIZE as u64) as usize;
+        self.len += data.len() as u64;
+        if used != 0 {
+            let len = data.len().min(BLOCK_SIZE - used);
+            self.buffer[used..used + len].copy_from_slice(&data[..len]);
+            data = &data[len..];
+            if used + len < BLOCK_SIZE {
+                return;
+            }
+            self.backend.update_blocks(&mut self.hash, &self.buffer);
+        }
+
+        let split = data.len() - data.len() % BLOCK_SIZE;
+        self.backend.update_blocks(&mut self.hash, &data[..split]);
+        self.buffer[..data.len() - split].copy_from_slice(&data[split..]);
+    }
+
+    /// Pads the message and returns its hash
+    pub fn finalize(mut self) -> [u8; HASH_SIZE] {
+        let used = (self.len % BLOCK_SIZE as u64) as usize;
+        // we can write here unconditionally because `used` must be less than `BLOCK_SIZE`
+        self.buffer[used] = 0x80;
+        self.buffer[used + 1..].fill(0);
+        if used + 1 > BLOCK_SIZE - 8 {
+            self.backend.update_blocks(&mut self.hash, &self.buffer);
+            self.buffer.fill(0);
+        }
+        self.buffer[BLOCK_SIZE - 8..].copy_from_slice(&self.len.wrapping_mul(8).to_be_bytes());
+        self.backend.update_blocks(&mut self.hash, &self.buffer);
+
+        to_be_bytes_from_hash(self.hash)
+    }
+}
+
+impl Default for Sha256 {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Returns the name of the implementation new hashers use
+pub(crate) fn backend_name() -> &'static str {
+    Backend::detect().name()
+}
+
+/// The implementation of the compression function
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub(super) enum Backend {
+    /// The portable software implementation
+    Software,
+    /// The SHA extensions
+    #[cfg(target_arch = "x86_64")]
+    ShaNi,
+    /// The ARMv8 SHA2 instructions
+    #[cfg(target_arch = "aarch64")]
+    Armv8,
+}
+
+impl Backend {
+    /// Picks the fastest implementation supported by the CPU
+    pub(super) fn detect() -> Self {
+        if crate::cpu::has_sha256() {
+            #[cfg(target_arch = "x86_64")]
+            return Self::ShaNi;
+            #[cfg(target_arch = "aarch64")]
+            return Self::Armv8;
+        }
+        Self::Software
+    }
+
+    /// Returns the name of the implementation
+    const fn name(self) -> &'static str {
+        match self {
+            Self::Software => "software",
+            #[cfg(target_arch = "x86_64")]
+            Self::ShaNi => "sha-ni",
+            #[cfg(target_arch = "aarch64")]
+            Self::Armv8 => "armv8",
+        }
+    }
+
+    /// Updates `hash` with each block of `blocks`
+    ///
+    /// `blocks` must be a multiple of `BLOCK_SIZE` long.
+    fn update_blocks(self, hash: &mut [u32; HASH_SIZE / 4], blocks: &[u8]) {
+        debug_assert_eq!(blocks.len() % BLOCK_SIZE, 0);
+        match self {
+            Self::Software => blocks
+                // TODO: use `array_chunks` once stabilized
+                .chunks_exact(BLOCK_SIZE)
+                // we can safely unwrap because `block` is guaranteed to have a length of
+                // `BLOCK_SIZE`
+                .map(|block| be_bytes_to_u32_array(block.try_into().unwrap()))
+                .for_each(|block| update_hash(hash, &block)),
+            // SAFETY: `Backend::ShaNi` is only chosen if the CPU supports the SHA extensions
+            #[cfg(target_arch = "x86_64")]
+            Self::ShaNi => unsafe { super::sha256_ni::update_blocks(hash, blocks) },
+            // SAFETY: `Backend::Armv8` is only chosen if the CPU supports the SHA2 instructions
+            #[cfg(target_arch = "aarch64")]
+            Self::Armv8 => unsafe { super::sha256_armv8::update_blocks(hash, blocks) },
+        }
+    }
 }
 
 /// Updates `hash` with the next block (`next_block`).
@@ -158,7 +331,7 @@ fn be_bytes_to_u32_array(bytes: &[u8; BLOCK_SIZE]) -> [u32; BLOCK_SIZE / 4] {
     as_u32
 }
 
-fn to_be_bytes_from_hash(array: [u32; HASH_SIZE / 4]) -> [u8; HASH_SIZE] {
+pub(super) fn to_be_bytes_from_hash(array: [u32; HASH_SIZE / 4]) -> [u8; HASH_SIZE] {
     // TODO: use uninitialized memory if necessary
     let mut as_bytes = [0u8; HASH_SIZE];
     // TODO: use `array_chunks` once stabilized
@@ -210,4 +383,46 @@ mod tests {
         ];
         assert_eq!(super::sha256(msg), digest);
     }
+
+    #[test]
+    fn backends_agree() {
+        let mut msg = [0u8; 5 * super::BLOCK_SIZE + 9];
+        for (i, byte) in msg.iter_mut().enumerate() {
+            *byte = (i * 29) as u8;
+        }
+        for len in [0, 3, super::BLOCK_SIZE, msg.len()] {
+            let mut detected = super::Sha256::new();
+            let mut software = super::Sha256 {
+                backend: super::Backend::Software,
+                ..super::Sha256::new()
+            };
+            detected.update(&msg[..len]);
+            software.update(&msg[..len]);
+            assert_eq!(detected.finalize(), software.finalize());
+        }
+    }
+
+    #[test]
+    fn streaming() {
+        // the longest message whose length still fits in its last block
+        let msg = [b'a'; 55];
+        let hash = [
+            0x9f, 0x43, 0x90, 0xf8, 0xd3, 0x0c, 0x2d, 0xd9, 0x2e, 0xc9, 0xf0, 0x95, 0xb6, 0x5e,
+            0x2b, 0x9a, 0xe9, 0xb0, 0xa9, 0x25, 0xa5, 0x25, 0x8e, 0x24, 0x1c, 0x9f, 0x1e, 0x91,
+            0x0f, 0x73, 0x43, 0x18,
+        ];
+        assert_eq!(super::sha256(&msg), hash);
+
+        let mut long_msg = [0u8; 3 * super::BLOCK_SIZE + 7];
+        for (i, byte) in long_msg.iter_mut().enumerate() {
+            *byte = (i * 3) as u8;
+        }
+        for piece_len in [1, 13, super::BLOCK_SIZE, super::BLOCK_SIZE + 1] {
+            let mut hasher = super::Sha256::new();
+            for piece in long_msg.chunks(piece_len) {
+                hasher.update(piece);
+            }
+            assert_eq!(hasher.finalize(), super::sha256(&long_msg));
+        }
+    }
 }
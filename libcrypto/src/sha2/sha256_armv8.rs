@@ -0,0 +1,63 @@
+//! An implementation of the SHA-256 compression function using the ARMv8 SHA2 instructions
+use super::sha256::{BLOCK_SIZE, HASH_SIZE, K};
+use core::arch::aarch64::{
+    uint32x4_t, vaddq_u32, vld1q_u32, vld1q_u8, vreinterpretq_u32_u8, vrev32q_u8, vsha256h2q_u32,
+    vsha256hq_u32, vsha256su0q_u32, vsha256su1q_u32, vst1q_u32,
+};
+
+/// Updates `hash` with each block of `blocks`
+///
+/// `blocks` must be a multiple of [`BLOCK_SIZE`] long.
+///
+/// # Safety
+///
+/// The CPU must support the `sha2` target feature.
+#[target_feature(enable = "sha2")]
+pub(super) unsafe fn update_blocks(hash: &mut [u32; HASH_SIZE / 4], blocks: &[u8]) {
+    let mut abcd = vld1q_u32(hash.as_ptr());
+    let mut efgh = vld1q_u32(hash[4..].as_ptr());
+
+    // TODO: use `array_chunks` once stabilized
+    for block in blocks.chunks_exact(BLOCK_SIZE) {
+        let (abcd_saved, efgh_saved) = (abcd, efgh);
+
+        // the message schedule, four words at a time
+        let mut schedule = [
+            load(block, 0),
+            load(block, 1),
+            load(block, 2),
+            load(block, 3),
+        ];
+
+        for i in 0..K.len() / 4 {
+            let words = vaddq_u32(schedule[i % 4], vld1q_u32(K[4 * i..].as_ptr()));
+            // the words just used are replaced by the words needed four groups later
+            if i < 12 {
+                schedule[i % 4] = vsha256su0q_u32(schedule[i % 4], schedule[(i + 1) % 4]);
+            }
+            let abcd_before = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, words);
+            efgh = vsha256h2q_u32(efgh, abcd_before, words);
+            if i < 12 {
+                schedule[i % 4] = vsha256su1q_u32(
+                    schedule[i % 4],
+                    schedule[(i + 2) % 4],
+                    schedule[(i + 3) % 4],
+                );
+            }
+        }
+
+        abcd = vaddq_u32(abcd, abcd_saved);
+        efgh = vaddq_u32(efgh, efgh_saved);
+    }
+
+    vst1q_u32(hash.as_mut_ptr(), abcd);
+    vst1q_u32(hash[4..].as_mut_ptr(), efgh);
+}
+
+/// Loads the `i`th group of four big-endian words of `block`
+#[inline]
+#[target_feature(enable = "sha2")]
+unsafe fn load(block: &[u8], i: usize) -> uint32x4_t {
+    vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(block[16 * i..].as_ptr())))
+}
@@ -0,0 +1,274 @@
+//! A multi-buffer implementation of SHA-256
+//!
+//! Several independent messages ("lanes") are hashed at once.
+//! The state and message schedule are stored transposed, with one word from each lane
+//! side by side in a SIMD register, so every step of the compression function
+//! runs on all lanes with a single instruction.
+//! SSE2 and NEON give 4 lanes, and AVX2 gives 8.
+//!
+//! Lanes that run out of blocks before the others are masked off,
+//! so messages of different lengths can share a batch.
+use super::sha256::{to_be_bytes_from_hash, Backend, BLOCK_SIZE, HASH_SIZE, INITIAL_HASH, K};
+
+use crate::lanes::Lanes;
+#[cfg(target_arch = "aarch64")]
+use crate::lanes::Neon;
+#[cfg(target_arch = "x86_64")]
+use crate::lanes::Sse2;
+
+/// Returns the name of the implementation [`sha256_many`](super::sha256_many) uses
+///
+/// With the SHA-256 instructions, it hashes one message at a time with those instead of
+/// calling [`hash_many`].
+pub(crate) fn backend_name() -> &'static str {
+    if Backend::detect() != Backend::Software {
+        return super::sha256::backend_name();
+    }
+    #[cfg(target_arch = "x86_64")]
+    {
+        if crate::cpu::has_avx2() {
+            "avx2"
+        } else {
+            "sse2"
+        }
+    }
+    #[cfg(target_arch = "aarch64")]
+    {
+        "neon"
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    {
+        "software"
+    }
+}
+
+/// Writes the hash of each message of `msgs` to the corresponding element of `hashes`
+///
+/// `msgs` and `hashes` must be equally long.
+pub(super) fn hash_many(msgs: &[&[u8]], hashes: &mut [[u8; HASH_SIZE]]) {
+    debug_assert_eq!(msgs.len(), hashes.len());
+    #[cfg(target_arch = "x86_64")]
+    {
+        if crate::cpu::has_avx2() {
+            for (msgs, hashes) in msgs.chunks(8).zip(hashes.chunks_mut(8)) {
+                // SAFETY: we just checked that the CPU supports AVX2
+                unsafe { hash_lanes_avx2(msgs, hashes) };
+            }
+        } else {
+            for (msgs, hashes) in msgs.chunks(4).zip(hashes.chunks_mut(4)) {
+                hash_lanes::<Sse2, 4>(msgs, hashes);
+            }
+        }
+    }
+    #[cfg(target_arch = "aarch64")]
+    for (msgs, hashes) in msgs.chunks(4).zip(hashes.chunks_mut(4)) {
+        hash_lanes::<Neon, 4>(msgs, hashes);
+    }
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    for (msg, hash) in msgs.iter().zip(hashes) {
+        *hash = super::sha256(msg);
+    }
+}
+
+/// [`hash_lanes`] with 8 lanes, compiled for AVX2
+///
+/// # Safety
+///
+/// The CPU must support the `avx2` target feature.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn hash_lanes_avx2(msgs: &[&[u8]], hashes: &mut [[u8; HASH_SIZE]]) {
+    hash_lanes::<[u32; 8], 8>(msgs, hashes);
+}
+
+/// Hashes up to `LANES` messages at once
+#[inline(always)]
+fn hash_lanes<V: Lanes<LANES>, const LANES: usize>(msgs: &[&[u8]], hashes: &mut [[u8; HASH_SIZE]]) {
+    debug_assert!(msgs.len() <= LANES);
+    let mut num_blocks = [0; LANES];
+    for (num_blocks, msg) in num_blocks.iter_mut().zip(msgs) {
+        *num_blocks = padded_len(msg.len()) / BLOCK_SIZE;
+    }
+
+    let mut state = INITIAL_HASH.map(V::splat);
+    let most_blocks = num_blocks.iter().copied().max().unwrap_or(0);
+    for index in 0..most_blocks {
+        // TODO: use uninitialized memory if necessary
+        let mut block = [[0u32; LANES]; BLOCK_SIZE / 4];
+        for (lane, msg) in msgs.iter().enumerate() {
+            if index < num_blocks[lane] {
+                let bytes = padded_block(msg, index);
+                // TODO: use `array_chunks` once stabilized
+                for (words, chunk) in block.iter_mut().zip(bytes.chunks_exact(4)) {
+                    // we can safely unwrap because `chunk` is guaranteed to have a length of 4
+                    words[lane] = u32::from_be_bytes(chunk.try_into().unwrap());
+                }
+            }
+        }
+
+        let mut new_state = state;
+        update_hash_lanes(&mut new_state, &block.map(|words| V::load(&words)));
+        if num_blocks.iter().all(|&num_blocks| index < num_blocks) {
+            state = new_state;
+        } else {
+            // keep the old state of lanes that have no block left
+            for (words, new_words) in state.iter_mut().zip(new_state) {
+                let (mut words_array, new_words) = (words.store(), new_words.store());
+                for lane in 0..LANES {
+                    if index < num_blocks[lane] {
+                        words_array[lane] = new_words[lane];
+                    }
+                }
+                *words = V::load(&words_array);
+            }
+        }
+    }
+
+    let state = state.map(V::store);
+    for (lane, hash) in hashes.iter_mut().enumerate() {
+        *hash = to_be_bytes_from_hash(state.map(|words| words[lane]));
+    }
+}
+
+/// Updates each lane of `hash` with the same lane of `next_block`
+///
+/// This is `update_hash` from [`super::sha256`], with every operation applied to all lanes.
+#[inline(always)]
+fn update_hash_lanes<V: Lanes<LANES>, const LANES: usize>(
+    hash: &mut [V; HASH_SIZE / 4],
+    next_block: &[V; BLOCK_SIZE / 4],
+) {
+    let mut message_schedule = [next_block[0]; 64];
+    message_schedule[..next_block.len()].copy_from_slice(next_block);
+
+    for i in 16..message_schedule.len() {
+        message_schedule[i] = little_sigma_1(message_schedule[i - 2])
+            .add(message_schedule[i - 7])
+            .add(little_sigma_0(message_schedule[i - 15]))
+            .add(message_schedule[i - 16]);
+    }
+
+    let [mut a, mut b, mut c, mut d, mut e, mut f, mut g, mut h] = *hash;
+
+    for i in 0..64 {
+        let temp1 = h
+            .add(sigma_1(e))
+            .add(ch(e, f, g))
+            .add(V::splat(K[i]))
+            .add(message_schedule[i]);
+        let temp2 = sigma_0(a).add(maj(a, b, c));
+        h = g;
+        g = f;
+        f = e;
+        e = d.add(temp1);
+        d = c;
+        c = b;
+        b = a;
+        a = temp1.add(temp2);
+    }
+
+    for (word, new_word) in hash.iter_mut().zip([a, b, c, d, e, f, g, h]) {
+        *word = word.add(new_word);
+    }
+}
+
+#[inline(always)]
+fn ch<V: Lanes<LANES>, const LANES: usize>(x: V, y: V, z: V) -> V {
+    x.and(y).xor(x.and_not(z))
+}
+
+#[inline(always)]
+fn maj<V: Lanes<LANES>, const LANES: usize>(x: V, y: V, z: V) -> V {
+    x.and(y).xor(x.and(z)).xor(y.and(z))
+}
+
+#[inline(always)]
+fn sigma_0<V: Lanes<LANES>, const LANES: usize>(x: V) -> V {
+    x.rotate_right(2)
+        .xor(x.rotate_right(13))
+        .xor(x.rotate_right(22))
+}
+
+#[inline(always)]
+fn sigma_1<V: Lanes<LANES>, const LANES: usize>(x: V) -> V {
+    x.rotate_right(6)
+        .xor(x.rotate_right(11))
+        .xor(x.rotate_right(25))
+}
+
+#[inline(always)]
+fn little_sigma_0<V: Lanes<LANES>, const LANES: usize>(x: V) -> V {
+    x.rotate_right(7)
+        .xor(x.rotate_right(18))
+        .xor(x.shift_right(3))
+}
+
+#[inline(always)]
+fn little_sigma_1<V: Lanes<LANES>, const LANES: usize>(x: V) -> V {
+    x.rotate_right(17)
+        .xor(x.rotate_right(19))
+        .xor(x.shift_right(10))
+}
+
+/// The length of a message of `len` bytes once padded
+const fn padded_len(len: usize) -> usize {
+    (len + 9).div_ceil(BLOCK_SIZE) * BLOCK_SIZE
+}
+
+/// Returns block number `index` of `msg`, once padded
+///
+/// `index` must be less than the number of padded blocks.
+fn padded_block(msg: &[u8], index: usize) -> [u8; BLOCK_SIZE] {
+    let start = index * BLOCK_SIZE;
+    if let Some(block) = msg.get(start..start + BLOCK_SIZE) {
+        // we can safely unwrap because `block` is guaranteed to have a length of `BLOCK_SIZE`
+        return block.try_into().unwrap();
+    }
+
+    let mut block = [0u8; BLOCK_SIZE];
+    if start <= msg.len() {
+        let excess = &msg[start..];
+        block[..excess.len()].copy_from_slice(excess);
+        block[excess.len()] = 0x80;
+    }
+    if start + BLOCK_SIZE == padded_len(msg.len()) {
+        block[BLOCK_SIZE - 8..].copy_from_slice(&(msg.len() as u64 * 8).to_be_bytes());
+    }
+    block
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::sha256::{sha256, BLOCK_SIZE, HASH_SIZE};
+
+    #[test]
+    fn hash_many() {
+        let mut data = [0u8; 3 * BLOCK_SIZE];
+        for (i, byte) in data.iter_mut().enumerate() {
+            *byte = (i * 17) as u8;
+        }
+        // lengths around each padding boundary, and a batch that isn't full
+        let lens = [0, 55, 56, 63, 64, 119, 120, 3 * BLOCK_SIZE, 1, 150, 2];
+        let mut msgs: [&[u8]; 11] = [&[]; 11];
+        for (msg, len) in msgs.iter_mut().zip(lens) {
+            *msg = &data[..len];
+        }
+
+        let mut hashes = [[0u8; HASH_SIZE]; 11];
+        super::hash_many(&msgs, &mut hashes);
+        for (msg, hash) in msgs.iter().zip(&hashes) {
+            assert_eq!(*hash, sha256(msg));
+        }
+
+        #[cfg(target_arch = "x86_64")]
+        {
+            let mut hashes = [[0u8; HASH_SIZE]; 11];
+            for (msgs, hashes) in msgs.chunks(4).zip(hashes.chunks_mut(4)) {
+                super::hash_lanes::<super::Sse2, 4>(msgs, hashes);
+            }
+            for (msg, hash) in msgs.iter().zip(&hashes) {
+                assert_eq!(*hash, sha256(msg));
+            }
+        }
+    }
+}
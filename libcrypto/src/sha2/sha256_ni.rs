@@ -0,0 +1,75 @@
+//! An implementation of the SHA-256 compression function using the x86_64 SHA extensions
+//!
+//! `SHA256RNDS2` keeps the state split into the words `ABEF` and `CDGH`,
+//! so the state is shuffled into that layout before the first block and back after the last.
+use super::sha256::{BLOCK_SIZE, HASH_SIZE, K};
+use core::arch::x86_64::{
+    __m128i, _mm_add_epi32, _mm_alignr_epi8, _mm_blend_epi16, _mm_loadu_si128, _mm_set_epi64x,
+    _mm_setzero_si128, _mm_sha256msg1_epu32, _mm_sha256msg2_epu32, _mm_sha256rnds2_epu32,
+    _mm_shuffle_epi32, _mm_shuffle_epi8, _mm_storeu_si128,
+};
+
+/// Updates `hash` with each block of `blocks`
+///
+/// `blocks` must be a multiple of [`BLOCK_SIZE`] long.
+///
+/// # Safety
+///
+/// The CPU must support the `sha`, `ssse3`, and `sse4.1` target features.
+#[target_feature(enable = "sha,ssse3,sse4.1")]
+pub(super) unsafe fn update_blocks(hash: &mut [u32; HASH_SIZE / 4], blocks: &[u8]) {
+    // swaps the bytes of each 32-bit word
+    let byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0b, 0x0405060700010203);
+
+    let dcba = _mm_loadu_si128(hash.as_ptr().cast());
+    let hgfe = _mm_loadu_si128(hash[4..].as_ptr().cast());
+    let cdab = _mm_shuffle_epi32(dcba, 0xb1);
+    let efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+    let mut abef = _mm_alignr_epi8(cdab, efgh, 8);
+    let mut cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+    // TODO: use `array_chunks` once stabilized
+    for block in blocks.chunks_exact(BLOCK_SIZE) {
+        let (abef_saved, cdgh_saved) = (abef, cdgh);
+
+        // the message schedule, four words at a time
+        let mut schedule = [_mm_setzero_si128(); 4];
+        for (i, words) in schedule.iter_mut().enumerate() {
+            *words = _mm_shuffle_epi8(_mm_loadu_si128(block[16 * i..].as_ptr().cast()), byte_swap);
+        }
+
+        for i in 0..K.len() / 4 {
+            let mut words = _mm_add_epi32(schedule[i % 4], load_k(i));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, words);
+            if (3..15).contains(&i) {
+                let shifted = _mm_alignr_epi8(schedule[i % 4], schedule[(i + 3) % 4], 4);
+                let next = _mm_add_epi32(schedule[(i + 1) % 4], shifted);
+                schedule[(i + 1) % 4] = _mm_sha256msg2_epu32(next, schedule[i % 4]);
+            }
+            // `SHA256RNDS2` only uses the low 64 bits of `words`
+            words = _mm_shuffle_epi32(words, 0x0e);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, words);
+            if (1..13).contains(&i) {
+                schedule[(i + 3) % 4] =
+                    _mm_sha256msg1_epu32(schedule[(i + 3) % 4], schedule[i % 4]);
+            }
+        }
+
+        abef = _mm_add_epi32(abef, abef_saved);
+        cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+    }
+
+    let feba = _mm_shuffle_epi32(abef, 0x1b);
+    let dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+    _mm_storeu_si128(hash.as_mut_ptr().cast(), _mm_blend_epi16(feba, dchg, 0xf0));
+    _mm_storeu_si128(
+        hash[4..].as_mut_ptr().cast(),
+        _mm_alignr_epi8(dchg, feba, 8),
+    );
+}
+
+/// Loads the `i`th group of four round constants
+#[inline(always)]
+unsafe fn load_k(i: usize) -> __m128i {
+    _mm_loadu_si128(K[4 * i..].as_ptr().cast())
+}
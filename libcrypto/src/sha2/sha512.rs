@@ -130,42 +130,113 @@ const fn little_sigma_1(x: u64) -> u64 {
 /// assert_eq!(sha2::sha512(message), hash);
 /// ```
 pub fn sha512(msg: &[u8]) -> [u8; HASH_SIZE] {
-    let mut hash: [u64; HASH_SIZE / 8] = [
-        0x6a09e667f3bcc908,
-        0xbb67ae8584caa73b,
-        0x3c6ef372fe94f82b,
-        0xa54ff53a5f1d36f1,
-        0x510e527fade682d1,
-        0x9b05688c2b3e6c1f,
-        0x1f83d9abfb41bd6b,
-        0x5be0cd19137e2179,
-    ];
-    msg
-        // TODO: use `array_chunks` once stabilized
-        .chunks_exact(BLOCK_SIZE)
-        // we can safely unwrap because `block` is guaranteed to have a length of
-        // `BLOCK_SIZE`
-        .map(|block| be_bytes_to_u64_array(block.try_into().unwrap()))
-        .for_each(|block| update_hash(&mut hash, &block));
+    let mut hasher = Sha512::new();
+    hasher.update(msg);
+    hasher.finalize()
+}
+
+/// The initial hash value
+const INITIAL_HASH: [u64; HASH_SIZE / 8] = [
+    0x6a09e667f3bcc908,
+    0xbb67ae8584caa73b,
+    0x3c6ef372fe94f82b,
+    0xa54ff53a5f1d36f1,
+    0x510e527fade682d1,
+    0x9b05688c2b3e6c1f,
+    0x1f83d9abfb41bd6b,
+    0x5be0cd19137e2179,
+];
+
+/// A SHA-512 hash that is computed incrementally
+///
+/// The state is small and contains no pointers,
+/// so cloning it to take the hash of a prefix of the message is cheap.
+///
+/// # Examples
+///
+/// ```
+/// use libcrypto::sha2::{self, Sha512};
+///
+/// let mut hasher = Sha512::new();
+/// hasher.update(b"first message");
+/// let snapshot = hasher.clone();
+/// hasher.update(b", second message");
+///
+/// assert_eq!(hasher.finalize(), sha2::sha512(b"first message, second message"));
+/// assert_eq!(snapshot.finalize(), sha2::sha512(b"first message"));
+/// ```
+#[derive(Clone, Debug)]
+pub struct Sha512 {
+    hash: [u64; HASH_SIZE / 8],
+    /// The start of the current, incomplete block
+    buffer: [u8; BLOCK_SIZE],
+    /// The length of the message so far, in bytes
+    len: u128,
+}
+
+impl Sha512 {
+    /// Starts hashing a new message
+    pub const fn new() -> Self {
+        Self {
+            hash: INITIAL_HASH,
+            buffer: [0; BLOCK_SIZE],
+            len: 0,
+        }
+    }
 
-    // let padding_size = BLOCK_SIZE - (msg.len() % BLOCK_SIZE);
-    let msg_excess = &msg[msg.len() - (msg.len() % BLOCK_SIZE)..];
-    let mut last_block = [0u8; BLOCK_SIZE];
-    last_block[..msg_excess.len()].copy_from_slice(msg_excess);
+    /// Appends `data` to the message
+    pub fn update(&mut self, mut data: &[u8]) {
+        let used = (self.len % BLOCK_SIZE as u128) as usize;
+        self.len += data.len() as u128;
+        if used != 0 {
+            let len = data.len().min(BLOCK_SIZE - used);
+            self.buffer[used..used + len].copy_from_slice(&data[..len]);
+            data = &data[len..];
+            if used + len < BLOCK_SIZE {
+                return;
+            }
+            update_blocks(&mut self.hash, &self.buffer);
+        }
 
-    // we can write here unconditionally because the excess must be less than `BLOCK_SIZE`
-    last_block[msg_excess.len()] = 0x80;
-    if msg_excess.len() < BLOCK_SIZE - 17 {
-        last_block[BLOCK_SIZE - 16..].copy_from_slice(&(msg.len() as u128 * 8).to_be_bytes());
-        update_hash(&mut hash, &be_bytes_to_u64_array(&last_block));
-    } else {
-        update_hash(&mut hash, &be_bytes_to_u64_array(&last_block));
-        let mut extra_block = [0u8; BLOCK_SIZE];
-        extra_block[BLOCK_SIZE - 16..].copy_from_slice(&(msg.len() as u128 * 8).to_be_bytes());
-        update_hash(&mut hash, &be_bytes_to_u64_array(&extra_block));
+        let split = data.len() - data.len() % BLOCK_SIZE;
+        update_blocks(&mut self.hash, &data[..split]);
+        self.buffer[..data.len() - split].copy_from_slice(&data[split..]);
     }
 
-    to_be_bytes_from_hash(hash)
+    /// Pads the message and returns its hash
+    pub fn finalize(mut self) -> [u8; HASH_SIZE] {
+        let used = (self.len % BLOCK_SIZE as u128) as usize;
+        // we can write here unconditionally because `used` must be less than `BLOCK_SIZE`
+        self.buffer[used] = 0x80;
+        self.buffer[used + 1..].fill(0);
+        if used + 1 > BLOCK_SIZE - 16 {
+            update_blocks(&mut self.hash, &self.buffer);
+            self.buffer.fill(0);
+        }
+        self.buffer[BLOCK_SIZE - 16..].copy_from_slice(&self.len.wrapping_mul(8).to_be_bytes());
+        update_blocks(&mut self.hash, &self.buffer);
+
+        to_be_bytes_from_hash(self.hash)
+    }
+}
+
+impl Default for Sha512 {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+/// Updates `hash` with each block of `blocks`
+///
+/// `blocks` must be a multiple of `BLOCK_SIZE` long.
+fn update_blocks(hash: &mut [u64; HASH_SIZE / 8], blocks: &[u8]) {
+    debug_assert_eq!(blocks.len() % BLOCK_SIZE, 0);
+    blocks
+        // TODO: use `array_chunks` once stabilized
+        .chunks_exact(BLOCK_SIZE)
+        // we can safely unwrap because `block` is guaranteed to have a length of `BLOCK_SIZE`
+        .map(|block| be_bytes_to_u64_array(block.try_into().unwrap()))
+        .for_each(|block| update_hash(hash, &block));
 }
 
 // TODO: use macro to use the same function as in sha-256
@@ -262,4 +333,30 @@ mod tests {
         ];
         assert_eq!(hash, super::sha512(msg));
     }
+
+    #[test]
+    fn streaming() {
+        // the longest message whose length still fits in its last block
+        let msg = [b'a'; 111];
+        let hash = [
+            0xfa, 0x91, 0x21, 0xc7, 0xb3, 0x2b, 0x9e, 0x01, 0x73, 0x3d, 0x03, 0x4c, 0xfc, 0x78,
+            0xcb, 0xf6, 0x7f, 0x92, 0x6c, 0x7e, 0xd8, 0x3e, 0x82, 0x20, 0x0e, 0xf8, 0x68, 0x18,
+            0x19, 0x69, 0x21, 0x76, 0x0b, 0x4b, 0xef, 0xf4, 0x84, 0x04, 0xdf, 0x81, 0x1b, 0x95,
+            0x38, 0x28, 0x27, 0x44, 0x61, 0x67, 0x3c, 0x68, 0xd0, 0x4e, 0x29, 0x7b, 0x0e, 0xb7,
+            0xb2, 0xb4, 0xd6, 0x0f, 0xc6, 0xb5, 0x66, 0xa2,
+        ];
+        assert_eq!(super::sha512(&msg), hash);
+
+        let mut long_msg = [0u8; 3 * super::BLOCK_SIZE + 7];
+        for (i, byte) in long_msg.iter_mut().enumerate() {
+            *byte = (i * 3) as u8;
+        }
+        for piece_len in [1, 13, super::BLOCK_SIZE, super::BLOCK_SIZE + 1] {
+            let mut hasher = super::Sha512::new();
+            for piece in long_msg.chunks(piece_len) {
+                hasher.update(piece);
+            }
+            assert_eq!(hasher.finalize(), super::sha512(&long_msg));
+        }
+    }
 }
@@ -0,0 +1,24 @@
+//! Erasing secrets from memory
+//!
+//! The compiler may remove an ordinary write to memory that is never read again,
+//! which is exactly what a write erasing a secret looks like, so these writes are volatile.
+
+/// Overwrites every element of `values` with `zero`
+///
+/// # Examples
+///
+/// ```
+/// use libcrypto::zeroize::zeroize;
+///
+/// let mut secret = [0x42u8; 32];
+/// zeroize(&mut secret, 0);
+/// assert_eq!(secret, [0; 32]);
+/// ```
+pub fn zeroize<T: Copy>(values: &mut [T], zero: T) {
+    for value in values.iter_mut() {
+        // SAFETY: `value` is a valid, aligned, and exclusive reference
+        unsafe { core::ptr::write_volatile(value, zero) };
+    }
+    // keep the writes from being moved after whatever reuses the memory
+    core::sync::atomic::compiler_fence(core::sync::atomic::Ordering::SeqCst);
+}
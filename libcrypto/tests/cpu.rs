@@ -0,0 +1,24 @@
+//! Restricting the CPU features changes the backends of the whole process,
+//! so this runs apart from the unit tests, which check that the backends agree.
+use libcrypto::cpu::{self, Features};
+
+#[test]
+fn restrict() {
+    let detected = cpu::detected();
+    assert_eq!(cpu::restrict(Features::default()), Features::default());
+    assert_eq!(cpu::features(), Features::default());
+    let software = cpu::backends();
+    assert_eq!((software.aes, software.ghash), ("bitsliced", "software"));
+    assert_eq!((software.sha256, software.poly1305), ("software", "scalar"));
+    assert_eq!(software.chacha20, "portable");
+
+    // nothing the CPU lacks can be turned on
+    assert_eq!(cpu::restrict(Features::ALL), detected);
+    assert_eq!(cpu::features(), detected);
+    let hardware = cpu::backends();
+    assert_eq!(hardware.aes == "bitsliced", !detected.aes);
+    // many messages are hashed one at a time when there are SHA-256 instructions
+    if hardware.sha256 != "software" {
+        assert_eq!(hardware.sha256_many, hardware.sha256);
+    }
+}
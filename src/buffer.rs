@@ -0,0 +1,157 @@
+//! Record buffers, and the pools they are taken from
+//!
+//! Each [`Connection`](crate::connection::Connection) uses up to three buffers of
+//! [`BUFFER_SIZE`] bytes: one for records as they are received, one for the data decrypted from
+//! them, and one for records waiting to be sent. It only holds each while it has something in it,
+//! and gives it back to its [`BufferPool`] once it is drained, so an idle connection holds none.
+//! It erases everything it wrote to a buffer before giving it back, so a pool never holds one
+//! connection's data where another can see it.
+//!
+//! The default pool, [`Heap`], allocates and frees each buffer. A [`SlabPool`] instead keeps
+//! the buffers it is given, and hands them out again, so busy connections recycle each other's
+//! buffers instead of going through the allocator.
+//!
+//! Like the rest of this crate, pools need the standard library; there is no `no_std` version.
+//!
+//! # Examples
+//!
+//! ```
+//! use turtls::buffer::{BufferPool, SlabPool};
+//!
+//! static POOL: SlabPool = SlabPool::new(1024);
+//!
+//! let buffer = POOL.take();
+//! POOL.give(buffer);
+//! assert_eq!(POOL.len(), 1);
+//! ```
+use std::sync::Mutex;
+
+use crate::record::MAX_RECORD_SIZE;
+
+/// The size of every buffer, which is enough to hold any record
+pub const BUFFER_SIZE: usize = MAX_RECORD_SIZE;
+
+/// A record buffer
+pub type Buffer = Box<[u8; BUFFER_SIZE]>;
+
+/// Allocates an empty buffer on the heap, without building it on the stack first
+pub fn allocate() -> Buffer {
+    // we can safely unwrap because the slice is guaranteed to have a length of `BUFFER_SIZE`
+    vec![0; BUFFER_SIZE].into_boxed_slice().try_into().unwrap()
+}
+
+/// Somewhere to take buffers from and give them back to
+///
+/// Pools are shared between connections, and so between threads.
+pub trait BufferPool: Send + Sync {
+    /// Takes a buffer from the pool
+    ///
+    /// Its contents are unspecified, and may be left over from another connection.
+    fn take(&self) -> Buffer;
+
+    /// Gives `buffer` back to the pool
+    fn give(&self, buffer: Buffer);
+}
+
+/// A pool that allocates every buffer it hands out, and frees every buffer it is given
+pub struct Heap;
+
+impl BufferPool for Heap {
+    fn take(&self) -> Buffer {
+        allocate()
+    }
+
+    fn give(&self, buffer: Buffer) {
+        drop(buffer);
+    }
+}
+
+/// A pool that keeps the buffers it is given, to hand them out again
+///
+/// It keeps up to a fixed number of buffers, and frees any more it is given. It allocates
+/// whenever it has none to hand out.
+pub struct SlabPool {
+    free: Mutex<Vec<Buffer>>,
+    capacity: usize,
+}
+
+impl SlabPool {
+    /// Creates a new [`SlabPool`] that keeps up to `capacity` buffers
+    ///
+    /// Nothing is allocated until buffers are given back, so this can initialize a `static`.
+    pub const fn new(capacity: usize) -> Self {
+        Self {
+            free: Mutex::new(Vec::new()),
+            capacity,
+        }
+    }
+
+    fn free(&self) -> std::sync::MutexGuard<'_, Vec<Buffer>> {
+        // a panic while the lock is held can't leave the list inconsistent,
+        // so a poisoned lock is safe to use
+        self.free
+            .lock()
+            .unwrap_or_else(|poisoned| poisoned.into_inner())
+    }
+
+    /// Returns the number of buffers the pool is keeping
+    pub fn len(&self) -> usize {
+        self.free().len()
+    }
+
+    /// Returns whether the pool is keeping no buffers
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Frees every buffer the pool is keeping, such as after a burst of traffic
+    pub fn shrink(&self) {
+        // free them after releasing the lock
+        let free = core::mem::take(&mut *self.free());
+        drop(free);
+    }
+}
+
+impl BufferPool for SlabPool {
+    fn take(&self) -> Buffer {
+        self.free().pop().unwrap_or_else(allocate)
+    }
+
+    fn give(&self, buffer: Buffer) {
+        let mut free = self.free();
+        if free.len() < self.capacity {
+            if free.capacity() == 0 {
+                free.reserve_exact(self.capacity);
+            }
+            free.push(buffer);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn slab_pool() {
+        let pool = SlabPool::new(2);
+        let mut first = pool.take();
+        first[0] = 0x17;
+        let first_ptr = first.as_ptr();
+        pool.give(first);
+        assert_eq!(pool.len(), 1);
+
+        // the same buffer comes back out
+        let first = pool.take();
+        assert_eq!(first.as_ptr(), first_ptr);
+        assert!(pool.is_empty());
+
+        let (second, third) = (pool.take(), pool.take());
+        pool.give(first);
+        pool.give(second);
+        pool.give(third);
+        assert_eq!(pool.len(), 2);
+        pool.shrink();
+        assert!(pool.is_empty());
+    }
+}
@@ -0,0 +1,819 @@
+//! A TLS connection, as a state machine that does no I/O of its own
+//!
+//! A [`Connection`] never touches a socket and never blocks. The caller reads from the network
+//! into the connection, with [`Connection::feed`] or [`Connection::receive_buffer`],
+//! and writes out what [`Connection::pending_output`] returns. [`Connection::wants`] says which
+//! of these the connection is waiting on, so it fits into an event loop built on epoll, io_uring,
+//! or anything else, with many connections to a thread.
+//!
+//! Buffers are only held while they have something in them, so an idle connection takes up little
+//! memory. They're taken from a [`BufferPool`], which [`Connection::with_pool`] can share between
+//! connections.
+//!
+//! Connections are currently created from the traffic keys of a handshake done elsewhere;
+//! post-handshake messages, such as key updates, are not yet supported.
+//!
+//! # Examples
+//!
+//! ```
+//! use turtls::connection::Connection;
+//! use turtls::record::{Aead, CipherSuite, TrafficKey};
+//!
+//! let key = |byte| {
+//!     let aead = Aead::new(CipherSuite::Aes128GcmSha256, &[byte; 16]).unwrap();
+//!     TrafficKey::new(aead, [byte; 12])
+//! };
+//! let mut client = Connection::new(key(1), key(2));
+//! let mut server = Connection::new(key(2), key(1));
+//!
+//! assert_eq!(client.write(b"Hello, world!"), Ok(13));
+//! assert!(client.wants().write);
+//! let sent = server.feed(client.pending_output()).unwrap();
+//! client.consume_output(sent);
+//!
+//! let mut buf = [0; 64];
+//! let len = server.read(&mut buf);
+//! assert_eq!(buf[..len], *b"Hello, world!");
+//! ```
+use crate::buffer::{Buffer, BufferPool, Heap, BUFFER_SIZE};
+use crate::ktls::{CryptoInfo, Ktls, KtlsError};
+use crate::record::{self, ContentType, RecordError, TrafficKey, HEADROOM, MAX_PLAINTEXT_SIZE};
+#[cfg(feature = "stats")]
+use crate::stats::Counters;
+use libcrypto::zeroize::zeroize;
+
+/// The output space kept free for an alert, so that one can always be sent
+const ALERT_RESERVE: usize = record::sealed_size(2);
+
+/// The alert level of fatal alerts
+const FATAL: u8 = 2;
+
+/// The alert level of warnings, which is only used by closure alerts
+const WARNING: u8 = 1;
+
+/// The alert that closes a connection
+const CLOSE_NOTIFY: u8 = 0;
+
+/// The alert that says the peer is abandoning the connection, which is followed by close_notify
+/// (RFC 8446, section 6.1)
+const USER_CANCELED: u8 = 90;
+
+/// The alert sent for unexpected messages
+const UNEXPECTED_MESSAGE: u8 = 10;
+
+/// The alert sent for errors that aren't caused by the peer
+const INTERNAL_ERROR: u8 = 80;
+
+/// What a connection is waiting on
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Default)]
+pub struct Want {
+    /// More data from the network, for [`Connection::feed`] or [`Connection::receive_buffer`]
+    pub read: bool,
+    /// Room in the network to send [`Connection::pending_output`]
+    pub write: bool,
+}
+
+/// An error that ended a connection
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum ConnectionError {
+    /// The connection is closed for writing, either by [`Connection::close`] or by an error
+    Closed,
+    /// A record from the peer was bad, so a fatal alert was sent
+    Record(RecordError),
+    /// The peer sent a fatal alert, with this description
+    PeerAlert(u8),
+    /// The peer sent a post-handshake message, which isn't yet supported
+    Unsupported,
+    /// The connection was handed to kernel TLS, which now seals and opens its records
+    Offloaded,
+}
+
+impl ConnectionError {
+    /// Returns the description of the alert sent or received for this error, if any
+    pub const fn alert(self) -> Option<u8> {
+        match self {
+            Self::Closed | Self::Offloaded => None,
+            Self::Record(error) => Some(alert_for(error)),
+            Self::PeerAlert(alert) => Some(alert),
+            Self::Unsupported => Some(UNEXPECTED_MESSAGE),
+        }
+    }
+}
+
+impl core::fmt::Display for ConnectionError {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        match self {
+            Self::Closed => write!(f, "connection is closed"),
+            Self::Record(error) => write!(f, "{error}"),
+            Self::PeerAlert(alert) => write!(f, "peer sent fatal alert {alert}"),
+            Self::Unsupported => write!(f, "peer sent an unsupported post-handshake message"),
+            Self::Offloaded => write!(f, "connection is offloaded to kernel TLS"),
+        }
+    }
+}
+
+impl std::error::Error for ConnectionError {}
+
+/// Returns the description of the alert to send for `error`
+const fn alert_for(error: RecordError) -> u8 {
+    match error {
+        RecordError::BufferTooSmall | RecordError::SequenceExhausted => INTERNAL_ERROR,
+        RecordError::RecordOverflow => 22,
+        RecordError::BadRecordMac => 20,
+        RecordError::DecodeError => 50,
+        RecordError::UnexpectedMessage => UNEXPECTED_MESSAGE,
+    }
+}
+
+/// Bytes held in a pooled buffer, from `start` to `end`
+///
+/// The buffer is taken from the pool when something is put in it,
+/// and given back once it's drained. Everything written to it is erased first, so no data can
+/// leak to the next connection that takes it.
+struct Slot {
+    buffer: Option<Buffer>,
+    start: usize,
+    end: usize,
+    /// The end of everything written to the buffer since it was taken,
+    /// which can be past `end` once the data has been moved back
+    written: usize,
+}
+
+impl Slot {
+    const EMPTY: Self = Self {
+        buffer: None,
+        start: 0,
+        end: 0,
+        written: 0,
+    };
+
+    fn len(&self) -> usize {
+        self.end - self.start
+    }
+
+    fn is_empty(&self) -> bool {
+        self.start == self.end
+    }
+
+    fn data(&self) -> &[u8] {
+        self.buffer
+            .as_ref()
+            .map_or(&[], |buffer| &buffer[self.start..self.end])
+    }
+
+    /// Returns the space after the data, taking a buffer from `pool` if there isn't one
+    ///
+    /// The data is first moved to the start of the buffer if that makes room for `wanted` bytes.
+    fn spare(&mut self, pool: &dyn BufferPool, wanted: usize) -> &mut [u8] {
+        let buffer = self.buffer.get_or_insert_with(|| pool.take());
+        if BUFFER_SIZE - self.end < wanted && self.start > 0 {
+            buffer.copy_within(self.start..self.end, 0);
+            self.end -= self.start;
+            self.start = 0;
+        }
+        &mut buffer[self.end..]
+    }
+
+    /// Adds the `n` bytes written after the data to it
+    fn commit(&mut self, n: usize) {
+        self.end += n;
+        self.written = self.written.max(self.end);
+    }
+
+    /// Marks the first `n` bytes of the data as used, giving the buffer back once it's drained
+    fn consume(&mut self, n: usize, pool: &dyn BufferPool) {
+        debug_assert!(n <= self.len());
+        self.start += n;
+        if self.is_empty() {
+            self.release(pool);
+        }
+    }
+
+    /// Erases the data and gives the buffer back to `pool`
+    fn release(&mut self, pool: &dyn BufferPool) {
+        if let Some(mut buffer) = self.buffer.take() {
+            zeroize(&mut buffer[..self.written], 0);
+            pool.give(buffer);
+        }
+        *self = Self::EMPTY;
+    }
+}
+
+/// An established TLS connection
+pub struct Connection {
+    read_key: TrafficKey,
+    write_key: TrafficKey,
+    pool: &'static dyn BufferPool,
+    /// Received bytes that haven't been opened yet
+    received: Slot,
+    /// Decrypted application data
+    plaintext: Slot,
+    /// Sealed records waiting to be sent
+    output: Slot,
+    /// Whether the peer has closed its side of the connection
+    read_closed: bool,
+    /// Whether this side of the connection is closed
+    write_closed: bool,
+    error: Option<ConnectionError>,
+    #[cfg(feature = "stats")]
+    counters: Counters,
+}
+
+impl Connection {
+    /// Creates a new [`Connection`] that opens records with `read_key` and seals them with
+    /// `write_key`
+    ///
+    /// Its buffers are allocated as they're needed, and freed once they're drained.
+    pub fn new(read_key: TrafficKey, write_key: TrafficKey) -> Self {
+        Self::with_pool(read_key, write_key, &Heap)
+    }
+
+    /// Creates a new [`Connection`] that opens records with `read_key` and seals them with
+    /// `write_key`, taking its buffers from `pool`
+    pub fn with_pool(
+        read_key: TrafficKey,
+        write_key: TrafficKey,
+        pool: &'static dyn BufferPool,
+    ) -> Self {
+        Self {
+            read_key,
+            write_key,
+            pool,
+            received: Slot::EMPTY,
+            plaintext: Slot::EMPTY,
+            output: Slot::EMPTY,
+            read_closed: false,
+            write_closed: false,
+            error: None,
+            #[cfg(feature = "stats")]
+            counters: Counters::default(),
+        }
+    }
+
+    /// Returns what the connection is waiting on
+    ///
+    /// The connection wants to read until the peer closes its side or its receive buffer is full,
+    /// which happens when it has as much decrypted data as it holds, and wants to write whenever it
+    /// has output pending.
+    pub fn wants(&self) -> Want {
+        Want {
+            read: !self.read_closed && self.error.is_none() && self.received.end < BUFFER_SIZE,
+            write: !self.output.is_empty(),
+        }
+    }
+
+    /// Returns the error that ended the connection, if any
+    pub fn error(&self) -> Option<ConnectionError> {
+        self.error
+    }
+
+    /// Returns the counts of the records this connection has sealed and opened
+    #[cfg(feature = "stats")]
+    pub fn counters(&self) -> Counters {
+        self.counters
+    }
+
+    /// Returns whether the peer has closed its side of the connection
+    ///
+    /// Once it has, and [`read`](Self::read) returns nothing, there is nothing more to read.
+    pub fn is_read_closed(&self) -> bool {
+        self.read_closed
+    }
+
+    /// Returns the space to receive data into from the network
+    ///
+    /// After receiving `n` bytes into it, call [`commit_received`](Self::commit_received),
+    /// even if `n` is 0, so that an unused buffer is given back to the pool.
+    /// This lets a socket read straight into the connection. The slice is empty when the
+    /// connection isn't reading.
+    pub fn receive_buffer(&mut self) -> &mut [u8] {
+        if !self.wants().read {
+            return &mut [];
+        }
+        self.received.spare(self.pool, 0)
+    }
+
+    /// Processes `n` bytes that were received into [`receive_buffer`](Self::receive_buffer)
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if the peer sent a bad record or a fatal alert,
+    /// which ends the connection. Decrypted data received before the error can still be read.
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `n` is longer than the last slice returned by
+    /// [`receive_buffer`](Self::receive_buffer).
+    pub fn commit_received(&mut self, n: usize) -> Result<(), ConnectionError> {
+        assert!(n <= self.received_spare(), "received more than the buffer");
+        self.received.commit(n);
+        self.open_received()
+    }
+
+    /// Returns the length of the space after the received data, without taking a buffer
+    pub(crate) fn received_spare(&self) -> usize {
+        match self.received.buffer {
+            Some(_) => BUFFER_SIZE - self.received.end,
+            None => 0,
+        }
+    }
+
+    /// Processes `data`, which was received from the network, returning how much of it was used
+    ///
+    /// Less than all of `data` is used when the connection stops reading. In that case, read some
+    /// data, then feed the rest.
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if the peer sent a bad record or a fatal alert,
+    /// which ends the connection. Decrypted data received before the error can still be read.
+    pub fn feed(&mut self, mut data: &[u8]) -> Result<usize, ConnectionError> {
+        let mut used = 0;
+        while !data.is_empty() {
+            let buf = self.receive_buffer();
+            let len = buf.len().min(data.len());
+            if len == 0 {
+                break;
+            }
+            buf[..len].copy_from_slice(&data[..len]);
+            data = &data[len..];
+            used += len;
+            self.commit_received(len)?;
+        }
+        Ok(used)
+    }
+
+    /// Opens the complete records received, if there's room for what they decrypt to
+    fn open_received(&mut self) -> Result<(), ConnectionError> {
+        // a record's payload is shorter than the record,
+        // so this is enough room for everything received
+        let wanted = self.received.len();
+        if wanted == 0 {
+            // give back a buffer that was asked for but never received into
+            self.received.release(self.pool);
+            return Ok(());
+        }
+        if BUFFER_SIZE - self.plaintext.len() < wanted {
+            return Ok(());
+        }
+        let mut alert = None;
+        let mut unsupported = false;
+        let (read_closed, plaintext) = (&mut self.read_closed, &mut self.plaintext);
+        let mut spare = plaintext.spare(self.pool, wanted);
+        let mut decrypted = 0;
+        #[cfg(feature = "stats")]
+        let (mut records, mut bytes) = (0, 0);
+        // we can safely unwrap because `received` isn't empty, so it has a buffer
+        let received = self.received.buffer.as_mut().unwrap();
+        let result = self.read_key.open_many(
+            &mut received[..self.received.end],
+            |content_type, payload| {
+                #[cfg(feature = "stats")]
+                {
+                    records += 1;
+                    bytes += payload.len() as u64;
+                }
+                // anything after close_notify or an error is ignored
+                if *read_closed || alert.is_some() || unsupported {
+                    return;
+                }
+                match content_type {
+                    ContentType::ApplicationData => {
+                        let rest = core::mem::take(&mut spare);
+                        let (dst, rest) = rest.split_at_mut(payload.len());
+                        dst.copy_from_slice(payload);
+                        spare = rest;
+                        decrypted += payload.len();
+                    },
+                    ContentType::Alert => match *payload {
+                        [_, CLOSE_NOTIFY] => *read_closed = true,
+                        // not an error, so the connection carries on until the close_notify
+                        [_, USER_CANCELED] => (),
+                        [_, description] => alert = Some(Ok(description)),
+                        _ => alert = Some(Err(RecordError::DecodeError)),
+                    },
+                    ContentType::Handshake => unsupported = true,
+                    ContentType::ChangeCipherSpec => {
+                        alert = Some(Err(RecordError::UnexpectedMessage))
+                    },
+                }
+            },
+        );
+        plaintext.commit(decrypted);
+        #[cfg(feature = "stats")]
+        self.counters.opened(records, bytes);
+        if plaintext.is_empty() {
+            plaintext.release(self.pool);
+        }
+        let error = match (result, alert) {
+            (Err(error), _) | (Ok(_), Some(Err(error))) => Some(ConnectionError::Record(error)),
+            (Ok(_), Some(Ok(description))) => Some(ConnectionError::PeerAlert(description)),
+            (Ok(_), None) if unsupported => Some(ConnectionError::Unsupported),
+            (Ok(opened), None) => {
+                received.copy_within(opened..self.received.end, 0);
+                self.received.end -= opened;
+                None
+            },
+        };
+        if self.received.is_empty() || self.read_closed || error.is_some() {
+            self.received.release(self.pool);
+        }
+        match error {
+            Some(error) => Err(self.fail(error)),
+            None => Ok(()),
+        }
+    }
+
+    /// Ends the connection with `error`, sending the alert for it if there is one to send
+    fn fail(&mut self, error: ConnectionError) -> ConnectionError {
+        self.error = Some(error);
+        if let (Some(description), ConnectionError::Record(_) | ConnectionError::Unsupported) =
+            (error.alert(), error)
+        {
+            // the alert is best-effort, since the connection is failing anyway, and none is sent
+            // after close_notify
+            if !self.write_closed {
+                let _ = self.send(ContentType::Alert, &[FATAL, description]);
+            }
+        }
+        self.write_closed = true;
+        error
+    }
+
+    /// Reads decrypted application data into `buf`, returning how much was read
+    ///
+    /// Returns 0 if there is no data to read yet, or if the connection is closed and there is no
+    /// more to read. If reading makes room for records that were waiting to be opened, they are
+    /// opened, and any error that causes is returned by [`error`](Self::error).
+    pub fn read(&mut self, buf: &mut [u8]) -> usize {
+        let available = self.plaintext.data();
+        let len = buf.len().min(available.len());
+        buf[..len].copy_from_slice(&available[..len]);
+        self.plaintext.consume(len, self.pool);
+        if len > 0 && self.error.is_none() {
+            // the error is recorded by the connection
+            let _ = self.open_received();
+        }
+        len
+    }
+
+    /// Seals `data` as application data, returning how much of it was sealed
+    ///
+    /// Less than all of `data` is sealed when the output buffer is full. In that case, write out
+    /// some of the [`pending_output`](Self::pending_output), then write the rest.
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if the connection is closed for writing.
+    pub fn write(&mut self, data: &[u8]) -> Result<usize, ConnectionError> {
+        if self.write_closed {
+            return Err(match self.error {
+                Some(ConnectionError::Offloaded) => ConnectionError::Offloaded,
+                _ => ConnectionError::Closed,
+            });
+        }
+        let len = data.len().min(MAX_PLAINTEXT_SIZE);
+        if len == 0 || BUFFER_SIZE - self.output.len() < record::sealed_size(len) + ALERT_RESERVE {
+            return Ok(0);
+        }
+        self.send(ContentType::ApplicationData, &data[..len])
+            .map_err(|error| self.fail(ConnectionError::Record(error)))?;
+        Ok(len)
+    }
+
+    /// Seals `data` into a record of `content_type`, and queues it
+    fn send(&mut self, content_type: ContentType, data: &[u8]) -> Result<(), RecordError> {
+        let sealed_len = record::sealed_size(data.len());
+        let spare = self.output.spare(self.pool, sealed_len);
+        let result = match spare.get_mut(..sealed_len) {
+            Some(record) => {
+                record[HEADROOM..][..data.len()].copy_from_slice(data);
+                self.write_key.seal(record, data.len(), content_type)
+            },
+            None => Err(RecordError::BufferTooSmall),
+        };
+        match result {
+            Ok(len) => {
+                self.output.commit(len);
+                #[cfg(feature = "stats")]
+                self.counters.sealed(1, data.len() as u64);
+            },
+            Err(_) => {
+                // the plaintext may have been left where the record would have gone
+                let end = BUFFER_SIZE.min(self.output.end + sealed_len);
+                self.output.written = self.output.written.max(end);
+                if self.output.is_empty() {
+                    self.output.release(self.pool);
+                }
+            },
+        }
+        result.map(|_| ())
+    }
+
+    /// Returns the sealed records waiting to be sent
+    ///
+    /// After sending `n` bytes of them, call [`consume_output`](Self::consume_output).
+    pub fn pending_output(&self) -> &[u8] {
+        self.output.data()
+    }
+
+    /// Marks the first `n` bytes of [`pending_output`](Self::pending_output) as sent
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `n` is longer than the pending output.
+    pub fn consume_output(&mut self, n: usize) {
+        assert!(n <= self.output.len(), "sent more than the pending output");
+        self.output.consume(n, self.pool);
+    }
+
+    /// Hands the connection over to kernel TLS, returning its state in the form the kernel takes
+    ///
+    /// Pass the result to [`ktls::install`](crate::ktls::install), on Linux.
+    /// From then on, the connection refuses to seal or open records, as the kernel does that.
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error, and leave the connection as it was, if it is closed,
+    /// if it has output that hasn't been sent, data that hasn't been read, or part of a record, or
+    /// if its traffic keys weren't created with [`TrafficKey::with_key`].
+    pub fn offload_ktls(&mut self) -> Result<Ktls, KtlsError> {
+        if self.error.is_some() || self.read_closed || self.write_closed {
+            return Err(KtlsError::Closed);
+        }
+        if !(self.output.is_empty() && self.received.is_empty() && self.plaintext.is_empty()) {
+            return Err(KtlsError::Pending);
+        }
+        let ktls = Ktls {
+            tx: CryptoInfo::new(&self.write_key).ok_or(KtlsError::NoKey)?,
+            rx: CryptoInfo::new(&self.read_key).ok_or(KtlsError::NoKey)?,
+        };
+        self.error = Some(ConnectionError::Offloaded);
+        self.write_closed = true;
+        Ok(ktls)
+    }
+
+    /// Closes this side of the connection, by queueing a close_notify alert
+    ///
+    /// Pending output should still be sent. The peer may keep sending data until it closes its
+    /// side too.
+    pub fn close(&mut self) {
+        if self.write_closed {
+            return;
+        }
+        if let Err(error) = self.send(ContentType::Alert, &[WARNING, CLOSE_NOTIFY]) {
+            self.fail(ConnectionError::Record(error));
+        }
+        self.write_closed = true;
+    }
+}
+
+impl Drop for Connection {
+    /// Gives the connection's buffers back to its pool
+    fn drop(&mut self) {
+        self.received.release(self.pool);
+        self.plaintext.release(self.pool);
+        self.output.release(self.pool);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::buffer::SlabPool;
+    use crate::record::{Aead, CipherSuite};
+
+    fn pair() -> (Connection, Connection) {
+        let key = |byte| {
+            let aead = Aead::new(CipherSuite::ChaCha20Poly1305Sha256, &[byte; 32]).unwrap();
+            TrafficKey::new(aead, [byte; 12])
+        };
+        (
+            Connection::new(key(1), key(2)),
+            Connection::new(key(2), key(1)),
+        )
+    }
+
+    /// Moves as much of `from`'s output to `to` as it will take, a few bytes at a time
+    fn transfer(from: &mut Connection, to: &mut Connection) -> Result<(), ConnectionError> {
+        while from.wants().write && to.wants().read {
+            let chunk = from.pending_output().len().min(1000);
+            let buf = to.receive_buffer();
+            let len = buf.len().min(chunk);
+            buf[..len].copy_from_slice(&from.pending_output()[..len]);
+            from.consume_output(len);
+            to.commit_received(len)?;
+        }
+        Ok(())
+    }
+
+    #[test]
+    fn round_trip() {
+        let (mut client, mut server) = pair();
+        assert_eq!(
+            client.wants(),
+            Want {
+                read: true,
+                write: false
+            }
+        );
+        let msg: Vec<u8> = (0..50_000).map(|i| i as u8).collect();
+        let mut written = 0;
+        let mut received = Vec::new();
+        while received.len() < msg.len() {
+            written += client.write(&msg[written..]).unwrap();
+            transfer(&mut client, &mut server).unwrap();
+            let mut buf = [0; 7000];
+            loop {
+                let len = server.read(&mut buf);
+                if len == 0 {
+                    break;
+                }
+                received.extend_from_slice(&buf[..len]);
+            }
+        }
+        assert_eq!(received, msg);
+        // nothing is held once everything has been passed on
+        assert!(client.output.buffer.is_none() && server.received.buffer.is_none());
+        assert!(server.plaintext.buffer.is_none());
+    }
+
+    #[test]
+    fn backpressure() {
+        let (mut client, mut server) = pair();
+        let msg = vec![0x17; 10 * MAX_PLAINTEXT_SIZE];
+        // one full record fits in the output buffer
+        assert_eq!(client.write(&msg), Ok(MAX_PLAINTEXT_SIZE));
+        assert_eq!(client.write(&msg), Ok(0));
+
+        // the server stops reading once its plaintext and receive buffers are full
+        let mut written = MAX_PLAINTEXT_SIZE;
+        while server.wants().read {
+            transfer(&mut client, &mut server).unwrap();
+            written += client.write(&msg[written..]).unwrap();
+        }
+        assert_eq!(
+            server.plaintext.len(),
+            2 * MAX_PLAINTEXT_SIZE - MAX_PLAINTEXT_SIZE
+        );
+        assert_eq!(server.received.len(), BUFFER_SIZE);
+        assert!(server.receive_buffer().is_empty());
+        assert_eq!(server.feed(client.pending_output()), Ok(0));
+
+        // reading makes room for the records waiting to be opened
+        let mut buf = vec![0; MAX_PLAINTEXT_SIZE];
+        assert_eq!(server.read(&mut buf), MAX_PLAINTEXT_SIZE);
+        assert!(server.wants().read);
+        assert_eq!(server.plaintext.len(), MAX_PLAINTEXT_SIZE);
+    }
+
+    #[test]
+    fn pool() {
+        static POOL: SlabPool = SlabPool::new(8);
+        let key = |byte| {
+            let aead = Aead::new(CipherSuite::ChaCha20Poly1305Sha256, &[byte; 32]).unwrap();
+            TrafficKey::new(aead, [byte; 12])
+        };
+        let mut client = Connection::with_pool(key(1), key(2), &POOL);
+        let mut server = Connection::with_pool(key(2), key(1), &POOL);
+        client.write(b"hello").unwrap();
+        transfer(&mut client, &mut server).unwrap();
+        // only the server's plaintext is still held, and the other buffer is back in the pool
+        assert_eq!(POOL.len(), 1);
+        assert!(client.output.buffer.is_none() && server.received.buffer.is_none());
+
+        let mut buf = [0; 5];
+        assert_eq!(server.read(&mut buf), 5);
+        assert_eq!(POOL.len(), 2);
+        // idle connections hold no buffers
+        let taken = POOL.len();
+        server.write(b"world").unwrap();
+        assert_eq!(POOL.len(), taken - 1);
+        drop(server);
+        assert_eq!(POOL.len(), taken);
+    }
+
+    #[test]
+    fn pool_nothing_received() {
+        static POOL: SlabPool = SlabPool::new(8);
+        let key = |byte| {
+            let aead = Aead::new(CipherSuite::ChaCha20Poly1305Sha256, &[byte; 32]).unwrap();
+            TrafficKey::new(aead, [byte; 12])
+        };
+        POOL.give(crate::buffer::allocate());
+        let mut server = Connection::with_pool(key(2), key(1), &POOL);
+        assert_eq!(server.feed(&[]), Ok(0));
+        assert_eq!(POOL.len(), 1);
+        // a read that would block, or reached the end of the stream
+        assert!(!server.receive_buffer().is_empty());
+        assert_eq!(POOL.len(), 0);
+        server.commit_received(0).unwrap();
+        assert_eq!(POOL.len(), 1);
+        assert!(server.received.buffer.is_none());
+    }
+
+    #[test]
+    fn pool_erased() {
+        static POOL: SlabPool = SlabPool::new(8);
+        let key = |byte| {
+            let aead = Aead::new(CipherSuite::ChaCha20Poly1305Sha256, &[byte; 32]).unwrap();
+            TrafficKey::new(aead, [byte; 12])
+        };
+        let mut client = Connection::with_pool(key(1), key(2), &POOL);
+        let mut server = Connection::with_pool(key(2), key(1), &POOL);
+        client.write(&[0x5a; 3000]).unwrap();
+        client.write(&[0x5a; 2000]).unwrap();
+        transfer(&mut client, &mut server).unwrap();
+        let mut buf = [0; 4096];
+        assert_eq!(server.read(&mut buf), 4096);
+        assert_eq!(server.read(&mut buf), 904);
+        drop((client, server));
+
+        // every buffer given back, including the one decrypted into, is blank
+        let recycled: Vec<_> = (0..POOL.len()).map(|_| POOL.take()).collect();
+        assert_eq!(recycled.len(), 3);
+        assert!(recycled
+            .iter()
+            .all(|buffer| buffer.iter().all(|&byte| byte == 0)));
+    }
+
+    #[test]
+    fn close() {
+        let (mut client, mut server) = pair();
+        client.write(b"bye").unwrap();
+        client.close();
+        assert_eq!(client.write(b"more"), Err(ConnectionError::Closed));
+        transfer(&mut client, &mut server).unwrap();
+        assert!(server.is_read_closed());
+        assert!(!server.wants().read);
+        let mut buf = [0; 8];
+        assert_eq!(server.read(&mut buf), 3);
+        assert_eq!(server.read(&mut buf), 0);
+        // the server can still write until it closes too
+        assert_eq!(server.write(b"ok"), Ok(2));
+    }
+
+    #[test]
+    fn user_canceled() {
+        let (mut client, mut server) = pair();
+        client
+            .send(ContentType::Alert, &[WARNING, USER_CANCELED])
+            .unwrap();
+        client.write(b"last").unwrap();
+        transfer(&mut client, &mut server).unwrap();
+        assert_eq!(server.error(), None);
+        assert!(!server.is_read_closed());
+        let mut buf = [0; 8];
+        assert_eq!(server.read(&mut buf), 4);
+
+        client.close();
+        transfer(&mut client, &mut server).unwrap();
+        assert!(server.is_read_closed());
+        assert_eq!(server.error(), None);
+    }
+
+    #[test]
+    fn offload_ktls() {
+        let key = |byte| {
+            TrafficKey::with_key(CipherSuite::Aes256GcmSha384, &[byte; 32], [byte; 12]).unwrap()
+        };
+        let mut client = Connection::new(key(1), key(2));
+        let mut server = Connection::new(key(2), key(1));
+        client.write(b"hello").unwrap();
+        assert_eq!(client.offload_ktls().err(), Some(KtlsError::Pending));
+        transfer(&mut client, &mut server).unwrap();
+        assert_eq!(server.offload_ktls().err(), Some(KtlsError::Pending));
+        server.read(&mut [0; 5]);
+
+        let ktls = client.offload_ktls().unwrap();
+        // one record was sent, so the kernel carries on from sequence number 1
+        assert_eq!(ktls.tx.as_bytes()[48..], 1u64.to_be_bytes());
+        assert_eq!(ktls.rx.as_bytes()[48..], 0u64.to_be_bytes());
+        assert_eq!(client.write(b"x"), Err(ConnectionError::Offloaded));
+        assert_eq!(client.wants(), Want::default());
+        assert_eq!(client.offload_ktls().err(), Some(KtlsError::Closed));
+
+        let ktls = server.offload_ktls().unwrap();
+        assert_eq!(ktls.rx.as_bytes()[48..], 1u64.to_be_bytes());
+
+        let (mut client, _) = pair();
+        assert_eq!(client.offload_ktls().err(), Some(KtlsError::NoKey));
+    }
+
+    #[test]
+    fn bad_record() {
+        let (mut client, mut server) = pair();
+        client.write(b"hello").unwrap();
+        let mut record = client.pending_output().to_vec();
+        record[HEADROOM] ^= 1;
+        let error = ConnectionError::Record(RecordError::BadRecordMac);
+        assert_eq!(server.feed(&record), Err(error));
+        assert_eq!(server.error(), Some(error));
+        assert_eq!(server.write(b"x"), Err(ConnectionError::Closed));
+        assert_eq!(server.feed(&record), Ok(0));
+
+        // the server sent a fatal bad_record_mac alert
+        let fed = client.feed(server.pending_output());
+        assert_eq!(fed, Err(ConnectionError::PeerAlert(20)));
+    }
+}
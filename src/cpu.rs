@@ -0,0 +1,55 @@
+//! The hardware implementations `libcrypto` dispatches to, and overriding them
+//!
+//! `libcrypto` detects the CPU's features once, and keeps them in a table that every primitive
+//! picks its implementation from. [`backends`] reports the implementations in use, such as to log
+//! at startup, so it is plain when a machine has fallen back to software AES.
+//!
+//! The features can be turned off, to compare the hardware and software implementations, either
+//! with [`restrict`], or by setting [`DISABLE_VAR`] to a comma-separated list of features, such as
+//! `TURTLS_DISABLE=aes,clmul`. The variable is read the first time turtls creates a key through
+//! [`Aead::new`](crate::record::Aead::new), or by [`apply_env`]. A variable naming an unknown
+//! feature is ignored.
+//!
+//! # Examples
+//!
+//! ```
+//! use turtls::cpu;
+//!
+//! println!("{}", cpu::backends());
+//! let software = cpu::restrict(cpu::Features::default());
+//! assert!(!software.aes);
+//! assert_eq!(cpu::backends().aes, "bitsliced");
+//! cpu::restrict(cpu::Features::ALL);
+//! ```
+use std::sync::Once;
+
+pub use libcrypto::cpu::{backends, detected, features, Backends, Features};
+
+/// The environment variable that lists the CPU features to turn off
+pub const DISABLE_VAR: &str = "TURTLS_DISABLE";
+
+/// Turns off the CPU features listed in [`DISABLE_VAR`], if this hasn't been done yet
+///
+/// This happens the first time turtls creates a key, so only needs to be called to apply the
+/// variable before then, such as to report the [`backends`] at startup.
+pub fn apply_env() {
+    static APPLIED: Once = Once::new();
+    APPLIED.call_once(|| {
+        let Ok(names) = std::env::var(DISABLE_VAR) else {
+            return;
+        };
+        if let Ok(allowed) = Features::ALL.without(&names) {
+            libcrypto::cpu::restrict(allowed);
+        }
+    });
+}
+
+/// Uses only the features of `allowed` that the CPU supports, returning the features now in use
+///
+/// This replaces what [`DISABLE_VAR`] turned off. Keys that already exist keep the implementations
+/// they were created with.
+pub fn restrict(allowed: Features) -> Features {
+    // so that the variable can't later undo this
+    apply_env();
+    libcrypto::cpu::restrict(allowed)
+}
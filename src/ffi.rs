@@ -0,0 +1,620 @@
+//! The C interface, declared in `include/turtls.h`
+//!
+//! A connection is an opaque pointer, created by [`turtls_connection_new`] and freed by
+//! [`turtls_connection_free`]. No function blocks or does I/O; the caller moves bytes between the
+//! connection and the network, as [`turtls_want`] asks it to.
+//!
+//! Functions that can fail return a negative status: [`TURTLS_ERR_CLOSED`] if the connection is
+//! closed for writing, and [`TURTLS_ERR_FATAL`] if an error ended it, in which case
+//! [`turtls_alert`] returns the alert that was sent or received.
+//!
+//! [`turtls_hardware`] and [`turtls_backends`] report the hardware the cryptographic primitives
+//! use, and [`turtls_restrict_hardware`] turns it off.
+//!
+//! With the `stats` feature, `turtls_stats` and `turtls_connection_counters` read the counters of
+//! the `stats` module, and `turtls_set_trace_hook` sets its trace hook.
+use core::ffi::c_int;
+
+use crate::connection::{Connection, ConnectionError};
+use crate::cpu::Features;
+use crate::ktls::KtlsError;
+use crate::record::{CipherSuite, TrafficKey, IV_SIZE};
+
+/// The connection wants to read from the network
+pub const TURTLS_WANT_READ: u32 = 1;
+
+/// The connection wants to write to the network
+pub const TURTLS_WANT_WRITE: u32 = 2;
+
+/// The connection is closed for writing
+pub const TURTLS_ERR_CLOSED: c_int = -1;
+
+/// An error ended the connection
+pub const TURTLS_ERR_FATAL: c_int = -2;
+
+/// A null pointer or out-of-range length was passed, or the connection wasn't in a state to do
+/// what was asked
+pub const TURTLS_ERR_INVALID: c_int = -3;
+
+/// The kernel refused to enable kernel TLS, and set `errno` to say why
+pub const TURTLS_ERR_KTLS: c_int = -4;
+
+/// AES is using the AES instructions, rather than running in software
+pub const TURTLS_HW_AES: u32 = 1;
+
+/// GHASH is using carry-less multiplication, rather than running in software
+pub const TURTLS_HW_CLMUL: u32 = 2;
+
+/// SHA-256 is using the SHA-256 instructions
+pub const TURTLS_HW_SHA256: u32 = 4;
+
+/// ChaCha20, Poly1305, and multi-buffer SHA-256 are using AVX2
+pub const TURTLS_HW_AVX2: u32 = 8;
+
+/// ChaCha20 is using AVX-512
+pub const TURTLS_HW_AVX512F: u32 = 16;
+
+fn hardware_bits(features: Features) -> u32 {
+    (u32::from(features.aes) * TURTLS_HW_AES)
+        | (u32::from(features.clmul) * TURTLS_HW_CLMUL)
+        | (u32::from(features.sha256) * TURTLS_HW_SHA256)
+        | (u32::from(features.avx2) * TURTLS_HW_AVX2)
+        | (u32::from(features.avx512f) * TURTLS_HW_AVX512F)
+}
+
+fn status(error: ConnectionError) -> c_int {
+    match error {
+        ConnectionError::Closed | ConnectionError::Offloaded => TURTLS_ERR_CLOSED,
+        _ => TURTLS_ERR_FATAL,
+    }
+}
+
+/// Creates a connection from the traffic keys of a completed handshake
+///
+/// `cipher_suite` is the IANA value of a TLS 1.3 cipher suite, such as `0x1301`. Each key must be
+/// as long as the cipher suite's key, and each initialization vector 12 bytes.
+///
+/// Returns null if the cipher suite is unknown or a key has the wrong length.
+///
+/// # Safety
+///
+/// `read_key` and `write_key` must be valid for reads of `key_len` bytes,
+/// and `read_iv` and `write_iv` for reads of 12 bytes.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_connection_new(
+    cipher_suite: u16,
+    read_key: *const u8,
+    read_iv: *const u8,
+    write_key: *const u8,
+    write_iv: *const u8,
+    key_len: usize,
+) -> *mut Connection {
+    let Some(cipher_suite) = CipherSuite::from_u16(cipher_suite) else {
+        return core::ptr::null_mut();
+    };
+    if [read_key, read_iv, write_key, write_iv]
+        .iter()
+        .any(|ptr| ptr.is_null())
+    {
+        return core::ptr::null_mut();
+    }
+    let traffic_key = |key: *const u8, iv: *const u8| {
+        // SAFETY: the caller guarantees `key` and `iv` are valid for these lengths
+        let (key, iv) = unsafe {
+            (
+                core::slice::from_raw_parts(key, key_len),
+                core::slice::from_raw_parts(iv, IV_SIZE),
+            )
+        };
+        // we can safely unwrap because `iv` is guaranteed to have a length of `IV_SIZE`
+        TrafficKey::with_key(cipher_suite, key, iv.try_into().unwrap())
+    };
+    match (
+        traffic_key(read_key, read_iv),
+        traffic_key(write_key, write_iv),
+    ) {
+        (Some(read_key), Some(write_key)) => {
+            Box::into_raw(Box::new(Connection::new(read_key, write_key)))
+        },
+        _ => core::ptr::null_mut(),
+    }
+}
+
+/// Frees `connection`
+///
+/// # Safety
+///
+/// `connection` must be null or have been returned by [`turtls_connection_new`], and must not be
+/// used again.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_connection_free(connection: *mut Connection) {
+    if !connection.is_null() {
+        // SAFETY: the caller guarantees `connection` came from `Box::into_raw`
+        drop(unsafe { Box::from_raw(connection) });
+    }
+}
+
+/// Returns what `connection` is waiting on, as a combination of [`TURTLS_WANT_READ`] and
+/// [`TURTLS_WANT_WRITE`]
+///
+/// # Safety
+///
+/// `connection` must be a valid connection.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_want(connection: *const Connection) -> u32 {
+    // SAFETY: the caller guarantees `connection` is valid
+    let Some(connection) = (unsafe { connection.as_ref() }) else {
+        return 0;
+    };
+    let want = connection.wants();
+    (u32::from(want.read) * TURTLS_WANT_READ) | (u32::from(want.write) * TURTLS_WANT_WRITE)
+}
+
+/// Returns the description of the alert sent or received when `connection` failed,
+/// or -1 if it hasn't failed
+///
+/// # Safety
+///
+/// `connection` must be a valid connection.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_alert(connection: *const Connection) -> c_int {
+    // SAFETY: the caller guarantees `connection` is valid
+    unsafe { connection.as_ref() }
+        .and_then(|connection| connection.error()?.alert())
+        .map_or(-1, c_int::from)
+}
+
+/// Processes `len` bytes received from the network, returning how many were used,
+/// or a negative status
+///
+/// # Safety
+///
+/// `connection` must be a valid connection, and `data` must be valid for reads of `len` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_feed(
+    connection: *mut Connection,
+    data: *const u8,
+    len: usize,
+) -> isize {
+    // SAFETY: the caller guarantees `connection` is valid
+    let Some(connection) = (unsafe { connection.as_mut() }) else {
+        return TURTLS_ERR_INVALID as isize;
+    };
+    if data.is_null() || len > isize::MAX as usize {
+        return TURTLS_ERR_INVALID as isize;
+    }
+    // SAFETY: the caller guarantees `data` is valid for reads of `len` bytes
+    let data = unsafe { core::slice::from_raw_parts(data, len) };
+    match connection.feed(data) {
+        Ok(used) => used as isize,
+        Err(error) => status(error) as isize,
+    }
+}
+
+/// Returns the space to receive data into from the network, and writes its length to `len`
+///
+/// After receiving `n` bytes into it, call [`turtls_commit_received`], even if `n` is 0, so that
+/// an unused buffer is given back to the pool. The length is 0 when the connection isn't reading.
+///
+/// # Safety
+///
+/// `connection` must be a valid connection, and `len` must be valid for writes. The space is only
+/// valid until the next call on `connection`.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_receive_buffer(
+    connection: *mut Connection,
+    len: *mut usize,
+) -> *mut u8 {
+    // SAFETY: the caller guarantees `connection` and `len` are valid
+    let (Some(connection), Some(len)) = (unsafe { connection.as_mut() }, unsafe { len.as_mut() })
+    else {
+        return core::ptr::null_mut();
+    };
+    let buf = connection.receive_buffer();
+    *len = buf.len();
+    buf.as_mut_ptr()
+}
+
+/// Processes `n` bytes received into the space from [`turtls_receive_buffer`],
+/// returning 0 or a negative status
+///
+/// # Safety
+///
+/// `connection` must be a valid connection.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_commit_received(connection: *mut Connection, n: usize) -> c_int {
+    // SAFETY: the caller guarantees `connection` is valid
+    let Some(connection) = (unsafe { connection.as_mut() }) else {
+        return TURTLS_ERR_INVALID;
+    };
+    if n > connection.received_spare() {
+        return TURTLS_ERR_INVALID;
+    }
+    match connection.commit_received(n) {
+        Ok(()) => 0,
+        Err(error) => status(error),
+    }
+}
+
+/// Reads up to `len` bytes of decrypted application data into `buf`,
+/// returning how many were read
+///
+/// Returns 0 if there is nothing to read yet, or if the peer has closed the connection and there
+/// is nothing more to read.
+///
+/// # Safety
+///
+/// `connection` must be a valid connection, and `buf` must be valid for writes of `len` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_read(
+    connection: *mut Connection,
+    buf: *mut u8,
+    len: usize,
+) -> isize {
+    // SAFETY: the caller guarantees `connection` is valid
+    let Some(connection) = (unsafe { connection.as_mut() }) else {
+        return TURTLS_ERR_INVALID as isize;
+    };
+    if buf.is_null() || len > isize::MAX as usize {
+        return TURTLS_ERR_INVALID as isize;
+    }
+    // SAFETY: the caller guarantees `buf` is valid for writes of `len` bytes
+    let buf = unsafe { core::slice::from_raw_parts_mut(buf, len) };
+    connection.read(buf) as isize
+}
+
+/// Seals up to `len` bytes of `data` as application data, returning how many were sealed,
+/// or a negative status
+///
+/// # Safety
+///
+/// `connection` must be a valid connection, and `data` must be valid for reads of `len` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_write(
+    connection: *mut Connection,
+    data: *const u8,
+    len: usize,
+) -> isize {
+    // SAFETY: the caller guarantees `connection` is valid
+    let Some(connection) = (unsafe { connection.as_mut() }) else {
+        return TURTLS_ERR_INVALID as isize;
+    };
+    if data.is_null() || len > isize::MAX as usize {
+        return TURTLS_ERR_INVALID as isize;
+    }
+    // SAFETY: the caller guarantees `data` is valid for reads of `len` bytes
+    let data = unsafe { core::slice::from_raw_parts(data, len) };
+    match connection.write(data) {
+        Ok(written) => written as isize,
+        Err(error) => status(error) as isize,
+    }
+}
+
+/// Returns the sealed records waiting to be sent, and writes their length to `len`
+///
+/// After sending `n` bytes of them, call [`turtls_consume_output`].
+///
+/// # Safety
+///
+/// `connection` must be a valid connection, and `len` must be valid for writes. The records are
+/// only valid until the next call on `connection`.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_pending_output(
+    connection: *const Connection,
+    len: *mut usize,
+) -> *const u8 {
+    // SAFETY: the caller guarantees `connection` and `len` are valid
+    let (Some(connection), Some(len)) = (unsafe { connection.as_ref() }, unsafe { len.as_mut() })
+    else {
+        return core::ptr::null();
+    };
+    let output = connection.pending_output();
+    *len = output.len();
+    output.as_ptr()
+}
+
+/// Marks the first `n` bytes of the pending output as sent, returning 0 or a negative status
+///
+/// # Safety
+///
+/// `connection` must be a valid connection.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_consume_output(connection: *mut Connection, n: usize) -> c_int {
+    // SAFETY: the caller guarantees `connection` is valid
+    let Some(connection) = (unsafe { connection.as_mut() }) else {
+        return TURTLS_ERR_INVALID;
+    };
+    if n > connection.pending_output().len() {
+        return TURTLS_ERR_INVALID;
+    }
+    connection.consume_output(n);
+    0
+}
+
+/// Hands `connection` over to kernel TLS on the TCP socket `fd`, returning 0 or a negative status
+///
+/// The connection must have no output left to send and no data left to read, and must have been
+/// created by [`turtls_connection_new`]. On success, the socket seals and opens records itself,
+/// and the connection can only be freed. If the kernel refuses, [`TURTLS_ERR_KTLS`] is returned
+/// with `errno` set, and the socket can't be used for TLS any more.
+///
+/// # Safety
+///
+/// `connection` must be a valid connection.
+#[cfg(target_os = "linux")]
+#[no_mangle]
+pub unsafe extern "C" fn turtls_ktls_offload(connection: *mut Connection, fd: c_int) -> c_int {
+    // SAFETY: the caller guarantees `connection` is valid
+    let Some(connection) = (unsafe { connection.as_mut() }) else {
+        return TURTLS_ERR_INVALID;
+    };
+    match connection.offload_ktls() {
+        Ok(ktls) => match crate::ktls::install(fd, &ktls) {
+            Ok(()) => 0,
+            Err(_) => TURTLS_ERR_KTLS,
+        },
+        Err(KtlsError::Closed) => TURTLS_ERR_CLOSED,
+        Err(KtlsError::Pending | KtlsError::NoKey) => TURTLS_ERR_INVALID,
+    }
+}
+
+/// Closes this side of `connection`, by queueing a close_notify alert
+///
+/// # Safety
+///
+/// `connection` must be a valid connection.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_close(connection: *mut Connection) {
+    // SAFETY: the caller guarantees `connection` is valid
+    if let Some(connection) = unsafe { connection.as_mut() } {
+        connection.close();
+    }
+}
+
+/// Returns the hardware in use, as a combination of the `TURTLS_HW_*` flags
+///
+/// This applies the `TURTLS_DISABLE` environment variable first, if it hasn't been yet.
+#[no_mangle]
+pub extern "C" fn turtls_hardware() -> u32 {
+    crate::cpu::apply_env();
+    hardware_bits(crate::cpu::features())
+}
+
+/// Uses only the hardware in `allowed`, a combination of the `TURTLS_HW_*` flags,
+/// that the CPU supports, and returns the hardware now in use
+///
+/// 0 forces the software implementations. Connections that already exist keep the
+/// implementations they were created with.
+#[no_mangle]
+pub extern "C" fn turtls_restrict_hardware(allowed: u32) -> u32 {
+    let allowed = Features {
+        aes: allowed & TURTLS_HW_AES != 0,
+        clmul: allowed & TURTLS_HW_CLMUL != 0,
+        sha256: allowed & TURTLS_HW_SHA256 != 0,
+        avx2: allowed & TURTLS_HW_AVX2 != 0,
+        avx512f: allowed & TURTLS_HW_AVX512F != 0,
+    };
+    hardware_bits(crate::cpu::restrict(allowed))
+}
+
+/// Writes the names of the implementations in use, such as `aes=aes-ni ghash=pclmulqdq ...`,
+/// to `buf` as a null-terminated string, and returns the length of the names
+///
+/// If the returned length isn't less than `len`, the names were cut short to fit.
+///
+/// # Safety
+///
+/// `buf` must be valid for writes of `len` bytes.
+#[no_mangle]
+pub unsafe extern "C" fn turtls_backends(buf: *mut core::ffi::c_char, len: usize) -> usize {
+    use std::io::Write;
+
+    crate::cpu::apply_env();
+    let mut names = Vec::new();
+    // we can safely unwrap because writing to a `Vec` can't fail
+    write!(names, "{}", crate::cpu::backends()).unwrap();
+    if !buf.is_null() && len > 0 {
+        let copied = names.len().min(len - 1);
+        // SAFETY: the caller guarantees `buf` is valid for writes of `len` bytes,
+        // and `copied` is less than `len`
+        unsafe {
+            core::ptr::copy_nonoverlapping(names.as_ptr(), buf.cast(), copied);
+            *buf.add(copied) = 0;
+        }
+    }
+    names.len()
+}
+
+/// The counters for the whole process, as `struct turtls_stats`
+#[cfg(feature = "stats")]
+#[repr(C)]
+pub struct Stats {
+    /// The records sealed and opened by every connection
+    pub records: crate::stats::Counters,
+    /// The time taken by each handshake stage, indexed by its value
+    pub stages: [crate::stats::StageTimes; 2],
+    /// The hardware in use, as a combination of the `TURTLS_HW_*` flags
+    pub hardware: u32,
+}
+
+/// Writes the counters for the whole process to `stats`, returning 0 or a negative status
+///
+/// # Safety
+///
+/// `stats` must be valid for writes.
+#[cfg(feature = "stats")]
+#[no_mangle]
+pub unsafe extern "C" fn turtls_stats(stats: *mut Stats) -> c_int {
+    // SAFETY: the caller guarantees `stats` is valid
+    let Some(stats) = (unsafe { stats.as_mut() }) else {
+        return TURTLS_ERR_INVALID;
+    };
+    let snapshot = crate::stats::snapshot();
+    *stats = Stats {
+        records: snapshot.records,
+        stages: snapshot.stages,
+        hardware: hardware_bits(snapshot.hardware),
+    };
+    0
+}
+
+/// Writes the counts of the records `connection` has sealed and opened to `counters`,
+/// returning 0 or a negative status
+///
+/// # Safety
+///
+/// `connection` must be a valid connection, and `counters` must be valid for writes.
+#[cfg(feature = "stats")]
+#[no_mangle]
+pub unsafe extern "C" fn turtls_connection_counters(
+    connection: *const Connection,
+    counters: *mut crate::stats::Counters,
+) -> c_int {
+    // SAFETY: the caller guarantees `connection` and `counters` are valid
+    let (Some(connection), Some(counters)) =
+        (unsafe { connection.as_ref() }, unsafe { counters.as_mut() })
+    else {
+        return TURTLS_ERR_INVALID;
+    };
+    *counters = connection.counters();
+    0
+}
+
+/// A C trace hook: `hook(stage, nanoseconds, context)`
+#[cfg(feature = "stats")]
+pub type TraceHook = extern "C" fn(u32, u64, *mut core::ffi::c_void);
+
+/// Sets `hook` to be called, with `context`, as each handshake stage completes,
+/// or removes the hook if `hook` is null
+///
+/// The hook is called on whichever thread ran the stage.
+///
+/// # Safety
+///
+/// `hook` must be safe to call from any thread with `context`, until it is replaced.
+#[cfg(feature = "stats")]
+#[no_mangle]
+pub unsafe extern "C" fn turtls_set_trace_hook(
+    hook: Option<TraceHook>,
+    context: *mut core::ffi::c_void,
+) {
+    struct Context(*mut core::ffi::c_void);
+    // SAFETY: the caller guarantees `hook` can use `context` from any thread
+    unsafe impl Send for Context {}
+    // SAFETY: as above
+    unsafe impl Sync for Context {}
+
+    impl Context {
+        // a method, so that the closure captures all of `Context` rather than its pointer
+        fn get(&self) -> *mut core::ffi::c_void {
+            self.0
+        }
+    }
+
+    let context = Context(context);
+    crate::stats::set_trace_hook(hook.map(|hook| -> crate::stats::TraceHook {
+        std::sync::Arc::new(move |stage, elapsed| {
+            let nanos = u64::try_from(elapsed.as_nanos()).unwrap_or(u64::MAX);
+            hook(stage as u32, nanos, context.get());
+        })
+    }));
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn c_api() {
+        let (read_key, write_key, iv) = ([1u8; 16], [2u8; 16], [3u8; 12]);
+        // SAFETY: every pointer is valid for its length, and each connection is freed once
+        unsafe {
+            let client = turtls_connection_new(
+                0x1301,
+                read_key.as_ptr(),
+                iv.as_ptr(),
+                write_key.as_ptr(),
+                iv.as_ptr(),
+                16,
+            );
+            let server = turtls_connection_new(
+                0x1301,
+                write_key.as_ptr(),
+                iv.as_ptr(),
+                read_key.as_ptr(),
+                iv.as_ptr(),
+                16,
+            );
+            assert!(!client.is_null() && !server.is_null());
+            let wrong_len = turtls_connection_new(
+                0x1302,
+                read_key.as_ptr(),
+                iv.as_ptr(),
+                write_key.as_ptr(),
+                iv.as_ptr(),
+                16,
+            );
+            assert!(wrong_len.is_null());
+            assert_eq!(turtls_want(client), TURTLS_WANT_READ);
+
+            assert_eq!(turtls_write(client, b"ping".as_ptr(), 4), 4);
+            assert_eq!(turtls_want(client), TURTLS_WANT_READ | TURTLS_WANT_WRITE);
+            let mut output_len = 0;
+            let output = turtls_pending_output(client, &mut output_len);
+            let mut buf_len = 0;
+            let buf = turtls_receive_buffer(server, &mut buf_len);
+            assert!(buf_len >= output_len);
+            core::ptr::copy_nonoverlapping(output, buf, output_len);
+            assert_eq!(turtls_commit_received(server, output_len), 0);
+            assert_eq!(turtls_consume_output(client, output_len), 0);
+            assert_eq!(turtls_want(client), TURTLS_WANT_READ);
+
+            let mut plaintext = [0u8; 16];
+            assert_eq!(turtls_read(server, plaintext.as_mut_ptr(), 16), 4);
+            assert_eq!(plaintext[..4], *b"ping");
+            assert_eq!(turtls_alert(server), -1);
+
+            // garbage is fatal
+            assert_eq!(turtls_feed(server, [23, 3, 3, 0, 17].as_ptr(), 5), 5);
+            assert_eq!(
+                turtls_feed(server, [0; 17].as_ptr(), 17),
+                TURTLS_ERR_FATAL as isize
+            );
+            assert_eq!(turtls_alert(server), 20);
+            assert_eq!(
+                turtls_write(server, b"x".as_ptr(), 1),
+                TURTLS_ERR_CLOSED as isize
+            );
+
+            turtls_close(client);
+            assert_eq!(
+                turtls_write(client, b"x".as_ptr(), 1),
+                TURTLS_ERR_CLOSED as isize
+            );
+            #[cfg(feature = "stats")]
+            {
+                let mut counters = crate::stats::Counters::default();
+                assert_eq!(turtls_connection_counters(client, &mut counters), 0);
+                assert_eq!((counters.records_sealed, counters.bytes_sealed), (2, 6));
+                assert_eq!(turtls_connection_counters(server, &mut counters), 0);
+                assert_eq!((counters.records_opened, counters.bytes_opened), (1, 4));
+                let mut stats = core::mem::MaybeUninit::<Stats>::uninit();
+                assert_eq!(turtls_stats(stats.as_mut_ptr()), 0);
+                assert!(stats.assume_init().records.records_sealed >= 2);
+                assert_eq!(turtls_stats(core::ptr::null_mut()), TURTLS_ERR_INVALID);
+            }
+            turtls_connection_free(client);
+            turtls_connection_free(server);
+            turtls_connection_free(core::ptr::null_mut());
+
+            let mut names = [0 as core::ffi::c_char; 128];
+            let len = turtls_backends(names.as_mut_ptr(), names.len());
+            let names = core::ffi::CStr::from_ptr(names.as_ptr()).to_str().unwrap();
+            assert_eq!(names.len(), len);
+            assert!(names.starts_with("aes="));
+            let mut short = [1 as core::ffi::c_char; 4];
+            assert_eq!(turtls_backends(short.as_mut_ptr(), 4), len);
+            assert_eq!(core::ffi::CStr::from_ptr(short.as_ptr()).to_bytes(), b"aes");
+        }
+    }
+}
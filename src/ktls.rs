@@ -0,0 +1,195 @@
+//! Handing a connection's records to the Linux kernel (kTLS)
+//!
+//! Once the handshake is done, the kernel can seal and open records itself, so that application
+//! data can be sent with `sendfile` or offloaded to the NIC, and never passes through user space.
+//! [`Connection::offload_ktls`](crate::connection::Connection::offload_ktls) exports the traffic
+//! keys, initialization vectors, and sequence numbers in the form the kernel takes them,
+//! the `tls12_crypto_info_*` structures of `linux/tls.h`, and [`install`] passes them to a socket.
+//!
+//! After that, the socket is read and written like a plain TCP socket. Records other than
+//! application data, such as alerts and post-handshake messages, are delivered with a
+//! `TLS_GET_RECORD_TYPE` control message, which is up to the caller to handle.
+use crate::record::{CipherSuite, TrafficKey, IV_SIZE};
+use libcrypto::zeroize::zeroize;
+
+/// The version the kernel calls TLS 1.3
+const TLS_1_3_VERSION: u16 = 0x0304;
+
+/// The cipher types of `linux/tls.h`
+const TLS_CIPHER_AES_GCM_128: u16 = 51;
+const TLS_CIPHER_AES_GCM_256: u16 = 52;
+const TLS_CIPHER_CHACHA20_POLY1305: u16 = 54;
+
+/// The size of the largest `tls12_crypto_info_*` structure, in bytes
+const MAX_CRYPTO_INFO_SIZE: usize = 4 + 12 + 32 + 4 + 8;
+
+/// The keys and state of one direction of a connection, as the kernel takes them
+///
+/// This is laid out as the `tls12_crypto_info_*` structure of the cipher suite,
+/// and is erased when dropped.
+pub struct CryptoInfo {
+    bytes: [u8; MAX_CRYPTO_INFO_SIZE],
+    len: usize,
+}
+
+impl CryptoInfo {
+    /// Exports `traffic_key`, returning `None` if it wasn't created with
+    /// [`TrafficKey::with_key`]
+    pub(crate) fn new(traffic_key: &TrafficKey) -> Option<Self> {
+        let (cipher_suite, key, iv) = traffic_key.raw_key()?;
+        let (cipher_type, salt_size) = match cipher_suite {
+            CipherSuite::Aes128GcmSha256 => (TLS_CIPHER_AES_GCM_128, 4),
+            CipherSuite::Aes256GcmSha384 => (TLS_CIPHER_AES_GCM_256, 4),
+            CipherSuite::ChaCha20Poly1305Sha256 => (TLS_CIPHER_CHACHA20_POLY1305, 0),
+        };
+        // the structures split the initialization vector into a salt and an "IV", in the
+        // opposite order, and they're all made of bytes and u16s, so they have no padding
+        let (salt, iv) = iv.split_at(salt_size);
+        let fields: [&[u8]; 6] = [
+            &TLS_1_3_VERSION.to_ne_bytes(),
+            &cipher_type.to_ne_bytes(),
+            iv,
+            key,
+            salt,
+            &traffic_key.sequence().to_be_bytes(),
+        ];
+        let mut info = Self {
+            bytes: [0; MAX_CRYPTO_INFO_SIZE],
+            len: 0,
+        };
+        for field in fields {
+            info.bytes[info.len..][..field.len()].copy_from_slice(field);
+            info.len += field.len();
+        }
+        debug_assert_eq!(info.len, 4 + IV_SIZE + key.len() + 8);
+        Some(info)
+    }
+
+    /// Returns the structure, to pass to `setsockopt`
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.bytes[..self.len]
+    }
+}
+
+impl Drop for CryptoInfo {
+    fn drop(&mut self) {
+        zeroize(&mut self.bytes, 0);
+    }
+}
+
+/// The state of both directions of a connection, as the kernel takes them
+pub struct Ktls {
+    /// The state for sending, to set with `TLS_TX`
+    pub tx: CryptoInfo,
+    /// The state for receiving, to set with `TLS_RX`
+    pub rx: CryptoInfo,
+}
+
+/// An error that kept a connection from being offloaded
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum KtlsError {
+    /// The connection is closed, or already offloaded
+    Closed,
+    /// The connection has output to send, received data to read,
+    /// or part of a record it has received
+    Pending,
+    /// The traffic keys weren't created with [`TrafficKey::with_key`], so they can't be exported
+    NoKey,
+}
+
+impl core::fmt::Display for KtlsError {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        match self {
+            Self::Closed => write!(f, "connection is closed"),
+            Self::Pending => write!(f, "connection has data pending"),
+            Self::NoKey => write!(f, "traffic keys can't be exported"),
+        }
+    }
+}
+
+impl std::error::Error for KtlsError {}
+
+/// Enables kernel TLS on the TCP socket `fd`, with the state in `ktls`
+///
+/// # Errors
+///
+/// This function will return an error if the kernel doesn't support TLS or the cipher suite,
+/// or if `fd` isn't a connected TCP socket.
+#[cfg(target_os = "linux")]
+pub fn install(fd: std::os::fd::RawFd, ktls: &Ktls) -> std::io::Result<()> {
+    use core::ffi::{c_int, c_void};
+
+    const SOL_TCP: c_int = 6;
+    const TCP_ULP: c_int = 31;
+    const SOL_TLS: c_int = 282;
+    const TLS_TX: c_int = 1;
+    const TLS_RX: c_int = 2;
+
+    extern "C" {
+        fn setsockopt(
+            fd: c_int,
+            level: c_int,
+            name: c_int,
+            value: *const c_void,
+            len: u32,
+        ) -> c_int;
+    }
+
+    let set = |level, name, value: &[u8]| {
+        // SAFETY: `value` is valid for reads of its length
+        match unsafe { setsockopt(fd, level, name, value.as_ptr().cast(), value.len() as u32) } {
+            0 => Ok(()),
+            _ => Err(std::io::Error::last_os_error()),
+        }
+    };
+    set(SOL_TCP, TCP_ULP, b"tls")?;
+    set(SOL_TLS, TLS_TX, ktls.tx.as_bytes())?;
+    set(SOL_TLS, TLS_RX, ktls.rx.as_bytes())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn layout() {
+        let iv: [u8; IV_SIZE] = core::array::from_fn(|i| i as u8);
+        let mut traffic_key =
+            TrafficKey::with_key(CipherSuite::Aes128GcmSha256, &[0xaa; 16], iv).unwrap();
+        let mut buf = [0; 64];
+        traffic_key
+            .seal(&mut buf, 0, crate::record::ContentType::ApplicationData)
+            .unwrap();
+
+        let info = CryptoInfo::new(&traffic_key).unwrap();
+        let bytes = info.as_bytes();
+        assert_eq!(bytes.len(), 40);
+        assert_eq!(
+            bytes[..4],
+            [0x0304u16.to_ne_bytes(), 51u16.to_ne_bytes()].concat()
+        );
+        assert_eq!(bytes[4..12], iv[4..]);
+        assert_eq!(bytes[12..28], [0xaa; 16]);
+        assert_eq!(bytes[28..32], iv[..4]);
+        assert_eq!(bytes[32..], 1u64.to_be_bytes());
+
+        let traffic_key =
+            TrafficKey::with_key(CipherSuite::Aes256GcmSha384, &[0xbb; 32], iv).unwrap();
+        let info = CryptoInfo::new(&traffic_key).unwrap();
+        assert_eq!(info.as_bytes().len(), 56);
+        assert_eq!(info.as_bytes()[12..44], [0xbb; 32]);
+        assert_eq!(info.as_bytes()[44..48], iv[..4]);
+
+        let traffic_key =
+            TrafficKey::with_key(CipherSuite::ChaCha20Poly1305Sha256, &[0xcc; 32], iv).unwrap();
+        let info = CryptoInfo::new(&traffic_key).unwrap();
+        let bytes = info.as_bytes();
+        assert_eq!(bytes.len(), 56);
+        assert_eq!(bytes[2..4], 54u16.to_ne_bytes());
+        assert_eq!(bytes[4..16], iv);
+        assert_eq!(bytes[16..48], [0xcc; 32]);
+        assert_eq!(bytes[48..], [0; 8]);
+
+        assert!(TrafficKey::with_key(CipherSuite::Aes128GcmSha256, &[0; 32], iv).is_none());
+    }
+}
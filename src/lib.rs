@@ -6,5 +6,15 @@
 //! </div>
 #![warn(missing_docs)]
 
+pub mod buffer;
 pub mod client;
+pub mod connection;
+pub mod cpu;
+pub mod ffi;
+pub mod ktls;
+pub mod offload;
+mod random;
+pub mod record;
 pub mod server;
+#[cfg(feature = "stats")]
+pub mod stats;
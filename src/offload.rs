@@ -0,0 +1,470 @@
+//! Running private-key operations and key exchanges off the event loop
+//!
+//! Signing and key exchange take far longer than anything else in a handshake, and an event loop
+//! that ran them inline would stall every other connection on its thread. Instead, the handshake
+//! hands each [`Operation`] to an [`Offload`], such as a [`WorkerPool`] or an external signer,
+//! and suspends on the [`Pending`] result. When the operation completes, on whatever thread,
+//! the [`Waker`] given for it is woken, and the event loop resumes the handshake.
+//!
+//! # Examples
+//!
+//! ```
+//! use std::sync::atomic::{AtomicBool, Ordering};
+//! use std::sync::Arc;
+//! use std::task::{Wake, Waker};
+//!
+//! use turtls::offload::{pending, Offload, Operation, WorkerPool};
+//!
+//! struct Flag(AtomicBool);
+//!
+//! impl Wake for Flag {
+//!     fn wake(self: Arc<Self>) {
+//!         self.0.store(true, Ordering::Release);
+//!     }
+//! }
+//!
+//! let pool = WorkerPool::software(2);
+//! let flag = Arc::new(Flag(AtomicBool::new(false)));
+//! let (mut result, completer) = pending(Waker::from(flag.clone()));
+//! let mut peer_share = [0; 32];
+//! peer_share[0] = 9;
+//! pool.start(Operation::X25519 { private_key: [0x42; 32], peer_share }, completer);
+//!
+//! // the event loop carries on with other connections until the flag is set
+//! while !flag.0.load(Ordering::Acquire) {
+//!     std::thread::yield_now();
+//! }
+//! let shared_secret = result.poll().unwrap().unwrap();
+//! assert_eq!(shared_secret.len(), 32);
+//! ```
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::sync::{Arc, Mutex};
+use std::task::Waker;
+use std::thread::JoinHandle;
+
+use libcrypto::elliptic_curve::{curve25519, secp256r1};
+use libcrypto::zeroize::zeroize;
+
+/// An expensive handshake operation
+pub enum Operation {
+    /// Signs `message` with the certificate's private key, using the signature scheme `scheme`,
+    /// as numbered by TLS
+    Sign {
+        /// The TLS signature scheme, such as `0x0403` for `ecdsa_secp256r1_sha256`
+        scheme: u16,
+        /// The message to sign
+        message: Vec<u8>,
+    },
+    /// Computes the X25519 shared secret of an ephemeral private key and the peer's key share
+    X25519 {
+        /// The ephemeral private key, which is erased when the operation is dropped
+        private_key: [u8; curve25519::KEY_SIZE],
+        /// The peer's key share
+        peer_share: [u8; curve25519::KEY_SIZE],
+    },
+    /// Computes the P-256 ECDH shared secret of an ephemeral private key and the peer's key share
+    P256 {
+        /// The ephemeral private key, as a big-endian integer, which is erased when the operation
+        /// is dropped
+        private_key: [u8; secp256r1::ELEMENT_SIZE],
+        /// The peer's key share, as an uncompressed point
+        peer_share: [u8; secp256r1::POINT_SIZE],
+    },
+}
+
+impl Operation {
+    /// Runs the operation on the current thread, with the software implementations in
+    /// `libcrypto`
+    ///
+    /// Signing isn't implemented in software yet, so needs an external signer.
+    pub fn run_in_software(&self) -> Outcome {
+        let secret = match self {
+            Self::Sign { .. } => return Err(OperationError::Unsupported),
+            Self::X25519 {
+                private_key,
+                peer_share,
+            } => curve25519::shared_secret(private_key, peer_share).ok(),
+            Self::P256 {
+                private_key,
+                peer_share,
+            } => secp256r1::shared_secret(private_key, peer_share).ok(),
+        };
+        let mut secret = secret.ok_or(OperationError::Failed)?;
+        let output = Output::from(&secret[..]);
+        zeroize(&mut secret, 0);
+        Ok(output)
+    }
+}
+
+/// Runs `operation` with `run`, recording how long it took with the `stats` feature
+fn run_recorded(operation: &Operation, run: impl FnOnce(&Operation) -> Outcome) -> Outcome {
+    #[cfg(feature = "stats")]
+    let start = std::time::Instant::now();
+    let outcome = run(operation);
+    #[cfg(feature = "stats")]
+    crate::stats::record_stage(crate::stats::Stage::of(operation), start.elapsed());
+    outcome
+}
+
+impl Drop for Operation {
+    fn drop(&mut self) {
+        if let Self::X25519 { private_key, .. } | Self::P256 { private_key, .. } = self {
+            zeroize(private_key, 0);
+        }
+    }
+}
+
+/// The result of an [`Operation`]: a signature or shared secret, or an error
+pub type Outcome = Result<Output, OperationError>;
+
+/// The bytes an [`Operation`] produced, which are erased when they are dropped
+///
+/// They're read through [`Deref`](core::ops::Deref), as a slice.
+#[derive(PartialEq, Eq)]
+pub struct Output(Vec<u8>);
+
+impl From<Vec<u8>> for Output {
+    fn from(bytes: Vec<u8>) -> Self {
+        Self(bytes)
+    }
+}
+
+impl From<&[u8]> for Output {
+    fn from(bytes: &[u8]) -> Self {
+        Self(bytes.to_vec())
+    }
+}
+
+impl core::ops::Deref for Output {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        &self.0
+    }
+}
+
+impl core::fmt::Debug for Output {
+    /// Writes the length of the output, but not the output itself, which may be a secret
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "Output({} bytes)", self.0.len())
+    }
+}
+
+impl Drop for Output {
+    fn drop(&mut self) {
+        zeroize(&mut self.0, 0);
+    }
+}
+
+/// An error that kept an [`Operation`] from completing
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum OperationError {
+    /// The operation isn't supported, such as an unknown signature scheme
+    Unsupported,
+    /// The operation failed, such as a key share of small order, or a signer that refused
+    Failed,
+    /// The operation was dropped without completing
+    Abandoned,
+}
+
+impl core::fmt::Display for OperationError {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        match self {
+            Self::Unsupported => write!(f, "operation is not supported"),
+            Self::Failed => write!(f, "operation failed"),
+            Self::Abandoned => write!(f, "operation was abandoned"),
+        }
+    }
+}
+
+impl std::error::Error for OperationError {}
+
+/// The state shared by a [`Pending`] and its [`Completer`]
+struct Shared {
+    outcome: Mutex<Option<Outcome>>,
+    waker: Waker,
+}
+
+/// Creates the two ends of an operation in progress: the result to wait on, and the means to
+/// complete it, which wakes `waker`
+pub fn pending(waker: Waker) -> (Pending, Completer) {
+    let shared = Arc::new(Shared {
+        outcome: Mutex::new(None),
+        waker,
+    });
+    (
+        Pending {
+            shared: shared.clone(),
+        },
+        Completer {
+            shared: Some(shared),
+        },
+    )
+}
+
+/// The result of an operation in progress
+pub struct Pending {
+    shared: Arc<Shared>,
+}
+
+impl Pending {
+    /// Returns the outcome of the operation, if it has completed
+    ///
+    /// The outcome is only returned once.
+    pub fn poll(&mut self) -> Option<Outcome> {
+        // a panic while the lock is held can't leave the outcome inconsistent,
+        // so a poisoned lock is safe to use
+        self.shared
+            .outcome
+            .lock()
+            .unwrap_or_else(|poisoned| poisoned.into_inner())
+            .take()
+    }
+}
+
+/// The means to complete an operation in progress
+///
+/// If it is dropped without completing, the operation completes with
+/// [`OperationError::Abandoned`].
+pub struct Completer {
+    shared: Option<Arc<Shared>>,
+}
+
+impl Completer {
+    /// Completes the operation with `outcome`, and wakes whoever is waiting on it
+    pub fn complete(mut self, outcome: Outcome) {
+        self.finish(outcome);
+    }
+
+    fn finish(&mut self, outcome: Outcome) {
+        if let Some(shared) = self.shared.take() {
+            *shared
+                .outcome
+                .lock()
+                .unwrap_or_else(|poisoned| poisoned.into_inner()) = Some(outcome);
+            shared.waker.wake_by_ref();
+        }
+    }
+}
+
+impl Drop for Completer {
+    fn drop(&mut self) {
+        self.finish(Err(OperationError::Abandoned));
+    }
+}
+
+/// Something that runs [`Operation`]s, such as a [`WorkerPool`] or an external signer
+pub trait Offload: Send + Sync {
+    /// Starts `operation`, calling [`Completer::complete`] with its outcome once it is done
+    ///
+    /// Apart from [`Inline`], this shouldn't wait for the operation. The operation may complete
+    /// on any thread, including this one, before this returns.
+    fn start(&self, operation: Operation, completer: Completer);
+}
+
+/// Runs every operation on the calling thread, in software, before returning
+///
+/// This is for when the operations are cheap enough, or there's nothing else for the thread to do.
+pub struct Inline;
+
+impl Offload for Inline {
+    fn start(&self, operation: Operation, completer: Completer) {
+        completer.complete(run_recorded(&operation, Operation::run_in_software));
+    }
+}
+
+/// A job for a [`WorkerPool`]
+type Job = (Operation, Completer);
+
+/// A fixed number of threads that run operations, in the order they were started
+pub struct WorkerPool {
+    sender: Option<Sender<Job>>,
+    workers: Vec<JoinHandle<()>>,
+}
+
+impl WorkerPool {
+    /// Creates a new [`WorkerPool`] of `threads` threads, which run each operation with `run`
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `threads` is 0, or if a thread can't be spawned.
+    pub fn new(
+        threads: usize,
+        run: impl Fn(&Operation) -> Outcome + Send + Sync + 'static,
+    ) -> Self {
+        assert!(threads > 0, "worker pool needs a thread");
+        let (sender, receiver) = mpsc::channel::<Job>();
+        let receiver = Arc::new(Mutex::new(receiver));
+        let run = Arc::new(run);
+        let workers = (0..threads)
+            .map(|i| {
+                let (receiver, run) = (receiver.clone(), run.clone());
+                std::thread::Builder::new()
+                    .name(format!("turtls-offload-{i}"))
+                    .spawn(move || work(&receiver, &*run))
+                    .expect("failed to spawn offload worker")
+            })
+            .collect();
+        Self {
+            sender: Some(sender),
+            workers,
+        }
+    }
+
+    /// Creates a new [`WorkerPool`] of `threads` threads, which run operations in software
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `threads` is 0, or if a thread can't be spawned.
+    pub fn software(threads: usize) -> Self {
+        Self::new(threads, Operation::run_in_software)
+    }
+}
+
+/// Runs jobs from `receiver` with `run` until the pool is dropped
+fn work(receiver: &Mutex<Receiver<Job>>, run: &dyn Fn(&Operation) -> Outcome) {
+    loop {
+        // the lock is only held while waiting for a job, not while running it
+        let job = receiver
+            .lock()
+            .unwrap_or_else(|poisoned| poisoned.into_inner())
+            .recv();
+        let Ok((operation, completer)) = job else {
+            return;
+        };
+        completer.complete(run_recorded(&operation, run));
+    }
+}
+
+impl Offload for WorkerPool {
+    fn start(&self, operation: Operation, completer: Completer) {
+        // if the workers are gone, the job is dropped, which abandons it
+        if let Some(sender) = &self.sender {
+            let _ = sender.send((operation, completer));
+        }
+    }
+}
+
+impl Drop for WorkerPool {
+    /// Finishes the operations already started, then stops the threads
+    fn drop(&mut self) {
+        self.sender = None;
+        for worker in self.workers.drain(..) {
+            let _ = worker.join();
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::sync::atomic::{AtomicUsize, Ordering};
+    use std::task::Wake;
+
+    use super::*;
+
+    struct Counter(AtomicUsize);
+
+    impl Wake for Counter {
+        fn wake(self: Arc<Self>) {
+            self.0.fetch_add(1, Ordering::Release);
+        }
+    }
+
+    fn x25519(byte: u8) -> Operation {
+        let mut peer_share = [0; 32];
+        peer_share[0] = 9;
+        Operation::X25519 {
+            private_key: [byte; 32],
+            peer_share,
+        }
+    }
+
+    #[test]
+    fn inline() {
+        let counter = Arc::new(Counter(AtomicUsize::new(0)));
+        let (mut result, completer) = pending(Waker::from(counter.clone()));
+        assert_eq!(result.poll(), None);
+        Inline.start(x25519(1), completer);
+        assert_eq!(counter.0.load(Ordering::Acquire), 1);
+        let expected = curve25519::public_key(&[1; 32]);
+        assert_eq!(result.poll(), Some(Ok(Output::from(&expected[..]))));
+        assert_eq!(result.poll(), None);
+
+        let (mut result, completer) = pending(Waker::noop().clone());
+        let operation = Operation::Sign {
+            scheme: 0x0403,
+            message: b"hello".to_vec(),
+        };
+        Inline.start(operation, completer);
+        assert_eq!(result.poll(), Some(Err(OperationError::Unsupported)));
+    }
+
+    #[test]
+    fn p256() {
+        let (first, second) = ([1; 32], [2; 32]);
+        let operation = Operation::P256 {
+            private_key: first,
+            peer_share: secp256r1::public_key(&second),
+        };
+        let expected = secp256r1::shared_secret(&second, &secp256r1::public_key(&first)).unwrap();
+        assert_eq!(&*operation.run_in_software().unwrap(), &expected);
+
+        // a share that isn't on the curve
+        let operation = Operation::P256 {
+            private_key: first,
+            peer_share: [4; secp256r1::POINT_SIZE],
+        };
+        assert_eq!(operation.run_in_software(), Err(OperationError::Failed));
+    }
+
+    #[test]
+    fn abandoned() {
+        let counter = Arc::new(Counter(AtomicUsize::new(0)));
+        let (mut result, completer) = pending(Waker::from(counter.clone()));
+        drop(completer);
+        assert_eq!(counter.0.load(Ordering::Acquire), 1);
+        assert_eq!(result.poll(), Some(Err(OperationError::Abandoned)));
+    }
+
+    #[test]
+    fn worker_pool() {
+        let counter = Arc::new(Counter(AtomicUsize::new(0)));
+        let pool = WorkerPool::software(3);
+        let mut results: Vec<_> = (0..20)
+            .map(|i| {
+                let (result, completer) = pending(Waker::from(counter.clone()));
+                pool.start(x25519(i), completer);
+                result
+            })
+            .collect();
+        // dropping the pool finishes the operations already started
+        drop(pool);
+        assert_eq!(counter.0.load(Ordering::Acquire), 20);
+        for (i, result) in results.iter_mut().enumerate() {
+            let expected = curve25519::public_key(&[i as u8; 32]);
+            assert_eq!(result.poll(), Some(Ok(Output::from(&expected[..]))));
+        }
+    }
+
+    #[test]
+    fn external_signer() {
+        // a signer that only knows one scheme, standing in for an HSM
+        let pool = WorkerPool::new(1, |operation| match operation {
+            Operation::Sign {
+                scheme: 0x0807,
+                message,
+            } => Ok(Output::from(
+                message.iter().rev().copied().collect::<Vec<_>>(),
+            )),
+            _ => Err(OperationError::Unsupported),
+        });
+        let (mut result, completer) = pending(Waker::noop().clone());
+        let operation = Operation::Sign {
+            scheme: 0x0807,
+            message: vec![1, 2, 3],
+        };
+        pool.start(operation, completer);
+        drop(pool);
+        assert_eq!(result.poll(), Some(Ok(Output::from(vec![3, 2, 1]))));
+    }
+}
@@ -0,0 +1,63 @@
+//! Randomness from the operating system
+
+/// Fills `buf` with random bytes from the operating system
+///
+/// # Panics
+///
+/// This function will panic if the operating system can't provide randomness,
+/// since nothing that needs it can safely carry on without it.
+pub(crate) fn fill(buf: &mut [u8]) {
+    #[cfg(target_os = "linux")]
+    {
+        extern "C" {
+            fn getrandom(buf: *mut core::ffi::c_void, len: usize, flags: u32) -> isize;
+        }
+
+        let mut rest = buf;
+        while !rest.is_empty() {
+            // SAFETY: `rest` is valid for writes of its length
+            let filled = unsafe { getrandom(rest.as_mut_ptr().cast(), rest.len(), 0) };
+            match usize::try_from(filled) {
+                Ok(filled) => rest = &mut rest[filled..],
+                Err(_) => {
+                    let error = std::io::Error::last_os_error();
+                    assert!(
+                        error.kind() == std::io::ErrorKind::Interrupted,
+                        "getrandom failed: {error}"
+                    );
+                },
+            }
+        }
+    }
+    #[cfg(not(target_os = "linux"))]
+    {
+        use std::io::Read;
+
+        std::fs::File::open("/dev/urandom")
+            .and_then(|mut urandom| urandom.read_exact(buf))
+            .expect("failed to read /dev/urandom");
+    }
+}
+
+/// Returns a random `u64`
+///
+/// # Panics
+///
+/// This function will panic if the operating system can't provide randomness.
+pub(crate) fn u64() -> u64 {
+    let mut bytes = [0; 8];
+    fill(&mut bytes);
+    u64::from_ne_bytes(bytes)
+}
+
+#[cfg(test)]
+mod tests {
+    #[test]
+    fn fill() {
+        let (mut first, mut second) = ([0u8; 64], [0u8; 64]);
+        super::fill(&mut first);
+        super::fill(&mut second);
+        assert_ne!(first, second);
+        assert_ne!(first, [0; 64]);
+    }
+}
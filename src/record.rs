@@ -0,0 +1,851 @@
+//! The TLS 1.3 record layer, as specified in RFC 8446, section 5
+//!
+//! Records are sealed and opened in place, in a buffer owned by the caller,
+//! so nothing is allocated and the payload is never copied.
+//! A record is laid out as follows:
+//!
+//! ```text
+//! | header | payload | content type | tag |
+//! |   5    |   len   |      1       | 16  |
+//! ```
+//!
+//! To send a record, write the payload [`HEADROOM`] bytes into the buffer, with at least
+//! [`TAILROOM`] bytes free after it, and call [`TrafficKey::seal`]. This writes the header,
+//! content type, and tag around the payload, and encrypts the payload where it is.
+//! To receive one, read [`HEADER_SIZE`] bytes, pass them to [`record_size`] to learn how long the
+//! whole record is, read the rest, and call [`TrafficKey::open`]. This decrypts the payload where
+//! it is and returns it as a slice of the buffer.
+//!
+//! # Examples
+//!
+//! ```
+//! use turtls::record::{Aead, ContentType, TrafficKey, HEADROOM, MAX_RECORD_SIZE};
+//! use libcrypto::aes::{gcm::Gcm, Aes128};
+//!
+//! let mut sender = TrafficKey::new(Aead::Aes128Gcm(Gcm::new([0x42; 16])), [0x5a; 12]);
+//! let mut receiver = TrafficKey::new(Aead::Aes128Gcm(Gcm::new([0x42; 16])), [0x5a; 12]);
+//!
+//! let mut buf = [0u8; MAX_RECORD_SIZE];
+//! let msg = b"Hello, world!";
+//! buf[HEADROOM..][..msg.len()].copy_from_slice(msg);
+//! let record_len = sender.seal(&mut buf, msg.len(), ContentType::ApplicationData).unwrap();
+//!
+//! let (content_type, payload) = receiver.open(&mut buf[..record_len]).unwrap();
+//! assert_eq!(content_type, ContentType::ApplicationData);
+//! assert_eq!(payload, msg);
+//! ```
+use libcrypto::aes::gcm::{self, BatchMessage, Gcm};
+use libcrypto::aes::{Aes128, Aes256};
+use libcrypto::chacha::chacha20_poly1305::{self, ChaCha20Poly1305};
+use libcrypto::zeroize::zeroize;
+
+/// The size of a record header, in bytes
+pub const HEADER_SIZE: usize = 5;
+
+/// The size of an authentication tag, in bytes
+///
+/// This is the same for every cipher suite.
+pub const TAG_SIZE: usize = 16;
+
+/// The size of the per-connection initialization vector, in bytes
+pub const IV_SIZE: usize = 12;
+
+/// The number of bytes that must be left free before the payload
+pub const HEADROOM: usize = HEADER_SIZE;
+
+/// The number of bytes that must be left free after the payload
+///
+/// These hold the content type and the tag.
+pub const TAILROOM: usize = 1 + TAG_SIZE;
+
+/// The largest payload a record can hold
+pub const MAX_PLAINTEXT_SIZE: usize = 1 << 14;
+
+/// The largest encrypted body a record can have, including the content type, padding, and tag
+pub const MAX_CIPHERTEXT_SIZE: usize = MAX_PLAINTEXT_SIZE + 256;
+
+/// The largest a record can be, including its header
+///
+/// A buffer this long can receive any record.
+pub const MAX_RECORD_SIZE: usize = HEADER_SIZE + MAX_CIPHERTEXT_SIZE;
+
+/// The version every TLS 1.3 record claims to be, which is TLS 1.2
+const LEGACY_VERSION: [u8; 2] = [0x03, 0x03];
+
+/// The type of the message carried by a record
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+#[repr(u8)]
+pub enum ContentType {
+    /// A change_cipher_spec message, which TLS 1.3 only sends for compatibility
+    ChangeCipherSpec = 20,
+    /// An alert
+    Alert = 21,
+    /// A handshake message
+    Handshake = 22,
+    /// Application data
+    ApplicationData = 23,
+}
+
+impl ContentType {
+    /// Returns the content type `byte` stands for, if any
+    pub const fn from_byte(byte: u8) -> Option<Self> {
+        match byte {
+            20 => Some(Self::ChangeCipherSpec),
+            21 => Some(Self::Alert),
+            22 => Some(Self::Handshake),
+            23 => Some(Self::ApplicationData),
+            _ => None,
+        }
+    }
+}
+
+/// An error that occurred while sealing or opening a record
+///
+/// Apart from [`RecordError::BufferTooSmall`], each of these is fatal to the connection, and
+/// should be answered with the alert of the same name.
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum RecordError {
+    /// The buffer has no room for the header, content type, or tag
+    BufferTooSmall,
+    /// The payload or record is longer than allowed
+    RecordOverflow,
+    /// The record failed to decrypt
+    BadRecordMac,
+    /// The record is malformed
+    DecodeError,
+    /// The record holds a message of the wrong type
+    UnexpectedMessage,
+    /// The sequence number ran out, so the key must be updated
+    SequenceExhausted,
+}
+
+impl core::fmt::Display for RecordError {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        match self {
+            Self::BufferTooSmall => write!(f, "buffer has no room for the record"),
+            Self::RecordOverflow => write!(f, "record is too long"),
+            Self::BadRecordMac => write!(f, "record failed to decrypt"),
+            Self::DecodeError => write!(f, "record is malformed"),
+            Self::UnexpectedMessage => write!(f, "record has an unexpected content type"),
+            Self::SequenceExhausted => write!(f, "sequence number exhausted"),
+        }
+    }
+}
+
+impl std::error::Error for RecordError {}
+
+/// A TLS 1.3 cipher suite
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+#[repr(u16)]
+pub enum CipherSuite {
+    /// `TLS_AES_128_GCM_SHA256`
+    Aes128GcmSha256 = 0x1301,
+    /// `TLS_AES_256_GCM_SHA384`
+    Aes256GcmSha384 = 0x1302,
+    /// `TLS_CHACHA20_POLY1305_SHA256`
+    ChaCha20Poly1305Sha256 = 0x1303,
+}
+
+impl CipherSuite {
+    /// Returns the cipher suite `value` stands for, if any
+    pub const fn from_u16(value: u16) -> Option<Self> {
+        match value {
+            0x1301 => Some(Self::Aes128GcmSha256),
+            0x1302 => Some(Self::Aes256GcmSha384),
+            0x1303 => Some(Self::ChaCha20Poly1305Sha256),
+            _ => None,
+        }
+    }
+
+    /// Returns the size of the cipher suite's key, in bytes
+    pub const fn key_size(self) -> usize {
+        match self {
+            Self::Aes128GcmSha256 => 16,
+            Self::Aes256GcmSha384 | Self::ChaCha20Poly1305Sha256 => 32,
+        }
+    }
+}
+
+/// The AEAD of a cipher suite, keyed for one direction of a connection
+pub enum Aead {
+    /// AES-128-GCM, used by `TLS_AES_128_GCM_SHA256`
+    Aes128Gcm(Gcm<Aes128>),
+    /// AES-256-GCM, used by `TLS_AES_256_GCM_SHA384`
+    Aes256Gcm(Gcm<Aes256>),
+    /// ChaCha20-Poly1305, used by `TLS_CHACHA20_POLY1305_SHA256`
+    ChaCha20Poly1305(ChaCha20Poly1305),
+}
+
+impl Aead {
+    /// Creates the AEAD of `cipher_suite`, keyed with `key`
+    ///
+    /// Returns `None` if `key` isn't [`CipherSuite::key_size`] bytes long.
+    pub fn new(cipher_suite: CipherSuite, key: &[u8]) -> Option<Self> {
+        crate::cpu::apply_env();
+        Some(match cipher_suite {
+            CipherSuite::Aes128GcmSha256 => Self::Aes128Gcm(Gcm::new(key.try_into().ok()?)),
+            CipherSuite::Aes256GcmSha384 => Self::Aes256Gcm(Gcm::new(key.try_into().ok()?)),
+            CipherSuite::ChaCha20Poly1305Sha256 => {
+                Self::ChaCha20Poly1305(ChaCha20Poly1305::new(key.try_into().ok()?))
+            },
+        })
+    }
+
+    fn seal(&self, data: &mut [u8], add_data: &[u8], nonce: &[u8; IV_SIZE]) -> [u8; TAG_SIZE] {
+        match self {
+            Self::Aes128Gcm(cipher) => cipher.encrypt_inline(data, add_data, nonce),
+            Self::Aes256Gcm(cipher) => cipher.encrypt_inline(data, add_data, nonce),
+            Self::ChaCha20Poly1305(cipher) => cipher.encrypt_inline(data, add_data, nonce),
+        }
+    }
+
+    fn open(
+        &self,
+        data: &mut [u8],
+        add_data: &[u8],
+        nonce: &[u8; IV_SIZE],
+        tag: &[u8; TAG_SIZE],
+    ) -> Result<(), gcm::BadData> {
+        match self {
+            Self::Aes128Gcm(cipher) => cipher.decrypt_inline(data, add_data, nonce, tag),
+            Self::Aes256Gcm(cipher) => cipher.decrypt_inline(data, add_data, nonce, tag),
+            Self::ChaCha20Poly1305(cipher) => cipher.decrypt_inline(data, add_data, nonce, tag),
+        }
+    }
+
+    /// Seals each of `messages`, writing its tag to its `tag`
+    ///
+    /// AES-GCM generates the key streams of all the messages together. ChaCha20-Poly1305 seals
+    /// them one by one, since its blocks are already processed several at a time.
+    fn seal_batch(&self, messages: &mut [BatchMessage<'_>]) {
+        match self {
+            Self::Aes128Gcm(cipher) => cipher.encrypt_batch_inline(messages),
+            Self::Aes256Gcm(cipher) => cipher.encrypt_batch_inline(messages),
+            Self::ChaCha20Poly1305(cipher) => {
+                for message in messages {
+                    message.tag =
+                        cipher.encrypt_inline(message.data, message.add_data, &message.init_vector);
+                }
+            },
+        }
+    }
+
+    /// Opens each of `messages`, checking it against its `tag`
+    fn open_batch(&self, messages: &mut [BatchMessage<'_>]) -> Result<(), gcm::BadData> {
+        match self {
+            Self::Aes128Gcm(cipher) => cipher.decrypt_batch_inline(messages),
+            Self::Aes256Gcm(cipher) => cipher.decrypt_batch_inline(messages),
+            Self::ChaCha20Poly1305(cipher) => messages.iter_mut().try_for_each(|message| {
+                cipher.decrypt_inline(
+                    message.data,
+                    message.add_data,
+                    &message.init_vector,
+                    &message.tag,
+                )
+            }),
+        }
+    }
+}
+
+// every cipher suite has the same sizes
+const _: () = assert!(gcm::IV_SIZE == IV_SIZE && chacha20_poly1305::NONCE_SIZE == IV_SIZE);
+const _: () = assert!(chacha20_poly1305::TAG_SIZE == TAG_SIZE);
+
+/// The number of records [`TrafficKey::seal_many`] and [`TrafficKey::open_many`] hand to the
+/// AEAD at once
+///
+/// A batch of records is kept on the stack, so this bounds the stack space used.
+const BATCH_RECORDS: usize = 8;
+
+/// The key, initialization vector, and sequence number that protect one direction of a connection
+pub struct TrafficKey {
+    aead: Aead,
+    iv: [u8; IV_SIZE],
+    sequence: u64,
+    key: Option<RawKey>,
+}
+
+/// A key as it was before being expanded, kept so that it can be handed to the kernel
+struct RawKey {
+    cipher_suite: CipherSuite,
+    bytes: [u8; 32],
+}
+
+impl Drop for RawKey {
+    fn drop(&mut self) {
+        zeroize(&mut self.bytes, 0);
+    }
+}
+
+impl TrafficKey {
+    /// Creates a new [`TrafficKey`], starting at sequence number 0
+    pub fn new(aead: Aead, iv: [u8; IV_SIZE]) -> Self {
+        Self {
+            aead,
+            iv,
+            sequence: 0,
+            key: None,
+        }
+    }
+
+    /// Creates a new [`TrafficKey`] for `cipher_suite` from `key`, starting at sequence number 0
+    ///
+    /// Unlike [`new`](Self::new), this keeps a copy of `key`, so the connection can later be
+    /// handed to kernel TLS with [`Connection::offload_ktls`](crate::connection::Connection::offload_ktls).
+    ///
+    /// Returns `None` if `key` isn't [`CipherSuite::key_size`] bytes long.
+    pub fn with_key(cipher_suite: CipherSuite, key: &[u8], iv: [u8; IV_SIZE]) -> Option<Self> {
+        let mut traffic_key = Self::new(Aead::new(cipher_suite, key)?, iv);
+        let mut bytes = [0; 32];
+        bytes[..key.len()].copy_from_slice(key);
+        traffic_key.key = Some(RawKey {
+            cipher_suite,
+            bytes,
+        });
+        Some(traffic_key)
+    }
+
+    /// Returns the sequence number of the next record
+    pub fn sequence(&self) -> u64 {
+        self.sequence
+    }
+
+    /// Returns the cipher suite and key this was created from, and the initialization vector,
+    /// if it was created with [`with_key`](Self::with_key)
+    pub(crate) fn raw_key(&self) -> Option<(CipherSuite, &[u8], &[u8; IV_SIZE])> {
+        let key = self.key.as_ref()?;
+        Some((
+            key.cipher_suite,
+            &key.bytes[..key.cipher_suite.key_size()],
+            &self.iv,
+        ))
+    }
+
+    /// Seals the first `len` bytes after [`HEADROOM`] in `buf` into a record of `content_type`
+    ///
+    /// The record starts at the beginning of `buf`. Returns its length.
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if `len` is more than [`MAX_PLAINTEXT_SIZE`], if `buf` is
+    /// shorter than [`HEADROOM`] + `len` + [`TAILROOM`], or if the sequence number has run out.
+    pub fn seal(
+        &mut self,
+        buf: &mut [u8],
+        len: usize,
+        content_type: ContentType,
+    ) -> Result<usize, RecordError> {
+        if len > MAX_PLAINTEXT_SIZE {
+            return Err(RecordError::RecordOverflow);
+        }
+        let record_len = sealed_size(len);
+        if buf.len() < record_len {
+            return Err(RecordError::BufferTooSmall);
+        }
+        let nonce = self.next_nonce()?;
+
+        let (header, inner, tag) = prepare_record(&mut buf[..record_len], content_type);
+        tag.copy_from_slice(&self.aead.seal(inner, header, &nonce));
+        Ok(record_len)
+    }
+
+    /// Seals consecutive records of `content_type`, one for each of `lens`, into `buf`
+    ///
+    /// The records lie back to back from the start of `buf`, so they can be sent with a single
+    /// write. Each takes up [`sealed_size`] of its payload's length, and its payload goes
+    /// [`HEADROOM`] bytes into that space. Returns the combined length of the records.
+    ///
+    /// This gives the same records as calling [`seal`](Self::seal) for each of `lens`, but with
+    /// AES-GCM the records are encrypted together, so the pipeline doesn't drain between them.
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error, without sealing anything, if any of `lens` is more
+    /// than [`MAX_PLAINTEXT_SIZE`], if `buf` is too short to hold all the records, or if the
+    /// sequence number would run out.
+    pub fn seal_many(
+        &mut self,
+        buf: &mut [u8],
+        lens: &[usize],
+        content_type: ContentType,
+    ) -> Result<usize, RecordError> {
+        if lens.iter().any(|&len| len > MAX_PLAINTEXT_SIZE) {
+            return Err(RecordError::RecordOverflow);
+        }
+        let total_len = lens.iter().map(|&len| sealed_size(len)).sum();
+        if buf.len() < total_len {
+            return Err(RecordError::BufferTooSmall);
+        }
+        self.check_sequence(lens.len())?;
+
+        let mut rest = &mut buf[..total_len];
+        for lens in lens.chunks(BATCH_RECORDS) {
+            let mut messages: [BatchMessage; BATCH_RECORDS] = Default::default();
+            let mut tags: [&mut [u8]; BATCH_RECORDS] = Default::default();
+            for ((message, tag), &len) in messages.iter_mut().zip(&mut tags).zip(lens) {
+                let record;
+                (record, rest) = core::mem::take(&mut rest).split_at_mut(sealed_size(len));
+                (message.add_data, message.data, *tag) = prepare_record(record, content_type);
+                // we can safely unwrap because the sequence number was checked above
+                message.init_vector = self.next_nonce().unwrap();
+            }
+            let messages = &mut messages[..lens.len()];
+            self.aead.seal_batch(messages);
+            for (message, tag) in messages.iter().zip(tags) {
+                tag.copy_from_slice(&message.tag);
+            }
+        }
+        Ok(total_len)
+    }
+
+    /// Opens `record`, which must be exactly one record, header included
+    ///
+    /// Returns the content type and payload, which is decrypted in place in `record`.
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if the record is malformed, too long, or fails to
+    /// decrypt, or if the sequence number has run out.
+    pub fn open<'a>(
+        &mut self,
+        record: &'a mut [u8],
+    ) -> Result<(ContentType, &'a mut [u8]), RecordError> {
+        let (header, inner, tag) = split_record(record)?;
+        let nonce = self.next_nonce()?;
+        self.aead
+            .open(inner, header, &nonce, tag)
+            .map_err(|_| RecordError::BadRecordMac)?;
+        unpad(inner)
+    }
+
+    /// Opens every whole record at the start of `buf`, calling `on_record` with the content type
+    /// and payload of each
+    ///
+    /// Payloads are decrypted in place in `buf`. Returns how many bytes of `buf` were opened,
+    /// which leaves any partial record at the end for the next call, once the rest has arrived.
+    ///
+    /// This gives the same results as calling [`open`](Self::open) for each record, but with
+    /// AES-GCM the records are decrypted together, so the pipeline doesn't drain between them.
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if any record is malformed, too long, or fails to
+    /// decrypt, or if the sequence number runs out.
+    /// Records before the batch of the bad one may already have been passed to `on_record`.
+    pub fn open_many(
+        &mut self,
+        buf: &mut [u8],
+        mut on_record: impl FnMut(ContentType, &mut [u8]),
+    ) -> Result<usize, RecordError> {
+        let mut opened = 0;
+        let mut rest = buf;
+        loop {
+            let mut messages: [BatchMessage; BATCH_RECORDS] = Default::default();
+            let mut count = 0;
+            for message in messages.iter_mut() {
+                let Some(header) = rest.first_chunk::<HEADER_SIZE>() else {
+                    break;
+                };
+                let record_len = record_size(header)?;
+                if rest.len() < record_len {
+                    break;
+                }
+                let record;
+                (record, rest) = core::mem::take(&mut rest).split_at_mut(record_len);
+                let (header, inner, tag) = split_record(record)?;
+                message.init_vector = self.next_nonce()?;
+                (message.add_data, message.data, message.tag) = (header, inner, *tag);
+                opened += record_len;
+                count += 1;
+            }
+            if count == 0 {
+                return Ok(opened);
+            }
+            let messages = &mut messages[..count];
+            self.aead
+                .open_batch(messages)
+                .map_err(|_| RecordError::BadRecordMac)?;
+            for message in messages {
+                let (content_type, payload) = unpad(core::mem::take(&mut message.data))?;
+                on_record(content_type, payload);
+            }
+        }
+    }
+
+    /// Returns an error if there aren't sequence numbers left for `records` more records
+    fn check_sequence(&self, records: usize) -> Result<(), RecordError> {
+        // the sequence number must not wrap, so the last one is never used
+        match self.sequence.checked_add(records as u64) {
+            Some(_) => Ok(()),
+            None => Err(RecordError::SequenceExhausted),
+        }
+    }
+
+    /// Returns the nonce for the next record, and moves on to the record after it
+    fn next_nonce(&mut self) -> Result<[u8; IV_SIZE], RecordError> {
+        self.check_sequence(1)?;
+        let mut nonce = self.iv;
+        for (nonce, sequence) in nonce[IV_SIZE - 8..]
+            .iter_mut()
+            .zip(self.sequence.to_be_bytes())
+        {
+            *nonce ^= sequence;
+        }
+        self.sequence += 1;
+        Ok(nonce)
+    }
+}
+
+/// Returns the space a sealed record with a payload of `len` bytes takes up
+pub const fn sealed_size(len: usize) -> usize {
+    HEADROOM + len + TAILROOM
+}
+
+/// Writes the header and content type of `record`, whose payload is already in place
+///
+/// Returns the header, the payload and content type, which are to be encrypted,
+/// and the space for the tag.
+fn prepare_record(record: &mut [u8], content_type: ContentType) -> (&[u8], &mut [u8], &mut [u8]) {
+    let (header, body) = record.split_at_mut(HEADER_SIZE);
+    write_header(header, ContentType::ApplicationData, body.len());
+    let (inner, tag) = body.split_at_mut(body.len() - TAG_SIZE);
+    // we can safely unwrap because the content type is within the record
+    *inner.last_mut().unwrap() = content_type as u8;
+    (header, inner, tag)
+}
+
+/// The header, encrypted body, and tag of a protected record
+type RecordParts<'a> = (&'a [u8; HEADER_SIZE], &'a mut [u8], &'a [u8; TAG_SIZE]);
+
+/// Splits `record`, one whole protected record, into its header, encrypted body, and tag
+fn split_record(record: &mut [u8]) -> Result<RecordParts<'_>, RecordError> {
+    let (header, body) = record
+        .split_first_chunk_mut::<HEADER_SIZE>()
+        .ok_or(RecordError::DecodeError)?;
+    if record_size(header)? != HEADER_SIZE + body.len() {
+        return Err(RecordError::DecodeError);
+    }
+    if header[0] != ContentType::ApplicationData as u8 {
+        return Err(RecordError::UnexpectedMessage);
+    }
+    let (inner, tag) = body
+        .split_last_chunk_mut::<TAG_SIZE>()
+        .filter(|(inner, _)| !inner.is_empty())
+        .ok_or(RecordError::DecodeError)?;
+    Ok((header, inner, tag))
+}
+
+/// Strips the padding from `inner`, a decrypted body,
+/// and returns the content type and payload it holds
+fn unpad(inner: &mut [u8]) -> Result<(ContentType, &mut [u8]), RecordError> {
+    // the content type is the last byte that isn't padding
+    let len = inner
+        .iter()
+        .rposition(|&byte| byte != 0)
+        .ok_or(RecordError::UnexpectedMessage)?;
+    let content_type = ContentType::from_byte(inner[len]).ok_or(RecordError::UnexpectedMessage)?;
+    if len > MAX_PLAINTEXT_SIZE {
+        return Err(RecordError::RecordOverflow);
+    }
+    Ok((content_type, &mut inner[..len]))
+}
+
+/// Returns the size of the record that starts with `header`, header included
+///
+/// # Errors
+///
+/// This function will return an error if the record is too long,
+/// or if the header is of a record that can't be TLS 1.3.
+pub fn record_size(header: &[u8; HEADER_SIZE]) -> Result<usize, RecordError> {
+    if ContentType::from_byte(header[0]).is_none() {
+        return Err(RecordError::UnexpectedMessage);
+    }
+    // some clients send their first record with a version of TLS 1.0
+    if header[1] != 0x03 || !matches!(header[2], 0x01..=0x03) {
+        return Err(RecordError::DecodeError);
+    }
+    let len = u16::from_be_bytes([header[3], header[4]]) as usize;
+    if len > MAX_CIPHERTEXT_SIZE {
+        return Err(RecordError::RecordOverflow);
+    }
+    Ok(HEADER_SIZE + len)
+}
+
+/// Writes the header of an unprotected record of `content_type` in front of the first `len`
+/// bytes after [`HEADROOM`] in `buf`
+///
+/// This is used before the handshake has agreed on keys. Returns the length of the record.
+///
+/// # Errors
+///
+/// This function will return an error if `len` is more than [`MAX_PLAINTEXT_SIZE`],
+/// or if `buf` is shorter than [`HEADROOM`] + `len`.
+pub fn write_plaintext(
+    buf: &mut [u8],
+    len: usize,
+    content_type: ContentType,
+) -> Result<usize, RecordError> {
+    if len > MAX_PLAINTEXT_SIZE {
+        return Err(RecordError::RecordOverflow);
+    }
+    if buf.len() < HEADER_SIZE + len {
+        return Err(RecordError::BufferTooSmall);
+    }
+    write_header(buf, content_type, len);
+    Ok(HEADER_SIZE + len)
+}
+
+/// Returns the content type and payload of `record`, an unprotected record
+///
+/// # Errors
+///
+/// This function will return an error if `record` is not exactly one well-formed record.
+pub fn read_plaintext(record: &mut [u8]) -> Result<(ContentType, &mut [u8]), RecordError> {
+    let (header, payload) = record
+        .split_at_mut_checked(HEADER_SIZE)
+        .ok_or(RecordError::DecodeError)?;
+    // we can safely unwrap because `header` is guaranteed to have a length of `HEADER_SIZE`
+    let header: &[u8; HEADER_SIZE] = (&*header).try_into().unwrap();
+    if record_size(header)? != HEADER_SIZE + payload.len() {
+        return Err(RecordError::DecodeError);
+    }
+    if payload.len() > MAX_PLAINTEXT_SIZE {
+        return Err(RecordError::RecordOverflow);
+    }
+    // we can safely unwrap because `record_size` checks the content type
+    Ok((ContentType::from_byte(header[0]).unwrap(), payload))
+}
+
+fn write_header(buf: &mut [u8], content_type: ContentType, len: usize) {
+    buf[0] = content_type as u8;
+    buf[1..3].copy_from_slice(&LEGACY_VERSION);
+    buf[3..5].copy_from_slice(&(len as u16).to_be_bytes());
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn keys() -> [(TrafficKey, TrafficKey); 3] {
+        let iv = [0x5a; IV_SIZE];
+        [
+            (
+                TrafficKey::new(Aead::Aes128Gcm(Gcm::new([0x42; 16])), iv),
+                TrafficKey::new(Aead::Aes128Gcm(Gcm::new([0x42; 16])), iv),
+            ),
+            (
+                TrafficKey::new(Aead::Aes256Gcm(Gcm::new([0x42; 32])), iv),
+                TrafficKey::new(Aead::Aes256Gcm(Gcm::new([0x42; 32])), iv),
+            ),
+            (
+                TrafficKey::new(
+                    Aead::ChaCha20Poly1305(ChaCha20Poly1305::new([0x42; 32])),
+                    iv,
+                ),
+                TrafficKey::new(
+                    Aead::ChaCha20Poly1305(ChaCha20Poly1305::new([0x42; 32])),
+                    iv,
+                ),
+            ),
+        ]
+    }
+
+    #[test]
+    fn seal_open() {
+        for (mut sender, mut receiver) in keys() {
+            let mut buf = [0u8; MAX_RECORD_SIZE];
+            for len in [0, 1, 100, MAX_PLAINTEXT_SIZE] {
+                let msg: Vec<u8> = (0..len).map(|i| i as u8).collect();
+                buf[HEADROOM..][..len].copy_from_slice(&msg);
+                let record_len = sender.seal(&mut buf, len, ContentType::Handshake).unwrap();
+                assert_eq!(record_len, HEADROOM + len + TAILROOM);
+                assert_eq!(buf[..3], [23, 3, 3]);
+                if len > 0 {
+                    assert_ne!(buf[HEADROOM..][..len], msg[..]);
+                }
+                // we can safely unwrap because the header is `HEADER_SIZE` bytes long
+                assert_eq!(record_size(buf[..5].try_into().unwrap()), Ok(record_len));
+
+                let (content_type, payload) = receiver.open(&mut buf[..record_len]).unwrap();
+                assert_eq!(content_type, ContentType::Handshake);
+                assert_eq!(*payload, msg[..]);
+            }
+            assert_eq!(sender.sequence(), 4);
+            assert_eq!(receiver.sequence(), 4);
+        }
+    }
+
+    #[test]
+    fn tampered() {
+        for (mut sender, mut receiver) in keys() {
+            let mut buf = [0u8; 64];
+            let record_len = sender
+                .seal(&mut buf, 20, ContentType::ApplicationData)
+                .unwrap();
+            let mut tampered = buf;
+            tampered[HEADROOM + 3] ^= 1;
+            assert_eq!(
+                receiver.open(&mut tampered[..record_len]).unwrap_err(),
+                RecordError::BadRecordMac
+            );
+            // records can't be replayed, reordered, or truncated either
+            let mut replayed = buf;
+            assert!(receiver.open(&mut replayed[..record_len]).is_err());
+            assert_eq!(
+                receiver.open(&mut buf[..record_len - 1]).unwrap_err(),
+                RecordError::DecodeError
+            );
+        }
+    }
+
+    #[test]
+    fn padding() {
+        let (_, mut receiver) = keys().into_iter().next().unwrap();
+        let cipher = Gcm::<Aes128>::new([0x42; 16]);
+        // a handshake message of 3 bytes, followed by 10 bytes of padding
+        let mut buf = [0u8; HEADER_SIZE + 3 + 1 + 10 + TAG_SIZE];
+        let body_len = buf.len() - HEADER_SIZE;
+        write_header(&mut buf, ContentType::ApplicationData, body_len);
+        buf[HEADER_SIZE..][..4].copy_from_slice(&[1, 2, 3, ContentType::Handshake as u8]);
+        let (header, body) = buf.split_at_mut(HEADER_SIZE);
+        let (inner, tag) = body.split_at_mut(body_len - TAG_SIZE);
+        tag.copy_from_slice(&cipher.encrypt_inline(inner, header, &[0x5a; IV_SIZE]));
+
+        let (content_type, payload) = receiver.open(&mut buf).unwrap();
+        assert_eq!(content_type, ContentType::Handshake);
+        assert_eq!(payload, [1, 2, 3]);
+    }
+
+    #[test]
+    fn limits() {
+        let (mut sender, _) = keys().into_iter().next().unwrap();
+        let mut buf = [0u8; MAX_RECORD_SIZE];
+        assert_eq!(
+            sender.seal(
+                &mut buf,
+                MAX_PLAINTEXT_SIZE + 1,
+                ContentType::ApplicationData
+            ),
+            Err(RecordError::RecordOverflow)
+        );
+        assert_eq!(
+            sender.seal(
+                &mut buf[..HEADROOM + 10 + TAILROOM - 1],
+                10,
+                ContentType::Alert
+            ),
+            Err(RecordError::BufferTooSmall)
+        );
+        sender.sequence = u64::MAX;
+        assert_eq!(
+            sender.seal(&mut buf, 10, ContentType::Alert),
+            Err(RecordError::SequenceExhausted)
+        );
+
+        let len = MAX_CIPHERTEXT_SIZE + 1;
+        assert_eq!(
+            record_size(&[23, 3, 3, (len >> 8) as u8, len as u8]),
+            Err(RecordError::RecordOverflow)
+        );
+        assert_eq!(
+            record_size(&[24, 3, 3, 0, 1]),
+            Err(RecordError::UnexpectedMessage)
+        );
+        assert_eq!(
+            record_size(&[22, 3, 0, 0, 1]),
+            Err(RecordError::DecodeError)
+        );
+    }
+
+    #[test]
+    fn seal_many_open_many() {
+        const LENS: [usize; 11] = [0, 1, 16, 100, 15, 17, 1000, 3, 0, 64, 2000];
+        for ((mut sender, mut receiver), (mut single, _)) in keys().into_iter().zip(keys()) {
+            let total_len = LENS.iter().map(|&len| sealed_size(len)).sum();
+            let mut buf = vec![0u8; total_len + 7];
+            let mut expected = vec![0u8; total_len];
+            let mut offset = 0;
+            for (i, &len) in LENS.iter().enumerate() {
+                buf[offset + HEADROOM..][..len].fill(i as u8 + 1);
+                expected[offset + HEADROOM..][..len].fill(i as u8 + 1);
+                offset += single
+                    .seal(&mut expected[offset..], len, ContentType::ApplicationData)
+                    .unwrap();
+            }
+
+            let sealed_len = sender
+                .seal_many(&mut buf, &LENS, ContentType::ApplicationData)
+                .unwrap();
+            assert_eq!(sealed_len, total_len);
+            assert_eq!(buf[..total_len], expected[..]);
+            assert_eq!(sender.sequence(), LENS.len() as u64);
+
+            // only part of the last record has arrived
+            let mut records = Vec::new();
+            let opened = receiver
+                .open_many(&mut buf[..total_len - 1], |content_type, payload| {
+                    records.push((content_type, payload.to_vec()))
+                })
+                .unwrap();
+            assert_eq!(opened, total_len - sealed_size(LENS[LENS.len() - 1]));
+            assert_eq!(records.len(), LENS.len() - 1);
+            for (i, (content_type, payload)) in records.iter().enumerate() {
+                assert_eq!(*content_type, ContentType::ApplicationData);
+                assert_eq!(*payload, vec![i as u8 + 1; LENS[i]]);
+            }
+
+            let (content_type, payload) = receiver.open(&mut buf[opened..total_len]).unwrap();
+            assert_eq!(content_type, ContentType::ApplicationData);
+            assert_eq!(*payload, vec![LENS.len() as u8; LENS[LENS.len() - 1]]);
+            assert_eq!(receiver.open_many(&mut [], |_, _| ()), Ok(0));
+        }
+    }
+
+    #[test]
+    fn many_errors() {
+        for (mut sender, mut receiver) in keys() {
+            let mut buf = [0u8; 256];
+            assert_eq!(
+                sender.seal_many(&mut buf, &[100, 200], ContentType::ApplicationData),
+                Err(RecordError::BufferTooSmall)
+            );
+            assert_eq!(
+                sender.seal_many(
+                    &mut buf,
+                    &[1, MAX_PLAINTEXT_SIZE + 1],
+                    ContentType::ApplicationData
+                ),
+                Err(RecordError::RecordOverflow)
+            );
+            // nothing was sealed, so no sequence numbers were used
+            assert_eq!(sender.sequence(), 0);
+
+            let sealed_len = sender
+                .seal_many(&mut buf, &[10, 20, 30], ContentType::ApplicationData)
+                .unwrap();
+            buf[sealed_size(10) + HEADROOM + 5] ^= 1;
+            assert_eq!(
+                receiver.open_many(&mut buf[..sealed_len], |_, _| ()),
+                Err(RecordError::BadRecordMac)
+            );
+
+            sender.sequence = u64::MAX - 1;
+            assert_eq!(
+                sender.seal_many(&mut buf, &[1, 1], ContentType::ApplicationData),
+                Err(RecordError::SequenceExhausted)
+            );
+            assert_eq!(sender.sequence(), u64::MAX - 1);
+        }
+    }
+
+    #[test]
+    fn plaintext() {
+        let mut buf = [0u8; 32];
+        buf[HEADROOM..][..4].copy_from_slice(b"ping");
+        let record_len = write_plaintext(&mut buf, 4, ContentType::Handshake).unwrap();
+        assert_eq!(buf[..record_len], *b"\x16\x03\x03\x00\x04ping");
+        let (content_type, payload) = read_plaintext(&mut buf[..record_len]).unwrap();
+        assert_eq!(content_type, ContentType::Handshake);
+        assert_eq!(payload, b"ping");
+    }
+}
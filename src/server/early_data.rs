@@ -0,0 +1,389 @@
+//! Accepting early data (0-RTT), as specified in RFC 8446, sections 4.2.10 and 8
+//!
+//! A client resuming a session may send application data in its first flight, before the
+//! handshake completes, saving a round trip. That data isn't protected against replay by the
+//! handshake, so the server must only accept it once per ClientHello. It does so with a
+//! freshness check, which limits how long after it was sent a ClientHello can be accepted,
+//! and an [`AntiReplay`] filter, which keeps each ClientHello seen within that time.
+//!
+//! How much early data a client may send is set per ticket, by [`Session::max_early_data`].
+//! Once early data is accepted, [`EarlyData`] enforces the limit as it arrives.
+//!
+//! # Examples
+//!
+//! ```
+//! use turtls::server::early_data::AntiReplay;
+//! use turtls::server::ticket::Session;
+//!
+//! let anti_replay = AntiReplay::new(1 << 16, 10_000);
+//! let session = Session {
+//!     cipher_suite: 0x1301,
+//!     psk: vec![0x17; 32],
+//!     issued_at: 1_700_000_000,
+//!     lifetime: 3600,
+//!     age_add: 0x12345678,
+//!     max_early_data: 1 << 14,
+//! };
+//! let binder = [0x5a; 32];
+//! // the client reports the ticket is 2 seconds old, and it is
+//! let obfuscated_ticket_age = session.age_add.wrapping_add(2000);
+//! let now = 1_700_000_002_000;
+//!
+//! let mut early_data = anti_replay
+//!     .accept(&session, &binder, obfuscated_ticket_age, now)
+//!     .unwrap();
+//! assert!(early_data.receive(1000).is_ok());
+//! // the same ClientHello is refused the second time
+//! assert!(anti_replay.accept(&session, &binder, obfuscated_ticket_age, now).is_none());
+//! ```
+use std::hash::{BuildHasher, RandomState};
+use std::sync::atomic::{AtomicU64, Ordering};
+
+use super::ticket::Session;
+
+/// The number of bits each binder sets in the filter
+const BITS_PER_BINDER: u32 = 5;
+
+/// The epoch while the filter is moving on to a new window
+const ADVANCING: u64 = u64::MAX;
+
+/// A filter of the ClientHellos seen recently, keyed on their PSK binders
+///
+/// This is a Bloom filter, split into windows of time. A binder is remembered for as long as the
+/// window it was seen in and the next, so for at least one window, and then forgotten.
+/// Like any Bloom filter, it may report a binder it hasn't seen as seen, which only means that
+/// early data gets refused and the client sends it again after the handshake. It never reports
+/// a binder it has seen within the last window as unseen.
+///
+/// All of a binder's bits are in the same word of each window's filter, so it is looked up and
+/// added with an atomic operation on the previous window's filter and another on the current one.
+/// Two threads in the same or adjacent windows always meet on one of those words, so the filter
+/// takes no locks, and when several threads see the same binder at once, even across the start of
+/// a window, exactly one of them finds it unseen.
+///
+/// Binders seen while the filter is moving on to a new window are refused, since the filters are
+/// being cleared.
+pub struct ReplayFilter {
+    /// The filters of the current window, the previous window, and the next, which is kept clear
+    ///
+    /// The filter of window `w` is `generations[w % 3]`.
+    generations: [Box<[AtomicU64]>; 3],
+    window: u64,
+    /// The current window
+    epoch: AtomicU64,
+    hasher: RandomState,
+}
+
+impl ReplayFilter {
+    /// Creates a new [`ReplayFilter`] of `words` 64-bit words per window, with windows lasting
+    /// `window` milliseconds
+    ///
+    /// A window can hold about `words` binders before false positives become common.
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `words` or `window` is 0, or if `words` is more than
+    /// [`u32::MAX`].
+    pub fn new(words: usize, window: u64) -> Self {
+        assert!(words > 0 && window > 0, "replay filter can't be empty");
+        assert!(words <= u32::MAX as usize, "replay filter is too large");
+        Self {
+            generations: core::array::from_fn(|_| (0..words).map(|_| AtomicU64::new(0)).collect()),
+            window,
+            epoch: AtomicU64::new(0),
+            hasher: RandomState::new(),
+        }
+    }
+
+    /// Adds `binder` to the filter, returning whether it was unseen
+    ///
+    /// `now` is the current time in milliseconds, which need not be exactly the same across
+    /// threads.
+    pub fn insert(&self, binder: &[u8], now: u64) -> bool {
+        let epoch = self.advance(now / self.window);
+        if epoch == ADVANCING || now / self.window + 1 < epoch {
+            // the filters are being cleared, or this is too far behind the other threads to tell
+            return false;
+        }
+        let hash = self.hasher.hash_one(binder);
+        let words = self.generations[0].len() as u64;
+        let index = (((hash >> 32) * words) >> 32) as usize;
+        let mask = (0..BITS_PER_BINDER).fold(0, |mask, i| mask | 1 << (hash >> (6 * i) & 63));
+
+        // the binder is added to the previous window's filter too, rather than only looked up,
+        // so that a thread still in that window can't add it at the same time without seeing it
+        let previous =
+            self.generations[((epoch + 2) % 3) as usize][index].fetch_or(mask, Ordering::Relaxed);
+        if previous & mask == mask {
+            return false;
+        }
+        let current =
+            self.generations[(epoch % 3) as usize][index].fetch_or(mask, Ordering::Relaxed);
+        current & mask != mask
+    }
+
+    /// Moves the filter on to window `target`, if it is ahead, and returns the current window,
+    /// or [`ADVANCING`] if another thread is moving it on
+    fn advance(&self, target: u64) -> u64 {
+        let mut epoch = self.epoch.load(Ordering::Acquire);
+        while epoch != ADVANCING && target > epoch {
+            // the filters are cleared before the new window is published, so that nothing
+            // added in the new window is cleared
+            match self.epoch.compare_exchange_weak(
+                epoch,
+                ADVANCING,
+                Ordering::AcqRel,
+                Ordering::Acquire,
+            ) {
+                Ok(_) => {
+                    // keep the next window's filter clear, along with any whose window has passed
+                    if target == epoch + 1 {
+                        clear(&self.generations[((target + 1) % 3) as usize]);
+                    } else {
+                        self.generations.iter().for_each(|words| clear(words));
+                    }
+                    self.epoch.store(target, Ordering::Release);
+                    return target;
+                },
+                Err(current) => epoch = current,
+            }
+        }
+        epoch
+    }
+}
+
+fn clear(words: &[AtomicU64]) {
+    for word in words {
+        word.store(0, Ordering::Relaxed);
+    }
+}
+
+/// Decides whether to accept early data, by checking that each ClientHello is fresh and unseen
+pub struct AntiReplay {
+    filter: ReplayFilter,
+    tolerance: u64,
+}
+
+impl AntiReplay {
+    /// Creates a new [`AntiReplay`] that accepts a ClientHello if it arrives within `tolerance`
+    /// milliseconds of when the client's ticket age says it was sent
+    ///
+    /// The filter keeps ClientHellos for at least `tolerance` milliseconds, and can hold about
+    /// `words` of them in that time.
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `words` or `tolerance` is 0, or if `words` is more than
+    /// [`u32::MAX`].
+    pub fn new(words: usize, tolerance: u64) -> Self {
+        Self {
+            // a ClientHello is within the tolerance for twice the tolerance, from too early to
+            // too late, and the filter remembers it for at least one window
+            filter: ReplayFilter::new(words, 2 * tolerance),
+            tolerance,
+        }
+    }
+
+    /// Decides whether to accept early data on a connection resuming `session`
+    ///
+    /// `binder` is the PSK binder of the ClientHello, which must already have been verified,
+    /// `obfuscated_ticket_age` is the age the client sent with it, and `now` is the current time
+    /// in milliseconds since the Unix epoch.
+    ///
+    /// Returns the limit to enforce on the early data, or `None` if it must be refused.
+    pub fn accept(
+        &self,
+        session: &Session,
+        binder: &[u8],
+        obfuscated_ticket_age: u32,
+        now: u64,
+    ) -> Option<EarlyData> {
+        if session.max_early_data == 0 {
+            return None;
+        }
+        let age = now.checked_sub(session.issued_at.saturating_mul(1000))?;
+        let reported_age = u64::from(session.ticket_age(obfuscated_ticket_age));
+        if age.abs_diff(reported_age) > self.tolerance {
+            return None;
+        }
+        self.filter
+            .insert(binder, now)
+            .then(|| EarlyData::new(session.max_early_data))
+    }
+}
+
+/// An error that occurred while receiving early data
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub struct TooMuchEarlyData;
+
+impl core::fmt::Display for TooMuchEarlyData {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        write!(f, "client sent more early data than allowed")
+    }
+}
+
+impl std::error::Error for TooMuchEarlyData {}
+
+/// The early data a client may still send
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub struct EarlyData {
+    remaining: u32,
+}
+
+impl EarlyData {
+    /// Creates a new [`EarlyData`] that allows up to `max_early_data` bytes
+    pub fn new(max_early_data: u32) -> Self {
+        Self {
+            remaining: max_early_data,
+        }
+    }
+
+    /// Returns how many more bytes of early data are allowed
+    pub fn remaining(&self) -> u32 {
+        self.remaining
+    }
+
+    /// Counts a record of `len` bytes of early data against the limit
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if the record goes over the limit,
+    /// which is fatal to the connection and should be answered with an unexpected_message alert.
+    pub fn receive(&mut self, len: usize) -> Result<(), TooMuchEarlyData> {
+        self.remaining = u32::try_from(len)
+            .ok()
+            .and_then(|len| self.remaining.checked_sub(len))
+            .ok_or(TooMuchEarlyData)?;
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn session() -> Session {
+        Session {
+            cipher_suite: 0x1301,
+            psk: vec![0x17; 32],
+            issued_at: 1000,
+            lifetime: 3600,
+            age_add: 0x87654321,
+            max_early_data: 100,
+        }
+    }
+
+    #[test]
+    fn filter_windows() {
+        let filter = ReplayFilter::new(1024, 10);
+        assert!(filter.insert(b"first", 0));
+        assert!(!filter.insert(b"first", 5));
+        assert!(filter.insert(b"second", 12));
+        // remembered through the next window
+        assert!(!filter.insert(b"first", 19));
+        assert!(!filter.insert(b"second", 25));
+        // and forgotten after that
+        assert!(filter.insert(b"first", 20));
+        assert!(filter.insert(b"second", 49));
+        // a thread that is far behind is refused
+        assert!(!filter.insert(b"third", 10));
+        assert!(filter.insert(b"third", 30));
+        // skipping ahead several windows forgets everything
+        assert!(filter.insert(b"second", 100));
+        assert!(!filter.insert(b"second", 100));
+    }
+
+    #[test]
+    fn filter_boundary() {
+        // threads on either side of the start of a window, all seeing the same binder
+        for trial in 0..200u64 {
+            let filter = ReplayFilter::new(64, 10);
+            filter.insert(b"warm up", 0);
+            let barrier = std::sync::Barrier::new(8);
+            let accepted = std::sync::atomic::AtomicUsize::new(0);
+            std::thread::scope(|scope| {
+                for thread in 0..8 {
+                    let (filter, barrier, accepted) = (&filter, &barrier, &accepted);
+                    scope.spawn(move || {
+                        barrier.wait();
+                        let now = if thread % 2 == 0 { 9 } else { 10 };
+                        if filter.insert(&trial.to_le_bytes(), now) {
+                            accepted.fetch_add(1, Ordering::Relaxed);
+                        }
+                    });
+                }
+            });
+            assert!(accepted.into_inner() <= 1, "binder accepted twice");
+        }
+    }
+
+    #[test]
+    fn filter_concurrent() {
+        let filter = ReplayFilter::new(1 << 16, 1000);
+        let binders: Vec<[u8; 8]> = (0..1000u64).map(|i| i.to_le_bytes()).collect();
+        let accepted = std::sync::atomic::AtomicUsize::new(0);
+        std::thread::scope(|scope| {
+            for _ in 0..4 {
+                scope.spawn(|| {
+                    for binder in &binders {
+                        if filter.insert(binder, 0) {
+                            accepted.fetch_add(1, Ordering::Relaxed);
+                        }
+                    }
+                });
+            }
+        });
+        // each binder is accepted exactly once, whichever thread gets there first
+        assert_eq!(accepted.into_inner(), binders.len());
+    }
+
+    #[test]
+    fn freshness() {
+        let anti_replay = AntiReplay::new(1024, 1000);
+        let session = session();
+        let now = 1_000_000 + 5000;
+        let age_add = session.age_add;
+        let sent = |age: u32| age_add.wrapping_add(age);
+        assert!(anti_replay
+            .accept(&session, b"a", sent(5000), now)
+            .is_some());
+        assert!(anti_replay
+            .accept(&session, b"b", sent(4000), now)
+            .is_some());
+        assert!(anti_replay
+            .accept(&session, b"c", sent(6000), now)
+            .is_some());
+        assert!(anti_replay
+            .accept(&session, b"d", sent(3999), now)
+            .is_none());
+        assert!(anti_replay
+            .accept(&session, b"e", sent(6001), now)
+            .is_none());
+        assert!(anti_replay
+            .accept(&session, b"a", sent(5000), now)
+            .is_none());
+        // tickets issued in the future are refused
+        assert!(anti_replay
+            .accept(&session, b"f", sent(0), 999_999)
+            .is_none());
+
+        let mut session = session;
+        session.max_early_data = 0;
+        assert!(anti_replay
+            .accept(&session, b"g", sent(5000), now)
+            .is_none());
+    }
+
+    #[test]
+    fn limit() {
+        let mut early_data = EarlyData::new(100);
+        assert_eq!(early_data.receive(60), Ok(()));
+        assert_eq!(early_data.receive(40), Ok(()));
+        assert_eq!(early_data.remaining(), 0);
+        assert_eq!(early_data.receive(1), Err(TooMuchEarlyData));
+        assert_eq!(
+            EarlyData::new(100).receive(usize::MAX),
+            Err(TooMuchEarlyData)
+        );
+    }
+}
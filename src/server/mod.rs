@@ -1 +1,3 @@
-
+//! The server side of the handshake
+pub mod early_data;
+pub mod ticket;
@@ -0,0 +1,528 @@
+//! Session tickets, for resuming sessions with a pre-shared key, as specified in RFC 8446,
+//! section 4.6.1
+//!
+//! A resumed handshake proves knowledge of the pre-shared key from an earlier session instead of
+//! repeating the key exchange and certificate signature, so it does no asymmetric cryptography.
+//! Rather than keeping every session it has issued a ticket for, the server seals the session
+//! into the ticket itself with [`TicketKeys`], and gets it back when the client offers the
+//! ticket. The key that seals tickets should be rotated regularly; tickets sealed under the
+//! previous key still open, and older ones don't.
+//!
+//! Tickets sealed this way can be offered any number of times until they expire.
+//! To make each ticket single-use, which is required to accept early data without replay,
+//! give the [`TicketKeys`] a [`TicketCache`]. It keeps track of the tickets that have been
+//! issued but not yet used, so a ticket is accepted at most once,
+//! and the least recently issued tickets are forgotten once it is full.
+//!
+//! # Examples
+//!
+//! ```
+//! use turtls::server::ticket::{Session, TicketCache, TicketError, TicketKeys};
+//!
+//! // the keys should come from a cryptographically secure random number generator
+//! let mut keys = TicketKeys::new([0x42; 32]).single_use(TicketCache::new(16, 1024));
+//! let session = Session {
+//!     cipher_suite: 0x1301,
+//!     psk: vec![0x17; 32],
+//!     issued_at: 1_700_000_000,
+//!     lifetime: 3600,
+//!     age_add: 0x12345678,
+//!     max_early_data: 0,
+//! };
+//! let ticket = keys.seal(&session);
+//!
+//! keys.rotate([0x43; 32]);
+//! assert_eq!(keys.open(&ticket, 1_700_000_060), Ok(session));
+//! assert_eq!(keys.open(&ticket, 1_700_000_060), Err(TicketError::Reused));
+//! ```
+use std::collections::{HashSet, VecDeque};
+use std::hash::{BuildHasher, RandomState};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Mutex;
+
+use libcrypto::aes::gcm::{self, Gcm};
+use libcrypto::aes::Aes256;
+use libcrypto::zeroize::zeroize;
+
+/// The longest a ticket may be valid for, in seconds, which is 7 days
+pub const MAX_LIFETIME: u32 = 604_800;
+
+/// The size of the unencrypted prefix of a ticket, which holds the key ID and nonce
+const PREFIX_SIZE: usize = 4 + 8;
+
+/// The size of the encoded [`Session`], not counting the pre-shared key
+const STATE_SIZE: usize = 2 + 8 + 4 + 4 + 4;
+
+/// The size of a ticket's authentication tag
+const TAG_SIZE: usize = 16;
+
+/// A session that can be resumed
+#[derive(Clone, PartialEq, Eq, Debug)]
+pub struct Session {
+    /// The cipher suite of the session, which the resumed session must use the hash of
+    pub cipher_suite: u16,
+    /// The pre-shared key, derived from the resumption master secret and the ticket nonce
+    pub psk: Vec<u8>,
+    /// When the ticket was issued, in seconds since the Unix epoch
+    pub issued_at: u64,
+    /// How long the ticket is valid for, in seconds
+    ///
+    /// This is capped at [`MAX_LIFETIME`] when the ticket is sealed.
+    pub lifetime: u32,
+    /// The value the client adds to the ticket's age to obscure it
+    pub age_add: u32,
+    /// The most early data the client may send when resuming, or 0 if it may send none
+    pub max_early_data: u32,
+}
+
+impl Session {
+    /// Returns whether the ticket for this session is still valid at `now`,
+    /// in seconds since the Unix epoch
+    pub fn is_valid_at(&self, now: u64) -> bool {
+        now.checked_sub(self.issued_at)
+            .is_some_and(|age| age < u64::from(self.lifetime))
+    }
+
+    /// Returns the ticket age the client reports, in milliseconds,
+    /// given the `obfuscated_ticket_age` it sent
+    pub fn ticket_age(&self, obfuscated_ticket_age: u32) -> u32 {
+        obfuscated_ticket_age.wrapping_sub(self.age_add)
+    }
+}
+
+impl Drop for Session {
+    fn drop(&mut self) {
+        zeroize(&mut self.psk, 0);
+    }
+}
+
+/// The identifier of a ticket, unique among the tickets sealed by one [`TicketKeys`]
+pub type TicketId = [u8; PREFIX_SIZE];
+
+/// An error that occurred while opening a ticket
+///
+/// Each of these means the ticket can't be used,
+/// so the server should fall back to a full handshake.
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum TicketError {
+    /// The ticket is too short to be one
+    Malformed,
+    /// The ticket was sealed under a key that is no longer kept
+    UnknownKey,
+    /// The ticket failed to decrypt
+    BadTicket,
+    /// The ticket is past its lifetime
+    Expired,
+    /// The ticket has already been used, or was forgotten by the [`TicketCache`]
+    Reused,
+}
+
+impl core::fmt::Display for TicketError {
+    fn fmt(&self, f: &mut core::fmt::Formatter<'_>) -> core::fmt::Result {
+        match self {
+            Self::Malformed => write!(f, "ticket is malformed"),
+            Self::UnknownKey => write!(f, "ticket was sealed under an unknown key"),
+            Self::BadTicket => write!(f, "ticket failed to decrypt"),
+            Self::Expired => write!(f, "ticket has expired"),
+            Self::Reused => write!(f, "ticket has already been used"),
+        }
+    }
+}
+
+impl std::error::Error for TicketError {}
+
+impl From<gcm::BadData> for TicketError {
+    fn from(_: gcm::BadData) -> Self {
+        Self::BadTicket
+    }
+}
+
+/// A key that seals tickets, and the ID tickets sealed under it carry
+struct TicketKey {
+    id: u32,
+    cipher: Gcm<Aes256>,
+}
+
+/// The keys that seal and open tickets
+///
+/// Tickets are sealed with AES-256-GCM. The nonce of each is the ID of the key it was sealed
+/// under followed by a count of the tickets sealed under that key. The count starts at a random
+/// 64-bit value for each [`TicketKeys`] and each key, so that servers sharing a key, or a server
+/// that reloads its key after restarting, don't repeat each other's nonces.
+/// A ticket looks like this:
+///
+/// ```text
+/// | key ID | count | encrypted session | tag |
+/// |   4    |   8   |       22 + PSK    | 16  |
+/// ```
+pub struct TicketKeys {
+    current: TicketKey,
+    previous: Option<TicketKey>,
+    sealed: AtomicU64,
+    cache: Option<TicketCache>,
+}
+
+impl TicketKeys {
+    /// Creates a new [`TicketKeys`] that seals tickets under `key`
+    ///
+    /// `key` should come from a cryptographically secure random number generator.
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if the operating system can't provide randomness.
+    pub fn new(key: [u8; 32]) -> Self {
+        Self {
+            current: TicketKey {
+                id: 0,
+                cipher: Gcm::new(key),
+            },
+            previous: None,
+            sealed: AtomicU64::new(crate::random::u64()),
+            cache: None,
+        }
+    }
+
+    /// Makes every ticket single-use, keeping track of the ones not yet used in `cache`
+    pub fn single_use(mut self, cache: TicketCache) -> Self {
+        self.cache = Some(cache);
+        self
+    }
+
+    /// Seals new tickets under `key`
+    ///
+    /// Tickets sealed under the current key can still be opened, until the next rotation.
+    /// The key before that is erased.
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if the operating system can't provide randomness.
+    pub fn rotate(&mut self, key: [u8; 32]) {
+        let id = self.current.id.wrapping_add(1);
+        let current = core::mem::replace(
+            &mut self.current,
+            TicketKey {
+                id,
+                cipher: Gcm::new(key),
+            },
+        );
+        self.previous = Some(current);
+        *self.sealed.get_mut() = crate::random::u64();
+    }
+
+    /// Seals `session` into a ticket
+    ///
+    /// If the tickets are single-use, the ticket is added to the cache.
+    pub fn seal(&self, session: &Session) -> Vec<u8> {
+        // a key will never seal anywhere near 2^64 tickets, so even after the count wraps,
+        // it won't come back around to where it started
+        let count = self.sealed.fetch_add(1, Ordering::Relaxed);
+        let mut ticket =
+            Vec::with_capacity(PREFIX_SIZE + STATE_SIZE + session.psk.len() + TAG_SIZE);
+        ticket.extend_from_slice(&self.current.id.to_be_bytes());
+        ticket.extend_from_slice(&count.to_be_bytes());
+        ticket.extend_from_slice(&session.cipher_suite.to_be_bytes());
+        ticket.extend_from_slice(&session.issued_at.to_be_bytes());
+        ticket.extend_from_slice(&session.lifetime.min(MAX_LIFETIME).to_be_bytes());
+        ticket.extend_from_slice(&session.age_add.to_be_bytes());
+        ticket.extend_from_slice(&session.max_early_data.to_be_bytes());
+        ticket.extend_from_slice(&session.psk);
+
+        let (nonce, state) = ticket.split_at_mut(PREFIX_SIZE);
+        // we can safely unwrap because `nonce` is guaranteed to have a length of `PREFIX_SIZE`
+        let nonce: TicketId = (&*nonce).try_into().unwrap();
+        let tag = self.current.cipher.encrypt_inline(state, &[], &nonce);
+        ticket.extend_from_slice(&tag);
+        if let Some(cache) = &self.cache {
+            cache.insert(nonce);
+        }
+        ticket
+    }
+
+    /// Opens `ticket`, returning the session sealed in it if it is still valid at `now`,
+    /// in seconds since the Unix epoch
+    ///
+    /// If the tickets are single-use, the ticket is removed from the cache.
+    ///
+    /// # Errors
+    ///
+    /// This function will return an error if `ticket` wasn't sealed by this [`TicketKeys`] under
+    /// the current or previous key, if it has expired, or if it is single-use and not in the
+    /// cache.
+    pub fn open(&self, ticket: &[u8], now: u64) -> Result<Session, TicketError> {
+        if ticket.len() < PREFIX_SIZE + STATE_SIZE + TAG_SIZE {
+            return Err(TicketError::Malformed);
+        }
+        let (nonce, rest) = ticket.split_at(PREFIX_SIZE);
+        let (state, tag) = rest.split_at(rest.len() - TAG_SIZE);
+        // we can safely unwrap because `nonce` is guaranteed to have a length of `PREFIX_SIZE`
+        let nonce: TicketId = nonce.try_into().unwrap();
+        // we can safely unwrap because `tag` is guaranteed to have a length of `TAG_SIZE`
+        let tag: &[u8; TAG_SIZE] = tag.try_into().unwrap();
+
+        // we can safely unwrap because `nonce` is at least 4 bytes long
+        let id = u32::from_be_bytes(nonce[..4].try_into().unwrap());
+        let key = [Some(&self.current), self.previous.as_ref()]
+            .into_iter()
+            .flatten()
+            .find(|key| key.id == id)
+            .ok_or(TicketError::UnknownKey)?;
+        let mut state = state.to_vec();
+        key.cipher.decrypt_inline(&mut state, &[], &nonce, tag)?;
+
+        let session = decode_session(&state);
+        zeroize(&mut state, 0);
+        if !session.is_valid_at(now) {
+            return Err(TicketError::Expired);
+        }
+        if let Some(cache) = &self.cache {
+            if !cache.take(&nonce) {
+                return Err(TicketError::Reused);
+            }
+        }
+        Ok(session)
+    }
+}
+
+/// Decodes a session from `state`, which must be at least [`STATE_SIZE`] bytes long
+fn decode_session(state: &[u8]) -> Session {
+    let (fixed, psk) = state.split_at(STATE_SIZE);
+    // we can safely unwrap because each range is within `fixed`
+    Session {
+        cipher_suite: u16::from_be_bytes(fixed[0..2].try_into().unwrap()),
+        issued_at: u64::from_be_bytes(fixed[2..10].try_into().unwrap()),
+        lifetime: u32::from_be_bytes(fixed[10..14].try_into().unwrap()),
+        age_add: u32::from_be_bytes(fixed[14..18].try_into().unwrap()),
+        max_early_data: u32::from_be_bytes(fixed[18..22].try_into().unwrap()),
+        psk: psk.to_vec(),
+    }
+}
+
+/// The tickets that have been issued but not yet used, for single-use tickets
+///
+/// The cache is split into shards, each behind its own lock, so that connections on different
+/// threads rarely wait for each other. Each shard holds up to a fixed number of tickets, and
+/// forgets the least recently issued once it is full. Since a ticket leaves the cache when it is
+/// used, that is also the least recently used.
+pub struct TicketCache {
+    shards: Box<[Mutex<Shard>]>,
+    hasher: RandomState,
+}
+
+/// One shard of a [`TicketCache`]
+struct Shard {
+    live: HashSet<TicketId>,
+    /// The tickets in the order they were issued, including some that have since been used
+    order: VecDeque<TicketId>,
+    capacity: usize,
+}
+
+impl TicketCache {
+    /// Creates a new [`TicketCache`] of `shards` shards, each holding up to `capacity` tickets
+    ///
+    /// # Panics
+    ///
+    /// This function will panic if `shards` or `capacity` is 0.
+    pub fn new(shards: usize, capacity: usize) -> Self {
+        assert!(shards > 0 && capacity > 0, "ticket cache can't be empty");
+        Self {
+            shards: (0..shards)
+                .map(|_| {
+                    Mutex::new(Shard {
+                        live: HashSet::with_capacity(capacity),
+                        order: VecDeque::with_capacity(capacity),
+                        capacity,
+                    })
+                })
+                .collect(),
+            hasher: RandomState::new(),
+        }
+    }
+
+    fn shard(&self, id: &TicketId) -> std::sync::MutexGuard<'_, Shard> {
+        let index = self.hasher.hash_one(id) as usize % self.shards.len();
+        // a panic while the lock is held can't leave the shard inconsistent,
+        // so a poisoned lock is safe to use
+        self.shards[index]
+            .lock()
+            .unwrap_or_else(|poisoned| poisoned.into_inner())
+    }
+
+    /// Adds `id` to the cache, forgetting the least recently issued ticket if it is full
+    pub fn insert(&self, id: TicketId) {
+        let mut shard = self.shard(&id);
+        while shard.live.len() >= shard.capacity {
+            // we can safely unwrap because every live ticket is in `order`
+            let oldest = shard.order.pop_front().unwrap();
+            shard.live.remove(&oldest);
+        }
+        // drop tickets that have been used, before they outnumber the live ones
+        if shard.order.len() >= 2 * shard.capacity {
+            let Shard { live, order, .. } = &mut *shard;
+            order.retain(|id| live.contains(id));
+        }
+        shard.live.insert(id);
+        shard.order.push_back(id);
+    }
+
+    /// Removes `id` from the cache, returning whether it was there
+    pub fn take(&self, id: &TicketId) -> bool {
+        self.shard(id).live.remove(id)
+    }
+
+    /// Returns the number of tickets in the cache
+    pub fn len(&self) -> usize {
+        self.shards
+            .iter()
+            .map(|shard| {
+                shard
+                    .lock()
+                    .unwrap_or_else(|poisoned| poisoned.into_inner())
+                    .live
+                    .len()
+            })
+            .sum()
+    }
+
+    /// Returns whether the cache is empty
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn session(issued_at: u64) -> Session {
+        Session {
+            cipher_suite: 0x1302,
+            psk: (0..48).collect(),
+            issued_at,
+            lifetime: 100,
+            age_add: 0xdeadbeef,
+            max_early_data: 1 << 14,
+        }
+    }
+
+    #[test]
+    fn seal_open() {
+        let keys = TicketKeys::new([0x42; 32]);
+        let ticket = keys.seal(&session(1000));
+        assert_eq!(ticket.len(), PREFIX_SIZE + STATE_SIZE + 48 + TAG_SIZE);
+        assert_eq!(keys.open(&ticket, 1000), Ok(session(1000)));
+        // without a cache, tickets can be used more than once
+        assert_eq!(keys.open(&ticket, 1099), Ok(session(1000)));
+        assert_eq!(keys.open(&ticket, 1100), Err(TicketError::Expired));
+        assert_eq!(keys.open(&ticket, 999), Err(TicketError::Expired));
+
+        // every ticket has its own nonce
+        let other = keys.seal(&session(1000));
+        assert_ne!(ticket[..PREFIX_SIZE], other[..PREFIX_SIZE]);
+        assert_ne!(ticket[PREFIX_SIZE..], other[PREFIX_SIZE..]);
+
+        let mut long = session(1000);
+        long.lifetime = u32::MAX;
+        let ticket = keys.seal(&long);
+        assert_eq!(keys.open(&ticket, 1000).unwrap().lifetime, MAX_LIFETIME);
+    }
+
+    #[test]
+    fn shared_key() {
+        // two servers, or one server before and after a restart, sealing with the same key
+        let (first, second) = (TicketKeys::new([0x42; 32]), TicketKeys::new([0x42; 32]));
+        let (one, two) = (first.seal(&session(1000)), second.seal(&session(1000)));
+        assert_ne!(one[..PREFIX_SIZE], two[..PREFIX_SIZE]);
+        assert_ne!(one, two);
+        // but each still opens the other's tickets
+        assert_eq!(first.open(&two, 1000), Ok(session(1000)));
+        assert_eq!(second.open(&one, 1000), Ok(session(1000)));
+    }
+
+    #[test]
+    fn bad_tickets() {
+        let keys = TicketKeys::new([0x42; 32]);
+        let ticket = keys.seal(&session(1000));
+        assert_eq!(
+            keys.open(&ticket[..PREFIX_SIZE + STATE_SIZE + TAG_SIZE - 1], 1000),
+            Err(TicketError::Malformed)
+        );
+        for i in [4, PREFIX_SIZE, ticket.len() - 1] {
+            let mut tampered = ticket.clone();
+            tampered[i] ^= 1;
+            assert_eq!(keys.open(&tampered, 1000), Err(TicketError::BadTicket));
+        }
+        let mut tampered = ticket.clone();
+        tampered[3] ^= 1;
+        assert_eq!(keys.open(&tampered, 1000), Err(TicketError::UnknownKey));
+
+        let other = TicketKeys::new([0x43; 32]);
+        assert_eq!(other.open(&ticket, 1000), Err(TicketError::BadTicket));
+    }
+
+    #[test]
+    fn rotate() {
+        let mut keys = TicketKeys::new([0x42; 32]);
+        let first = keys.seal(&session(1000));
+        keys.rotate([0x43; 32]);
+        let second = keys.seal(&session(1000));
+        assert_eq!(keys.open(&first, 1000), Ok(session(1000)));
+        assert_eq!(keys.open(&second, 1000), Ok(session(1000)));
+        keys.rotate([0x44; 32]);
+        assert_eq!(keys.open(&first, 1000), Err(TicketError::UnknownKey));
+        assert_eq!(keys.open(&second, 1000), Ok(session(1000)));
+    }
+
+    #[test]
+    fn single_use() {
+        let keys = TicketKeys::new([0x42; 32]).single_use(TicketCache::new(4, 8));
+        let tickets: Vec<_> = (0..8).map(|_| keys.seal(&session(1000))).collect();
+        for ticket in &tickets {
+            assert_eq!(keys.open(ticket, 1000), Ok(session(1000)));
+            assert_eq!(keys.open(ticket, 1000), Err(TicketError::Reused));
+        }
+        assert!(keys.cache.as_ref().unwrap().is_empty());
+    }
+
+    #[test]
+    fn eviction() {
+        let cache = TicketCache::new(1, 4);
+        let ids: Vec<TicketId> = (0..6).map(|i| [i; PREFIX_SIZE]).collect();
+        for id in &ids {
+            cache.insert(*id);
+        }
+        assert_eq!(cache.len(), 4);
+        assert!(!cache.take(&ids[0]));
+        assert!(!cache.take(&ids[1]));
+        assert!(cache.take(&ids[2]));
+
+        // used tickets don't pile up
+        for i in 0..100 {
+            let id = [i + 100; PREFIX_SIZE];
+            cache.insert(id);
+            assert!(cache.take(&id));
+        }
+        let shard = cache.shards[0].lock().unwrap();
+        assert!(shard.order.len() <= 2 * shard.capacity);
+        assert_eq!(shard.live.len(), 3);
+    }
+
+    #[test]
+    fn concurrent() {
+        let keys = TicketKeys::new([0x42; 32]).single_use(TicketCache::new(8, 1024));
+        let tickets: Vec<_> = (0..64).map(|_| keys.seal(&session(1000))).collect();
+        let opened = std::sync::atomic::AtomicUsize::new(0);
+        std::thread::scope(|scope| {
+            for _ in 0..4 {
+                scope.spawn(|| {
+                    for ticket in &tickets {
+                        if keys.open(ticket, 1000).is_ok() {
+                            opened.fetch_add(1, Ordering::Relaxed);
+                        }
+                    }
+                });
+            }
+        });
+        // each ticket is accepted exactly once, whichever thread gets there first
+        assert_eq!(opened.into_inner(), tickets.len());
+    }
+}
@@ -0,0 +1,266 @@
+//! Counters of the work the library does, for finding where time goes
+//!
+//! This module is only built with the `stats` feature, so that without it the hot paths don't pay
+//! for counting. With it, each connection counts the records it seals and opens, and the same
+//! counts are kept for the whole process. How long each handshake stage takes is recorded too,
+//! and can be passed to a [trace hook](set_trace_hook) as it happens.
+//!
+//! [`snapshot`] also reports the CPU features `libcrypto` dispatches on, as
+//! [`cpu::features`](crate::cpu::features) does, so it is plain when a machine has fallen back
+//! to software AES.
+//!
+//! # Examples
+//!
+//! ```
+//! let stats = turtls::stats::snapshot();
+//! if !stats.hardware.aes {
+//!     eprintln!("AES is running in software");
+//! }
+//! ```
+use std::cell::Cell;
+use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, RwLock};
+use std::time::Duration;
+
+pub use crate::cpu::Features;
+
+use crate::offload::Operation;
+
+/// Counts of the records sealed and opened
+#[repr(C)]
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Default)]
+pub struct Counters {
+    /// The number of records sealed
+    pub records_sealed: u64,
+    /// The number of payload bytes sealed into records
+    pub bytes_sealed: u64,
+    /// The number of records opened
+    pub records_opened: u64,
+    /// The number of payload bytes opened from records
+    pub bytes_opened: u64,
+}
+
+impl Counters {
+    /// Counts `records` records with `bytes` bytes of payload sealed,
+    /// both here and for the whole process
+    pub(crate) fn sealed(&mut self, records: u64, bytes: u64) {
+        self.records_sealed += records;
+        self.bytes_sealed += bytes;
+        shard().add(RECORDS_SEALED, records, BYTES_SEALED, bytes);
+    }
+
+    /// Counts `records` records with `bytes` bytes of payload opened,
+    /// both here and for the whole process
+    pub(crate) fn opened(&mut self, records: u64, bytes: u64) {
+        self.records_opened += records;
+        self.bytes_opened += bytes;
+        shard().add(RECORDS_OPENED, records, BYTES_OPENED, bytes);
+    }
+}
+
+/// A stage of the handshake that is timed
+#[repr(u32)]
+#[derive(Clone, Copy, PartialEq, Eq, Debug)]
+pub enum Stage {
+    /// Computing a key exchange's shared secret
+    KeyExchange = 0,
+    /// Signing with the certificate's private key
+    Sign = 1,
+}
+
+/// The number of [`Stage`]s
+const STAGES: usize = 2;
+
+impl Stage {
+    /// Returns the stage `operation` is part of
+    pub fn of(operation: &Operation) -> Self {
+        match operation {
+            Operation::X25519 { .. } | Operation::P256 { .. } => Self::KeyExchange,
+            Operation::Sign { .. } => Self::Sign,
+        }
+    }
+}
+
+/// How many times a [`Stage`] ran, and how long it took in all
+#[repr(C)]
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Default)]
+pub struct StageTimes {
+    /// The number of times the stage ran
+    pub count: u64,
+    /// The total time the stage took, in nanoseconds
+    pub nanos: u64,
+}
+
+/// The counters for the whole process
+#[derive(Clone, Copy, PartialEq, Eq, Debug, Default)]
+pub struct Snapshot {
+    /// The records sealed and opened by every connection
+    pub records: Counters,
+    /// The time taken by each [`Stage`], indexed by its value
+    pub stages: [StageTimes; STAGES],
+    /// The CPU features `libcrypto` dispatches on
+    pub hardware: Features,
+}
+
+/// The indices of the counters in a [`Shard`]
+const RECORDS_SEALED: usize = 0;
+const BYTES_SEALED: usize = 1;
+const RECORDS_OPENED: usize = 2;
+const BYTES_OPENED: usize = 3;
+const STAGE_COUNT: usize = 4;
+const STAGE_NANOS: usize = STAGE_COUNT + STAGES;
+const COUNTERS: usize = STAGE_NANOS + STAGES;
+
+/// The number of copies of the process-wide counters
+///
+/// Threads are spread across them, so that threads on different cores rarely write to the same
+/// cache line.
+const SHARDS: usize = 16;
+
+/// One copy of the process-wide counters, on its own cache line
+#[repr(align(64))]
+struct Shard([AtomicU64; COUNTERS]);
+
+impl Shard {
+    fn add(&self, first: usize, first_by: u64, second: usize, second_by: u64) {
+        // the counters are independent, and only summed when read, so they need no ordering
+        self.0[first].fetch_add(first_by, Ordering::Relaxed);
+        self.0[second].fetch_add(second_by, Ordering::Relaxed);
+    }
+}
+
+static GLOBAL: [Shard; SHARDS] = [const { Shard([const { AtomicU64::new(0) }; COUNTERS]) }; SHARDS];
+
+/// Returns this thread's copy of the process-wide counters
+fn shard() -> &'static Shard {
+    static NEXT: AtomicUsize = AtomicUsize::new(0);
+    thread_local! {
+        static INDEX: Cell<usize> = const { Cell::new(usize::MAX) };
+    }
+    let index = INDEX.with(|index| {
+        if index.get() == usize::MAX {
+            index.set(NEXT.fetch_add(1, Ordering::Relaxed) % SHARDS);
+        }
+        index.get()
+    });
+    &GLOBAL[index]
+}
+
+/// Called with each handshake stage and how long it took
+pub type TraceHook = Arc<dyn Fn(Stage, Duration) + Send + Sync>;
+
+static TRACE_HOOK: RwLock<Option<TraceHook>> = RwLock::new(None);
+
+/// Sets the hook to call as each handshake stage completes, or removes it if `hook` is `None`
+///
+/// The hook is called on whichever thread ran the stage, so it should be quick.
+pub fn set_trace_hook(hook: Option<TraceHook>) {
+    // a panic while the lock is held can't leave the hook inconsistent,
+    // so a poisoned lock is safe to use
+    *TRACE_HOOK
+        .write()
+        .unwrap_or_else(|poisoned| poisoned.into_inner()) = hook;
+}
+
+/// Records that `stage` took `elapsed`, and passes it to the trace hook
+///
+/// The [`WorkerPool`](crate::offload::WorkerPool) and [`Inline`](crate::offload::Inline)
+/// offloads record the operations they run. Other [`Offload`](crate::offload::Offload)s can call
+/// this to do the same.
+pub fn record_stage(stage: Stage, elapsed: Duration) {
+    let nanos = u64::try_from(elapsed.as_nanos()).unwrap_or(u64::MAX);
+    let stage_index = stage as usize;
+    shard().add(
+        STAGE_COUNT + stage_index,
+        1,
+        STAGE_NANOS + stage_index,
+        nanos,
+    );
+    let hook = TRACE_HOOK
+        .read()
+        .unwrap_or_else(|poisoned| poisoned.into_inner())
+        .clone();
+    // the lock isn't held while calling the hook, so the hook can replace itself
+    if let Some(hook) = hook {
+        hook(stage, elapsed);
+    }
+}
+
+/// Returns the counters for the whole process
+///
+/// The counters are summed one at a time, so a snapshot taken while connections are busy may
+/// count a record without its bytes, or the other way around.
+pub fn snapshot() -> Snapshot {
+    let mut totals = [0u64; COUNTERS];
+    for shard in &GLOBAL {
+        for (total, counter) in totals.iter_mut().zip(&shard.0) {
+            *total = total.wrapping_add(counter.load(Ordering::Relaxed));
+        }
+    }
+    Snapshot {
+        records: Counters {
+            records_sealed: totals[RECORDS_SEALED],
+            bytes_sealed: totals[BYTES_SEALED],
+            records_opened: totals[RECORDS_OPENED],
+            bytes_opened: totals[BYTES_OPENED],
+        },
+        stages: core::array::from_fn(|i| StageTimes {
+            count: totals[STAGE_COUNT + i],
+            nanos: totals[STAGE_NANOS + i],
+        }),
+        hardware: crate::cpu::features(),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use std::sync::Mutex;
+
+    use super::*;
+
+    #[test]
+    fn counters() {
+        let before = snapshot().records;
+        let mut counters = Counters::default();
+        counters.sealed(2, 100);
+        counters.opened(1, 7);
+        std::thread::spawn(|| Counters::default().sealed(1, 1))
+            .join()
+            .unwrap();
+        assert_eq!(
+            counters,
+            Counters {
+                records_sealed: 2,
+                bytes_sealed: 100,
+                records_opened: 1,
+                bytes_opened: 7,
+            }
+        );
+        // other tests may be counting at the same time
+        let after = snapshot().records;
+        assert!(after.records_sealed >= before.records_sealed + 3);
+        assert!(after.bytes_sealed >= before.bytes_sealed + 101);
+        assert!(after.records_opened > before.records_opened);
+    }
+
+    #[test]
+    fn trace_hook() {
+        let traced = Arc::new(Mutex::new(Vec::new()));
+        let sink = traced.clone();
+        set_trace_hook(Some(Arc::new(move |stage, elapsed| {
+            sink.lock().unwrap().push((stage, elapsed));
+        })));
+        let before = snapshot().stages[Stage::Sign as usize];
+        record_stage(Stage::Sign, Duration::from_micros(3));
+        set_trace_hook(None);
+        record_stage(Stage::Sign, Duration::from_micros(4));
+
+        let after = snapshot().stages[Stage::Sign as usize];
+        assert!(after.count >= before.count + 2);
+        assert!(after.nanos >= before.nanos + 7000);
+        assert!(traced
+            .lock()
+            .unwrap()
+            .contains(&(Stage::Sign, Duration::from_micros(3))));
+    }
+}
@@ -0,0 +1,11 @@
+//! Restricting the hardware changes the backends of the whole process,
+//! so this runs apart from the unit tests, which check that the backends agree.
+use turtls::ffi::{turtls_hardware, turtls_restrict_hardware};
+
+#[test]
+fn restrict_hardware() {
+    let hardware = turtls_hardware();
+    assert_eq!(turtls_restrict_hardware(0), 0);
+    assert_eq!(turtls_hardware(), 0);
+    assert_eq!(turtls_restrict_hardware(u32::MAX), hardware);
+}